@@ -0,0 +1,214 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+//betauser
+
+// Benchmark of dWorldParallelQuickStep on a single large island: a collapsed building, columns
+// of boxes which lean on each other, with chains of capsules joined by ball joints lying across
+// them. Every thread count steps the same scene, the time per step and a checksum of the body
+// positions are printed. The checksum is the same for every thread count.
+//
+// Usage: demo_parallel_quickstep [columns] [height] [steps] [iterations] [tolerance]
+//
+// Build it against the ode library, for example with g++:
+//   g++ -O2 -Iode/include ode/demo/demo_parallel_quickstep.cpp -Llib -lode -lpthread
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <ode/ode.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/time.h>
+#endif
+
+static double getTime()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	timeval time;
+	gettimeofday(&time, NULL);
+	return time.tv_sec + time.tv_usec * 1e-6;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+const int maxContacts = 4;
+const dReal boxSize = 1;
+const dReal stepSize = (dReal)(1.0 / 60.0);
+
+struct Scene
+{
+	dWorldID world;
+	dSpaceID space;
+	dJointGroupID contactGroup;
+	std::vector<dBodyID> bodies;
+
+	Scene(int columns, int height, int iterations, dReal tolerance, int threadCount);
+	~Scene();
+
+	void step(bool parallel);
+	double checksum() const;
+};
+
+static void nearCallback(void* data, dGeomID geom1, dGeomID geom2)
+{
+	Scene* scene = (Scene*)data;
+
+	dBodyID body1 = dGeomGetBody(geom1);
+	dBodyID body2 = dGeomGetBody(geom2);
+	if(body1 && body2 && dAreConnectedExcluding(body1, body2, dJointTypeContact))
+		return;
+
+	dContact contacts[maxContacts];
+	int count = dCollide(geom1, geom2, maxContacts, &contacts[0].geom, sizeof(dContact));
+	for(int n = 0; n < count; n++)
+	{
+		dContact& contact = contacts[n];
+		contact.surface.mode = dContactSoftERP | dContactSoftCFM | dContactApprox1;
+		contact.surface.mu = .5f;
+		contact.surface.soft_erp = .2f;
+		contact.surface.soft_cfm = 1e-5f;
+		dJointID joint = dJointCreateContact(scene->world, scene->contactGroup, &contact);
+		dJointAttach(joint, body1, body2);
+	}
+}
+
+Scene::Scene(int columns, int height, int iterations, dReal tolerance, int threadCount)
+{
+	world = dWorldCreate();
+	dWorldSetGravity(world, 0, 0, -9.81f);
+	dWorldSetQuickStepNumIterations(world, iterations);
+	dWorldSetParallelQuickStepTolerance(world, tolerance);
+	dWorldSetQuickStepThreadCount(world, threadCount);
+	space = dHashSpaceCreate(0);
+	contactGroup = dJointGroupCreate(0);
+	dCreatePlane(space, 0, 0, 1, 0);
+
+	//columns of boxes a little closer than their size, so that all of them touch and the
+	//building is one island. every column leans a little and the building falls.
+	dRandSetSeed(1);
+	const dReal spacing = boxSize * .98f;
+	for(int y = 0; y < columns; y++)
+	{
+		for(int x = 0; x < columns; x++)
+		{
+			for(int z = 0; z < height; z++)
+			{
+				dBodyID body = dBodyCreate(world);
+				dMass mass;
+				dMassSetBox(&mass, 1, boxSize, boxSize, boxSize);
+				dBodySetMass(body, &mass);
+				dBodySetPosition(body, x * spacing + z * .02f, y * spacing,
+					boxSize * .5f + z * spacing);
+				dBodySetLinearVel(body, dRandReal() * .1f, dRandReal() * .1f, 0);
+				dGeomID geom = dCreateBox(space, boxSize, boxSize, boxSize);
+				dGeomSetBody(geom, body);
+				bodies.push_back(body);
+			}
+		}
+	}
+
+	//chains of capsules on the top, like ragdolls fallen on the building
+	const dReal top = height * spacing + boxSize * .3f;
+	const int links = columns * 2;
+	for(int y = 0; y < columns; y += 2)
+	{
+		dBodyID previous = NULL;
+		for(int n = 0; n < links; n++)
+		{
+			dBodyID body = dBodyCreate(world);
+			dMass mass;
+			dMassSetCapsule(&mass, 1, 1, .2f, .3f);
+			dBodySetMass(body, &mass);
+			dBodySetPosition(body, n * spacing * .5f, y * spacing, top);
+			dMatrix3 rotation;
+			dRFromAxisAndAngle(rotation, 0, 1, 0, M_PI * .5f);
+			dBodySetRotation(body, rotation);
+			dGeomID geom = dCreateCapsule(space, .2f, .3f);
+			dGeomSetBody(geom, body);
+			if(previous)
+			{
+				dJointID joint = dJointCreateBall(world, 0);
+				dJointAttach(joint, previous, body);
+				dJointSetBallAnchor(joint, (n - .5f) * spacing * .5f, y * spacing, top);
+			}
+			previous = body;
+			bodies.push_back(body);
+		}
+	}
+}
+
+Scene::~Scene()
+{
+	dJointGroupDestroy(contactGroup);
+	dSpaceDestroy(space);
+	dWorldDestroy(world);
+}
+
+void Scene::step(bool parallel)
+{
+	dSpaceCollide(space, this, nearCallback);
+	if(parallel)
+		dWorldParallelQuickStep(world, stepSize);
+	else
+		dWorldQuickStep(world, stepSize);
+	dJointGroupEmpty(contactGroup);
+}
+
+double Scene::checksum() const
+{
+	double sum = 0;
+	for(size_t n = 0; n < bodies.size(); n++)
+	{
+		const dReal* position = dBodyGetPosition(bodies[n]);
+		sum += position[0] + position[1] * 2 + position[2] * 3;
+	}
+	return sum;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void run(const char* name, bool parallel, int threadCount, int columns, int height,
+	int steps, int iterations, dReal tolerance)
+{
+	Scene scene(columns, height, iterations, tolerance, threadCount);
+
+	//let the building fall apart before measuring
+	for(int n = 0; n < 30; n++)
+		scene.step(parallel);
+
+	double start = getTime();
+	for(int n = 0; n < steps; n++)
+		scene.step(parallel);
+	double time = getTime() - start;
+
+	printf("%-22s threads %2d: %8.2f ms per step, checksum %.6f\n", name, threadCount,
+		time * 1000 / steps, scene.checksum());
+}
+
+int main(int argc, char** argv)
+{
+	int columns = argc > 1 ? atoi(argv[1]) : 12;
+	int height = argc > 2 ? atoi(argv[2]) : 8;
+	int steps = argc > 3 ? atoi(argv[3]) : 60;
+	int iterations = argc > 4 ? atoi(argv[4]) : 20;
+	dReal tolerance = argc > 5 ? (dReal)atof(argv[5]) : 0;
+
+	dInitODE2(0);
+
+	printf("%d bodies, %d iterations, tolerance %g\n",
+		columns * columns * height + (columns + 1) / 2 * columns * 2, iterations, (double)tolerance);
+
+	run("dWorldQuickStep", false, 1, columns, height, steps, iterations, tolerance);
+	for(int threadCount = 1; threadCount <= 16; threadCount *= 2)
+		run("dWorldParallelQuickStep", true, threadCount, columns, height, steps, iterations, tolerance);
+
+	dCloseODE();
+	return 0;
+}
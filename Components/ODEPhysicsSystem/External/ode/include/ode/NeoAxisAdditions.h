@@ -52,6 +52,14 @@ ODE_API bool DoCCDCast( NeoAxisAdditions* additions, dBodyID checkBodyID, int co
 ODE_API void SetGeomTriMeshSetRayCallback( dGeomID geomID );
 ODE_API void DoSimulationStep(NeoAxisAdditions* additions, int* collisionEventCount, 
 	CollisionEventData** collisionEvents);
+//called after the world step instead of dJointGroupEmpty of the contact joint group
+ODE_API void EndSimulationStep(NeoAxisAdditions* additions);
+//contacts of touching geom pairs are kept between the steps. contacts of the next step take the
+//impulses of the cached contacts of the same features within matchDistance (warm starting of the
+//solver, see dWorldSetQuickStepWarmStarting). the narrowphase is skipped for the pairs which moved
+//less than reuseTolerance, 0 means they must not move at all.
+ODE_API void SetContactCache( NeoAxisAdditions* additions, bool enabled, float matchDistance, 
+	float reuseTolerance );
 
 ODE_API BodyData* CreateBodyData(dBodyID bodyID);
 ODE_API void DestroyBodyData(BodyData* bodyData);
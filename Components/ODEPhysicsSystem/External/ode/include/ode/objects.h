@@ -186,6 +186,25 @@ ODE_API void dWorldImpulseToForce
 ODE_API void dWorldQuickStep (dWorldID w, dReal stepsize);
 
 
+/**
+ * @brief Step the world with QuickStep, solving the rows of each island in
+ *        parallel.
+ * @ingroup world
+ * @remarks
+ * dWorldQuickStep steps islands in parallel, which does nothing for a single
+ * large island such as a collapsed building. This stepper takes the islands
+ * one after another and solves the rows of each island by color: rows which
+ * share no body get the same color and are solved at once on the threads set
+ * by dWorldSetQuickStepThreadCount. The result does not depend on the number
+ * of threads.
+ *
+ * The iteration count is the one of dWorldSetQuickStepNumIterations, the
+ * iterations can end early with dWorldSetParallelQuickStepTolerance. For
+ * scenes of many small islands dWorldQuickStep is faster.
+ */
+ODE_API void dWorldParallelQuickStep (dWorldID w, dReal stepsize);
+
+
 /**
  * @brief Set the number of iterations that the QuickStep method performs per
  *        step.
@@ -220,6 +239,83 @@ ODE_API void dWorldSetQuickStepW (dWorldID, dReal over_relaxation);
  */
 ODE_API dReal dWorldGetQuickStepW (dWorldID);
 
+//betauser
+/**
+ * @brief Set the warm starting of the QuickStep method.
+ * @ingroup world
+ * @remarks
+ * With warm starting the solver starts from the constraint forces of the
+ * last step, scaled by this factor, instead of zero, so stacks and joints
+ * converge in fewer iterations. Contact joints are recreated every step and
+ * start from zero unless their lambda is set after creation.
+ * @param scale 0 disables warm starting (the default), 0.9 is a good value.
+ */
+ODE_API void dWorldSetQuickStepWarmStarting (dWorldID, dReal scale);
+
+/**
+ * @brief Get the warm starting scale of the QuickStep method.
+ * @ingroup world
+ */
+ODE_API dReal dWorldGetQuickStepWarmStarting (dWorldID);
+
+/**
+ * @brief Set whether the QuickStep method solves rows with SSE.
+ * @ingroup world
+ * @remarks
+ * The constraint rows are put in batches of four rows without common bodies,
+ * which are solved at once in SSE registers. The result differs from the
+ * scalar solver by the order the rows are solved in. Only single precision
+ * x86 builds have the SSE path, others ignore the setting.
+ * @param enable 0 (the default) uses the scalar solver.
+ */
+ODE_API void dWorldSetQuickStepSIMD (dWorldID, int enable);
+
+/**
+ * @brief Get whether the QuickStep method solves rows with SSE.
+ * @ingroup world
+ */
+ODE_API int dWorldGetQuickStepSIMD (dWorldID);
+
+/**
+ * @brief Set the number of threads the QuickStep method steps the islands on.
+ * @ingroup world
+ * @remarks
+ * With more than one thread all islands are found first and then stepped
+ * concurrently, the biggest ones first. Every island reorders its constraint
+ * rows with its own seed taken from the dRand() sequence in island order, so
+ * the result does not depend on the number of threads if it is more than one.
+ * The geoms of the moved bodies are updated and the moved callbacks are
+ * called on the calling thread after all islands are stepped. The same
+ * threads run the narrowphase of DoSimulationStep in NeoAxisAdditions and
+ * the rows of an island in dWorldParallelQuickStep.
+ * @param count The default is 1, which steps the islands one by one on the
+ * calling thread. 0 uses one thread per processor.
+ */
+ODE_API void dWorldSetQuickStepThreadCount (dWorldID, int count);
+
+/**
+ * @brief Get the number of threads the QuickStep method steps the islands on.
+ * @ingroup world
+ */
+ODE_API int dWorldGetQuickStepThreadCount (dWorldID);
+
+/**
+ * @brief Set when dWorldParallelQuickStep stops iterating.
+ * @ingroup world
+ * @remarks
+ * The iterations of an island end when no constraint force changed by more
+ * than the tolerance in the last iteration, or after the QuickStep iteration
+ * count.
+ * @param tolerance 0 (the default) always does all iterations.
+ */
+ODE_API void dWorldSetParallelQuickStepTolerance (dWorldID, dReal tolerance);
+
+/**
+ * @brief Get the tolerance of dWorldParallelQuickStep.
+ * @ingroup world
+ */
+ODE_API dReal dWorldGetParallelQuickStepTolerance (dWorldID);
+
 /* World contact parameter functions */
 
 /**
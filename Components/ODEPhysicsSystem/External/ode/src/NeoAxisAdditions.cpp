@@ -4,7 +4,10 @@
 #include <ode/NeoAxisAdditions.h>
 #include "collision_kernel.h"
 #include "ode/objects.h"
+#include <ode/odemath.h>
 #include "joints/joint.h"
+#include "util.h"
+#include "threadpool.h"
 
 typedef unsigned int uint;
 class NeoAxisAdditions;
@@ -26,6 +29,8 @@ struct ShapeData
 	BodyData* bodyData;
 	int shapeDictionaryIndex;
 	bool shapeTypeMesh;
+	//unique for every shape data, a new geom can be allocated at the address of a destroyed one
+	uint serial;
 
 	int contactGroup;
 	float hardness;
@@ -40,6 +45,152 @@ struct ShapeData
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
+//transform and bounds of a geom when the contacts of a pair were found
+struct ContactCacheGeomState
+{
+	dReal position[3];
+	dReal rotation[12];
+	dReal aabb[6];
+
+	//returns false for geoms which can't be compared
+	bool Get( dGeomID geom )
+	{
+		if( geom->gflags & GEOM_PLACEABLE )
+		{
+			const dReal* p = dGeomGetPosition( geom );
+			const dReal* r = dGeomGetRotation( geom );
+			for( int n = 0; n < 3; n++ )
+				position[ n ] = p[ n ];
+			for( int n = 0; n < 12; n++ )
+				rotation[ n ] = r[ n ];
+		}
+		else if( dGeomGetClass( geom ) == dPlaneClass )
+		{
+			dVector4 params;
+			dGeomPlaneGetParams( geom, params );
+			for( int n = 0; n < 3; n++ )
+				position[ n ] = params[ n ];
+			for( int n = 0; n < 12; n++ )
+				rotation[ n ] = params[ 3 ];
+		}
+		else
+			return false;
+
+		dGeomGetAABB( geom, aabb );
+		return true;
+	}
+
+	static bool IsNear( const dReal* a, const dReal* b, int count, dReal tolerance )
+	{
+		for( int n = 0; n < count; n++ )
+		{
+			//infinite bounds of planes
+			if( a[ n ] == b[ n ] )
+				continue;
+			if( !( dFabs( a[ n ] - b[ n ] ) <= tolerance ) )
+				return false;
+		}
+		return true;
+	}
+
+	bool IsNear( const ContactCacheGeomState& state, dReal tolerance ) const
+	{
+		return IsNear( position, state.position, 3, tolerance ) && 
+			IsNear( rotation, state.rotation, 12, tolerance ) && 
+			IsNear( aabb, state.aabb, 6, tolerance );
+	}
+};
+
+struct ContactCacheImpulse
+{
+	//normal and two friction rows of the contact joint
+	dReal lambda[3];
+};
+
+//the cache keeps the contacts of a pair as seen from the shape with the lower serial, the broadphase
+//reports the geoms in any order. swapping the sides negates the normal. the joint of a swapped pair
+//is attached to the bodies in the other order and dPlaneSpace of the negated normal gives the negated
+//first and the same second friction direction, the constraint rows of the normal and of the first
+//friction direction stay the same and the row of the second one is negated. when one of the bodies is
+//static the joint reverses itself and all rows stay the same.
+static void SwapContactSides( dContactGeom& contact )
+{
+	for( int n = 0; n < 3; n++ )
+		contact.normal[ n ] = -contact.normal[ n ];
+	dGeomID g = contact.g1;
+	contact.g1 = contact.g2;
+	contact.g2 = g;
+	int side = contact.side1;
+	contact.side1 = contact.side2;
+	contact.side2 = side;
+}
+
+static void SwapImpulseSides( ContactCacheImpulse& impulse, bool twoBodies )
+{
+	if( twoBodies )
+		impulse.lambda[ 2 ] = -impulse.lambda[ 2 ];
+}
+
+//contacts of a geom pair kept between the steps. the impulses of the contact joints warm start the
+//solver in the next step, the contacts are used again while the geoms stay in place.
+struct ContactCacheEntry
+{
+	int lastStep;
+	bool stateValid;
+	ContactCacheGeomState state1;
+	ContactCacheGeomState state2;
+	std::vector<dContactGeom> contacts;
+	std::vector<ContactCacheImpulse> impulses;
+
+	ContactCacheEntry()
+	{
+		lastStep = -2;
+		stateValid = false;
+	}
+};
+
+struct ContactCacheJoint
+{
+	dJointID jointID;
+	ContactCacheEntry* entry;
+	int index;
+	//the impulse is stored with swapped sides
+	bool swapImpulse;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//geom pair found by the broadphase, its contacts are in the buffer of the worker which collided it
+struct CollisionPair
+{
+	dGeomID geom1;
+	dGeomID geom2;
+	ShapeData* shapeData1;
+	ShapeData* shapeData2;
+
+	ContactCacheEntry* cache;
+	bool cacheReuse;
+	//geom1 has the higher serial, the cached contacts are seen from geom2
+	bool cacheSwapped;
+
+	int worker;
+	int contactOffset;
+	int contactCount;
+};
+
+struct CollisionWorkerContacts
+{
+	std::vector<dContactGeom> contacts;
+	int count;
+
+	CollisionWorkerContacts()
+	{
+		count = 0;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
 class NeoAxisAdditions
 {
 public:
@@ -61,6 +212,25 @@ public:
 	//collision callbacks
 	dContactGeom* contactArray;
 
+	//simulation step collision pairs
+	std::vector<CollisionPair> collisionPairs;
+	//indices in collisionPairs. pairs of geoms which keep collision state in the geom or in global
+	//data (trimeshes, heightfields) are collided by one task, the others are split in chunks.
+	std::vector<int> collisionPairsShared;
+	std::vector<int> collisionPairsParallel;
+	int collisionPairsChunkCount;
+	std::vector<CollisionWorkerContacts> collisionWorkerContacts;
+
+	//contact cache
+	bool contactCacheEnabled;
+	float contactCacheMatchDistance;
+	float contactCacheReuseTolerance;
+	int contactCacheStep;
+	std::map<std::pair<uint, uint>, ContactCacheEntry> contactCache;
+	std::vector<ContactCacheJoint> contactCacheJoints;
+	std::vector<ContactCacheImpulse> contactCacheImpulses;
+	std::vector<dContactGeom> contactCacheContacts;
+
 	//ContactGroups
 	uint contactGroupFlags[32];
 
@@ -103,6 +273,11 @@ public:
 		this->contactJointGroupID = contactJointGroupID;
 		
 		contactArray = new dContactGeom[maxContacts];
+
+		contactCacheEnabled = false;
+		contactCacheMatchDistance = 0;
+		contactCacheReuseTolerance = 0;
+		contactCacheStep = 0;
 	}
 
 	~NeoAxisAdditions()
@@ -194,6 +369,24 @@ public:
 		return true;
 	}
 
+	static bool IsGeomClassSharingCollisionState( int geomClass )
+	{
+		switch( geomClass )
+		{
+		case dSphereClass:
+		case dBoxClass:
+		case dCapsuleClass:
+		case dCylinderClass:
+		case dPlaneClass:
+		case dRayClass:
+		case dConvexClass:
+			return false;
+		}
+		//trimesh colliders cache and temporal coherence, heightfield buffers, transform final posr,
+		//user classes
+		return true;
+	}
+
 	static void CollisionCallbackStatic( void* data, dGeomID o1, dGeomID o2 )
 	{
 		NeoAxisAdditions* additions = (NeoAxisAdditions*)data;
@@ -243,116 +436,265 @@ public:
 			if( !ShapeIsContactableWithShape( shapeData1, shapeData2 ) )
 				return;
 
-			// Now actually test for collision between the two geoms.
-			// This is one of the more expensive operations.
-			int numContacts = dCollide( o1, o2, maxContacts, contactArray, sizeof( dContactGeom ) );
+			//the pair is collided later by the narrowphase, all geoms are clean at this point
+			CollisionPair pair;
+			pair.geom1 = o1;
+			pair.geom2 = o2;
+			pair.shapeData1 = shapeData1;
+			pair.shapeData2 = shapeData2;
+			pair.cache = NULL;
+			pair.cacheReuse = false;
+			pair.cacheSwapped = false;
+			pair.worker = 0;
+			pair.contactOffset = 0;
+			pair.contactCount = 0;
+
+			if( contactCacheEnabled )
+			{
+				pair.cacheSwapped = shapeData2->serial < shapeData1->serial;
+				dGeomID key1 = pair.cacheSwapped ? o2 : o1;
+				dGeomID key2 = pair.cacheSwapped ? o1 : o2;
+				ContactCacheEntry* entry = &contactCache[ std::make_pair( 
+					( pair.cacheSwapped ? shapeData2 : shapeData1 )->serial, 
+					( pair.cacheSwapped ? shapeData1 : shapeData2 )->serial ) ];
+
+				//contacts of the last step are used again when both geoms are still in place
+				if( entry->lastStep == contactCacheStep - 1 && entry->stateValid )
+				{
+					ContactCacheGeomState state1;
+					ContactCacheGeomState state2;
+					if( state1.Get( key1 ) && state2.Get( key2 ) && 
+						state1.IsNear( entry->state1, contactCacheReuseTolerance ) &&
+						state2.IsNear( entry->state2, contactCacheReuseTolerance ) )
+					{
+						pair.cacheReuse = true;
+						pair.contactCount = (int)entry->contacts.size();
+					}
+				}
 
-			// If the two objects didn't make any contacts, they weren't
-			// touching, so just return.
-			if( numContacts == 0 )
-				return;
+				entry->lastStep = contactCacheStep;
+				pair.cache = entry;
 
-			//collision event
-			dContactGeom* contact = contactArray;
-			for( int n = 0; n < numContacts; n++ )
+				if( pair.cacheReuse )
+				{
+					collisionPairs.push_back( pair );
+					return;
+				}
+			}
+
+			if( IsGeomClassSharingCollisionState( dGeomGetClass( o1 ) ) || 
+				IsGeomClassSharingCollisionState( dGeomGetClass( o2 ) ) )
 			{
-				CollisionEventData eventData;
+				collisionPairsShared.push_back( (int)collisionPairs.size() );
+			}
+			else
+				collisionPairsParallel.push_back( (int)collisionPairs.size() );
+			collisionPairs.push_back( pair );
+		}
+	}
 
-				eventData.shapeDictionaryIndex1 = shapeData1->shapeDictionaryIndex;
-				eventData.shapeDictionaryIndex2 = shapeData2->shapeDictionaryIndex;
-				eventData.position[0] = contact->pos[0];
-				eventData.position[1] = contact->pos[1];
-				eventData.position[2] = contact->pos[2];
-				eventData.normal[0] = contact->normal[0];
-				eventData.normal[1] = contact->normal[1];
-				eventData.normal[2] = contact->normal[2];
-				eventData.depth = contact->depth;
+	void CreateContacts( const CollisionPair& pair, dContactGeom* contacts, 
+		const ContactCacheImpulse* impulses )
+	{
+		ShapeData* shapeData1 = pair.shapeData1;
+		ShapeData* shapeData2 = pair.shapeData2;
+		dBodyID body1 = shapeData1->bodyData->bodyID;
+		dBodyID body2 = shapeData2->bodyData->bodyID;
+		int numContacts = pair.contactCount;
+
+		//collision event
+		dContactGeom* contact = contacts;
+		for( int n = 0; n < numContacts; n++ )
+		{
+			CollisionEventData eventData;
 
-				collisionEvents.push_back(eventData);
+			eventData.shapeDictionaryIndex1 = shapeData1->shapeDictionaryIndex;
+			eventData.shapeDictionaryIndex2 = shapeData2->shapeDictionaryIndex;
+			eventData.position[0] = contact->pos[0];
+			eventData.position[1] = contact->pos[1];
+			eventData.position[2] = contact->pos[2];
+			eventData.normal[0] = contact->normal[0];
+			eventData.normal[1] = contact->normal[1];
+			eventData.normal[2] = contact->normal[2];
+			eventData.depth = contact->depth;
 
-				contact++;
-			}
+			collisionEvents.push_back(eventData);
 
-			for( int i = 0; i < numContacts; ++i )
-			{
-				dContact tempContact = {0};
-				tempContact.surface.mode = (int)( dContactBounce | dContactSoftERP );
+			contact++;
+		}
 
-				// Average the hardness of the two materials.
-				float hardness = ( shapeData1->hardness + shapeData2->hardness ) * .5f;
+		for( int i = 0; i < numContacts; ++i )
+		{
+			dContact tempContact = {0};
+			tempContact.surface.mode = (int)( dContactBounce | dContactSoftERP );
 
-				// Convert hardness to ERP.  As hardness goes from
-				// 0.0 to 1.0, ERP goes from min to max.
-				tempContact.surface.soft_erp = hardness * ( maxERP - minERP ) + minERP;
+			// Average the hardness of the two materials.
+			float hardness = ( shapeData1->hardness + shapeData2->hardness ) * .5f;
 
-				float shape1Friction;
-				float shape2Friction;
+			// Convert hardness to ERP.  As hardness goes from
+			// 0.0 to 1.0, ERP goes from min to max.
+			tempContact.surface.soft_erp = hardness * ( maxERP - minERP ) + minERP;
+
+			float shape1Friction;
+			float shape2Friction;
+			{
+				float diffX = 0;
+				float diffY = 0;
+				float diffZ = 0;
+				if(body1)
 				{
-					float diffX = 0;
-					float diffY = 0;
-					float diffZ = 0;
-					if(body1)
-					{
-						diffX += body1->lvel[0];
-						diffY += body1->lvel[1];
-						diffZ += body1->lvel[2];
-					}
-					if(body2)
-					{
-						diffX -= body2->lvel[0];
-						diffY -= body2->lvel[1];
-						diffZ -= body2->lvel[2];
-					}
-					bool dynamic = fabsf( diffX ) > .001f || fabsf( diffY ) > .001f || 
-						fabsf( diffZ ) > .001f;
+					diffX += body1->lvel[0];
+					diffY += body1->lvel[1];
+					diffZ += body1->lvel[2];
+				}
+				if(body2)
+				{
+					diffX -= body2->lvel[0];
+					diffY -= body2->lvel[1];
+					diffZ -= body2->lvel[2];
+				}
+				bool dynamic = fabsf( diffX ) > .001f || fabsf( diffY ) > .001f || 
+					fabsf( diffZ ) > .001f;
 
-					if( dynamic )
-					{
-						shape1Friction = shapeData1->dynamicFriction;
-						shape2Friction = shapeData2->dynamicFriction;
-					}
-					else
-					{
-						shape1Friction = shapeData1->staticFriction;
-						shape2Friction = shapeData2->staticFriction;
-					}
+				if( dynamic )
+				{
+					shape1Friction = shapeData1->dynamicFriction;
+					shape2Friction = shapeData2->dynamicFriction;
+				}
+				else
+				{
+					shape1Friction = shapeData1->staticFriction;
+					shape2Friction = shapeData2->staticFriction;
 				}
+			}
+
+			// As friction goes from 0.0 to 1.0, mu goes from 0.0
+			// to max, though it is set to dInfinity when
+			// friction == 1.0.
+			//if( shape1Friction >= .999f && shape2Friction >= .999f )
+			//{
+			//	tempContact.surface.mu = dInfinity;
+			//}
+			//else
+			//{
+			float mu = shape1Friction * shape2Friction * maxFriction;
+			if( body1 && body1->mass.mass != 0 )
+				mu *= body1->mass.mass;
+			if( body2 && body2->mass.mass != 0 )
+				mu *= body2->mass.mass;
+			tempContact.surface.mu = mu;
+			//}
+
+			// calculate bounciness of the two materials.
+			float bounciness = shapeData1->bounciness * shapeData2->bounciness;
+
+			// ODE's bounce parameter, a.k.a. restitution.
+			tempContact.surface.bounce = bounciness;
+
+			// ODE's bounce_vel parameter is a threshold:
+			// the relative velocity of the two objects must be
+			// greater than this for bouncing to occur at all.
+			tempContact.surface.bounce_vel = bounceThreshold;
+
+			tempContact.geom = contacts[ i ];
+
+			dJointID contactJoint = dJointCreateContact( worldID, contactJointGroupID, 
+				&tempContact );
+			dJointAttach( contactJoint, body1, body2 );
+
+			if( pair.cache )
+			{
+				//warm start from the impulse of the same contact in the last step
+				for( int k = 0; k < 3; k++ )
+					contactJoint->lambda[ k ] = impulses[ i ].lambda[ k ];
+
+				ContactCacheJoint cacheJoint;
+				cacheJoint.jointID = contactJoint;
+				cacheJoint.entry = pair.cache;
+				cacheJoint.index = i;
+				cacheJoint.swapImpulse = pair.cacheSwapped && body1 && body2;
+				contactCacheJoints.push_back( cacheJoint );
+			}
+		}
+	}
 
-				// As friction goes from 0.0 to 1.0, mu goes from 0.0
-				// to max, though it is set to dInfinity when
-				// friction == 1.0.
-				//if( shape1Friction >= .999f && shape2Friction >= .999f )
-				//{
-				//	tempContact.surface.mu = dInfinity;
-				//}
-				//else
-				//{
-				float mu = shape1Friction * shape2Friction * maxFriction;
-				if( body1 && body1->mass.mass != 0 )
-					mu *= body1->mass.mass;
-				if( body2 && body2->mass.mass != 0 )
-					mu *= body2->mass.mass;
-				tempContact.surface.mu = mu;
-				//}
-
-				// calculate bounciness of the two materials.
-				float bounciness = shapeData1->bounciness * shapeData2->bounciness;
-
-				// ODE's bounce parameter, a.k.a. restitution.
-				tempContact.surface.bounce = bounciness;
-
-				// ODE's bounce_vel parameter is a threshold:
-				// the relative velocity of the two objects must be
-				// greater than this for bouncing to occur at all.
-				tempContact.surface.bounce_vel = bounceThreshold;
-
-				tempContact.geom = contactArray[ i ];
-
-				dJointID contactJoint = dJointCreateContact( worldID, contactJointGroupID, 
-					&tempContact );
-				dJointAttach( contactJoint, body1, body2 );
+	//contacts and impulses of the cache entry of a pair as seen from the pair, into contactCacheContacts
+	//and contactCacheImpulses
+	void GetCachedContacts( const CollisionPair& pair )
+	{
+		const ContactCacheEntry* entry = pair.cache;
+		contactCacheContacts = entry->contacts;
+		contactCacheImpulses = entry->impulses;
+		if( pair.cacheSwapped )
+		{
+			bool twoBodies = pair.shapeData1->bodyData->bodyID && pair.shapeData2->bodyData->bodyID;
+			for( size_t n = 0; n < contactCacheContacts.size(); n++ )
+			{
+				SwapContactSides( contactCacheContacts[ n ] );
+				SwapImpulseSides( contactCacheImpulses[ n ], twoBodies );
+			}
+		}
+	}
+
+	//stores new contacts of a pair in its cache entry. every contact takes the impulse of the nearest
+	//contact of the last step with the same features and a similar normal. the impulses as seen from
+	//the pair are left in contactCacheImpulses.
+	void UpdateContactCache( const CollisionPair& pair, const dContactGeom* contacts )
+	{
+		ContactCacheEntry* entry = pair.cache;
+		int count = pair.contactCount;
+		const dReal maxDistanceSquared = contactCacheMatchDistance * contactCacheMatchDistance;
+		bool twoBodies = pair.shapeData1->bodyData->bodyID && pair.shapeData2->bodyData->bodyID;
+
+		//the new contacts as seen from the shape with the lower serial
+		contactCacheContacts.assign( contacts, contacts + count );
+		if( pair.cacheSwapped )
+		{
+			for( int n = 0; n < count; n++ )
+				SwapContactSides( contactCacheContacts[ n ] );
+		}
+
+		contactCacheImpulses.resize( count );
+		for( int n = 0; n < count; n++ )
+		{
+			const dContactGeom& contact = contactCacheContacts[ n ];
+			ContactCacheImpulse& impulse = contactCacheImpulses[ n ];
+			impulse.lambda[ 0 ] = 0;
+			impulse.lambda[ 1 ] = 0;
+			impulse.lambda[ 2 ] = 0;
+
+			int nearest = -1;
+			dReal nearestDistanceSquared = maxDistanceSquared;
+			for( int m = 0; m < (int)entry->contacts.size(); m++ )
+			{
+				const dContactGeom& old = entry->contacts[ m ];
+				if( old.side1 != contact.side1 || old.side2 != contact.side2 )
+					continue;
+				if( dDOT( old.normal, contact.normal ) < REAL( 0.95 ) )
+					continue;
+				dReal diff[ 3 ] = { old.pos[ 0 ] - contact.pos[ 0 ], old.pos[ 1 ] - contact.pos[ 1 ], 
+					old.pos[ 2 ] - contact.pos[ 2 ] };
+				dReal distanceSquared = dDOT( diff, diff );
+				if( distanceSquared <= nearestDistanceSquared )
+				{
+					nearest = m;
+					nearestDistanceSquared = distanceSquared;
+				}
 			}
+			if( nearest != -1 )
+				impulse = entry->impulses[ nearest ];
 		}
+
+		entry->contacts = contactCacheContacts;
+		entry->impulses = contactCacheImpulses;
+		if( pair.cacheSwapped )
+		{
+			entry->stateValid = entry->state1.Get( pair.geom2 ) && entry->state2.Get( pair.geom1 );
+			for( int n = 0; n < count; n++ )
+				SwapImpulseSides( contactCacheImpulses[ n ], twoBodies );
+		}
+		else
+			entry->stateValid = entry->state1.Get( pair.geom1 ) && entry->state2.Get( pair.geom2 );
 	}
 
 	//!!!!! no multithread support.
@@ -661,13 +1003,106 @@ public:
 		return ccdCastFound;
 	}
 
+	void CollidePair( CollisionPair& pair, int worker )
+	{
+		CollisionWorkerContacts& workerContacts = collisionWorkerContacts[ worker ];
+		if( (int)workerContacts.contacts.size() < workerContacts.count + maxContacts )
+			workerContacts.contacts.resize( ( workerContacts.count + maxContacts ) * 2 );
+
+		pair.worker = worker;
+		pair.contactOffset = workerContacts.count;
+		pair.contactCount = dCollide( pair.geom1, pair.geom2, maxContacts, 
+			&workerContacts.contacts[ workerContacts.count ], sizeof( dContactGeom ) );
+		workerContacts.count += pair.contactCount;
+	}
+
+	static void NarrowPhaseTaskStatic( void* data, int task, int worker )
+	{
+		NeoAxisAdditions* additions = (NeoAxisAdditions*)data;
+		additions->NarrowPhaseTask( task, worker );
+	}
+
+	//task 0 collides the shared state pairs, the next ones a chunk of the other pairs each
+	void NarrowPhaseTask( int task, int worker )
+	{
+		if( task == 0 )
+		{
+			for( size_t n = 0; n < collisionPairsShared.size(); n++ )
+				CollidePair( collisionPairs[ collisionPairsShared[ n ] ], worker );
+			return;
+		}
+
+		int count = (int)collisionPairsParallel.size();
+		int start = count * ( task - 1 ) / collisionPairsChunkCount;
+		int end = count * task / collisionPairsChunkCount;
+		for( int n = start; n < end; n++ )
+			CollidePair( collisionPairs[ collisionPairsParallel[ n ] ], worker );
+	}
+
 	void DoSimulationStep(int* collisionEventCount, CollisionEventData** collisionEvents)
 	{
 		this->collisionEvents.resize(0);
 
-		// Do collision detection; add contacts to the contact joint group.
+		// Do collision detection in three steps. The broadphase gathers the geom pairs, the 
+		// narrowphase collides them on the threads of the world into the contact buffers of the 
+		// threads, then the events and contact joints are made in the order of the pairs, which 
+		// does not depend on the thread count.
+		collisionPairs.resize(0);
+		collisionPairsShared.resize(0);
+		collisionPairsParallel.resize(0);
 		dSpaceCollide( rootSpaceID, this, CollisionCallbackStatic );
 
+		dxThreadPool* pool = dxGetWorldThreadPool( worldID );
+		int threadCount = pool->getThreadCount();
+		if( (int)collisionWorkerContacts.size() < threadCount )
+			collisionWorkerContacts.resize( threadCount );
+		for( size_t n = 0; n < collisionWorkerContacts.size(); n++ )
+			collisionWorkerContacts[ n ].count = 0;
+
+		//several chunks per thread to balance the pairs of different cost
+		collisionPairsChunkCount = threadCount * 4;
+		if( collisionPairsChunkCount > (int)collisionPairsParallel.size() )
+			collisionPairsChunkCount = (int)collisionPairsParallel.size();
+		pool->run( NarrowPhaseTaskStatic, this, collisionPairsChunkCount + 1 );
+
+		for( size_t n = 0; n < collisionPairs.size(); n++ )
+		{
+			const CollisionPair& pair = collisionPairs[ n ];
+
+			if( pair.cacheReuse )
+			{
+				if( pair.contactCount )
+				{
+					GetCachedContacts( pair );
+					CreateContacts( pair, &contactCacheContacts[ 0 ], &contactCacheImpulses[ 0 ] );
+				}
+				continue;
+			}
+
+			dContactGeom* contacts = NULL;
+			if( pair.contactCount )
+				contacts = &collisionWorkerContacts[ pair.worker ].contacts[ pair.contactOffset ];
+
+			if( pair.cache )
+			{
+				UpdateContactCache( pair, contacts );
+				if( pair.contactCount )
+					CreateContacts( pair, contacts, &contactCacheImpulses[ 0 ] );
+			}
+			else if( pair.contactCount )
+				CreateContacts( pair, contacts, NULL );
+		}
+
+		//forget the pairs which are not touching anymore
+		for( std::map<std::pair<uint, uint>, ContactCacheEntry>::iterator it = 
+			contactCache.begin(); it != contactCache.end(); )
+		{
+			if( it->second.lastStep != contactCacheStep )
+				contactCache.erase( it++ );
+			else
+				it++;
+		}
+
 		*collisionEventCount = this->collisionEvents.size();
 		if(this->collisionEvents.size())
 			*collisionEvents = &this->collisionEvents[0];
@@ -675,6 +1110,33 @@ public:
 			*collisionEvents = NULL;
 	}
 
+	void EndSimulationStep()
+	{
+		//keep the impulses found by the solver for warm starting the next step
+		for( size_t n = 0; n < contactCacheJoints.size(); n++ )
+		{
+			const ContactCacheJoint& cacheJoint = contactCacheJoints[ n ];
+			ContactCacheImpulse& impulse = cacheJoint.entry->impulses[ cacheJoint.index ];
+			for( int k = 0; k < 3; k++ )
+				impulse.lambda[ k ] = cacheJoint.jointID->lambda[ k ];
+			SwapImpulseSides( impulse, cacheJoint.swapImpulse );
+		}
+		contactCacheJoints.resize(0);
+		contactCacheStep++;
+
+		// Remove all joints from the contact group.
+		dJointGroupEmpty( contactJointGroupID );
+	}
+
+	void SetContactCache( bool enabled, float matchDistance, float reuseTolerance )
+	{
+		contactCacheEnabled = enabled;
+		contactCacheMatchDistance = matchDistance;
+		contactCacheReuseTolerance = reuseTolerance;
+		if( !enabled )
+			contactCache.clear();
+	}
+
 };
 
 NeoAxisAdditions* NeoAxisAdditions::tempAdditionsForTriCallback = NULL;
@@ -742,6 +1204,17 @@ void DoSimulationStep(NeoAxisAdditions* additions, int* collisionEventCount,
 	additions->DoSimulationStep(collisionEventCount, collisionEvents);
 }
 
+void EndSimulationStep(NeoAxisAdditions* additions)
+{
+	additions->EndSimulationStep();
+}
+
+void SetContactCache( NeoAxisAdditions* additions, bool enabled, float matchDistance, 
+	float reuseTolerance )
+{
+	additions->SetContactCache(enabled, matchDistance, reuseTolerance);
+}
+
 BodyData* CreateBodyData(dBodyID bodyID)
 {
 	BodyData* bodyData = new BodyData();
@@ -771,6 +1244,8 @@ void BodyDataRemoveJoint(BodyData* bodyData, dJointID jointID)
 	}
 }
 
+static uint shapeDataSerialCounter = 0;
+
 void CreateShapeData( dGeomID geomID, BodyData* bodyData, int shapeDictionaryIndex, 
 	bool shapeTypeMesh, int contactGroup, float hardness, float bounciness, 
 	float dynamicFriction, float staticFriction)
@@ -780,6 +1255,7 @@ void CreateShapeData( dGeomID geomID, BodyData* bodyData, int shapeDictionaryInd
 	shapeData->bodyData = bodyData;
 	shapeData->shapeDictionaryIndex = shapeDictionaryIndex;
 	shapeData->shapeTypeMesh = shapeTypeMesh;
+	shapeData->serial = ++shapeDataSerialCounter;
 	shapeData->contactGroup = contactGroup;
 	shapeData->hardness = hardness;
 	shapeData->bounciness = bounciness;
@@ -98,6 +98,10 @@ struct dxDampingParameters {
 struct dxQuickStepParameters {
   int num_iterations;		// number of SOR iterations to perform
   dReal w;			// the SOR over-relaxation parameter
+  //betauser
+  dReal warm_starting;		// scale of the lambdas of the last step, 0 = off
+  int simd;			// solve the SOR rows in SSE batches where available
+  dReal tolerance;		// lambda change ending dWorldParallelQuickStep, 0 = off
 };
 
 
@@ -160,6 +164,9 @@ struct dxWorld : public dBase {
   dxContactParameters contactp;
   dxDampingParameters dampingp; // damping parameters
   dReal max_angular_speed;      // limit the angular velocity to this magnitude
+  //betauser
+  int quickstep_threads;        // threads dWorldQuickStep steps the islands on
+  struct dxStepperWorkspace *stepper_workspace; // created by the first step
 };
 
 
@@ -1564,6 +1564,9 @@ dxWorld * dWorldCreate()
 
   w->qs.num_iterations = 20;
   w->qs.w = REAL(1.3);
+  w->qs.warm_starting = 0;
+  w->qs.simd = 0;
+  w->qs.tolerance = 0;
 
   w->contactp.max_vel = dInfinity;
   w->contactp.min_depth = 0;
@@ -1574,6 +1577,10 @@ dxWorld * dWorldCreate()
   w->dampingp.angular_threshold = REAL(0.01) * REAL(0.01);  
   w->max_angular_speed = dInfinity;
 
+  //betauser
+  w->quickstep_threads = 1;
+  w->stepper_workspace = 0;
+
   return w;
 }
 
@@ -1618,6 +1625,8 @@ void dWorldDestroy (dxWorld *w)
     }
     j = nextj;
   }
+  //betauser
+  dxFreeStepperWorkspace (w);
   delete w;
 }
 
@@ -1672,7 +1681,7 @@ void dWorldStep (dWorldID w, dReal stepsize)
 {
   dUASSERT (w,"bad world argument");
   dUASSERT (stepsize > 0,"stepsize must be > 0");
-  dxProcessIslands (w,stepsize,&dInternalStepIsland);
+  dxProcessIslands (w,stepsize,&dInternalStepIsland,1,0);
 }
 
 
@@ -1680,7 +1689,16 @@ void dWorldQuickStep (dWorldID w, dReal stepsize)
 {
   dUASSERT (w,"bad world argument");
   dUASSERT (stepsize > 0,"stepsize must be > 0");
-  dxProcessIslands (w,stepsize,&dxQuickStepper);
+  dxProcessIslands (w,stepsize,&dxQuickStepper,w->quickstep_threads,1);
+}
+
+
+//betauser
+void dWorldParallelQuickStep (dWorldID w, dReal stepsize)
+{
+  dUASSERT (w,"bad world argument");
+  dUASSERT (stepsize > 0,"stepsize must be > 0");
+  dxProcessIslands (w,stepsize,&dxParallelQuickStepper,w->quickstep_threads,0);
 }
 
 
@@ -1896,6 +1914,63 @@ dReal dWorldGetQuickStepW (dWorldID w)
 }
 
 
+//betauser
+void dWorldSetQuickStepWarmStarting (dWorldID w, dReal scale)
+{
+	dAASSERT(w);
+	w->qs.warm_starting = scale;
+}
+
+
+dReal dWorldGetQuickStepWarmStarting (dWorldID w)
+{
+	dAASSERT(w);
+	return w->qs.warm_starting;
+}
+
+
+void dWorldSetQuickStepSIMD (dWorldID w, int enable)
+{
+	dAASSERT(w);
+	w->qs.simd = enable;
+}
+
+
+int dWorldGetQuickStepSIMD (dWorldID w)
+{
+	dAASSERT(w);
+	return w->qs.simd;
+}
+
+
+void dWorldSetQuickStepThreadCount (dWorldID w, int count)
+{
+	dAASSERT(w);
+	w->quickstep_threads = count;
+}
+
+
+int dWorldGetQuickStepThreadCount (dWorldID w)
+{
+	dAASSERT(w);
+	return w->quickstep_threads;
+}
+
+
+void dWorldSetParallelQuickStepTolerance (dWorldID w, dReal tolerance)
+{
+	dAASSERT(w);
+	w->qs.tolerance = tolerance;
+}
+
+
+dReal dWorldGetParallelQuickStepTolerance (dWorldID w)
+{
+	dAASSERT(w);
+	return w->qs.tolerance;
+}
+
+
 void dWorldSetContactMaxCorrectingVel (dWorldID w, dReal vel)
 {
 	dAASSERT(w);
@@ -20,6 +20,13 @@
  *                                                                       *
  *************************************************************************/
 
+//betauser
+// before the ode headers, odeconfig.h redefines malloc and free
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define ODE_SSE 1
+#include <xmmintrin.h>
+#endif
+
 #include "objects.h"
 #include "joints/joint.h"
 #include <ode/odeconfig.h>
@@ -32,8 +39,12 @@
 #include <ode/misc.h>
 #include "lcp.h"
 #include "util.h"
+#include "threadpool.h"
 
-#define ALLOCA dALLOCA16
+//betauser
+// the scratch memory comes from the context of the island, so that islands can
+// be stepped on worker threads
+#define ALLOCA(num_bytes) context->alloc (num_bytes)
 
 typedef const dReal *dRealPtr;
 typedef dReal *dRealMutablePtr;
@@ -49,6 +60,10 @@ typedef dReal *dRealMutablePtr;
 
 //#define WARM_STARTING 1
 
+//betauser: the SOR method is warm started at run time when the world has a
+// warm starting scale (dWorldSetQuickStepWarmStarting), the define above is
+// only used by the disabled CG method.
+
 
 // for the SOR method:
 // uncomment the following line to determine a new constraint-solving
@@ -66,6 +81,16 @@ typedef dReal *dRealMutablePtr;
 
 #define RANDOMLY_REORDER_CONSTRAINTS 1
 
+
+//betauser
+// for the SOR method:
+// rows without common bodies are solved four at a time with SSE when the world
+// asks for it (dWorldSetQuickStepSIMD). single precision x86 builds only.
+
+#if defined(dSINGLE) && defined(ODE_SSE)
+#define SSE_ROW_BATCHES 1
+#endif
+
 //****************************************************************************
 // special matrix multipliers
 
@@ -142,7 +167,6 @@ static void compute_invM_JT (int m, dRealMutablePtr J, dRealMutablePtr iMJ, int
 
 
 // compute out = inv(M)*J'*in.
-#if 0
 static void multiply_invM_JT (int m, int nb, dRealMutablePtr iMJ, int *jb,
 	dRealMutablePtr in, dRealMutablePtr out)
 {
@@ -162,7 +186,6 @@ static void multiply_invM_JT (int m, int nb, dRealMutablePtr iMJ, int *jb,
 		iMJ_ptr += 6;
 	}
 }
-#endif
 
 // compute out = J*in.
 
@@ -349,23 +372,538 @@ static int compare_index_error (const void *a, const void *b)
 #endif
 
 
-static void SOR_LCP (int m, int nb, dRealMutablePtr J, int *jb, dxBody * const *body,
+#ifdef SSE_ROW_BATCHES
+
+// rows solved together by the SSE path of SOR_LCP, stored component by
+// component with one lane per row. no body is used by two rows of a batch, so
+// solving the batch at once gives the same result as solving its rows one after
+// another.
+
+#define ROW_BATCH_SIZE 4
+
+// number of open batches a row is tried in before a new batch is started
+#define ROW_BATCH_SEARCH 64
+
+struct RowBatch {
+	float J[12][ROW_BATCH_SIZE];	// J scaled by Ad, 0 for a missing body 2
+	float iMJ[12][ROW_BATCH_SIZE];
+	float b[ROW_BATCH_SIZE];
+	float Ad[ROW_BATCH_SIZE];	// Ad scaled by cfm
+	float lo[ROW_BATCH_SIZE];
+	float hi[ROW_BATCH_SIZE];
+	float hicopy[ROW_BATCH_SIZE];
+	int findex[ROW_BATCH_SIZE];	// index in the batch ordered lambda
+	int b1[ROW_BATCH_SIZE];		// nb (a body with zero fc) for none
+	int b2[ROW_BATCH_SIZE];
+	int has_findex;
+	int pad[3];
+};
+
+
+// fc is kept as 8 floats per body: the linear part, the angular part and 2
+// unused. get the components of the bodies of the 4 lanes.
+static inline void gatherBodies (const float *fc8, const int *b, __m128 *f)
+{
+	__m128 a0 = _mm_load_ps (fc8 + b[0]*8);
+	__m128 a1 = _mm_load_ps (fc8 + b[1]*8);
+	__m128 a2 = _mm_load_ps (fc8 + b[2]*8);
+	__m128 a3 = _mm_load_ps (fc8 + b[3]*8);
+	_MM_TRANSPOSE4_PS (a0,a1,a2,a3);
+	f[0] = a0; f[1] = a1; f[2] = a2; f[3] = a3;
+	a0 = _mm_load_ps (fc8 + b[0]*8 + 4);
+	a1 = _mm_load_ps (fc8 + b[1]*8 + 4);
+	a2 = _mm_load_ps (fc8 + b[2]*8 + 4);
+	a3 = _mm_load_ps (fc8 + b[3]*8 + 4);
+	_MM_TRANSPOSE4_PS (a0,a1,a2,a3);
+	f[4] = a0; f[5] = a1; f[6] = a2; f[7] = a3;
+}
+
+
+static inline void scatterBodies (float *fc8, const int *b, const __m128 *f)
+{
+	__m128 a0 = f[0], a1 = f[1], a2 = f[2], a3 = f[3];
+	_MM_TRANSPOSE4_PS (a0,a1,a2,a3);
+	_mm_store_ps (fc8 + b[0]*8,a0);
+	_mm_store_ps (fc8 + b[1]*8,a1);
+	_mm_store_ps (fc8 + b[2]*8,a2);
+	_mm_store_ps (fc8 + b[3]*8,a3);
+	a0 = f[4]; a1 = f[5]; a2 = f[6]; a3 = f[7];
+	_MM_TRANSPOSE4_PS (a0,a1,a2,a3);
+	_mm_store_ps (fc8 + b[0]*8 + 4,a0);
+	_mm_store_ps (fc8 + b[1]*8 + 4,a1);
+	_mm_store_ps (fc8 + b[2]*8 + 4,a2);
+	_mm_store_ps (fc8 + b[3]*8 + 4,a3);
+}
+
+
+// the SOR iterations of SOR_LCP on row batches. J and b are scaled by Ad and
+// Ad by cfm already. a row goes to the first of the next open batches which
+// doesn't use its bodies. the batch order is shuffled instead of the rows.
+
+static void SOR_LCP_RowBatches (dxStepperContext *context, int m, int nb,
+	dRealPtr J, dRealPtr iMJ, const int *jb, dRealMutablePtr lambda,
+	dRealMutablePtr fc, dRealPtr b, dRealPtr lo, dRealPtr hi, dRealPtr hicopy,
+	dRealPtr Ad, const int *findex, int num_iterations)
+{
+	int i,j,k,l;
+
+	int *batch_rows = (int*) ALLOCA (m*ROW_BATCH_SIZE*sizeof(int));
+	int *batch_size = (int*) ALLOCA (m*sizeof(int));
+	int batch_count = 0;
+	int first_open = 0;		// batches before it are full
+
+	// the rows with findex < 0 first, like the scalar solver
+	for (int pass=0; pass<2; pass++) {
+		for (i=0; i<m; i++) {
+			if ((findex[i] >= 0) != (pass == 1)) continue;
+			int b1 = jb[i*2];
+			int b2 = jb[i*2+1];
+			int end = first_open + ROW_BATCH_SEARCH;
+			if (end > batch_count) end = batch_count;
+			for (k=first_open; k<end; k++) {
+				if (batch_size[k] == ROW_BATCH_SIZE) continue;
+				for (l=0; l<batch_size[k]; l++) {
+					int row = batch_rows[k*ROW_BATCH_SIZE + l];
+					int r1 = jb[row*2];
+					int r2 = jb[row*2+1];
+					if (r1 == b1 || r2 == b1 || (b2 >= 0 && (r1 == b2 || r2 == b2))) break;
+				}
+				if (l == batch_size[k]) break;
+			}
+			if (k >= end) {
+				k = batch_count++;
+				batch_size[k] = 0;
+			}
+			batch_rows[k*ROW_BATCH_SIZE + batch_size[k]++] = i;
+			while (first_open < batch_count && batch_size[first_open] == ROW_BATCH_SIZE)
+				first_open++;
+		}
+	}
+
+	// lambda is kept in batch order, with 0 for the padding lanes
+	int *lambda_index = (int*) ALLOCA (m*sizeof(int));
+	for (k=0; k<batch_count; k++) {
+		for (l=0; l<batch_size[k]; l++)
+			lambda_index[batch_rows[k*ROW_BATCH_SIZE + l]] = k*ROW_BATCH_SIZE + l;
+	}
+	float *lam = (float*) ALLOCA (batch_count*ROW_BATCH_SIZE*sizeof(float));
+
+	RowBatch *batch = (RowBatch*) ALLOCA (batch_count*sizeof(RowBatch));
+	for (k=0; k<batch_count; k++) {
+		RowBatch &bt = batch[k];
+		bt.has_findex = 0;
+		for (l=0; l<ROW_BATCH_SIZE; l++) {
+			if (l < batch_size[k]) {
+				int row = batch_rows[k*ROW_BATCH_SIZE + l];
+				int b2 = jb[row*2+1];
+				for (j=0; j<12; j++) {
+					bool used = j < 6 || b2 >= 0;
+					bt.J[j][l] = used ? J[row*12+j] : 0;
+					bt.iMJ[j][l] = used ? iMJ[row*12+j] : 0;
+				}
+				bt.b[l] = b[row];
+				bt.Ad[l] = Ad[row];
+				bt.lo[l] = lo[row];
+				bt.hi[l] = hi[row];
+				bt.hicopy[l] = hicopy[row];
+				bt.findex[l] = findex[row] >= 0 ? lambda_index[findex[row]] : -1;
+				lam[k*ROW_BATCH_SIZE + l] = lambda[row];
+				if (findex[row] >= 0) bt.has_findex = 1;
+				bt.b1[l] = jb[row*2];
+				bt.b2[l] = b2 >= 0 ? b2 : nb;
+			}
+			else {
+				for (j=0; j<12; j++) {
+					bt.J[j][l] = 0;
+					bt.iMJ[j][l] = 0;
+				}
+				bt.b[l] = 0;
+				bt.Ad[l] = 0;
+				bt.lo[l] = 0;
+				bt.hi[l] = 0;
+				bt.hicopy[l] = 0;
+				bt.findex[l] = -1;
+				lam[k*ROW_BATCH_SIZE + l] = 0;
+				bt.b1[l] = nb;
+				bt.b2[l] = nb;
+			}
+		}
+	}
+
+	// fc with the empty body
+	float *fc8 = (float*) ALLOCA ((nb+1)*8*sizeof(float));
+	for (i=0; i<nb; i++) {
+		for (j=0; j<6; j++) fc8[i*8+j] = fc[i*6+j];
+		fc8[i*8+6] = 0;
+		fc8[i*8+7] = 0;
+	}
+	for (j=0; j<8; j++) fc8[nb*8+j] = 0;
+
+	int *order = (int*) ALLOCA (batch_count*sizeof(int));
+	for (k=0; k<batch_count; k++) order[k] = k;
+
+	for (int iteration=0; iteration < num_iterations; iteration++) {
+
+#ifdef RANDOMLY_REORDER_CONSTRAINTS
+		if ((iteration & 7) == 0) {
+			for (k=1; k<batch_count; ++k) {
+				int tmp = order[k];
+				int swapk = context->randInt(k+1);
+				order[k] = order[swapk];
+				order[swapk] = tmp;
+			}
+		}
+#endif
+
+		for (int n=0; n<batch_count; n++) {
+			const RowBatch &bt = batch[order[n]];
+			float *bt_lambda = lam + order[n]*ROW_BATCH_SIZE;
+
+			__m128 vlo = _mm_load_ps (bt.lo);
+			__m128 vhi = _mm_load_ps (bt.hi);
+			if (bt.has_findex) {
+				// limits of the friction rows from the current normal lambda
+				dReal h[ROW_BATCH_SIZE], g[ROW_BATCH_SIZE];
+				for (l=0; l<ROW_BATCH_SIZE; l++) {
+					if (bt.findex[l] >= 0) {
+						h[l] = dFabs (bt.hicopy[l] * lam[bt.findex[l]]);
+						g[l] = -h[l];
+					}
+					else {
+						h[l] = bt.hi[l];
+						g[l] = bt.lo[l];
+					}
+				}
+				vlo = _mm_loadu_ps (g);
+				vhi = _mm_loadu_ps (h);
+			}
+
+			__m128 f1[8], f2[8];
+			gatherBodies (fc8,bt.b1,f1);
+			gatherBodies (fc8,bt.b2,f2);
+
+			__m128 old_lambda = _mm_load_ps (bt_lambda);
+			__m128 delta = _mm_sub_ps (_mm_load_ps (bt.b),
+				_mm_mul_ps (old_lambda,_mm_load_ps (bt.Ad)));
+			for (j=0; j<6; j++) {
+				delta = _mm_sub_ps (delta,_mm_mul_ps (f1[j],_mm_load_ps (bt.J[j])));
+				delta = _mm_sub_ps (delta,_mm_mul_ps (f2[j],_mm_load_ps (bt.J[j+6])));
+			}
+
+			// compute lambda and clamp it to [lo,hi]
+			__m128 new_lambda = _mm_min_ps (_mm_max_ps (_mm_add_ps (old_lambda,delta),vlo),vhi);
+			delta = _mm_sub_ps (new_lambda,old_lambda);
+			_mm_store_ps (bt_lambda,new_lambda);
+
+			// update fc
+			for (j=0; j<6; j++) {
+				f1[j] = _mm_add_ps (f1[j],_mm_mul_ps (delta,_mm_load_ps (bt.iMJ[j])));
+				f2[j] = _mm_add_ps (f2[j],_mm_mul_ps (delta,_mm_load_ps (bt.iMJ[j+6])));
+			}
+			scatterBodies (fc8,bt.b1,f1);
+			scatterBodies (fc8,bt.b2,f2);
+		}
+	}
+
+	for (i=0; i<m; i++) lambda[i] = lam[lambda_index[i]];
+	for (i=0; i<nb; i++) {
+		for (j=0; j<6; j++) fc[i*6+j] = fc8[i*8+j];
+	}
+}
+
+#endif
+
+
+//betauser
+// the SOR iterations of SOR_LCP for dWorldParallelQuickStep. the rows are
+// colored so that no two rows of a color use the same body, the rows of a
+// color can then be solved at once by any number of threads with the same
+// result. the colors are solved one after another, all threads wait for each
+// other in between. the rows are copied in color order for the iterations.
+
+// rows a thread should get at least, less rows are solved on one thread
+#define COLORED_ROWS_PER_THREAD 256
+
+struct ColoredSOR {
+	int color_count;
+	const int *color_start;		// rows of color c: color_start[c] ... color_start[c+1]-1
+	const int *color_order;		// shuffled colors for every 8 iterations
+	int num_iterations;
+	dReal tolerance;
+
+	// in color order
+	const dReal *J;
+	const dReal *iMJ;
+	const int *jb;
+	const dReal *b;
+	const dReal *Ad;
+	const dReal *hicopy;
+	const int *findex;
+	dReal *lo;
+	dReal *hi;
+	dReal *lambda;
+
+	dReal *fc;
+
+	int thread_count;
+	dxThreadBarrier *barrier;
+	dReal *max_delta;		// per thread, for even and odd iterations
+};
+
+
+// solve one row, returns the change of lambda
+static inline dReal solveColoredRow (const ColoredSOR &s, int index)
+{
+	const dReal *J_ptr = s.J + index*12;
+	const dReal *iMJ_ptr = s.iMJ + index*12;
+
+	if (s.findex[index] >= 0) {
+		s.hi[index] = dFabs (s.hicopy[index] * s.lambda[s.findex[index]]);
+		s.lo[index] = -s.hi[index];
+	}
+
+	int b1 = s.jb[index*2];
+	int b2 = s.jb[index*2+1];
+	dReal delta = s.b[index] - s.lambda[index]*s.Ad[index];
+	dReal *fc_ptr = s.fc + 6*b1;
+	delta -=fc_ptr[0] * J_ptr[0] + fc_ptr[1] * J_ptr[1] +
+		fc_ptr[2] * J_ptr[2] + fc_ptr[3] * J_ptr[3] +
+		fc_ptr[4] * J_ptr[4] + fc_ptr[5] * J_ptr[5];
+	if (b2 >= 0) {
+		fc_ptr = s.fc + 6*b2;
+		delta -=fc_ptr[0] * J_ptr[6] + fc_ptr[1] * J_ptr[7] +
+			fc_ptr[2] * J_ptr[8] + fc_ptr[3] * J_ptr[9] +
+			fc_ptr[4] * J_ptr[10] + fc_ptr[5] * J_ptr[11];
+	}
+
+	// compute lambda and clamp it to [lo,hi]
+	dReal new_lambda = s.lambda[index] + delta;
+	if (new_lambda < s.lo[index]) new_lambda = s.lo[index];
+	else if (new_lambda > s.hi[index]) new_lambda = s.hi[index];
+	delta = new_lambda - s.lambda[index];
+	s.lambda[index] = new_lambda;
+
+	// update fc
+	fc_ptr = s.fc + 6*b1;
+	fc_ptr[0] += delta * iMJ_ptr[0];
+	fc_ptr[1] += delta * iMJ_ptr[1];
+	fc_ptr[2] += delta * iMJ_ptr[2];
+	fc_ptr[3] += delta * iMJ_ptr[3];
+	fc_ptr[4] += delta * iMJ_ptr[4];
+	fc_ptr[5] += delta * iMJ_ptr[5];
+	if (b2 >= 0) {
+		fc_ptr = s.fc + 6*b2;
+		fc_ptr[0] += delta * iMJ_ptr[6];
+		fc_ptr[1] += delta * iMJ_ptr[7];
+		fc_ptr[2] += delta * iMJ_ptr[8];
+		fc_ptr[3] += delta * iMJ_ptr[9];
+		fc_ptr[4] += delta * iMJ_ptr[10];
+		fc_ptr[5] += delta * iMJ_ptr[11];
+	}
+	return dFabs (delta);
+}
+
+
+// all iterations on one thread. task is the part of every color the thread
+// solves, there is one task per thread.
+static void coloredSORTask (void *data, int task, int /*worker*/)
+{
+	const ColoredSOR &s = *(const ColoredSOR*) data;
+	const int thread_count = s.thread_count;
+
+	for (int iteration=0; iteration < s.num_iterations; iteration++) {
+		const int *order = s.color_order + (iteration >> 3) * s.color_count;
+		dReal *max_delta = s.max_delta + (iteration & 1) * thread_count;
+		dReal task_max_delta = 0;
+
+		for (int n=0; n<s.color_count; n++) {
+			int start = s.color_start[order[n]];
+			int count = s.color_start[order[n]+1] - start;
+			int end = start + count*(task+1)/thread_count;
+			for (int i = start + count*task/thread_count; i<end; i++) {
+				dReal delta = solveColoredRow (s,i);
+				if (delta > task_max_delta) task_max_delta = delta;
+			}
+			if (n == s.color_count-1) max_delta[task] = task_max_delta;
+			if (thread_count > 1) s.barrier->wait();
+		}
+
+		// every thread comes to the same decision. the slots of this iteration
+		// are written again two iterations later, after the next barrier.
+		if (s.tolerance > 0) {
+			dReal iteration_max_delta = 0;
+			for (int t=0; t<thread_count; t++) {
+				if (max_delta[t] > iteration_max_delta)
+					iteration_max_delta = max_delta[t];
+			}
+			if (iteration_max_delta < s.tolerance) break;
+		}
+	}
+}
+
+
+static void SOR_LCP_Colored (dxStepperContext *context, int m, int nb,
+	dRealPtr J, dRealPtr iMJ, const int *jb, dRealMutablePtr lambda,
+	dRealMutablePtr fc, dRealPtr b, dRealPtr lo, dRealPtr hi, dRealPtr hicopy,
+	dRealPtr Ad, const int *findex, const dxQuickStepParameters *qs)
+{
+	int i;
+
+	// greedy coloring, the rows with findex < 0 first like the scalar solver.
+	// a row has less than degree(b1)+degree(b2)-1 neighbours, so twice the
+	// biggest body degree is enough colors.
+	int *degree = (int*) ALLOCA (nb*sizeof(int));
+	memset (degree,0,nb*sizeof(int));
+	for (i=0; i<m; i++) {
+		degree[jb[i*2]]++;
+		if (jb[i*2+1] >= 0) degree[jb[i*2+1]]++;
+	}
+	int max_degree = 1;
+	for (i=0; i<nb; i++) {
+		if (degree[i] > max_degree) max_degree = degree[i];
+	}
+	const int words = (2*max_degree + 31) / 32;
+	unsigned int *used = (unsigned int*) ALLOCA (nb*words*sizeof(unsigned int));
+	memset (used,0,nb*words*sizeof(unsigned int));
+
+	int *row_color = (int*) ALLOCA (m*sizeof(int));
+	int color_count = 0;
+	for (int pass=0; pass<2; pass++) {
+		for (i=0; i<m; i++) {
+			if ((findex[i] >= 0) != (pass == 1)) continue;
+			unsigned int *used1 = used + jb[i*2]*words;
+			unsigned int *used2 = jb[i*2+1] >= 0 ? used + jb[i*2+1]*words : 0;
+			int color = 0;
+			for (int w=0; w<words; w++) {
+				unsigned int free_colors = ~(used1[w] | (used2 ? used2[w] : 0));
+				if (free_colors) {
+					int bit = 0;
+					while (!(free_colors & (1u << bit))) bit++;
+					color = w*32 + bit;
+					break;
+				}
+			}
+			used1[color >> 5] |= 1u << (color & 31);
+			if (used2) used2[color >> 5] |= 1u << (color & 31);
+			row_color[i] = color;
+			if (color >= color_count) color_count = color+1;
+		}
+	}
+
+	// place of every row in color order, the rows of a color keep their order
+	int *color_start = (int*) ALLOCA ((color_count+1)*sizeof(int));
+	memset (color_start,0,(color_count+1)*sizeof(int));
+	for (i=0; i<m; i++) color_start[row_color[i]+1]++;
+	for (i=0; i<color_count; i++) color_start[i+1] += color_start[i];
+	int *place = (int*) ALLOCA (m*sizeof(int));
+	{
+		int *next = (int*) ALLOCA (color_count*sizeof(int));
+		memcpy (next,color_start,color_count*sizeof(int));
+		for (int pass=0; pass<2; pass++) {
+			for (i=0; i<m; i++) {
+				if ((findex[i] >= 0) != (pass == 1)) continue;
+				place[i] = next[row_color[i]]++;
+			}
+		}
+	}
+
+	dRealAllocaArray (cJ,m*12);
+	dRealAllocaArray (ciMJ,m*12);
+	int *cjb = (int*) ALLOCA (m*2*sizeof(int));
+	dRealAllocaArray (cb,m);
+	dRealAllocaArray (cAd,m);
+	dRealAllocaArray (chicopy,m);
+	int *cfindex = (int*) ALLOCA (m*sizeof(int));
+	dRealAllocaArray (clo,m);
+	dRealAllocaArray (chi,m);
+	dRealAllocaArray (clambda,m);
+	for (i=0; i<m; i++) {
+		int k = place[i];
+		memcpy (cJ+k*12,J+i*12,12*sizeof(dReal));
+		memcpy (ciMJ+k*12,iMJ+i*12,12*sizeof(dReal));
+		cjb[k*2] = jb[i*2];
+		cjb[k*2+1] = jb[i*2+1];
+		cb[k] = b[i];
+		cAd[k] = Ad[i];
+		chicopy[k] = hicopy[i];
+		cfindex[k] = findex[i] >= 0 ? place[findex[i]] : -1;
+		clo[k] = lo[i];
+		chi[k] = hi[i];
+		clambda[k] = lambda[i];
+	}
+
+	// shuffled colors, like the rows of the scalar solver
+	const int num_iterations = qs->num_iterations;
+	const int shuffles = (num_iterations + 7) >> 3;
+	int *color_order = (int*) ALLOCA ((shuffles > 0 ? shuffles : 1)*color_count*sizeof(int));
+	for (int n=0; n<shuffles; n++) {
+		int *order = color_order + n*color_count;
+		for (i=0; i<color_count; i++) order[i] = i;
+#ifdef RANDOMLY_REORDER_CONSTRAINTS
+		for (i=1; i<color_count; ++i) {
+			int tmp = order[i];
+			int swapi = context->randInt(i+1);
+			order[i] = order[swapi];
+			order[swapi] = tmp;
+		}
+#endif
+	}
+
+	int thread_count = context->pool ? context->pool->getThreadCount() : 1;
+	if (thread_count > m / COLORED_ROWS_PER_THREAD)
+		thread_count = m / COLORED_ROWS_PER_THREAD;
+	if (thread_count < 1) thread_count = 1;
+
+	dxThreadBarrier barrier (thread_count);
+	ColoredSOR s;
+	s.color_count = color_count;
+	s.color_start = color_start;
+	s.color_order = color_order;
+	s.num_iterations = num_iterations;
+	s.tolerance = qs->tolerance;
+	s.J = cJ;
+	s.iMJ = ciMJ;
+	s.jb = cjb;
+	s.b = cb;
+	s.Ad = cAd;
+	s.hicopy = chicopy;
+	s.findex = cfindex;
+	s.lo = clo;
+	s.hi = chi;
+	s.lambda = clambda;
+	s.fc = fc;
+	s.thread_count = thread_count;
+	s.barrier = &barrier;
+	s.max_delta = (dReal*) ALLOCA (2*thread_count*sizeof(dReal));
+
+	if (thread_count > 1)
+		context->pool->run (&coloredSORTask,&s,thread_count);
+	else
+		coloredSORTask (&s,0,0);
+
+	for (i=0; i<m; i++) lambda[i] = clambda[place[i]];
+}
+
+
+static void SOR_LCP (dxStepperContext *context, int m, int nb, dRealMutablePtr J, int *jb, dxBody * const *body,
 	dRealPtr invI, dRealMutablePtr lambda, dRealMutablePtr fc, dRealMutablePtr b,
 	dRealMutablePtr lo, dRealMutablePtr hi, dRealPtr cfm, int *findex,
-	dxQuickStepParameters *qs)
+	dxQuickStepParameters *qs, int colored)
 {
 	const int num_iterations = qs->num_iterations;
 	const dReal sor_w = qs->w;		// SOR over-relaxation parameter
 
 	int i,j;
 
-#ifdef WARM_STARTING
-	// for warm starting, this seems to be necessary to prevent
-	// jerkiness in motor-driven joints. i have no idea why this works.
-	for (i=0; i<m; i++) lambda[i] *= 0.9;
-#else
-	dSetZero (lambda,m);
-#endif
+	//betauser
+	const dReal warm_starting = qs->warm_starting;
+	if (warm_starting > 0) {
+		// for warm starting, this seems to be necessary to prevent
+		// jerkiness in motor-driven joints. i have no idea why this works.
+		for (i=0; i<m; i++) lambda[i] *= warm_starting;
+	}
+	else
+		dSetZero (lambda,m);
 
 #ifdef REORDER_CONSTRAINTS
 	// the lambda computed at the previous iteration.
@@ -383,11 +921,10 @@ static void SOR_LCP (int m, int nb, dRealMutablePtr J, int *jb, dxBody * const *
 
 	// compute fc=(inv(M)*J')*lambda. we will incrementally maintain fc
 	// as we change lambda.
-#ifdef WARM_STARTING
-	multiply_invM_JT (m,nb,iMJ,jb,lambda,fc);
-#else
-	dSetZero (fc,nb*6);
-#endif
+	if (warm_starting > 0)
+		multiply_invM_JT (m,nb,iMJ,jb,lambda,fc);
+	else
+		dSetZero (fc,nb*6);
 
 	// precompute 1 / diagonals of A
 	dRealAllocaArray (Ad,m);
@@ -417,6 +954,21 @@ static void SOR_LCP (int m, int nb, dRealMutablePtr J, int *jb, dxBody * const *
 		Ad[i] *= cfm[i];
 	}
 
+	//betauser
+	if (colored) {
+		SOR_LCP_Colored (context,m,nb,J,iMJ,jb,lambda,fc,b,lo,hi,hicopy,Ad,
+			findex,qs);
+		return;
+	}
+
+#ifdef SSE_ROW_BATCHES
+	if (qs->simd) {
+		SOR_LCP_RowBatches (context,m,nb,J,iMJ,jb,lambda,fc,b,lo,hi,hicopy,Ad,
+			findex,num_iterations);
+		return;
+	}
+#endif
+
 	// order to solve constraint rows in
 	IndexError *order = (IndexError*) ALLOCA (m*sizeof(IndexError));
 
@@ -477,7 +1029,7 @@ static void SOR_LCP (int m, int nb, dRealMutablePtr J, int *jb, dxBody * const *
 		if ((iteration & 7) == 0) {
 			for (i=1; i<m; ++i) {
 				IndexError tmp = order[i];
-				int swapi = dRandInt(i+1);
+				int swapi = context->randInt(i+1);
 				order[i] = order[swapi];
 				order[swapi] = tmp;
 			}
@@ -569,8 +1121,10 @@ static void SOR_LCP (int m, int nb, dRealMutablePtr J, int *jb, dxBody * const *
 }
 
 
-void dxQuickStepper (dxWorld *world, dxBody * const *body, int nb,
-		     dxJoint * const *_joint, int nj, dReal stepsize)
+static void quickStepIsland (dxStepperContext *context, dxWorld *world,
+			     dxBody * const *body, int nb,
+			     dxJoint * const *_joint, int nj, dReal stepsize,
+			     int colored)
 {
 	int i,j;
 	IFTIMING(dTimerStart("preprocessing");)
@@ -750,26 +1304,26 @@ void dxQuickStepper (dxWorld *world, dxBody * const *body, int nb,
 
 		// load lambda from the value saved on the previous iteration
 		dRealAllocaArray (lambda,m);
-#ifdef WARM_STARTING
-		dSetZero (lambda,m);	//@@@ shouldn't be necessary
-		for (i=0; i<nj; i++) {
-			memcpy (lambda+ofs[i],joint[i]->lambda,info[i].m * sizeof(dReal));
+		if (world->qs.warm_starting > 0) {
+			for (i=0; i<nj; i++) {
+				memcpy (lambda+ofs[i],joint[i]->lambda,info[i].m * sizeof(dReal));
+			}
 		}
-#endif
 
 		// solve the LCP problem and get lambda and invM*constraint_force
 		IFTIMING (dTimerNow ("solving LCP problem");)
 		dRealAllocaArray (cforce,nb*6);
-		SOR_LCP (m,nb,J,jb,body,invI,lambda,cforce,rhs,lo,hi,cfm,findex,&world->qs);
+		SOR_LCP (context,m,nb,J,jb,body,invI,lambda,cforce,rhs,lo,hi,cfm,findex,&world->qs,
+			 colored);
 
-#ifdef WARM_STARTING
-		// save lambda for the next iteration
-		//@@@ note that this doesn't work for contact joints yet, as they are
-		// recreated every iteration
-		for (i=0; i<nj; i++) {
-			memcpy (joint[i]->lambda,lambda+ofs[i],info[i].m * sizeof(dReal));
+		if (world->qs.warm_starting > 0) {
+			// save lambda for the next iteration. contact joints are recreated
+			// every step, their lambda is carried over by the contact cache of
+			// NeoAxisAdditions.
+			for (i=0; i<nj; i++) {
+				memcpy (joint[i]->lambda,lambda+ofs[i],info[i].m * sizeof(dReal));
+			}
 		}
-#endif
 
 		// note that the SOR method overwrites rhs and J at this point, so
 		// they should not be used again.
@@ -841,7 +1395,7 @@ void dxQuickStepper (dxWorld *world, dxBody * const *body, int nb,
 	// update the position and orientation from the new linear/angular velocity
 	// (over the given timestep)
 	IFTIMING (dTimerNow ("update position");)
-	for (i=0; i<nb; i++) dxStepBody (body[i],stepsize);
+	for (i=0; i<nb; i++) dxStepBody (context,body[i],stepsize);
 
 	IFTIMING (dTimerNow ("tidy up");)
 
@@ -854,3 +1408,20 @@ void dxQuickStepper (dxWorld *world, dxBody * const *body, int nb,
 	IFTIMING (dTimerEnd();)
 	IFTIMING (if (m > 0) dTimerReport (stdout,1);)
 }
+
+
+void dxQuickStepper (dxStepperContext *context, dxWorld *world,
+		     dxBody * const *body, int nb,
+		     dxJoint * const *_joint, int nj, dReal stepsize)
+{
+	quickStepIsland (context,world,body,nb,_joint,nj,stepsize,0);
+}
+
+
+//betauser
+void dxParallelQuickStepper (dxStepperContext *context, dxWorld *world,
+			     dxBody * const *body, int nb,
+			     dxJoint * const *_joint, int nj, dReal stepsize)
+{
+	quickStepIsland (context,world,body,nb,_joint,nj,stepsize,1);
+}
@@ -26,8 +26,17 @@
 #include <ode/common.h>
 
 
-void dxQuickStepper (dxWorld *world, dxBody * const *body, int nb,
+struct dxStepperContext;
+
+void dxQuickStepper (dxStepperContext *context, dxWorld *world,
+		     dxBody * const *body, int nb,
 		     dxJoint * const *_joint, int nj, dReal stepsize);
 
+//betauser
+// dxQuickStepper with the rows of the island solved by color on context->pool
+void dxParallelQuickStepper (dxStepperContext *context, dxWorld *world,
+			     dxBody * const *body, int nb,
+			     dxJoint * const *_joint, int nj, dReal stepsize);
+
 
 #endif
@@ -1066,7 +1066,11 @@ void dInternalStepIsland_x2 (dxWorld *world, dxBody * const *body, int nb,
 
 //****************************************************************************
 
-void dInternalStepIsland (dxWorld *world, dxBody * const *body, int nb,
+//betauser
+// always called with the serial context of dWorldStep: dSolveLCP uses the global
+// dRand() seed and alloca.
+void dInternalStepIsland (dxStepperContext *context, dxWorld *world,
+			  dxBody * const *body, int nb,
 			  dxJoint * const *joint, int nj, dReal stepsize)
 {
 
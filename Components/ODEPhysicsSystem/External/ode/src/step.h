@@ -26,7 +26,9 @@
 #include <ode/common.h>
 
 
-void dInternalStepIsland (dxWorld *world,
+struct dxStepperContext;
+
+void dInternalStepIsland (dxStepperContext *context, dxWorld *world,
 			  dxBody * const *body, int nb,
 			  dxJoint * const *joint, int nj,
 			  dReal stepsize);
@@ -0,0 +1,293 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+//betauser
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <sched.h>
+	#include <unistd.h>
+#endif
+
+#include "threadpool.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Auto-reset event.
+class dxSignal
+{
+#ifdef _WIN32
+	HANDLE event;
+#else
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool state;
+#endif
+
+public:
+
+	dxSignal()
+	{
+#ifdef _WIN32
+		event = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+		pthread_mutex_init(&mutex, NULL);
+		pthread_cond_init(&cond, NULL);
+		state = false;
+#endif
+	}
+
+	~dxSignal()
+	{
+#ifdef _WIN32
+		CloseHandle(event);
+#else
+		pthread_cond_destroy(&cond);
+		pthread_mutex_destroy(&mutex);
+#endif
+	}
+
+	void set()
+	{
+#ifdef _WIN32
+		SetEvent(event);
+#else
+		pthread_mutex_lock(&mutex);
+		state = true;
+		pthread_cond_signal(&cond);
+		pthread_mutex_unlock(&mutex);
+#endif
+	}
+
+	void wait()
+	{
+#ifdef _WIN32
+		WaitForSingleObject(event, INFINITE);
+#else
+		pthread_mutex_lock(&mutex);
+		while(!state)
+			pthread_cond_wait(&cond, &mutex);
+		state = false;
+		pthread_mutex_unlock(&mutex);
+#endif
+	}
+};
+
+static inline long atomicIncrement(volatile long* value)
+{
+#ifdef _WIN32
+	return InterlockedIncrement(value);
+#else
+	return __sync_add_and_fetch(value, 1);
+#endif
+}
+
+static inline void memoryBarrier()
+{
+#ifdef _WIN32
+	MemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+}
+
+static inline void yieldThread()
+{
+#ifdef _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct dxThreadPool::Worker
+{
+	dxThreadPool* pool;
+	int index;
+	dxSignal start;
+	dxSignal done;
+#ifdef _WIN32
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
+};
+
+dxThreadPool::dxThreadPool()
+{
+	workers = NULL;
+	thread_count = 1;
+	quit = false;
+	function = NULL;
+	data = NULL;
+	task_count = 0;
+	next_task = 0;
+}
+
+dxThreadPool::~dxThreadPool()
+{
+	shutdown();
+}
+
+int dxThreadPool::getProcessorCount()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#endif
+}
+
+bool dxThreadPool::init(int thread_count)
+{
+	shutdown();
+
+	if(thread_count <= 0)
+		thread_count = getProcessorCount();
+
+	quit = false;
+	this->thread_count = 1;
+	if(thread_count == 1)
+		return true;
+
+	//worker 0 is the calling thread and has no entry here
+	workers = new Worker[thread_count];
+	for(int i = 1; i < thread_count; i++)
+	{
+		Worker& worker = workers[i];
+		worker.pool = this;
+		worker.index = i;
+#ifdef _WIN32
+		worker.thread = CreateThread(NULL, 0, threadProc, &worker, 0, NULL);
+		if(!worker.thread)
+			break;
+#else
+		if(pthread_create(&worker.thread, NULL, threadProc, &worker) != 0)
+			break;
+#endif
+		this->thread_count++;
+	}
+
+	return this->thread_count == thread_count;
+}
+
+void dxThreadPool::shutdown()
+{
+	if(!workers)
+		return;
+
+	quit = true;
+	for(int i = 1; i < thread_count; i++)
+		workers[i].start.set();
+
+	for(int i = 1; i < thread_count; i++)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(workers[i].thread, INFINITE);
+		CloseHandle(workers[i].thread);
+#else
+		pthread_join(workers[i].thread, NULL);
+#endif
+	}
+
+	delete[] workers;
+	workers = NULL;
+	thread_count = 1;
+}
+
+void dxThreadPool::run(TaskFunction* function, void* data, int task_count)
+{
+	if(task_count <= 0)
+		return;
+
+	this->function = function;
+	this->data = data;
+	this->task_count = task_count;
+	next_task = 0;
+
+	//no point waking more workers than there are tasks
+	const int active_threads = task_count < thread_count ? task_count : thread_count;
+
+	for(int i = 1; i < active_threads; i++)
+		workers[i].start.set();
+
+	doTasks(0);
+
+	for(int i = 1; i < active_threads; i++)
+		workers[i].done.wait();
+
+	this->function = NULL;
+	this->data = NULL;
+}
+
+void dxThreadPool::doTasks(int worker)
+{
+	while(true)
+	{
+		const int task = (int)atomicIncrement(&next_task) - 1;
+		if(task >= task_count)
+			break;
+		function(data, task, worker);
+	}
+}
+
+void dxThreadPool::workerMain(Worker* worker)
+{
+	dxThreadPool* pool = worker->pool;
+	while(true)
+	{
+		worker->start.wait();
+		if(pool->quit)
+			break;
+		pool->doTasks(worker->index);
+		worker->done.set();
+	}
+}
+
+#ifdef _WIN32
+unsigned long __stdcall dxThreadPool::threadProc(void* param)
+{
+	workerMain((Worker*)param);
+	return 0;
+}
+#else
+void* dxThreadPool::threadProc(void* param)
+{
+	workerMain((Worker*)param);
+	return 0;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+dxThreadBarrier::dxThreadBarrier(int thread_count)
+{
+	this->thread_count = thread_count;
+	count = 0;
+	generation = 0;
+}
+
+void dxThreadBarrier::wait()
+{
+	const long current = generation;
+	if(atomicIncrement(&count) == thread_count)
+	{
+		//last one in releases the others
+		count = 0;
+		atomicIncrement(&generation);
+		return;
+	}
+
+	for(int spin = 0; generation == current; spin++)
+	{
+		if(spin >= 1000)
+			yieldThread();
+	}
+	//see the writes the other threads made before the barrier
+	memoryBarrier();
+}
@@ -0,0 +1,71 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+//betauser
+
+#ifndef _ODE_THREADPOOL_H_
+#define _ODE_THREADPOOL_H_
+
+#include "objects.h"
+
+// Fixed-size worker pool for running the independent tasks of one call in parallel. The calling
+// thread takes part in every run as worker 0, a pool of one thread runs all tasks inline.
+
+class dxThreadPool : public dBase
+{
+public:
+	// Called once per task, worker is in [0, getThreadCount()).
+	typedef void TaskFunction (void *data, int task, int worker);
+
+	dxThreadPool();
+	~dxThreadPool();
+
+	// Starts thread_count-1 background threads. thread_count <= 0 means one per processor.
+	bool init (int thread_count);
+	void shutdown();
+
+	int getThreadCount() const { return thread_count; }
+
+	// Runs function for every task in [0, task_count) and returns when all of them are done.
+	// Not reentrant: run() must not be called from a task.
+	void run (TaskFunction *function, void *data, int task_count);
+
+	static int getProcessorCount();
+
+private:
+	struct Worker;
+
+	void doTasks (int worker);
+	static void workerMain (Worker *worker);
+#ifdef _WIN32
+	static unsigned long __stdcall threadProc (void *param);
+#else
+	static void *threadProc (void *param);
+#endif
+
+	Worker *workers;
+	int thread_count;
+	bool quit;
+
+	TaskFunction *function;
+	void *data;
+	int task_count;
+	volatile long next_task;
+};
+
+// Barrier for the tasks of one dxThreadPool::run() which wait for each other. Every task must
+// have its own thread, so the run may have at most getThreadCount() tasks.
+
+class dxThreadBarrier
+{
+public:
+	dxThreadBarrier (int thread_count);
+
+	// Returns when all thread_count threads have called wait(). Spins, then yields.
+	void wait();
+
+private:
+	int thread_count;
+	volatile long count;
+	volatile long generation;
+};
+
+#endif
@@ -24,8 +24,7 @@
 #include "objects.h"
 #include "joints/joint.h"
 #include "util.h"
-
-#define ALLOCA dALLOCA16
+#include "threadpool.h"
 
 //****************************************************************************
 // Auto disabling
@@ -186,7 +185,7 @@ static inline dReal sinc (dReal x)
 // given a body b, apply its linear and angular rotation over the time
 // interval h, thereby adjusting its position and orientation.
 
-void dxStepBody (dxBody *b, dReal h)
+static void stepBody (dxBody *b, dReal h, int notify)
 {
   // cap the angular velocity
   if (b->flags & dxBodyMaxAngularSpeed) {
@@ -267,14 +266,8 @@ void dxStepBody (dxBody *b, dReal h)
   dNormalize4 (b->q);
   dQtoR (b->q,b->posr.R);
 
-  // notify all attached geoms that this body has moved
-  for (dxGeom *geom = b->geom; geom; geom = dGeomGetBodyNext (geom))
-    dGeomMoved (geom);
-
-  // notify the user
-  if (b->moved_callback)
-    b->moved_callback(b);
-
+  //betauser
+  if (notify) dxNotifyBodyMoved (b);
 
   // damping
   if (b->flags & dxBodyLinearDamping) {
@@ -296,6 +289,190 @@ void dxStepBody (dxBody *b, dReal h)
 
 }
 
+
+void dxStepBody (dxBody *b, dReal h)
+{
+  stepBody (b,h,1);
+}
+
+
+//betauser
+void dxStepBody (dxStepperContext *context, dxBody *b, dReal h)
+{
+  stepBody (b,h,!context->defer_moves);
+}
+
+
+void dxNotifyBodyMoved (dxBody *b)
+{
+  // notify all attached geoms that this body has moved
+  for (dxGeom *geom = b->geom; geom; geom = dGeomGetBodyNext (geom))
+    dGeomMoved (geom);
+
+  // notify the user
+  if (b->moved_callback)
+    b->moved_callback(b);
+}
+
+//betauser
+//****************************************************************************
+// stepper scratch memory and worker threads
+
+// the first block is allocated with this size, the next ones double it
+#define dSTEPPER_ARENA_BLOCK_SIZE 65536
+
+
+static size_t arenaBlockAllocSize (size_t size)
+{
+  return sizeof(dxStepperArena::Block) + size + EFFICIENT_ALIGNMENT;
+}
+
+
+dxStepperArena::dxStepperArena()
+{
+  first = 0;
+  current = 0;
+}
+
+
+dxStepperArena::~dxStepperArena()
+{
+  Block *block = first;
+  while (block) {
+    Block *next = block->next;
+    dFree (block,arenaBlockAllocSize (block->size));
+    block = next;
+  }
+}
+
+
+void *dxStepperArena::alloc (size_t num_bytes)
+{
+  num_bytes = dEFFICIENT_SIZE(num_bytes);
+  if (!current || current->used + num_bytes > current->size) {
+    // continue in the next block, a new one is put in front of it if it is
+    // missing or too small
+    Block *next = current ? current->next : first;
+    if (!next || next->size < num_bytes) {
+      size_t size = current ? current->size * 2 : dSTEPPER_ARENA_BLOCK_SIZE;
+      if (size < num_bytes) size = num_bytes;
+      Block *block = (Block*) dAlloc (arenaBlockAllocSize (size));
+      block->data = (char*) dEFFICIENT_SIZE((size_t)(block+1));
+      block->size = size;
+      block->next = next;
+      if (current) current->next = block;
+      else first = block;
+      next = block;
+    }
+    next->used = 0;
+    current = next;
+  }
+  char *p = current->data + current->used;
+  current->used += num_bytes;
+  return p;
+}
+
+
+dxStepperArena::Mark dxStepperArena::mark() const
+{
+  Mark m;
+  m.block = current;
+  m.used = current ? current->used : 0;
+  return m;
+}
+
+
+void dxStepperArena::release (const Mark &m)
+{
+  current = m.block;
+  if (current) current->used = m.used;
+}
+
+
+// same as dRandInt(), but with the seed of the context when it has one
+
+int dxStepperContext::randInt (int n)
+{
+  if (!own_seed) return dRandInt (n);
+
+  const unsigned long un = n;
+  seed = (1664525L*seed + 1013904223L) & 0xffffffff;
+  unsigned long r = seed;
+  if (un <= 0x00010000UL) {
+    r ^= (r >> 16);
+    if (un <= 0x00000100UL) {
+      r ^= (r >> 8);
+      if (un <= 0x00000010UL) {
+        r ^= (r >> 4);
+        if (un <= 0x00000004UL) {
+          r ^= (r >> 2);
+          if (un <= 0x00000002UL) {
+            r ^= (r >> 1);
+          }
+        }
+      }
+    }
+  }
+  return (int) (r % un);
+}
+
+
+struct dxStepperWorkspace : public dBase {
+  dxThreadPool pool;
+  int thread_count;		// requested from the pool
+  dxStepperArena *arenas;	// one per pool thread, the first is the calling thread's
+  int arena_count;
+};
+
+
+static dxStepperWorkspace *getStepperWorkspace (dxWorld *world, int thread_count)
+{
+  dxStepperWorkspace *workspace = world->stepper_workspace;
+  if (!workspace) {
+    workspace = new dxStepperWorkspace;
+    workspace->thread_count = 1;
+    workspace->arenas = new dxStepperArena[1];
+    workspace->arena_count = 1;
+    world->stepper_workspace = workspace;
+  }
+
+  if (thread_count != workspace->thread_count) {
+    // threads that could not be started are simply not used
+    workspace->pool.init (thread_count);
+    workspace->thread_count = thread_count;
+    int count = workspace->pool.getThreadCount();
+    if (count > workspace->arena_count) {
+      delete[] workspace->arenas;
+      workspace->arenas = new dxStepperArena[count];
+      workspace->arena_count = count;
+    }
+  }
+  return workspace;
+}
+
+
+static int resolveThreadCount (int thread_count)
+{
+  return thread_count > 0 ? thread_count : dxThreadPool::getProcessorCount();
+}
+
+
+dxThreadPool *dxGetWorldThreadPool (dxWorld *world)
+{
+  return &getStepperWorkspace (world,resolveThreadCount (world->quickstep_threads))->pool;
+}
+
+
+void dxFreeStepperWorkspace (dxWorld *world)
+{
+  dxStepperWorkspace *workspace = world->stepper_workspace;
+  if (workspace) {
+    delete[] workspace->arenas;
+    delete workspace;
+    world->stepper_workspace = 0;
+  }
+}
+
 //****************************************************************************
 // island processing
 
@@ -310,20 +487,24 @@ void dxStepBody (dxBody *b, dReal h)
 // bodies will not be included in the simulation. disabled bodies are
 // re-enabled if they are found to be part of an active island.
 
-void dxProcessIslands (dxWorld *world, dReal stepsize, dstepper_fn_t stepper)
+static void processIslandsSerial (dxWorld *world, dReal stepsize,
+				  dstepper_fn_t stepper,
+				  dxStepperWorkspace *workspace)
 {
   dxBody *b,*bb,**body;
   dxJoint *j,**joint;
+  dxStepperArena *arena = workspace->arenas;
 
-  // nothing to do if no bodies
-  if (world->nb <= 0) return;
-
-  // handle auto-disabling of bodies
-  dInternalHandleAutoDisabling (world,stepsize);
+  dxStepperContext context;
+  context.arena = arena;
+  context.defer_moves = 0;
+  context.own_seed = 0;
+  context.seed = 0;
+  context.pool = &workspace->pool;
 
   // make arrays for body and joint lists (for a single island) to go into
-  body = (dxBody**) ALLOCA (world->nb * sizeof(dxBody*));
-  joint = (dxJoint**) ALLOCA (world->nj * sizeof(dxJoint*));
+  body = (dxBody**) arena->alloc (world->nb * sizeof(dxBody*));
+  joint = (dxJoint**) arena->alloc (world->nj * sizeof(dxJoint*));
   int bcount = 0;	// number of bodies in `body'
   int jcount = 0;	// number of joints in `joint'
 
@@ -336,7 +517,7 @@ void dxProcessIslands (dxWorld *world, dReal stepsize, dstepper_fn_t stepper)
   // new bodies are only ever added to the stack by going through untagged
   // joints. all the bodies in the stack must be tagged!
   int stackalloc = (world->nj < world->nb) ? world->nj : world->nb;
-  dxBody **stack = (dxBody**) ALLOCA (stackalloc * sizeof(dxBody*));
+  dxBody **stack = (dxBody**) arena->alloc (stackalloc * sizeof(dxBody*));
 
   for (bb=world->firstbody; bb; bb=(dxBody*)bb->next) {
     // get bb = the next enabled, untagged body, and tag it
@@ -372,7 +553,9 @@ void dxProcessIslands (dxWorld *world, dReal stepsize, dstepper_fn_t stepper)
     }
 
     // now do something with body and joint lists
-    stepper (world,body,bcount,joint,jcount,stepsize);
+    dxStepperArena::Mark mark = arena->mark();
+    stepper (&context,world,body,bcount,joint,jcount,stepsize);
+    arena->release (mark);
 
     // what we've just done may have altered the body/joint tag values.
     // we must make sure that these tags are nonzero.
@@ -384,11 +567,183 @@ void dxProcessIslands (dxWorld *world, dReal stepsize, dstepper_fn_t stepper)
     }
     for (i=0; i<jcount; i++) joint[i]->tag = 1;
   }
+}
+
+
+// the bodies and joints of an island in the lists of all islands
+struct dxIsland {
+  int body_start, nb;
+  int joint_start, nj;
+  unsigned long seed;
+};
+
+struct dxIslandOrder {
+  int island;
+  int size;
+};
+
+struct dxIslandTasks {
+  dxWorld *world;
+  dReal stepsize;
+  dstepper_fn_t stepper;
+  dxStepperArena *arenas;
+  dxBody **body;
+  dxJoint **joint;
+  const dxIsland *islands;
+  const dxIslandOrder *order;
+};
+
+
+// biggest islands first, so that a big island started last does not keep one
+// thread busy after the others are done
+static int compareIslandOrder (const void *a, const void *b)
+{
+  const dxIslandOrder *oa = (const dxIslandOrder*) a;
+  const dxIslandOrder *ob = (const dxIslandOrder*) b;
+  if (oa->size != ob->size) return oa->size > ob->size ? -1 : 1;
+  return oa->island - ob->island;
+}
+
+
+static void stepIslandTask (void *data, int task, int worker)
+{
+  const dxIslandTasks *tasks = (const dxIslandTasks*) data;
+  const dxIsland &island = tasks->islands[tasks->order[task].island];
+  dxStepperArena *arena = tasks->arenas + worker;
+
+  dxStepperContext context;
+  context.arena = arena;
+  context.defer_moves = 1;
+  context.own_seed = 1;
+  context.seed = island.seed;
+  context.pool = 0;
+
+  dxStepperArena::Mark mark = arena->mark();
+  tasks->stepper (&context,tasks->world,
+		  tasks->body + island.body_start,island.nb,
+		  tasks->joint + island.joint_start,island.nj,tasks->stepsize);
+  arena->release (mark);
+}
+
+
+// all islands are found first, then stepped on the pool threads. each island
+// reorders its rows with a seed taken from dRand() in island order, and the
+// geoms are notified in island order after, so the result does not depend on
+// the number of threads or on which thread steps which island.
+
+static void processIslandsParallel (dxWorld *world, dReal stepsize,
+				    dstepper_fn_t stepper,
+				    dxStepperWorkspace *workspace)
+{
+  dxBody *b,*bb;
+  dxJoint *j;
+  dxStepperArena *arena = workspace->arenas;
+
+  // body and joint lists of all islands, one after another
+  dxBody **body = (dxBody**) arena->alloc (world->nb * sizeof(dxBody*));
+  dxJoint **joint = (dxJoint**) arena->alloc (world->nj * sizeof(dxJoint*));
+  dxIsland *islands = (dxIsland*) arena->alloc (world->nb * sizeof(dxIsland));
+  int bcount = 0;
+  int jcount = 0;
+  int icount = 0;
+
+  for (b=world->firstbody; b; b=(dxBody*)b->next) b->tag = 0;
+  for (j=world->firstjoint; j; j=(dxJoint*)j->next) j->tag = 0;
+
+  int stackalloc = (world->nj < world->nb) ? world->nj : world->nb;
+  dxBody **stack = (dxBody**) arena->alloc (stackalloc * sizeof(dxBody*));
+
+  for (bb=world->firstbody; bb; bb=(dxBody*)bb->next) {
+    if (bb->tag || (bb->flags & dxBodyDisabled)) continue;
+    bb->tag = 1;
+
+    dxIsland &island = islands[icount++];
+    island.body_start = bcount;
+    island.joint_start = jcount;
+
+    int stacksize = 0;
+    b = bb;
+    body[bcount++] = bb;
+    goto quickstart;
+    while (stacksize > 0) {
+      b = stack[--stacksize];
+      body[bcount++] = b;
+      quickstart:
+
+      for (dxJointNode *n=b->firstjoint; n; n=n->next) {
+        if (!n->joint->tag && n->joint->isEnabled()) {
+	  n->joint->tag = 1;
+	  joint[jcount++] = n->joint;
+	  if (n->body && !n->body->tag) {
+	    n->body->tag = 1;
+	    stack[stacksize++] = n->body;
+	  }
+	}
+      }
+      dIASSERT(stacksize <= world->nb);
+      dIASSERT(stacksize <= world->nj);
+    }
+
+    island.nb = bcount - island.body_start;
+    island.nj = jcount - island.joint_start;
+    island.seed = dRand();
+  }
+
+  dxIslandOrder *order = (dxIslandOrder*) arena->alloc (icount * sizeof(dxIslandOrder));
+  int i;
+  for (i=0; i<icount; i++) {
+    order[i].island = i;
+    order[i].size = islands[i].nb + islands[i].nj;
+  }
+  qsort (order,icount,sizeof(dxIslandOrder),&compareIslandOrder);
+
+  dxIslandTasks tasks;
+  tasks.world = world;
+  tasks.stepsize = stepsize;
+  tasks.stepper = stepper;
+  tasks.arenas = workspace->arenas;
+  tasks.body = body;
+  tasks.joint = joint;
+  tasks.islands = islands;
+  tasks.order = order;
+  workspace->pool.run (&stepIslandTask,&tasks,icount);
+
+  // the steppers may have altered the tags, make them nonzero again and
+  // enable the bodies. the moves are passed on to the geoms in island order.
+  for (i=0; i<bcount; i++) {
+    body[i]->tag = 1;
+    body[i]->flags &= ~dxBodyDisabled;
+    dxNotifyBodyMoved (body[i]);
+  }
+  for (i=0; i<jcount; i++) joint[i]->tag = 1;
+}
+
+
+void dxProcessIslands (dxWorld *world, dReal stepsize, dstepper_fn_t stepper,
+		       int thread_count, int parallel_islands)
+{
+  // nothing to do if no bodies
+  if (world->nb <= 0) return;
+
+  // handle auto-disabling of bodies
+  dInternalHandleAutoDisabling (world,stepsize);
+
+  //betauser
+  thread_count = resolveThreadCount (thread_count);
+  dxStepperWorkspace *workspace = getStepperWorkspace (world,thread_count);
+  dxStepperArena::Mark mark = workspace->arenas[0].mark();
+  if (parallel_islands && workspace->pool.getThreadCount() > 1)
+    processIslandsParallel (world,stepsize,stepper,workspace);
+  else
+    processIslandsSerial (world,stepsize,stepper,workspace);
+  workspace->arenas[0].release (mark);
 
   // if debugging, check that all objects (except for disabled bodies,
   // unconnected joints, and joints that are connected to disabled bodies)
   // were tagged.
 # ifndef dNODEBUG
+  dxBody *b;
+  dxJoint *j;
   for (b=world->firstbody; b; b=(dxBody*)b->next) {
     if (b->flags & dxBodyDisabled) {
       if (b->tag) dDebug (0,"disabled body tagged");
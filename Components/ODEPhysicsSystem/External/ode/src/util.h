@@ -58,13 +58,88 @@
 
 
 
-void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize);
-void dxStepBody (dxBody *b, dReal h);
+//betauser
+/* scratch memory of the island steppers, used instead of alloca so that the
+ * islands stepped on worker threads do not depend on the size of the thread
+ * stacks. blocks are freed all at once by going back to a mark, the memory is
+ * kept for the next steps.
+ */
+
+struct dxStepperArena {
+  struct Block {
+    Block *next;
+    char *data;			// aligned to EFFICIENT_ALIGNMENT
+    size_t size;
+    size_t used;
+  };
+  struct Mark {
+    Block *block;
+    size_t used;
+  };
+
+  Block *first;
+  Block *current;		// block where memory is currently being allocated
+
+  dxStepperArena();
+  ~dxStepperArena();
+
+  void *alloc (size_t num_bytes);
+  Mark mark() const;
+  void release (const Mark &m);
+};
+
+
+/* state of one island stepper call. with deferred moves the geoms of the
+ * stepped bodies are not touched by the stepper, dxProcessIslands notifies
+ * them and calls the moved callbacks after all islands are stepped. an island
+ * with its own seed reorders the constraint rows with it instead of the
+ * global dRand() seed, so islands can be solved in any order. the pool is set
+ * when the islands are stepped one after another, the stepper may then run
+ * the parts of a single island on its threads.
+ */
+
+class dxThreadPool;
+
+struct dxStepperContext {
+  dxStepperArena *arena;
+  int defer_moves;
+  int own_seed;
+  unsigned long seed;
+  dxThreadPool *pool;
+
+  void *alloc (size_t num_bytes) { return arena->alloc (num_bytes); }
+  int randInt (int n);
+};
 
-typedef void (*dstepper_fn_t) (dxWorld *world, dxBody * const *body, int nb,
-        dxJoint * const *_joint, int nj, dReal stepsize);
 
-void dxProcessIslands (dxWorld *world, dReal stepsize, dstepper_fn_t stepper);
+/* persistent stepper data of a world: the arena of the calling thread and the
+ * worker threads of dWorldQuickStep with their arenas.
+ */
+
+struct dxStepperWorkspace;
+
+void dxFreeStepperWorkspace (dxWorld *world);
+
+// the worker threads of the world, for other parallel parts of a step. their
+// number follows dWorldSetQuickStepThreadCount.
+dxThreadPool *dxGetWorldThreadPool (dxWorld *world);
+
+
+void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize);
+void dxStepBody (dxBody *b, dReal h);
+void dxStepBody (dxStepperContext *context, dxBody *b, dReal h);
+void dxNotifyBodyMoved (dxBody *b);
+
+typedef void (*dstepper_fn_t) (dxStepperContext *context, dxWorld *world,
+        dxBody * const *body, int nb, dxJoint * const *_joint, int nj,
+        dReal stepsize);
+
+// thread_count is the number of worker threads of the world. with
+// parallel_islands the islands are stepped on them, the stepper must then only
+// use the memory and the seed of the context. otherwise the islands are
+// stepped one after another and the threads are in context->pool.
+void dxProcessIslands (dxWorld *world, dReal stepsize, dstepper_fn_t stepper,
+        int thread_count, int parallel_islands);
 
 
 
@@ -58,6 +58,11 @@ namespace ODEPhysicsSystem
 			MaxIterationCount = ODEPhysicsWorld.Instance.defaultMaxIterationCount;
 
 			worldID = Ode.dWorldCreate();
+			Ode.dWorldSetQuickStepThreadCount( worldID, ODEPhysicsWorld.Instance.quickStepThreadCount );
+			Ode.dWorldSetQuickStepWarmStarting( worldID, ODEPhysicsWorld.Instance.quickStepWarmStarting );
+			Ode.dWorldSetQuickStepSIMD( worldID, ODEPhysicsWorld.Instance.quickStepSIMD ? 1 : 0 );
+			Ode.dWorldSetParallelQuickStepTolerance( worldID,
+				ODEPhysicsWorld.Instance.parallelQuickStepTolerance );
 
 			//Ode.dVector3 center = new Ode.dVector3( 0, 0, 0 );
 			//Ode.dVector3 extents = new Ode.dVector3( 1000, 1000, 1000 );
@@ -101,6 +106,9 @@ namespace ODEPhysicsSystem
 			neoAxisAdditionsID = Ode.NeoAxisAdditions_Init( Defines.maxContacts, Defines.minERP,
 				Defines.maxERP, Defines.maxFriction, Defines.bounceThreshold, worldID, rootSpaceID,
 				rayCastGeomID, contactJointGroupID );
+			Ode.SetContactCache( neoAxisAdditionsID, ODEPhysicsWorld.Instance.contactCache,
+				ODEPhysicsWorld.Instance.contactCacheMatchDistance,
+				ODEPhysicsWorld.Instance.contactCacheReuseTolerance );
 
 			UpdateMaxIterationCount();
 			UpdateGravity();
@@ -412,10 +420,13 @@ namespace ODEPhysicsSystem
 			}
 
 			// Take a simulation step.
-			Ode.dWorldQuickStep( worldID, StepSize );
+			if( ODEPhysicsWorld.Instance.parallelQuickStep )
+				Ode.dWorldParallelQuickStep( worldID, StepSize );
+			else
+				Ode.dWorldQuickStep( worldID, StepSize );
 
-			// Remove all joints from the contact group.
-			Ode.dJointGroupEmpty( contactJointGroupID );
+			// Keep the contact impulses for the next step and remove all joints from the contact group.
+			Ode.EndSimulationStep( neoAxisAdditionsID );
 
 			//update from ODE
 			foreach( Body body in Bodies )
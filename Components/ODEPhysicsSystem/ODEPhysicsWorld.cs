@@ -31,6 +31,14 @@ namespace ODEPhysicsSystem
 		internal int defaultMaxIterationCount = 20;
 		internal int hashSpaceMinLevel = 2;// 2^2 = 4 minimum cell size
 		internal int hashSpaceMaxLevel = 8;// 2^8 = 256 maximum cell size
+		internal int quickStepThreadCount = 1;// islands, narrowphase and parallelQuickStep rows, 0 = one per processor
+		internal float quickStepWarmStarting = 0;// 0 = disabled
+		internal bool quickStepSIMD;
+		internal bool parallelQuickStep;// solve the rows of one island on the threads, for big islands
+		internal float parallelQuickStepTolerance = 0;// 0 = always all iterations
+		internal bool contactCache;
+		internal float contactCacheMatchDistance = .05f;
+		internal float contactCacheReuseTolerance = 0;
 
 		///////////////////////////////////////////
 
@@ -91,6 +99,31 @@ namespace ODEPhysicsSystem
 							hashSpaceMinLevel = int.Parse( odeBlock.GetAttribute( "hashSpaceMinLevel" ) );
 						if( odeBlock.IsAttributeExist( "hashSpaceMaxLevel" ) )
 							hashSpaceMaxLevel = int.Parse( odeBlock.GetAttribute( "hashSpaceMaxLevel" ) );
+						if( odeBlock.IsAttributeExist( "quickStepThreadCount" ) )
+							quickStepThreadCount = int.Parse( odeBlock.GetAttribute( "quickStepThreadCount" ) );
+						if( odeBlock.IsAttributeExist( "quickStepWarmStarting" ) )
+							quickStepWarmStarting = float.Parse( odeBlock.GetAttribute( "quickStepWarmStarting" ) );
+						if( odeBlock.IsAttributeExist( "quickStepSIMD" ) )
+							quickStepSIMD = bool.Parse( odeBlock.GetAttribute( "quickStepSIMD" ) );
+						if( odeBlock.IsAttributeExist( "parallelQuickStep" ) )
+							parallelQuickStep = bool.Parse( odeBlock.GetAttribute( "parallelQuickStep" ) );
+						if( odeBlock.IsAttributeExist( "parallelQuickStepTolerance" ) )
+						{
+							parallelQuickStepTolerance = float.Parse( 
+								odeBlock.GetAttribute( "parallelQuickStepTolerance" ) );
+						}
+						if( odeBlock.IsAttributeExist( "contactCache" ) )
+							contactCache = bool.Parse( odeBlock.GetAttribute( "contactCache" ) );
+						if( odeBlock.IsAttributeExist( "contactCacheMatchDistance" ) )
+						{
+							contactCacheMatchDistance = float.Parse( 
+								odeBlock.GetAttribute( "contactCacheMatchDistance" ) );
+						}
+						if( odeBlock.IsAttributeExist( "contactCacheReuseTolerance" ) )
+						{
+							contactCacheReuseTolerance = float.Parse( 
+								odeBlock.GetAttribute( "contactCacheReuseTolerance" ) );
+						}
 					}
 				}
 			}
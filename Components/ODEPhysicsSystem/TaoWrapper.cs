@@ -1865,6 +1865,19 @@ namespace ODEPhysicsSystem//Tao.Ode
 		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
 		public extern static void dWorldQuickStep( dWorldID world, dReal stepsize );
 
+		//betauser
+		/// <summary>
+		/// Steps the world with QuickStep, solving the constraint rows of each island in parallel
+		/// by color on the threads set with dWorldSetQuickStepThreadCount.
+		/// </summary>
+		/// <remarks>
+		/// Meant for a single large island. Scenes of many small islands are faster with dWorldQuickStep.
+		/// </remarks>
+		/// <param name="world">the world to step</param>
+		/// <param name="stepsize">the stepsize</param>
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static void dWorldParallelQuickStep( dWorldID world, dReal stepsize );
+
 		/// <summary>
 		/// Set the number of iterations that the QuickStep method performs per step.
 		///
@@ -1902,6 +1915,79 @@ namespace ODEPhysicsSystem//Tao.Ode
 		/// <param name="world">the world to query</param>
 		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
 		public extern static dReal dWorldGetQuickStepW( dWorldID world );
+
+		//betauser
+		/// <summary>
+		/// Set the scale of the last step constraint forces QuickStep starts from, 0 disables warm starting
+		/// </summary>
+		/// <param name="world">the world to set</param>
+		/// <param name="scale">warm starting scale</param>
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static void dWorldSetQuickStepWarmStarting( dWorldID world, dReal scale );
+
+		//betauser
+		/// <summary>
+		/// Get the warm starting scale of QuickStep
+		/// </summary>
+		/// <returns>the world's warm starting scale</returns>
+		/// <param name="world">the world to query</param>
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static dReal dWorldGetQuickStepWarmStarting( dWorldID world );
+
+		//betauser
+		/// <summary>
+		/// Set whether QuickStep solves the constraint rows four at a time with SSE
+		/// </summary>
+		/// <param name="world">the world to set</param>
+		/// <param name="enable">0 uses the scalar solver</param>
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static void dWorldSetQuickStepSIMD( dWorldID world, int enable );
+
+		//betauser
+		/// <summary>
+		/// Get whether QuickStep solves the constraint rows with SSE
+		/// </summary>
+		/// <returns>the world's setting</returns>
+		/// <param name="world">the world to query</param>
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static int dWorldGetQuickStepSIMD( dWorldID world );
+
+		//betauser
+		/// <summary>
+		/// Set the number of threads which step the islands of QuickStep, 0 means one per processor
+		/// </summary>
+		/// <param name="world">the world to set</param>
+		/// <param name="count">thread count</param>
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static void dWorldSetQuickStepThreadCount( dWorldID world, int count );
+
+		//betauser
+		/// <summary>
+		/// Get the number of threads which step the islands of QuickStep
+		/// </summary>
+		/// <returns>the world's thread count</returns>
+		/// <param name="world">the world to query</param>
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static int dWorldGetQuickStepThreadCount( dWorldID world );
+
+		//betauser
+		/// <summary>
+		/// Set the largest constraint force change of an iteration which ends the iterations of
+		/// dWorldParallelQuickStep, 0 always does all iterations
+		/// </summary>
+		/// <param name="world">the world to set</param>
+		/// <param name="tolerance">convergence tolerance</param>
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static void dWorldSetParallelQuickStepTolerance( dWorldID world, dReal tolerance );
+
+		//betauser
+		/// <summary>
+		/// Get the convergence tolerance of dWorldParallelQuickStep
+		/// </summary>
+		/// <returns>the world's tolerance</returns>
+		/// <param name="world">the world to query</param>
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static dReal dWorldGetParallelQuickStepTolerance( dWorldID world );
 		//#endregion World QuickStep functions
 		//#region World contact parameter functions
 		/// <summary>
@@ -6457,6 +6543,13 @@ namespace ODEPhysicsSystem//Tao.Ode
 		public extern static void DoSimulationStep( dNeoAxisAdditionsID additions,
 			out int collisionEventCount, out IntPtr collisionEvents );
 
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static void EndSimulationStep( dNeoAxisAdditionsID additions );
+
+		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
+		public extern static void SetContactCache( dNeoAxisAdditionsID additions,
+			[MarshalAs( UnmanagedType.U1 )] bool enabled, float matchDistance, float reuseTolerance );
+
 		[DllImport( ODE_NATIVE_LIBRARY, CallingConvention = CALLING_CONVENTION ), SuppressUnmanagedCodeSecurity]
 		public extern static IntPtr CreateBodyData( dBodyID bodyID );
 
@@ -17,9 +17,12 @@
 //
 
 #include "ChunkyTriMesh.h"
+#include "Recast.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <algorithm>
 
 struct BoundsItem
 {
@@ -28,27 +31,15 @@ struct BoundsItem
 	int i;
 };
 
-static int compareItemX(const void* va, const void* vb)
+struct CompareItemMin
 {
-	const BoundsItem* a = (const BoundsItem*)va;
-	const BoundsItem* b = (const BoundsItem*)vb;
-	if (a->bmin[0] < b->bmin[0])
-		return -1;
-	if (a->bmin[0] > b->bmin[0])
-		return 1;
-	return 0;
-}
-
-static int compareItemY(const void* va, const void* vb)
-{
-	const BoundsItem* a = (const BoundsItem*)va;
-	const BoundsItem* b = (const BoundsItem*)vb;
-	if (a->bmin[1] < b->bmin[1])
-		return -1;
-	if (a->bmin[1] > b->bmin[1])
-		return 1;
-	return 0;
-}
+	int axis;
+	CompareItemMin(const int axis) : axis(axis) {}
+	inline bool operator()(const BoundsItem& a, const BoundsItem& b) const
+	{
+		return a.bmin[axis] < b.bmin[axis];
+	}
+};
 
 static void calcExtends(const BoundsItem* items, const int /*nitems*/,
 						const int imin, const int imax,
@@ -76,17 +67,35 @@ inline int longestAxis(float x, float y)
 	return y > x ? 1 : 0;
 }
 
+// Number of nodes of the subtree of nitems items, the items are always split in halves.
+static int countNodes(const int nitems, const int trisPerChunk)
+{
+	if (nitems <= trisPerChunk)
+		return 1;
+	return 1 + countNodes(nitems/2, trisPerChunk) + countNodes(nitems - nitems/2, trisPerChunk);
+}
+
+// Computes the bounds of the node and moves the items which go to the left half before the others.
+static void splitNode(BoundsItem* items, const int nitems, const int imin, const int imax, rcChunkyTriMeshNode& node)
+{
+	calcExtends(items, nitems, imin, imax, node.bmin, node.bmax);
+
+	const int axis = longestAxis(node.bmax[0] - node.bmin[0], node.bmax[1] - node.bmin[1]);
+
+	// Only the median is needed, not the order of the halves.
+	std::nth_element(items+imin, items+imin+(imax-imin)/2, items+imax, CompareItemMin(axis));
+}
+
 static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int trisPerChunk,
-					  int& curNode, rcChunkyTriMeshNode* nodes, const int maxNodes,
-					  int& curTri, int* outTris, const int* inTris)
+					  int& curNode, int& curTri, int& maxTrisPerChunk, const int* inTris, rcChunkyTriMesh* cm)
 {
 	int inum = imax - imin;
 	int icur = curNode;
 	
-	if (curNode > maxNodes)
+	if (curNode >= cm->maxNodes)
 		return;
 
-	rcChunkyTriMeshNode& node = nodes[curNode++];
+	rcChunkyTriMeshNode& node = cm->nodes[curNode++];
 	
 	if (inum <= trisPerChunk)
 	{
@@ -99,39 +108,32 @@ static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int tri
 		
 		for (int i = imin; i < imax; ++i)
 		{
-			const int* src = &inTris[items[i].i*3];
-			int* dst = &outTris[curTri*3];
+			const int id = items[i].i;
+			const int* src = &inTris[id*3];
+			int* dst = &cm->tris[curTri*3];
+			cm->triIds[curTri] = id;
+			cm->triNodes[curTri] = icur;
+			cm->idSlots[id] = curTri;
 			curTri++;
 			dst[0] = src[0];
 			dst[1] = src[1];
 			dst[2] = src[2];
 		}
+
+		if (inum > maxTrisPerChunk)
+			maxTrisPerChunk = inum;
 	}
 	else
 	{
 		// Split
-		calcExtends(items, nitems, imin, imax, node.bmin, node.bmax);
-		
-		int	axis = longestAxis(node.bmax[0] - node.bmin[0],
-							   node.bmax[1] - node.bmin[1]);
-		
-		if (axis == 0)
-		{
-			// Sort along x-axis
-			qsort(items+imin, inum, sizeof(BoundsItem), compareItemX);
-		}
-		else if (axis == 1)
-		{
-			// Sort along y-axis
-			qsort(items+imin, inum, sizeof(BoundsItem), compareItemY);
-		}
+		splitNode(items, nitems, imin, imax, node);
 		
 		int isplit = imin+inum/2;
 		
 		// Left
-		subdivide(items, nitems, imin, isplit, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
+		subdivide(items, nitems, imin, isplit, trisPerChunk, curNode, curTri, maxTrisPerChunk, inTris, cm);
 		// Right
-		subdivide(items, nitems, isplit, imax, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
+		subdivide(items, nitems, isplit, imax, trisPerChunk, curNode, curTri, maxTrisPerChunk, inTris, cm);
 		
 		int iescape = curNode - icur;
 		// Negative index means escape.
@@ -139,37 +141,59 @@ static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int tri
 	}
 }
 
-bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
-						   int trisPerChunk, rcChunkyTriMesh* cm)
+template<class T>
+static bool growArray(T*& arr, const int count, int newCapacity)
 {
-	int nchunks = (ntris + trisPerChunk-1) / trisPerChunk;
-
-	cm->nodes = new rcChunkyTriMeshNode[nchunks*4];
-	if (!cm->nodes)
+	T* newArr = new T[newCapacity];
+	if (!newArr)
 		return false;
-		
-	cm->tris = new int[ntris*3];
-	if (!cm->tris)
-		return false;
-		
-	cm->ntris = ntris;
+	if (count)
+		memcpy(newArr, arr, count*sizeof(T));
+	delete [] arr;
+	arr = newArr;
+	return true;
+}
 
-	// Build tree
-	BoundsItem* items = new BoundsItem[ntris];
-	if (!items)
-		return false;
+// Range of items and the node of its subtree.
+struct SubtreeRange
+{
+	int imin, imax;
+	int node;
+};
+
+// Subtree ranges of a parallel build.
+struct ParallelTree
+{
+	BoundsItem* items;
+	int nitems;
+	int trisPerChunk;
+	const int* tris;
+	const float* verts;
+	const int* ids;
+	rcChunkyTriMesh* cm;
+	int firstSlot;
+
+	SubtreeRange* ranges;
+	int* maxTrisPerChunk;
+};
+
+static const int BOUNDS_TASK_SIZE = 16384;
 
-	for (int i = 0; i < ntris; i++)
+static void calcItemBoundsTask(void* userData, const int taskIndex)
+{
+	ParallelTree* tree = (ParallelTree*)userData;
+	const int end = rcMin((taskIndex+1)*BOUNDS_TASK_SIZE, tree->nitems);
+	for (int i = taskIndex*BOUNDS_TASK_SIZE; i < end; i++)
 	{
-		const int* t = &tris[i*3];
-		BoundsItem& it = items[i];
-		it.i = i;
+		const int* t = &tree->tris[tree->ids[i]*3];
+		BoundsItem& it = tree->items[i];
+		it.i = tree->ids[i];
 		// Calc triangle XZ bounds.
-		it.bmin[0] = it.bmax[0] = verts[t[0]*3+0];
-		it.bmin[1] = it.bmax[1] = verts[t[0]*3+2];
+		it.bmin[0] = it.bmax[0] = tree->verts[t[0]*3+0];
+		it.bmin[1] = it.bmax[1] = tree->verts[t[0]*3+2];
 		for (int j = 1; j < 3; ++j)
 		{
-			const float* v = &verts[t[j]*3];
+			const float* v = &tree->verts[t[j]*3];
 			if (v[0] < it.bmin[0]) it.bmin[0] = v[0]; 
 			if (v[2] < it.bmin[1]) it.bmin[1] = v[2]; 
 
@@ -177,29 +201,282 @@ bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
 			if (v[2] > it.bmax[1]) it.bmax[1] = v[2]; 
 		}
 	}
+}
+
+static void splitRangeTask(void* userData, const int taskIndex)
+{
+	ParallelTree* tree = (ParallelTree*)userData;
+	const SubtreeRange& range = tree->ranges[taskIndex];
+	const int inum = range.imax - range.imin;
+	if (inum <= tree->trisPerChunk)
+		return;
+
+	rcChunkyTriMeshNode& node = tree->cm->nodes[range.node];
+	splitNode(tree->items, tree->nitems, range.imin, range.imax, node);
+	// Negative index means escape.
+	node.i = -countNodes(inum, tree->trisPerChunk);
+}
+
+static void subdivideRangeTask(void* userData, const int taskIndex)
+{
+	ParallelTree* tree = (ParallelTree*)userData;
+	const SubtreeRange& range = tree->ranges[taskIndex];
+
+	// The slots of the triangles follow the order of the items.
+	int curNode = range.node;
+	int curTri = tree->firstSlot + range.imin;
+	tree->maxTrisPerChunk[taskIndex] = 0;
+	subdivide(tree->items, tree->nitems, range.imin, range.imax, tree->trisPerChunk, curNode, curTri,
+			  tree->maxTrisPerChunk[taskIndex], tree->tris, tree->cm);
+}
+
+// Splits the upper levels of the tree one level at a time, every split of a level runs as its own task,
+// until there are enough subtrees to build them in parallel. The nodes of the subtrees are at the same
+// places as in the recursive build because the size of every subtree is known from its item count.
+static void subdivideParallel(rcContext* ctx, ParallelTree& tree)
+{
+	const int targetRanges = ctx->getParallelism()*4;
+	tree.ranges = new SubtreeRange[targetRanges*2];
+	tree.maxTrisPerChunk = new int[targetRanges*2];
+
+	int nranges = 1;
+	tree.ranges[0].imin = 0;
+	tree.ranges[0].imax = tree.nitems;
+	tree.ranges[0].node = tree.cm->nnodes;
+
+	while (nranges < targetRanges)
+	{
+		ctx->runParallel(splitRangeTask, &tree, nranges);
+
+		SubtreeRange* next = new SubtreeRange[nranges*2];
+		int nnext = 0;
+		for (int i = 0; i < nranges; ++i)
+		{
+			const SubtreeRange& range = tree.ranges[i];
+			const int inum = range.imax - range.imin;
+			if (inum <= tree.trisPerChunk)
+			{
+				next[nnext++] = range;
+				continue;
+			}
+			const int isplit = range.imin + inum/2;
+			SubtreeRange& left = next[nnext++];
+			left.imin = range.imin;
+			left.imax = isplit;
+			left.node = range.node + 1;
+			SubtreeRange& right = next[nnext++];
+			right.imin = isplit;
+			right.imax = range.imax;
+			right.node = left.node + countNodes(isplit - range.imin, tree.trisPerChunk);
+		}
+
+		const bool split = nnext != nranges;
+		memcpy(tree.ranges, next, sizeof(SubtreeRange)*nnext);
+		nranges = nnext;
+		delete [] next;
+		if (!split)
+			break;
+	}
+
+	ctx->runParallel(subdivideRangeTask, &tree, nranges);
+
+	for (int i = 0; i < nranges; ++i)
+	{
+		if (tree.maxTrisPerChunk[i] > tree.cm->maxTrisPerChunk)
+			tree.cm->maxTrisPerChunk = tree.maxTrisPerChunk[i];
+	}
+	tree.cm->nnodes += countNodes(tree.nitems, tree.trisPerChunk);
+	tree.cm->nslots += tree.nitems;
+
+	delete [] tree.ranges;
+	delete [] tree.maxTrisPerChunk;
+}
+
+// Builds a subtree from the given source triangles and appends it after the existing nodes.
+static bool appendTree(rcChunkyTriMesh* cm, const float* verts, const int* tris,
+					   const int* ids, int nitems, int trisPerChunk, rcContext* ctx)
+{
+	if (!nitems)
+		return true;
+
+	int nchunks = (nitems + trisPerChunk-1) / trisPerChunk;
+
+	if (cm->nnodes + nchunks*4 > cm->maxNodes)
+	{
+		const int cap = cm->nnodes + nchunks*4;
+		if (!growArray(cm->nodes, cm->nnodes, cap))
+			return false;
+		cm->maxNodes = cap;
+	}
+
+	if (cm->nslots + nitems > cm->maxSlots)
+	{
+		// Leave room for later additions when appending to an existing mesh.
+		int cap = cm->nslots + nitems;
+		if (cm->nslots && cap < cm->maxSlots + cm->maxSlots/2)
+			cap = cm->maxSlots + cm->maxSlots/2;
+		if (!growArray(cm->tris, cm->nslots*3, cap*3))
+			return false;
+		if (!growArray(cm->triIds, cm->nslots, cap))
+			return false;
+		if (!growArray(cm->triNodes, cm->nslots, cap))
+			return false;
+		cm->maxSlots = cap;
+	}
+
+	// Build tree
+	BoundsItem* items = new BoundsItem[nitems];
+	if (!items)
+		return false;
 
-	int curTri = 0;
-	int curNode = 0;
-	subdivide(items, ntris, 0, ntris, trisPerChunk, curNode, cm->nodes, nchunks*4, curTri, cm->tris, tris);
+	ParallelTree tree;
+	memset(&tree, 0, sizeof(tree));
+	tree.items = items;
+	tree.nitems = nitems;
+	tree.trisPerChunk = trisPerChunk;
+	tree.tris = tris;
+	tree.verts = verts;
+	tree.ids = ids;
+	tree.cm = cm;
+	tree.firstSlot = cm->nslots;
+
+	const int boundsTasks = (nitems + BOUNDS_TASK_SIZE-1) / BOUNDS_TASK_SIZE;
+	if (ctx && ctx->getParallelism() > 1 && nitems > trisPerChunk)
+	{
+		ctx->runParallel(calcItemBoundsTask, &tree, boundsTasks);
+		subdivideParallel(ctx, tree);
+	}
+	else
+	{
+		for (int i = 0; i < boundsTasks; ++i)
+			calcItemBoundsTask(&tree, i);
+		subdivide(items, nitems, 0, nitems, trisPerChunk, cm->nnodes, cm->nslots, cm->maxTrisPerChunk, tris, cm);
+	}
 	
 	delete [] items;
+
+	cm->ntris += nitems;
 	
-	cm->nnodes = curNode;
-	
-	// Calc max tris per node.
+	return true;
+}
+
+static bool reserveIds(rcChunkyTriMesh* cm, int nids)
+{
+	if (nids <= cm->nids)
+		return true;
+	if (!growArray(cm->idSlots, cm->nids, nids))
+		return false;
+	for (int i = cm->nids; i < nids; ++i)
+		cm->idSlots[i] = -1;
+	cm->nids = nids;
+	return true;
+}
+
+bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
+						   int trisPerChunk, rcChunkyTriMesh* cm, rcContext* ctx)
+{
+	cm->nnodes = 0;
+	cm->nslots = 0;
+	cm->ntris = 0;
 	cm->maxTrisPerChunk = 0;
-	for (int i = 0; i < cm->nnodes; ++i)
+	for (int i = 0; i < cm->nids; ++i)
+		cm->idSlots[i] = -1;
+
+	if (!reserveIds(cm, ntris))
+		return false;
+
+	int* ids = new int[ntris];
+	if (!ids)
+		return false;
+	for (int i = 0; i < ntris; ++i)
+		ids[i] = i;
+
+	const bool result = appendTree(cm, verts, tris, ids, ntris, trisPerChunk, ctx);
+
+	delete [] ids;
+	
+	return result;
+}
+
+bool rcAddChunkyTriMeshTris(rcChunkyTriMesh* cm, const float* verts, const int* tris,
+							int firstId, int ntris, int trisPerChunk, rcContext* ctx)
+{
+	if (!reserveIds(cm, firstId + ntris))
+		return false;
+
+	int* ids = new int[ntris];
+	if (!ids)
+		return false;
+	for (int i = 0; i < ntris; ++i)
+		ids[i] = firstId + i;
+
+	const bool result = appendTree(cm, verts, tris, ids, ntris, trisPerChunk, ctx);
+
+	delete [] ids;
+
+	return result;
+}
+
+bool rcRemoveChunkyTriMeshTri(rcChunkyTriMesh* cm, int id)
+{
+	if (id < 0 || id >= cm->nids)
+		return false;
+	const int slot = cm->idSlots[id];
+	if (slot < 0)
+		return false;
+
+	// Move the last triangle of the leaf into the freed slot.
+	rcChunkyTriMeshNode& node = cm->nodes[cm->triNodes[slot]];
+	const int last = node.i + node.n - 1;
+	if (slot != last)
 	{
-		rcChunkyTriMeshNode& node = cm->nodes[i];
-		const bool isLeaf = node.i >= 0;
-		if (!isLeaf) continue;
-		if (node.n > cm->maxTrisPerChunk)
-			cm->maxTrisPerChunk = node.n;
+		cm->tris[slot*3+0] = cm->tris[last*3+0];
+		cm->tris[slot*3+1] = cm->tris[last*3+1];
+		cm->tris[slot*3+2] = cm->tris[last*3+2];
+		cm->triIds[slot] = cm->triIds[last];
+		cm->idSlots[cm->triIds[slot]] = slot;
 	}
-	 
+	node.n--;
+
+	cm->idSlots[id] = -1;
+	cm->ntris--;
+
 	return true;
 }
 
+bool rcChunkyTriMeshNeedsCompact(const rcChunkyTriMesh* cm, int trisPerChunk)
+{
+	// Too many holes, or too many small subtrees from additions.
+	const int holes = cm->nslots - cm->ntris;
+	const int nchunks = (cm->ntris + trisPerChunk-1) / trisPerChunk;
+	return holes > cm->ntris/2 + trisPerChunk || cm->nnodes > nchunks*4 + 64;
+}
+
+bool rcCompactChunkyTriMesh(rcChunkyTriMesh* cm, const float* verts, const int* tris, int trisPerChunk,
+							rcContext* ctx)
+{
+	int* ids = new int[cm->ntris];
+	if (!ids)
+		return false;
+	int nitems = 0;
+	for (int i = 0; i < cm->nids; ++i)
+	{
+		if (cm->idSlots[i] >= 0)
+			ids[nitems++] = i;
+	}
+
+	cm->nnodes = 0;
+	cm->nslots = 0;
+	cm->ntris = 0;
+	cm->maxTrisPerChunk = 0;
+
+	const bool result = appendTree(cm, verts, tris, ids, nitems, trisPerChunk, ctx);
+
+	delete [] ids;
+
+	return result;
+}
+
 
 inline bool checkOverlapRect(const float amin[2], const float amax[2],
 							 const float bmin[2], const float bmax[2])
@@ -245,6 +522,43 @@ int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm,
 }
 
 
+int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm,
+							   float bmin[2], float bmax[2],
+							   rcChunkIdList& list)
+{
+	// Traverse tree
+	int i = 0;
+	list.n = 0;
+	while (i < cm->nnodes)
+	{
+		const rcChunkyTriMeshNode* node = &cm->nodes[i];
+		const bool overlap = checkOverlapRect(bmin, bmax, node->bmin, node->bmax);
+		const bool isLeafNode = node->i >= 0;
+		
+		if (isLeafNode && overlap)
+		{
+			if (list.n == list.cap)
+			{
+				const int cap = list.cap ? list.cap*2 : 512;
+				if (!growArray(list.ids, list.n, cap))
+					return 0;
+				list.cap = cap;
+			}
+			list.ids[list.n++] = i;
+		}
+		
+		if (overlap || isLeafNode)
+			i++;
+		else
+		{
+			const int escapeIndex = -node->i;
+			i += escapeIndex;
+		}
+	}
+	
+	return list.n;
+}
+
 
 static bool checkOverlapSegment(const float p[2], const float q[2],
 								const float bmin[2], const float bmax[2])
@@ -19,6 +19,8 @@
 #ifndef CHUNKYTRIMESH_H
 #define CHUNKYTRIMESH_H
 
+class rcContext;
+
 struct rcChunkyTriMeshNode
 {
 	float bmin[2], bmax[2];
@@ -27,24 +29,74 @@ struct rcChunkyTriMeshNode
 
 struct rcChunkyTriMesh
 {
-	inline rcChunkyTriMesh() : nodes(0), tris(0) {};
-	inline ~rcChunkyTriMesh() { delete [] nodes; delete [] tris; }
+	inline rcChunkyTriMesh() : nodes(0), nnodes(0), maxNodes(0), tris(0), ntris(0), maxTrisPerChunk(0),
+		triIds(0), triNodes(0), nslots(0), maxSlots(0), idSlots(0), nids(0) {};
+	inline ~rcChunkyTriMesh() { delete [] nodes; delete [] tris; delete [] triIds; delete [] triNodes; delete [] idSlots; }
 
 	rcChunkyTriMeshNode* nodes;
 	int nnodes;
+	int maxNodes;
 	int* tris;
 	int ntris;
 	int maxTrisPerChunk;
+
+	/// @name Incremental update bookkeeping.
+	/// Source triangles are identified by their index in the tris array passed on creation (their id).
+	/// Added triangles are appended as new top level subtrees, removed ones leave holes at the end of their leaf.
+	///@{
+	int* triIds;			///< Source triangle id of each slot in tris.
+	int* triNodes;			///< Leaf node of each slot in tris.
+	int nslots;				///< Slots in tris used so far, including the holes.
+	int maxSlots;
+	int* idSlots;			///< Slot of each source triangle id, -1 for removed triangles.
+	int nids;
+	///@}
+};
+
+/// Chunk indices returned by an overlap query. The array grows to hold all of them and is kept
+/// for the next queries.
+struct rcChunkIdList
+{
+	inline rcChunkIdList() : ids(0), n(0), cap(0) {};
+	inline ~rcChunkIdList() { delete [] ids; }
+
+	int* ids;
+	int n;
+	int cap;
+
+private:
+	rcChunkIdList(const rcChunkIdList&);
+	rcChunkIdList& operator=(const rcChunkIdList&);
 };
 
 /// Creates partitioned triangle mesh (AABB tree),
 /// where each node contains at max trisPerChunk triangles.
+/// The upper levels of the tree are split and the subtrees built with ctx->runParallel when ctx is given,
+/// the tree is the same as of one thread. A mesh which was built before is replaced, keeping its arrays.
 bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
-						   int trisPerChunk, rcChunkyTriMesh* cm);
+						   int trisPerChunk, rcChunkyTriMesh* cm, rcContext* ctx = 0);
+
+/// Adds source triangles [firstId, firstId+ntris) to the mesh. tris is the whole source triangle array.
+bool rcAddChunkyTriMeshTris(rcChunkyTriMesh* cm, const float* verts, const int* tris,
+							int firstId, int ntris, int trisPerChunk, rcContext* ctx = 0);
+
+/// Removes source triangle from the mesh. Node bounds are not shrunk.
+bool rcRemoveChunkyTriMeshTri(rcChunkyTriMesh* cm, int id);
+
+/// Returns true when updates fragmented the mesh enough that rcCompactChunkyTriMesh is worth calling.
+bool rcChunkyTriMeshNeedsCompact(const rcChunkyTriMesh* cm, int trisPerChunk);
+
+/// Rebuilds the tree from the triangles which are still in the mesh.
+bool rcCompactChunkyTriMesh(rcChunkyTriMesh* cm, const float* verts, const int* tris, int trisPerChunk,
+							rcContext* ctx = 0);
 
 /// Returns the chunk indices which overlap the input rectable.
 int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm, float bmin[2], float bmax[2], int* ids, const int maxIds);
 
+/// Returns all chunk indices which overlap the input rectangle in list, growing it when needed.
+/// Returns the number of chunks, 0 if the list could not grow.
+int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm, float bmin[2], float bmax[2], rcChunkIdList& list);
+
 /// Returns the chunk indices which overlap the input segment.
 int rcGetChunksOverlappingSegment(const rcChunkyTriMesh* cm, float p[2], float q[2], int* ids, const int maxIds);
 
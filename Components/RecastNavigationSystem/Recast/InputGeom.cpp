@@ -108,6 +108,7 @@
 InputGeom::InputGeom() :
 	m_chunkyMesh(0),
 	m_mesh(0),
+	m_trianglesPerChunk(0),
 	m_offMeshConCount(0),
 	m_volumeCount(0)
 {
@@ -153,15 +154,118 @@ bool InputGeom::loadMesh(rcContext* ctx, float* vertices, int vertexCount, int*
 		return false;
 	}
 
-	if (!rcCreateChunkyTriMesh(m_mesh->getVerts(), m_mesh->getTris(), m_mesh->getTriCount(), trianglesPerChunk, m_chunkyMesh))
+	if (!rcCreateChunkyTriMesh(m_mesh->getVerts(), m_mesh->getTris(), m_mesh->getTriCount(), trianglesPerChunk, m_chunkyMesh, 
+		ctx))
 	{
 		ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Failed to build chunky mesh.");
 		return false;
 	}		
+	m_trianglesPerChunk = trianglesPerChunk;
 
 	return true;
 }
 
+static void addTriangleBounds(const float* verts, const int* tri, float* bmin, float* bmax)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		const float* v = &verts[tri[i]*3];
+		rcVmin(bmin, v);
+		rcVmax(bmax, v);
+	}
+}
+
+int InputGeom::addTriangles(rcContext* ctx, const float* vertices, int vertexCount, const int* indices, 
+	int indexCount, float* changedBMin, float* changedBMax)
+{
+	if (!m_mesh || !m_chunkyMesh)
+	{
+		ctx->log(RC_LOG_ERROR, "addTriangles: Input mesh is not specified.");
+		return -1;
+	}
+
+	const int firstId = m_mesh->getTriIdCount();
+	const int firstSlot = m_mesh->getTriCount();
+	const int triangleCount = indexCount / 3;
+
+	if (!m_mesh->append(vertices, vertexCount, indices, indexCount))
+	{
+		ctx->log(RC_LOG_ERROR, "addTriangles: Could not append triangles.");
+		return -1;
+	}
+
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		rcVmin(m_meshBMin, &vertices[i*3]);
+		rcVmax(m_meshBMax, &vertices[i*3]);
+	}
+	for (int i = 0; i < triangleCount; ++i)
+		addTriangleBounds(m_mesh->getVerts(), &m_mesh->getTris()[(firstSlot + i)*3], changedBMin, changedBMax);
+
+	// The chunky mesh identifies the triangles by their slot in the loaded mesh.
+	if (!rcAddChunkyTriMeshTris(m_chunkyMesh, m_mesh->getVerts(), m_mesh->getTris(), firstSlot, triangleCount, 
+		m_trianglesPerChunk, ctx))
+	{
+		ctx->log(RC_LOG_ERROR, "addTriangles: Failed to update chunky mesh.");
+		return -1;
+	}
+
+	if (rcChunkyTriMeshNeedsCompact(m_chunkyMesh, m_trianglesPerChunk) && !compactMesh(ctx))
+		return -1;
+
+	return firstId;
+}
+
+bool InputGeom::removeTriangles(rcContext* ctx, const int* ranges, int rangeCount, 
+	float* changedBMin, float* changedBMax)
+{
+	if (!m_mesh || !m_chunkyMesh)
+	{
+		ctx->log(RC_LOG_ERROR, "removeTriangles: Input mesh is not specified.");
+		return false;
+	}
+
+	for (int r = 0; r < rangeCount; ++r)
+	{
+		const int first = ranges[r*2+0];
+		const int count = ranges[r*2+1];
+		for (int id = first; id < first + count; ++id)
+		{
+			const int slot = m_mesh->getTriSlot(id);
+			if (slot < 0)
+				continue;
+			if (rcRemoveChunkyTriMeshTri(m_chunkyMesh, slot))
+				addTriangleBounds(m_mesh->getVerts(), &m_mesh->getTris()[slot*3], changedBMin, changedBMax);
+			m_mesh->removeTriangle(id);
+		}
+	}
+
+	if (rcChunkyTriMeshNeedsCompact(m_chunkyMesh, m_trianglesPerChunk) && !compactMesh(ctx))
+		return false;
+
+	return true;
+}
+
+bool InputGeom::compactMesh(rcContext* ctx)
+{
+	if (!m_mesh->getRemovedTriCount())
+		return rcCompactChunkyTriMesh(m_chunkyMesh, m_mesh->getVerts(), m_mesh->getTris(), m_trianglesPerChunk, ctx);
+
+	// Drop the vertices and indices of the removed triangles, the slots of the others change.
+	if (!m_mesh->compact())
+	{
+		ctx->log(RC_LOG_ERROR, "compactMesh: Out of memory.");
+		return false;
+	}
+	if (!rcCreateChunkyTriMesh(m_mesh->getVerts(), m_mesh->getTris(), m_mesh->getTriCount(), m_trianglesPerChunk, 
+		m_chunkyMesh, ctx))
+	{
+		ctx->log(RC_LOG_ERROR, "compactMesh: Failed to build chunky mesh.");
+		return false;
+	}
+	return true;
+}
+
 //bool InputGeom::load(rcContext* ctx, const char* filePath)
 //{
 //	char* buf = 0;
@@ -36,6 +36,7 @@ class InputGeom
 	rcChunkyTriMesh* m_chunkyMesh;
 	rcMeshLoaderObj* m_mesh;
 	float m_meshBMin[3], m_meshBMax[3];
+	int m_trianglesPerChunk;
 	
 	/// @name Off-Mesh connections.
 	///@{
@@ -55,6 +56,8 @@ class InputGeom
 	ConvexVolume m_volumes[MAX_VOLUMES];
 	int m_volumeCount;
 	///@}
+
+	bool compactMesh(class rcContext* ctx);
 	
 public:
 	InputGeom();
@@ -62,6 +65,20 @@ public:
 	
 	bool loadMesh(class rcContext* ctx, float* vertices, int vertexCount, int* indices, int indexCount, 
 		int trianglesPerChunk);
+
+	/// @name Incremental updates.
+	/// Triangles are identified by their index in the loaded mesh, added triangles get the following ids.
+	/// Ids are not reused. The memory of removed triangles is reclaimed when the chunky mesh is compacted,
+	/// the ids of the other triangles stay valid.
+	/// changedBMin/changedBMax are extended by the bounds of the affected triangles.
+	///@{
+	/// Returns the id of the first added triangle or -1 on failure.
+	int addTriangles(class rcContext* ctx, const float* vertices, int vertexCount, const int* indices, int indexCount,
+		float* changedBMin, float* changedBMax);
+	/// ranges contains rangeCount pairs of (first triangle id, triangle count).
+	bool removeTriangles(class rcContext* ctx, const int* ranges, int rangeCount, 
+		float* changedBMin, float* changedBMax);
+	///@}
 	
 	//bool load(class rcContext* ctx, const char* filepath);
 	//bool save(const char* filepath);
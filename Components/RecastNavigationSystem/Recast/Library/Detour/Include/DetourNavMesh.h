@@ -236,6 +236,10 @@ public:
 	
 	/// Returns max number of tiles.
 	int getMaxTiles() const;
+
+	/// Returns the number of tiles added and removed since the navmesh was created. Data derived from the
+	/// tiles and their links is up to date while it does not change.
+	unsigned int getChangeCount() const { return m_changeCount; }
 	
 	/// Returns pointer to tile in the tile array.
 	///  @param i [in] Index to the tile to retrieve, max index is getMaxTiles()-1.
@@ -392,6 +396,8 @@ private:
 	unsigned int m_saltBits;			///< Number of salt bits in the tile ID.
 	unsigned int m_tileBits;			///< Number of tile bits in the tile ID.
 	unsigned int m_polyBits;			///< Number of poly bits in the tile ID.
+
+	unsigned int m_changeCount;			///< Number of tiles added and removed.
 };
 
 /// Helper function to allocate navmesh class using Detour allocator.
@@ -106,8 +106,10 @@ public:
 	/// Initializes the nav mesh query.
 	///  @param nav [in] pointer to navigation mesh data.
 	///  @param maxNodes [in] Maximum number of search nodes to use (max 65536).
+	///  @param openAddressing [in] Use the open addressing node pool and the indexed 4-ary open list,
+	///    which are faster for short searches, see dtNodePool.
 	//betauser
-	dtStatus init(const dtNavMesh* nav, const int maxNodes, bool recreate);
+	dtStatus init(const dtNavMesh* nav, const int maxNodes, bool recreate, bool openAddressing = false);
 	//dtStatus init(const dtNavMesh* nav, const int maxNodes);
 	
 	/// Finds the nearest navigation polygon around the center location.
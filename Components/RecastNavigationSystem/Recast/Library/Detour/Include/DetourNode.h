@@ -38,13 +38,18 @@ struct dtNode
 	unsigned int pidx : 30;		///< Index to parent node.
 	unsigned int flags : 2;		///< Node flags 0/open/closed.
 	dtPolyRef id;				///< Polygon ref the node corresponds to.
+	int heapIndex;				///< Index in the indexed open list, see dtNodeQueue.
 };
 
 
+/// Node pool of the searches. By default the nodes are found through a chained hash, which clear()
+/// resets with a memset. With openAddressing the ids are kept in an open addressing table stamped
+/// with the search generation, so clear() only increments the generation and a lookup usually
+/// touches one cache line.
 class dtNodePool
 {
 public:
-	dtNodePool(int maxNodes, int hashSize);
+	dtNodePool(int maxNodes, int hashSize, bool openAddressing = false);
 	~dtNodePool();
 	inline void operator=(const dtNodePool&) {}
 	void clear();
@@ -71,6 +76,12 @@ public:
 	
 	inline int getMemUsed() const
 	{
+		if (m_slots)
+		{
+			return sizeof(*this) +
+				sizeof(dtNode)*m_maxNodes +
+				sizeof(dtNodeSlot)*m_hashSize;
+		}
 		return sizeof(*this) +
 			sizeof(dtNode)*m_maxNodes +
 			sizeof(dtNodeIndex)*m_maxNodes +
@@ -78,25 +89,47 @@ public:
 	}
 	
 	inline int getMaxNodes() const { return m_maxNodes; }
+	inline bool isOpenAddressing() const { return m_slots != 0; }
 	
+	/// The nodes are enumerated by the buckets of the hash. With open addressing a bucket holds
+	/// at most one node.
 	inline int getHashSize() const { return m_hashSize; }
-	inline dtNodeIndex getFirst(int bucket) const { return m_first[bucket]; }
-	inline dtNodeIndex getNext(int i) const { return m_next[i]; }
+	inline dtNodeIndex getFirst(int bucket) const
+	{
+		if (m_slots)
+			return m_slots[bucket].stamp == m_stamp ? m_slots[bucket].index : DT_NULL_IDX;
+		return m_first[bucket];
+	}
+	inline dtNodeIndex getNext(int i) const { return m_slots ? DT_NULL_IDX : m_next[i]; }
 	
 private:
 	
+	struct dtNodeSlot
+	{
+		dtPolyRef id;
+		dtNodeIndex index;
+		unsigned short stamp;		///< The slot is empty unless it equals m_stamp.
+	};
+	
+	dtNode* getNodeOpenAddressing(dtPolyRef id, bool create);
+	
 	dtNode* m_nodes;
 	dtNodeIndex* m_first;
 	dtNodeIndex* m_next;
+	dtNodeSlot* m_slots;
+	unsigned short m_stamp;
 	const int m_maxNodes;
 	const int m_hashSize;
 	int m_nodeCount;
 };
 
+/// Open list of the searches, a binary heap. An indexed queue is a 4-ary heap which keeps the heap
+/// index in the nodes, so modify() does not search the heap. It is shallower and finds the
+/// smallest child among adjacent entries.
 class dtNodeQueue
 {
 public:
-	dtNodeQueue(int n);
+	dtNodeQueue(int n, bool indexed = false);
 	~dtNodeQueue();
 	inline void operator=(dtNodeQueue&) {}
 	
@@ -114,18 +147,29 @@ public:
 	{
 		dtNode* result = m_heap[0];
 		m_size--;
-		trickleDown(0, m_heap[m_size]);
+		if (m_indexed)
+			trickleDown4(0, m_heap[m_size]);
+		else
+			trickleDown(0, m_heap[m_size]);
 		return result;
 	}
 	
 	inline void push(dtNode* node)
 	{
 		m_size++;
-		bubbleUp(m_size-1, node);
+		if (m_indexed)
+			bubbleUp4(m_size-1, node);
+		else
+			bubbleUp(m_size-1, node);
 	}
 	
 	inline void modify(dtNode* node)
 	{
+		if (m_indexed)
+		{
+			bubbleUp4(node->heapIndex, node);
+			return;
+		}
 		for (int i = 0; i < m_size; ++i)
 		{
 			if (m_heap[i] == node)
@@ -145,14 +189,18 @@ public:
 	}
 	
 	inline int getCapacity() const { return m_capacity; }
+	inline bool isIndexed() const { return m_indexed; }
 	
 private:
 	void bubbleUp(int i, dtNode* node);
 	void trickleDown(int i, dtNode* node);
+	void bubbleUp4(int i, dtNode* node);
+	void trickleDown4(int i, dtNode* node);
 	
 	dtNode** m_heap;
 	const int m_capacity;
 	int m_size;
+	const bool m_indexed;
 };		
 
 
@@ -161,7 +161,8 @@ dtNavMesh::dtNavMesh() :
 	m_tiles(0),
 	m_saltBits(0),
 	m_tileBits(0),
-	m_polyBits(0)
+	m_polyBits(0),
+	m_changeCount(0)
 {
 	m_orig[0] = 0;
 	m_orig[1] = 0;
@@ -857,6 +858,8 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		}
 	}
 	
+	m_changeCount++;
+
 	if (result)
 		*result = getTileRef(tile);
 	
@@ -1120,6 +1123,8 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	tile->next = m_nextFree;
 	m_nextFree = tile;
 
+	m_changeCount++;
+
 	return DT_SUCCESS;
 }
 
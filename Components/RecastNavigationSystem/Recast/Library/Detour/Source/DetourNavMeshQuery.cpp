@@ -108,12 +108,13 @@ dtNavMeshQuery::~dtNavMeshQuery()
 }
 
 //betauser
-dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes, bool recreate)
+dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes, bool recreate, bool openAddressing)
 //dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 {
 	m_nav = nav;
 	
-	if (!m_nodePool || m_nodePool->getMaxNodes() < maxNodes || recreate)
+	if (!m_nodePool || m_nodePool->getMaxNodes() < maxNodes || recreate ||
+		m_nodePool->isOpenAddressing() != openAddressing)
 	{
 		if (m_nodePool)
 		{
@@ -121,7 +122,7 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes, bool rec
 			dtFree(m_nodePool);
 			m_nodePool = 0;
 		}
-		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4));
+		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4), openAddressing);
 		if (!m_nodePool)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -142,7 +143,7 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes, bool rec
 	}
 	
 	// TODO: check the open list size too.
-	if (!m_openList || m_openList->getCapacity() < maxNodes || recreate)
+	if (!m_openList || m_openList->getCapacity() < maxNodes || recreate || m_openList->isIndexed() != openAddressing)
 	{
 		if (m_openList)
 		{
@@ -150,7 +151,7 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes, bool rec
 			dtFree(m_openList);
 			m_openList = 0;
 		}
-		m_openList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM)) dtNodeQueue(maxNodes);
+		m_openList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM)) dtNodeQueue(maxNodes, openAddressing);
 		if (!m_openList)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
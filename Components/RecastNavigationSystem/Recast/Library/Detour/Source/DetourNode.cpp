@@ -34,22 +34,34 @@ inline unsigned int dtHashRef(dtPolyRef a)
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
-dtNodePool::dtNodePool(int maxNodes, int hashSize) :
+dtNodePool::dtNodePool(int maxNodes, int hashSize, bool openAddressing) :
 	m_nodes(0),
 	m_first(0),
 	m_next(0),
+	m_slots(0),
+	m_stamp(1),
 	m_maxNodes(maxNodes),
-	m_hashSize(hashSize),
+	// At most half of the slots are used, so the probe sequences stay short.
+	m_hashSize(openAddressing ? (int)dtNextPow2(maxNodes*2) : hashSize),
 	m_nodeCount(0)
 {
 	dtAssert(dtNextPow2(m_hashSize) == (unsigned int)m_hashSize);
 	dtAssert(m_maxNodes > 0);
 
 	m_nodes = (dtNode*)dtAlloc(sizeof(dtNode)*m_maxNodes, DT_ALLOC_PERM);
+	dtAssert(m_nodes);
+
+	if (openAddressing)
+	{
+		m_slots = (dtNodeSlot*)dtAlloc(sizeof(dtNodeSlot)*m_hashSize, DT_ALLOC_PERM);
+		dtAssert(m_slots);
+		memset(m_slots, 0, sizeof(dtNodeSlot)*m_hashSize);
+		return;
+	}
+
 	m_next = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*m_maxNodes, DT_ALLOC_PERM);
 	m_first = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*hashSize, DT_ALLOC_PERM);
 
-	dtAssert(m_nodes);
 	dtAssert(m_next);
 	dtAssert(m_first);
 
@@ -62,16 +74,64 @@ dtNodePool::~dtNodePool()
 	dtFree(m_nodes);
 	dtFree(m_next);
 	dtFree(m_first);
+	dtFree(m_slots);
 }
 
 void dtNodePool::clear()
 {
-	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
 	m_nodeCount = 0;
+	if (m_slots)
+	{
+		// The slots of the previous searches are empty by their stamp, they are only cleared
+		// when the stamp wraps around.
+		m_stamp++;
+		if (m_stamp == 0)
+		{
+			memset(m_slots, 0, sizeof(dtNodeSlot)*m_hashSize);
+			m_stamp = 1;
+		}
+		return;
+	}
+	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
+}
+
+dtNode* dtNodePool::getNodeOpenAddressing(dtPolyRef id, bool create)
+{
+	const unsigned int mask = (unsigned int)m_hashSize-1;
+	unsigned int slot = dtHashRef(id) & mask;
+	while (m_slots[slot].stamp == m_stamp)
+	{
+		if (m_slots[slot].id == id)
+			return &m_nodes[m_slots[slot].index];
+		slot = (slot+1) & mask;
+	}
+	
+	if (!create || m_nodeCount >= m_maxNodes)
+		return 0;
+	
+	const dtNodeIndex i = (dtNodeIndex)m_nodeCount;
+	m_nodeCount++;
+	
+	// Init node
+	dtNode* node = &m_nodes[i];
+	node->pidx = 0;
+	node->cost = 0;
+	node->total = 0;
+	node->id = id;
+	node->flags = 0;
+	
+	m_slots[slot].id = id;
+	m_slots[slot].index = i;
+	m_slots[slot].stamp = m_stamp;
+	
+	return node;
 }
 
 dtNode* dtNodePool::findNode(dtPolyRef id)
 {
+	if (m_slots)
+		return getNodeOpenAddressing(id, false);
+
 	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
 	dtNodeIndex i = m_first[bucket];
 	while (i != DT_NULL_IDX)
@@ -85,6 +145,9 @@ dtNode* dtNodePool::findNode(dtPolyRef id)
 
 dtNode* dtNodePool::getNode(dtPolyRef id)
 {
+	if (m_slots)
+		return getNodeOpenAddressing(id, true);
+
 	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
 	dtNodeIndex i = m_first[bucket];
 	dtNode* node = 0;
@@ -117,10 +180,11 @@ dtNode* dtNodePool::getNode(dtPolyRef id)
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-dtNodeQueue::dtNodeQueue(int n) :
+dtNodeQueue::dtNodeQueue(int n, bool indexed) :
 	m_heap(0),
 	m_capacity(n),
-	m_size(0)
+	m_size(0),
+	m_indexed(indexed)
 {
 	dtAssert(m_capacity > 0);
 	
@@ -162,3 +226,41 @@ void dtNodeQueue::trickleDown(int i, dtNode* node)
 	}
 	bubbleUp(i, node);
 }
+
+void dtNodeQueue::bubbleUp4(int i, dtNode* node)
+{
+	int parent = (i-1)/4;
+	while ((i > 0) && (m_heap[parent]->total > node->total))
+	{
+		m_heap[i] = m_heap[parent];
+		m_heap[i]->heapIndex = i;
+		i = parent;
+		parent = (i-1)/4;
+	}
+	m_heap[i] = node;
+	node->heapIndex = i;
+}
+
+void dtNodeQueue::trickleDown4(int i, dtNode* node)
+{
+	// The four children are adjacent, so finding the smallest one touches one or two cache lines.
+	int child = (i*4)+1;
+	while (child < m_size)
+	{
+		int best = child;
+		const int last = dtMin(child+4, m_size);
+		for (int c = child+1; c < last; ++c)
+		{
+			if (m_heap[c]->total < m_heap[best]->total)
+				best = c;
+		}
+		if (m_heap[best]->total >= node->total)
+			break;
+		m_heap[i] = m_heap[best];
+		m_heap[i]->heapIndex = i;
+		i = best;
+		child = (i*4)+1;
+	}
+	m_heap[i] = node;
+	node->heapIndex = i;
+}
@@ -34,14 +34,22 @@ enum ObstacleState
 	OBS_PROCESSED,
 };
 
+enum ObstacleType
+{
+	DT_OBSTACLE_CYLINDER,
+	DT_OBSTACLE_BOX,		///< Axis aligned box.
+};
+
 static const int DT_MAX_TOUCHED_TILES = 8;
 struct dtTileCacheObstacle
 {
-	float pos[3], radius, height;
+	float pos[3], radius, height;		///< Cylinder obstacle.
+	float bmin[3], bmax[3];				///< Box obstacle.
 	dtCompressedTileRef touched[DT_MAX_TOUCHED_TILES];
 	unsigned short salt;
 	unsigned char state;
 	unsigned char ntouched;
+	unsigned char type;
 	dtTileCacheObstacle* next;
 };
 
@@ -92,12 +100,17 @@ public:
 	dtStatus removeTile(dtCompressedTileRef ref, unsigned char** data, int* dataSize);
 	
 	dtStatus addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result);
+	dtStatus addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result);
 	dtStatus removeObstacle(const dtObstacleRef ref);
 	
+	/// Finds again the tiles touched by the obstacles overlapping the bounds. Call after the tiles
+	/// there were removed and added back, the obstacles refer to the removed tiles otherwise.
+	void updateObstacleTiles(const float* bmin, const float* bmax);
+	
 	dtStatus queryTiles(const float* bmin, const float* bmax,
 						dtCompressedTileRef* results, int* resultCount, const int maxResults) const;
 	
-	dtStatus update(const float /*dt*/, class dtNavMesh* navmesh);
+	dtStatus update(const float /*dt*/, class dtNavMesh* navmesh, bool* upToDate = 0);
 	
 	dtStatus buildNavMeshTilesAt(const int tx, const int ty, class dtNavMesh* navmesh);
 	
@@ -163,6 +176,9 @@ private:
 		dtObstacleRef ref;
 	};
 	
+	dtTileCacheObstacle* allocObstacle();
+	dtStatus requestAddObstacle(dtTileCacheObstacle* ob, dtObstacleRef* result);
+	
 	int m_tileLutSize;						///< Tile hash lookup size (must be pot).
 	int m_tileLutMask;						///< Tile hash lookup mask.
 	
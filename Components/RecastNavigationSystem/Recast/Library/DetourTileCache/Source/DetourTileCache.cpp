@@ -345,11 +345,8 @@ dtStatus dtTileCache::removeTile(dtCompressedTileRef ref, unsigned char** data,
 }
 
 
-dtObstacleRef dtTileCache::addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result)
+dtTileCacheObstacle* dtTileCache::allocObstacle()
 {
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
-	
 	dtTileCacheObstacle* ob = 0;
 	if (m_nextFreeObstacle)
 	{
@@ -358,16 +355,17 @@ dtObstacleRef dtTileCache::addObstacle(const float* pos, const float radius, con
 		ob->next = 0;
 	}
 	if (!ob)
-		return DT_FAILURE | DT_OUT_OF_MEMORY;
+		return 0;
 	
 	unsigned short salt = ob->salt;
 	memset(ob, 0, sizeof(dtTileCacheObstacle));
 	ob->salt = salt;
 	ob->state = OBS_NEW;
-	dtVcopy(ob->pos, pos);
-	ob->radius = radius;
-	ob->height = height;
-	
+	return ob;
+}
+
+dtStatus dtTileCache::requestAddObstacle(dtTileCacheObstacle* ob, dtObstacleRef* result)
+{
 	ObstacleRequest* req = &m_reqs[m_nreqs++];
 	memset(req, 0, sizeof(ObstacleRequest));
 	req->action = REQUEST_ADD;
@@ -379,6 +377,39 @@ dtObstacleRef dtTileCache::addObstacle(const float* pos, const float radius, con
 	return DT_SUCCESS;
 }
 
+dtObstacleRef dtTileCache::addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result)
+{
+	if (m_nreqs >= MAX_REQUESTS)
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	
+	dtTileCacheObstacle* ob = allocObstacle();
+	if (!ob)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	ob->type = DT_OBSTACLE_CYLINDER;
+	dtVcopy(ob->pos, pos);
+	ob->radius = radius;
+	ob->height = height;
+	
+	return requestAddObstacle(ob, result);
+}
+
+dtStatus dtTileCache::addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result)
+{
+	if (m_nreqs >= MAX_REQUESTS)
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	
+	dtTileCacheObstacle* ob = allocObstacle();
+	if (!ob)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	ob->type = DT_OBSTACLE_BOX;
+	dtVcopy(ob->bmin, bmin);
+	dtVcopy(ob->bmax, bmax);
+	
+	return requestAddObstacle(ob, result);
+}
+
 dtObstacleRef dtTileCache::removeObstacle(const dtObstacleRef ref)
 {
 	if (!ref)
@@ -394,6 +425,23 @@ dtObstacleRef dtTileCache::removeObstacle(const dtObstacleRef ref)
 	return DT_SUCCESS;
 }
 
+void dtTileCache::updateObstacleTiles(const float* bmin, const float* bmax)
+{
+	for (int i = 0; i < m_params.maxObstacles; ++i)
+	{
+		dtTileCacheObstacle* ob = &m_obstacles[i];
+		if (ob->state != OBS_PROCESSED)
+			continue;
+		float obmin[3], obmax[3];
+		getObstacleBounds(ob, obmin, obmax);
+		if (!dtOverlapBounds(bmin, bmax, obmin, obmax))
+			continue;
+		int ntouched = 0;
+		queryTiles(obmin, obmax, ob->touched, &ntouched, DT_MAX_TOUCHED_TILES);
+		ob->ntouched = (unsigned char)ntouched;
+	}
+}
+
 dtStatus dtTileCache::queryTiles(const float* bmin, const float* bmax,
 								 dtCompressedTileRef* results, int* resultCount, const int maxResults) const 
 {
@@ -435,12 +483,13 @@ dtStatus dtTileCache::queryTiles(const float* bmin, const float* bmax,
 	return DT_SUCCESS;
 }
 
-dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh)
+dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh, bool* upToDate)
 {
 	if (m_nupdate == 0)
 	{
 		// Process requests.
-		for (int i = 0; i < m_nreqs; ++i)
+		int i = 0;
+		for (; i < m_nreqs; ++i)
 		{
 			ObstacleRequest* req = &m_reqs[i];
 			
@@ -452,6 +501,10 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh)
 			if (ob->salt != salt)
 				continue;
 			
+			// Leave the rest of the requests for the next update if the touched tiles may not fit.
+			if (m_nupdate + DT_MAX_TOUCHED_TILES > MAX_UPDATE)
+				break;
+			
 			if (req->action == REQUEST_ADD)
 			{
 				// Add and init obstacle.
@@ -490,19 +543,23 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh)
 			}
 		}
 		
-		m_nreqs = 0;
+		m_nreqs -= i;
+		if (m_nreqs)
+			memmove(m_reqs, &m_reqs[i], sizeof(ObstacleRequest)*m_nreqs);
 	}
 	
 	// Process updates
+	dtStatus status = DT_SUCCESS;
 	if (m_nupdate)
 	{
-		dtStatus status = buildNavMeshTile(m_update[m_nupdate-1], navmesh);
+		status = buildNavMeshTile(m_update[m_nupdate-1], navmesh);
 		m_nupdate--;
-		if (dtStatusFailed(status))
-			return status;
 	}
 	
-	return DT_SUCCESS;
+	if (upToDate)
+		*upToDate = m_nupdate == 0 && m_nreqs == 0;
+	
+	return status;
 }
 
 
@@ -554,8 +611,16 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 			continue;
 		if (contains(ob->touched, ob->ntouched, ref))
 		{
-			dtMarkCylinderArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch,
-							   ob->pos, ob->radius, ob->height, 0);
+			if (ob->type == DT_OBSTACLE_BOX)
+			{
+				dtMarkBoxArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch,
+							  ob->bmin, ob->bmax, 0);
+			}
+			else
+			{
+				dtMarkCylinderArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch,
+								   ob->pos, ob->radius, ob->height, 0);
+			}
 		}
 	}
 	
@@ -579,6 +644,9 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 	if (dtStatusFailed(status))
 		return status;
 	
+	// Remove the previous navmesh tile here already, obstacles can make the layer empty.
+	navmesh->removeTile(navmesh->getTileRefAt(tile->header->tx,tile->header->ty,tile->header->tlayer),0,0);
+	
 	// Early out if the mesh tile is empty.
 	if (!bc.lmesh->npolys)
 		return DT_SUCCESS;
@@ -662,7 +730,6 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 	
 	if (navData)
 	{
-		navmesh->removeTile(navmesh->getTileRefAt(tile->header->tx,tile->header->ty,tile->header->tlayer),0,0);
 		// Let the navmesh own the data.
 		dtStatus status = navmesh->addTile(navData,navDataSize,DT_TILE_FREE_DATA,0,0);
 		if (dtStatusFailed(status))
@@ -688,6 +755,13 @@ void dtTileCache::calcTightTileBounds(const dtTileCacheLayerHeader* header, floa
 
 void dtTileCache::getObstacleBounds(const struct dtTileCacheObstacle* ob, float* bmin, float* bmax) const
 {
+	if (ob->type == DT_OBSTACLE_BOX)
+	{
+		dtVcopy(bmin, ob->bmin);
+		dtVcopy(bmax, ob->bmax);
+		return;
+	}
+	
 	bmin[0] = ob->pos[0] - ob->radius;
 	bmin[1] = ob->pos[1];
 	bmin[2] = ob->pos[2] - ob->radius;
@@ -62,6 +62,9 @@ enum rcTimerLabel
 	RC_MAX_TIMERS
 };
 
+/// Task of rcContext::runParallel, called once for every index in [0, taskCount).
+typedef void (rcParallelTaskFunc)(void* userData, const int taskIndex);
+
 /// Build context provides several optional utilities needed for the build process,
 /// such as timing, logging, and build time collecting.
 class rcContext
@@ -88,6 +91,12 @@ public:
 	/// Returns time accumulated between timer start/stop.
 	inline int getAccumulatedTime(const rcTimerLabel label) const { return m_timerEnabled ? doGetAccumulatedTime(label) : -1; }
 
+	/// Number of threads runParallel() uses, 1 when the tasks run on the calling thread.
+	inline int getParallelism() const { return doGetParallelism(); }
+	/// Runs task for every index in [0, taskCount) and returns when all of them are done.
+	/// The tasks may run on several threads at once, so they must not use the context.
+	inline void runParallel(rcParallelTaskFunc* task, void* userData, const int taskCount) { doRunParallel(task, userData, taskCount); }
+
 protected:
 
 	/// @name Virtual functions to override for custom implementations.
@@ -98,6 +107,12 @@ protected:
 	virtual void doStartTimer(const rcTimerLabel /*label*/) {}
 	virtual void doStopTimer(const rcTimerLabel /*label*/) {}
 	virtual int doGetAccumulatedTime(const rcTimerLabel /*label*/) const { return -1; }
+	virtual int doGetParallelism() const { return 1; }
+	virtual void doRunParallel(rcParallelTaskFunc* task, void* userData, const int taskCount)
+	{
+		for (int i = 0; i < taskCount; ++i)
+			task(userData, i);
+	}
 	///@}
 	
 	bool m_logEnabled;
@@ -520,6 +535,15 @@ void rcAddSpan(rcContext* ctx, rcHeightfield& hf, const int x, const int y,
 			   const unsigned short smin, const unsigned short smax,
 			   const unsigned char area, const int flagMergeThr);
 
+/// Selects the SSE path of the triangle rasterization, which clips four cells of a row at once. 
+/// The heightfield is identical with both paths. The SSE path is used by default when it is compiled in.
+///  @param enabled [in] true to use the SSE path.
+///  @return true if the SSE path is used.
+bool rcSetSimdRasterization(const bool enabled);
+
+/// Returns true if the triangle rasterization uses the SSE path.
+bool rcGetSimdRasterization();
+
 /// Rasterizes a triangle into heightfield spans.
 ///  @param v0,v1,v2 [in] the vertices of the triangle.
 ///  @param area [in] area type of the triangle.
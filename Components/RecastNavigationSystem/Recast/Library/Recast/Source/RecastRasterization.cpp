@@ -19,10 +19,38 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <stdio.h>
+#include <float.h>
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
 
+// SSE2 is always there on x64, on x86 only when the compiler is allowed to use it.
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define RC_RASTERIZE_SSE
+#	include <emmintrin.h>
+#endif
+
+#ifdef RC_RASTERIZE_SSE
+static bool s_simdRasterization = true;
+#else
+static bool s_simdRasterization = false;
+#endif
+
+bool rcSetSimdRasterization(const bool enabled)
+{
+#ifdef RC_RASTERIZE_SSE
+	s_simdRasterization = enabled;
+#else
+	(void)enabled;
+#endif
+	return s_simdRasterization;
+}
+
+bool rcGetSimdRasterization()
+{
+	return s_simdRasterization;
+}
+
 inline bool overlapBounds(const float* amin, const float* amax, const float* bmin, const float* bmax)
 {
 	bool overlap = true;
@@ -192,6 +220,141 @@ static int clipPoly(const float* in, int n, float* out, float pnx, float pnz, fl
 	return m;
 }
 
+// Snaps the height range of the clipped triangle in cell x,y to the height grid and adds the span.
+static inline void addClippedSpan(rcHeightfield& hf, const int x, const int y, float smin, float smax,
+								  const float* bmin, const float by, const float ich,
+								  const unsigned char area, const int flagMergeThr)
+{
+	smin -= bmin[1];
+	smax -= bmin[1];
+	// Skip the span if it is outside the heightfield bbox
+	if (smax < 0.0f) return;
+	if (smin > by) return;
+	// Clamp the span to the heightfield bbox.
+	if (smin < 0.0f) smin = 0;
+	if (smax > by) smax = by;
+	
+	// Snap the span to the heightfield height grid.
+	unsigned short ismin = (unsigned short)rcClamp((int)floorf(smin * ich), 0, RC_SPAN_MAX_HEIGHT);
+	unsigned short ismax = (unsigned short)rcClamp((int)ceilf(smax * ich), (int)ismin+1, RC_SPAN_MAX_HEIGHT);
+	
+	addSpan(hf, x, y, ismin, ismax, area, flagMergeThr);
+}
+
+#ifdef RC_RASTERIZE_SSE
+
+static inline __m128 selectPs(const __m128 mask, const __m128 a, const __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Clips the row polygon to four neighbouring cells at once, lane i is the cell starting at cx[i].
+// Every lane does the float operations of the two clipPoly() calls of rasterizeTri() in the same order,
+// so the heights are bit identical. Instead of compacting the clipped polygon, the first clip gives
+// every intersection and every vertex a slot with a validity mask. The second clip walks the slots,
+// the previous valid slot starts the edge, and only needs the height range of its result.
+// Only the lanes of laneMask are clipped. Returns the mask of the cells which are covered, the height 
+// range is in smin, smax.
+static int clipRowCellsSSE(const float* in, const int n, const __m128 cx, const __m128 cxcs,
+						   const __m128 laneMask, float* smin, float* smax)
+{
+	static const int MAX_SLOTS = 7*2;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	
+	// clipPoly(in, n, out, 1, 0, -cx)
+	const __m128 pd = _mm_xor_ps(cx, _mm_set1_ps(-0.0f));
+	__m128 d[7];
+	for (int i = 0; i < n; ++i)
+		d[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(one, _mm_set1_ps(in[i*3+0])), 
+									 _mm_mul_ps(zero, _mm_set1_ps(in[i*3+2]))), pd);
+	
+	__m128 slotValid[MAX_SLOTS], slotY[MAX_SLOTS], slotD[MAX_SLOTS];
+	__m128i count = _mm_setzero_si128();
+	for (int i = 0, j = n-1; i < n; j=i, ++i)
+	{
+		const __m128 ina = _mm_cmpge_ps(d[j], zero);
+		const __m128 inb = _mm_cmpge_ps(d[i], zero);
+		
+		const __m128 ix = _mm_set1_ps(in[i*3+0]), iy = _mm_set1_ps(in[i*3+1]), iz = _mm_set1_ps(in[i*3+2]);
+		
+		// Intersection of the edge j,i, the division is skipped when no lane crosses it.
+		slotValid[i*2+0] = _mm_and_ps(_mm_xor_ps(ina, inb), laneMask);
+		if (_mm_movemask_ps(slotValid[i*2+0]))
+		{
+			const __m128 s = _mm_div_ps(d[j], _mm_sub_ps(d[j], d[i]));
+			const __m128 jx = _mm_set1_ps(in[j*3+0]), jy = _mm_set1_ps(in[j*3+1]), jz = _mm_set1_ps(in[j*3+2]);
+			const __m128 px = _mm_add_ps(jx, _mm_mul_ps(_mm_sub_ps(ix, jx), s));
+			const __m128 pz = _mm_add_ps(jz, _mm_mul_ps(_mm_sub_ps(iz, jz), s));
+			slotY[i*2+0] = _mm_add_ps(jy, _mm_mul_ps(_mm_sub_ps(iy, jy), s));
+			// clipPoly(out, nv, in, -1, 0, cx+cs)
+			slotD[i*2+0] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(minusOne, px), _mm_mul_ps(zero, pz)), cxcs);
+		}
+		else
+		{
+			slotY[i*2+0] = zero;
+			slotD[i*2+0] = zero;
+		}
+		
+		// Vertex i.
+		slotValid[i*2+1] = _mm_and_ps(inb, laneMask);
+		slotY[i*2+1] = iy;
+		slotD[i*2+1] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(minusOne, ix), _mm_mul_ps(zero, iz)), cxcs);
+		
+		count = _mm_sub_epi32(count, _mm_castps_si128(slotValid[i*2+0]));
+		count = _mm_sub_epi32(count, _mm_castps_si128(slotValid[i*2+1]));
+	}
+	const int nslots = n*2;
+	
+	int covered = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(count, _mm_set1_epi32(2))));
+	if (!covered)
+		return 0;
+	
+	// The edge to the first valid slot starts at the last valid slot.
+	__m128 prevY = zero, prevD = zero;
+	for (int k = 0; k < nslots; ++k)
+	{
+		prevY = selectPs(slotValid[k], slotY[k], prevY);
+		prevD = selectPs(slotValid[k], slotD[k], prevD);
+	}
+	
+	__m128 ymin = _mm_set1_ps(FLT_MAX), ymax = _mm_set1_ps(-FLT_MAX);
+	count = _mm_setzero_si128();
+	for (int k = 0; k < nslots; ++k)
+	{
+		const __m128 valid = slotValid[k];
+		const __m128 ina = _mm_cmpge_ps(prevD, zero);
+		const __m128 inb = _mm_cmpge_ps(slotD[k], zero);
+		
+		const __m128 cross = _mm_and_ps(valid, _mm_xor_ps(ina, inb));
+		if (_mm_movemask_ps(cross))
+		{
+			const __m128 s = _mm_div_ps(prevD, _mm_sub_ps(prevD, slotD[k]));
+			const __m128 y = _mm_add_ps(prevY, _mm_mul_ps(_mm_sub_ps(slotY[k], prevY), s));
+			ymin = selectPs(cross, _mm_min_ps(ymin, y), ymin);
+			ymax = selectPs(cross, _mm_max_ps(ymax, y), ymax);
+			count = _mm_sub_epi32(count, _mm_castps_si128(cross));
+		}
+		
+		const __m128 keep = _mm_and_ps(valid, inb);
+		ymin = selectPs(keep, _mm_min_ps(ymin, slotY[k]), ymin);
+		ymax = selectPs(keep, _mm_max_ps(ymax, slotY[k]), ymax);
+		
+		count = _mm_sub_epi32(count, _mm_castps_si128(keep));
+		
+		prevY = selectPs(valid, slotY[k], prevY);
+		prevD = selectPs(valid, slotD[k], prevD);
+	}
+	covered &= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(count, _mm_set1_epi32(2))));
+	
+	_mm_storeu_ps(smin, ymin);
+	_mm_storeu_ps(smax, ymax);
+	return covered;
+}
+
+#endif
+
 static void rasterizeTri(const float* v0, const float* v1, const float* v2,
 						 const unsigned char area, rcHeightfield& hf,
 						 const float* bmin, const float* bmax,
@@ -241,7 +404,35 @@ static void rasterizeTri(const float* v0, const float* v1, const float* v2,
 		nvrow = clipPoly(out, nvrow, inrow, 0, -1, cz+cs);
 		if (nvrow < 3) continue;
 		
-		for (int x = x0; x <= x1; ++x)
+		int x = x0;
+		
+#ifdef RC_RASTERIZE_SSE
+		// Cells one by one are cheaper for narrow triangles.
+		if (s_simdRasterization && x1 - x0 >= 2)
+		{
+			const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+			const __m128 vcs = _mm_set1_ps(cs);
+			const __m128 vbmin = _mm_set1_ps(bmin[0]);
+			// The last cells of the row are clipped with the lanes past x1 masked out.
+			for (; x <= x1; x += 4)
+			{
+				// cx = bmin[0] + x*cs of the scalar path, per lane.
+				const __m128 column = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+				const __m128 cx = _mm_add_ps(vbmin, _mm_mul_ps(column, vcs));
+				const __m128 cxcs = _mm_add_ps(cx, vcs);
+				const __m128 laneMask = _mm_cmple_ps(column, _mm_set1_ps((float)x1));
+				float smin[4], smax[4];
+				const int covered = clipRowCellsSSE(inrow, nvrow, cx, cxcs, laneMask, smin, smax);
+				for (int i = 0; i < 4; ++i)
+				{
+					if (covered & (1 << i))
+						addClippedSpan(hf, x+i, y, smin[i], smax[i], bmin, by, ich, area, flagMergeThr);
+				}
+			}
+		}
+#endif
+		
+		for (; x <= x1; ++x)
 		{
 			// Clip polygon to column.
 			int nv = nvrow;
@@ -258,20 +449,7 @@ static void rasterizeTri(const float* v0, const float* v1, const float* v2,
 				smin = rcMin(smin, in[i*3+1]);
 				smax = rcMax(smax, in[i*3+1]);
 			}
-			smin -= bmin[1];
-			smax -= bmin[1];
-			// Skip the span if it is outside the heightfield bbox
-			if (smax < 0.0f) continue;
-			if (smin > by) continue;
-			// Clamp the span to the heightfield bbox.
-			if (smin < 0.0f) smin = 0;
-			if (smax > by) smax = by;
-			
-			// Snap the span to the heightfield height grid.
-			unsigned short ismin = (unsigned short)rcClamp((int)floorf(smin * ich), 0, RC_SPAN_MAX_HEIGHT);
-			unsigned short ismax = (unsigned short)rcClamp((int)ceilf(smax * ich), (int)ismin+1, RC_SPAN_MAX_HEIGHT);
-			
-			addSpan(hf, x, y, ismin, ismax, area, flagMergeThr);
+			addClippedSpan(hf, x, y, smin, smax, bmin, by, ich, area, flagMergeThr);
 		}
 	}
 }
@@ -28,17 +28,26 @@
 #include <new>
 
 
-static void calculateDistanceField(rcCompactHeightfield& chf, unsigned short* src, unsigned short& maxDist)
+// Rows of the compact heightfield processed by one task of rcContext::runParallel.
+static void getBandRows(const rcCompactHeightfield& chf, const int bandCount, const int band, int& y0, int& y1)
+{
+	y0 = chf.height*band/bandCount;
+	y1 = chf.height*(band+1)/bandCount;
+}
+
+static int getBandCount(rcContext* ctx, const rcCompactHeightfield& chf)
+{
+	// Narrow bands cost more in synchronization than they save.
+	const int minBandRows = 16;
+	const int n = rcMin(ctx->getParallelism(), chf.height/minBandRows);
+	return n > 1 ? n : 1;
+}
+
+static void markBoundaryRows(const rcCompactHeightfield& chf, unsigned short* src, const int y0, const int y1)
 {
 	const int w = chf.width;
-	const int h = chf.height;
 	
-	// Init distance and points.
-	for (int i = 0; i < chf.spanCount; ++i)
-		src[i] = 0xffff;
-	
-	// Mark boundary cells.
-	for (int y = 0; y < h; ++y)
+	for (int y = y0; y < y1; ++y)
 	{
 		for (int x = 0; x < w; ++x)
 		{
@@ -60,120 +69,236 @@ static void calculateDistanceField(rcCompactHeightfield& chf, unsigned short* sr
 							nc++;
 					}
 				}
-				if (nc != 4)
-					src[i] = 0;
+				src[i] = nc != 4 ? 0 : 0xffff;
 			}
 		}
 	}
+}
+
+// Pass 1 of the distance transform for row y, the previous rows are done. Without rowAbove
+// the row is processed as if it was the first one. Returns true if any distance got smaller.
+static bool sweepRowForward(const rcCompactHeightfield& chf, unsigned short* src, const int y, const bool rowAbove)
+{
+	const int w = chf.width;
+	bool changed = false;
 	
-			
-	// Pass 1
-	for (int y = 0; y < h; ++y)
+	for (int x = 0; x < w; ++x)
 	{
-		for (int x = 0; x < w; ++x)
+		const rcCompactCell& c = chf.cells[x+y*w];
+		for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			const rcCompactSpan& s = chf.spans[i];
+			const unsigned short sd = src[i];
+			
+			if (rcGetCon(s, 0) != RC_NOT_CONNECTED)
 			{
-				const rcCompactSpan& s = chf.spans[i];
+				// (-1,0)
+				const int ax = x + rcGetDirOffsetX(0);
+				const int ay = y + rcGetDirOffsetY(0);
+				const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 0);
+				const rcCompactSpan& as = chf.spans[ai];
+				if (src[ai]+2 < src[i])
+					src[i] = src[ai]+2;
 				
-				if (rcGetCon(s, 0) != RC_NOT_CONNECTED)
+				// (-1,-1)
+				if (rowAbove && rcGetCon(as, 3) != RC_NOT_CONNECTED)
 				{
-					// (-1,0)
-					const int ax = x + rcGetDirOffsetX(0);
-					const int ay = y + rcGetDirOffsetY(0);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 0);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (-1,-1)
-					if (rcGetCon(as, 3) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(3);
-						const int aay = ay + rcGetDirOffsetY(3);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 3);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
+					const int aax = ax + rcGetDirOffsetX(3);
+					const int aay = ay + rcGetDirOffsetY(3);
+					const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 3);
+					if (src[aai]+3 < src[i])
+						src[i] = src[aai]+3;
 				}
-				if (rcGetCon(s, 3) != RC_NOT_CONNECTED)
+			}
+			if (rowAbove && rcGetCon(s, 3) != RC_NOT_CONNECTED)
+			{
+				// (0,-1)
+				const int ax = x + rcGetDirOffsetX(3);
+				const int ay = y + rcGetDirOffsetY(3);
+				const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 3);
+				const rcCompactSpan& as = chf.spans[ai];
+				if (src[ai]+2 < src[i])
+					src[i] = src[ai]+2;
+				
+				// (1,-1)
+				if (rcGetCon(as, 2) != RC_NOT_CONNECTED)
 				{
-					// (0,-1)
-					const int ax = x + rcGetDirOffsetX(3);
-					const int ay = y + rcGetDirOffsetY(3);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 3);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (1,-1)
-					if (rcGetCon(as, 2) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(2);
-						const int aay = ay + rcGetDirOffsetY(2);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 2);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
+					const int aax = ax + rcGetDirOffsetX(2);
+					const int aay = ay + rcGetDirOffsetY(2);
+					const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 2);
+					if (src[aai]+3 < src[i])
+						src[i] = src[aai]+3;
 				}
 			}
+			
+			if (src[i] != sd)
+				changed = true;
 		}
 	}
 	
-	// Pass 2
-	for (int y = h-1; y >= 0; --y)
+	return changed;
+}
+
+// Pass 2 of the distance transform for row y, the next rows are done.
+static bool sweepRowBackward(const rcCompactHeightfield& chf, unsigned short* src, const int y, const bool rowBelow)
+{
+	const int w = chf.width;
+	bool changed = false;
+	
+	for (int x = w-1; x >= 0; --x)
 	{
-		for (int x = w-1; x >= 0; --x)
+		const rcCompactCell& c = chf.cells[x+y*w];
+		for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			const rcCompactSpan& s = chf.spans[i];
+			const unsigned short sd = src[i];
+			
+			if (rcGetCon(s, 2) != RC_NOT_CONNECTED)
 			{
-				const rcCompactSpan& s = chf.spans[i];
+				// (1,0)
+				const int ax = x + rcGetDirOffsetX(2);
+				const int ay = y + rcGetDirOffsetY(2);
+				const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 2);
+				const rcCompactSpan& as = chf.spans[ai];
+				if (src[ai]+2 < src[i])
+					src[i] = src[ai]+2;
 				
-				if (rcGetCon(s, 2) != RC_NOT_CONNECTED)
+				// (1,1)
+				if (rowBelow && rcGetCon(as, 1) != RC_NOT_CONNECTED)
 				{
-					// (1,0)
-					const int ax = x + rcGetDirOffsetX(2);
-					const int ay = y + rcGetDirOffsetY(2);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 2);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (1,1)
-					if (rcGetCon(as, 1) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(1);
-						const int aay = ay + rcGetDirOffsetY(1);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 1);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
+					const int aax = ax + rcGetDirOffsetX(1);
+					const int aay = ay + rcGetDirOffsetY(1);
+					const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 1);
+					if (src[aai]+3 < src[i])
+						src[i] = src[aai]+3;
 				}
-				if (rcGetCon(s, 1) != RC_NOT_CONNECTED)
+			}
+			if (rowBelow && rcGetCon(s, 1) != RC_NOT_CONNECTED)
+			{
+				// (0,1)
+				const int ax = x + rcGetDirOffsetX(1);
+				const int ay = y + rcGetDirOffsetY(1);
+				const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 1);
+				const rcCompactSpan& as = chf.spans[ai];
+				if (src[ai]+2 < src[i])
+					src[i] = src[ai]+2;
+				
+				// (-1,1)
+				if (rcGetCon(as, 0) != RC_NOT_CONNECTED)
 				{
-					// (0,1)
-					const int ax = x + rcGetDirOffsetX(1);
-					const int ay = y + rcGetDirOffsetY(1);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 1);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (-1,1)
-					if (rcGetCon(as, 0) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(0);
-						const int aay = ay + rcGetDirOffsetY(0);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 0);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
+					const int aax = ax + rcGetDirOffsetX(0);
+					const int aay = ay + rcGetDirOffsetY(0);
+					const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 0);
+					if (src[aai]+3 < src[i])
+						src[i] = src[aai]+3;
 				}
 			}
+			
+			if (src[i] != sd)
+				changed = true;
+		}
+	}
+	
+	return changed;
+}
+
+struct rcDistanceFieldTask
+{
+	const rcCompactHeightfield* chf;
+	unsigned short* src;
+	unsigned short* dst;
+	int bandCount;
+	int thr;
+};
+
+static void markBoundaryTask(void* userData, const int band)
+{
+	rcDistanceFieldTask* task = (rcDistanceFieldTask*)userData;
+	int y0, y1;
+	getBandRows(*task->chf, task->bandCount, band, y0, y1);
+	markBoundaryRows(*task->chf, task->src, y0, y1);
+}
+
+static void sweepForwardTask(void* userData, const int band)
+{
+	rcDistanceFieldTask* task = (rcDistanceFieldTask*)userData;
+	int y0, y1;
+	getBandRows(*task->chf, task->bandCount, band, y0, y1);
+	for (int y = y0; y < y1; ++y)
+		sweepRowForward(*task->chf, task->src, y, y > y0);
+}
+
+static void sweepBackwardTask(void* userData, const int band)
+{
+	rcDistanceFieldTask* task = (rcDistanceFieldTask*)userData;
+	int y0, y1;
+	getBandRows(*task->chf, task->bandCount, band, y0, y1);
+	for (int y = y1-1; y >= y0; --y)
+		sweepRowBackward(*task->chf, task->src, y, y < y1-1);
+}
+
+static void calculateDistanceField(rcContext* ctx, rcCompactHeightfield& chf, unsigned short* src, unsigned short& maxDist)
+{
+	const int h = chf.height;
+	const int bandCount = getBandCount(ctx, chf);
+	
+	rcDistanceFieldTask task;
+	task.chf = &chf;
+	task.src = src;
+	task.dst = 0;
+	task.bandCount = bandCount;
+	task.thr = 0;
+	
+	// Init distance and mark boundary cells.
+	if (bandCount > 1)
+		ctx->runParallel(markBoundaryTask, &task, bandCount);
+	else
+		markBoundaryRows(chf, src, 0, h);
+	
+	// Pass 1
+	if (bandCount > 1)
+	{
+		// Each band is swept as if nothing was above it. A row reached by shorter distances from the
+		// band above is swept again, the sweep stops at the first row which does not change,
+		// because the rows below it only depend on it. The result is the same as of a single sweep.
+		ctx->runParallel(sweepForwardTask, &task, bandCount);
+		for (int band = 1; band < bandCount; ++band)
+		{
+			int y0, y1;
+			getBandRows(chf, bandCount, band, y0, y1);
+			for (int y = y0; y < y1; ++y)
+			{
+				if (!sweepRowForward(chf, src, y, true))
+					break;
+			}
 		}
-	}	
+	}
+	else
+	{
+		for (int y = 0; y < h; ++y)
+			sweepRowForward(chf, src, y, true);
+	}
+	
+	// Pass 2
+	if (bandCount > 1)
+	{
+		ctx->runParallel(sweepBackwardTask, &task, bandCount);
+		for (int band = bandCount-2; band >= 0; --band)
+		{
+			int y0, y1;
+			getBandRows(chf, bandCount, band, y0, y1);
+			for (int y = y1-1; y >= y0; --y)
+			{
+				if (!sweepRowBackward(chf, src, y, true))
+					break;
+			}
+		}
+	}
+	else
+	{
+		for (int y = h-1; y >= 0; --y)
+			sweepRowBackward(chf, src, y, true);
+	}
 	
 	maxDist = 0;
 	for (int i = 0; i < chf.spanCount; ++i)
@@ -181,15 +306,14 @@ static void calculateDistanceField(rcCompactHeightfield& chf, unsigned short* sr
 	
 }
 
-static unsigned short* boxBlur(rcCompactHeightfield& chf, int thr,
-							   unsigned short* src, unsigned short* dst)
+static void boxBlurRows(const rcCompactHeightfield& chf, int thr,
+						const unsigned short* src, unsigned short* dst, const int y0, const int y1)
 {
 	const int w = chf.width;
-	const int h = chf.height;
 	
 	thr *= 2;
 	
-	for (int y = 0; y < h; ++y)
+	for (int y = y0; y < y1; ++y)
 	{
 		for (int x = 0; x < w; ++x)
 		{
@@ -237,6 +361,34 @@ static unsigned short* boxBlur(rcCompactHeightfield& chf, int thr,
 			}
 		}
 	}
+}
+
+static void boxBlurTask(void* userData, const int band)
+{
+	rcDistanceFieldTask* task = (rcDistanceFieldTask*)userData;
+	int y0, y1;
+	getBandRows(*task->chf, task->bandCount, band, y0, y1);
+	boxBlurRows(*task->chf, task->thr, task->src, task->dst, y0, y1);
+}
+
+static unsigned short* boxBlur(rcContext* ctx, rcCompactHeightfield& chf, int thr,
+							   unsigned short* src, unsigned short* dst)
+{
+	const int bandCount = getBandCount(ctx, chf);
+	if (bandCount > 1)
+	{
+		rcDistanceFieldTask task;
+		task.chf = &chf;
+		task.src = src;
+		task.dst = dst;
+		task.bandCount = bandCount;
+		task.thr = thr;
+		ctx->runParallel(boxBlurTask, &task, bandCount);
+	}
+	else
+	{
+		boxBlurRows(chf, thr, src, dst, 0, chf.height);
+	}
 	return dst;
 }
 
@@ -336,18 +488,13 @@ static bool floodRegion(int x, int y, int i,
 	return count > 0;
 }
 
-static unsigned short* expandRegions(int maxIter, unsigned short level,
-									 rcCompactHeightfield& chf,
-									 unsigned short* srcReg, unsigned short* srcDist,
-									 unsigned short* dstReg, unsigned short* dstDist, 
-									 rcIntArray& stack)
+static int findRevealedCells(const rcCompactHeightfield& chf, unsigned short level, const unsigned short* srcReg,
+							 const int y0, const int y1, int* stack)
 {
 	const int w = chf.width;
-	const int h = chf.height;
-
-	// Find cells revealed by the raised level.
-	stack.resize(0);
-	for (int y = 0; y < h; ++y)
+	int n = 0;
+	
+	for (int y = y0; y < y1; ++y)
 	{
 		for (int x = 0; x < w; ++x)
 		{
@@ -356,63 +503,199 @@ static unsigned short* expandRegions(int maxIter, unsigned short level,
 			{
 				if (chf.dist[i] >= level && srcReg[i] == 0 && chf.areas[i] != RC_NULL_AREA)
 				{
-					stack.push(x);
-					stack.push(y);
-					stack.push(i);
+					if (stack)
+					{
+						stack[n+0] = x;
+						stack[n+1] = y;
+						stack[n+2] = i;
+					}
+					n += 3;
 				}
 			}
 		}
 	}
 	
-	int iter = 0;
-	while (stack.size() > 0)
+	return n;
+}
+
+// One step of the expansion for the stack entries in [begin, end). Returns the number of entries
+// which could not be expanded.
+static int expandStackEntries(const rcCompactHeightfield& chf, int* stack, const int begin, const int end,
+							  const unsigned short* srcReg, const unsigned short* srcDist,
+							  unsigned short* dstReg, unsigned short* dstDist)
+{
+	const int w = chf.width;
+	int failed = 0;
+	
+	for (int j = begin; j < end; j += 3)
 	{
-		int failed = 0;
-		
-		memcpy(dstReg, srcReg, sizeof(unsigned short)*chf.spanCount);
-		memcpy(dstDist, srcDist, sizeof(unsigned short)*chf.spanCount);
+		int x = stack[j+0];
+		int y = stack[j+1];
+		int i = stack[j+2];
+		if (i < 0)
+		{
+			failed++;
+			continue;
+		}
 		
-		for (int j = 0; j < stack.size(); j += 3)
+		unsigned short r = srcReg[i];
+		unsigned short d2 = 0xffff;
+		const unsigned char area = chf.areas[i];
+		const rcCompactSpan& s = chf.spans[i];
+		for (int dir = 0; dir < 4; ++dir)
 		{
-			int x = stack[j+0];
-			int y = stack[j+1];
-			int i = stack[j+2];
-			if (i < 0)
+			if (rcGetCon(s, dir) == RC_NOT_CONNECTED) continue;
+			const int ax = x + rcGetDirOffsetX(dir);
+			const int ay = y + rcGetDirOffsetY(dir);
+			const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
+			if (chf.areas[ai] != area) continue;
+			if (srcReg[ai] > 0 && (srcReg[ai] & RC_BORDER_REG) == 0)
 			{
-				failed++;
-				continue;
+				if ((int)srcDist[ai]+2 < (int)d2)
+				{
+					r = srcReg[ai];
+					d2 = srcDist[ai]+2;
+				}
 			}
-			
-			unsigned short r = srcReg[i];
-			unsigned short d2 = 0xffff;
-			const unsigned char area = chf.areas[i];
-			const rcCompactSpan& s = chf.spans[i];
-			for (int dir = 0; dir < 4; ++dir)
+		}
+		if (r)
+		{
+			stack[j+2] = -1; // mark as used
+			dstReg[i] = r;
+			dstDist[i] = d2;
+		}
+		else
+		{
+			failed++;
+		}
+	}
+	
+	return failed;
+}
+
+// The stack entries of one step are independent, every one reads the source and writes its own span.
+static const int RC_MAX_EXPAND_TASKS = 64;
+
+struct rcExpandTask
+{
+	const rcCompactHeightfield* chf;
+	unsigned short level;
+	int taskCount;
+	int* stack;
+	int stackSize;
+	const unsigned short* srcReg;
+	const unsigned short* srcDist;
+	unsigned short* dstReg;
+	unsigned short* dstDist;
+	int counts[RC_MAX_EXPAND_TASKS];
+	int offsets[RC_MAX_EXPAND_TASKS];
+};
+
+static void countRevealedCellsTask(void* userData, const int band)
+{
+	rcExpandTask* task = (rcExpandTask*)userData;
+	int y0, y1;
+	getBandRows(*task->chf, task->taskCount, band, y0, y1);
+	task->counts[band] = findRevealedCells(*task->chf, task->level, task->srcReg, y0, y1, 0);
+}
+
+static void findRevealedCellsTask(void* userData, const int band)
+{
+	rcExpandTask* task = (rcExpandTask*)userData;
+	int y0, y1;
+	getBandRows(*task->chf, task->taskCount, band, y0, y1);
+	findRevealedCells(*task->chf, task->level, task->srcReg, y0, y1, task->stack + task->offsets[band]);
+}
+
+static void expandStackEntriesTask(void* userData, const int index)
+{
+	rcExpandTask* task = (rcExpandTask*)userData;
+	const int entryCount = task->stackSize/3;
+	const int begin = entryCount*index/task->taskCount*3;
+	const int end = entryCount*(index+1)/task->taskCount*3;
+	task->counts[index] = expandStackEntries(*task->chf, task->stack, begin, end,
+		task->srcReg, task->srcDist, task->dstReg, task->dstDist);
+}
+
+static unsigned short* expandRegions(rcContext* ctx, int maxIter, unsigned short level,
+									 rcCompactHeightfield& chf,
+									 unsigned short* srcReg, unsigned short* srcDist,
+									 unsigned short* dstReg, unsigned short* dstDist, 
+									 rcIntArray& stack)
+{
+	// Fewer entries are expanded faster on the calling thread.
+	const int minParallelEntries = 4096;
+	
+	rcExpandTask task;
+	task.chf = &chf;
+	task.level = level;
+	task.taskCount = rcMin(getBandCount(ctx, chf), RC_MAX_EXPAND_TASKS);
+	task.srcReg = srcReg;
+	
+	// Find cells revealed by the raised level.
+	if (task.taskCount > 1)
+	{
+		// Counted first, so the bands can write their cells in the same order as a single thread.
+		ctx->runParallel(countRevealedCellsTask, &task, task.taskCount);
+		int size = 0;
+		for (int band = 0; band < task.taskCount; ++band)
+		{
+			task.offsets[band] = size;
+			size += task.counts[band];
+		}
+		stack.resize(size);
+		if (size > 0)
+		{
+			task.stack = &stack[0];
+			ctx->runParallel(findRevealedCellsTask, &task, task.taskCount);
+		}
+	}
+	else
+	{
+		const int w = chf.width;
+		const int h = chf.height;
+		stack.resize(0);
+		for (int y = 0; y < h; ++y)
+		{
+			for (int x = 0; x < w; ++x)
 			{
-				if (rcGetCon(s, dir) == RC_NOT_CONNECTED) continue;
-				const int ax = x + rcGetDirOffsetX(dir);
-				const int ay = y + rcGetDirOffsetY(dir);
-				const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
-				if (chf.areas[ai] != area) continue;
-				if (srcReg[ai] > 0 && (srcReg[ai] & RC_BORDER_REG) == 0)
+				const rcCompactCell& c = chf.cells[x+y*w];
+				for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 				{
-					if ((int)srcDist[ai]+2 < (int)d2)
+					if (chf.dist[i] >= level && srcReg[i] == 0 && chf.areas[i] != RC_NULL_AREA)
 					{
-						r = srcReg[ai];
-						d2 = srcDist[ai]+2;
+						stack.push(x);
+						stack.push(y);
+						stack.push(i);
 					}
 				}
 			}
-			if (r)
-			{
-				stack[j+2] = -1; // mark as used
-				dstReg[i] = r;
-				dstDist[i] = d2;
-			}
-			else
-			{
-				failed++;
-			}
+		}
+	}
+	
+	int iter = 0;
+	while (stack.size() > 0)
+	{
+		int failed = 0;
+		
+		memcpy(dstReg, srcReg, sizeof(unsigned short)*chf.spanCount);
+		memcpy(dstDist, srcDist, sizeof(unsigned short)*chf.spanCount);
+		
+		if (task.taskCount > 1 && stack.size()/3 >= minParallelEntries)
+		{
+			task.stack = &stack[0];
+			task.stackSize = stack.size();
+			task.srcReg = srcReg;
+			task.srcDist = srcDist;
+			task.dstReg = dstReg;
+			task.dstDist = dstDist;
+			ctx->runParallel(expandStackEntriesTask, &task, task.taskCount);
+			for (int i = 0; i < task.taskCount; ++i)
+				failed += task.counts[i];
+		}
+		else
+		{
+			failed = expandStackEntries(chf, &stack[0], 0, stack.size(), srcReg, srcDist, dstReg, dstDist);
 		}
 		
 		// rcSwap source and dest.
@@ -967,7 +1250,7 @@ bool rcBuildDistanceField(rcContext* ctx, rcCompactHeightfield& chf)
 
 	ctx->startTimer(RC_TIMER_BUILD_DISTANCEFIELD_DIST);
 	
-	calculateDistanceField(chf, src, maxDist);
+	calculateDistanceField(ctx, chf, src, maxDist);
 	chf.maxDistance = maxDist;
 	
 	ctx->stopTimer(RC_TIMER_BUILD_DISTANCEFIELD_DIST);
@@ -975,7 +1258,7 @@ bool rcBuildDistanceField(rcContext* ctx, rcCompactHeightfield& chf)
 	ctx->startTimer(RC_TIMER_BUILD_DISTANCEFIELD_BLUR);
 	
 	// Blur
-	if (boxBlur(chf, 1, src, dst) != src)
+	if (boxBlur(ctx, chf, 1, src, dst) != src)
 		rcSwap(src, dst);
 	
 	// Store distance.
@@ -1231,7 +1514,7 @@ bool rcBuildRegions(rcContext* ctx, rcCompactHeightfield& chf,
 		ctx->startTimer(RC_TIMER_BUILD_REGIONS_EXPAND);
 		
 		// Expand current regions until no empty connected cells found.
-		if (expandRegions(expandIters, level, chf, srcReg, srcDist, dstReg, dstDist, stack) != srcReg)
+		if (expandRegions(ctx, expandIters, level, chf, srcReg, srcDist, dstReg, dstDist, stack) != srcReg)
 		{
 			rcSwap(srcReg, dstReg);
 			rcSwap(srcDist, dstDist);
@@ -1261,7 +1544,7 @@ bool rcBuildRegions(rcContext* ctx, rcCompactHeightfield& chf,
 	}
 	
 	// Expand current regions until no empty connected cells found.
-	if (expandRegions(expandIters*8, 0, chf, srcReg, srcDist, dstReg, dstDist, stack) != srcReg)
+	if (expandRegions(ctx, expandIters*8, 0, chf, srcReg, srcDist, dstReg, dstDist, stack) != srcReg)
 	{
 		rcSwap(srcReg, dstReg);
 		rcSwap(srcDist, dstDist);
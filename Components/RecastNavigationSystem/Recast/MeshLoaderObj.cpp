@@ -28,7 +28,13 @@ rcMeshLoaderObj::rcMeshLoaderObj() :
 	m_tris(0),
 	//m_normals(0),
 	m_vertCount(0),
-	m_triCount(0)
+	m_triCount(0),
+	m_vertCap(0),
+	m_triCap(0),
+	m_idSlots(0),
+	m_idCount(0),
+	m_idCap(0),
+	m_removedCount(0)
 {
 }
 
@@ -37,6 +43,7 @@ rcMeshLoaderObj::~rcMeshLoaderObj()
 	delete [] m_verts;
 	//delete [] m_normals;
 	delete [] m_tris;
+	delete [] m_idSlots;
 }
 		
 void rcMeshLoaderObj::addVertex(float x, float y, float z, int& cap)
@@ -230,22 +237,145 @@ void rcMeshLoaderObj::addTriangle(int a, int b, int c, int& cap)
 
 bool rcMeshLoaderObj::load(float* vertices, int vertexCount, int* indices, int indexCount)
 {
-	int vcap = 0;
-	int tcap = 0;
+	return append(vertices, vertexCount, indices, indexCount);
+}
 
-	for(int n = 0; n < vertexCount; n++)
+void rcMeshLoaderObj::reserve(int vertexCount, int triangleCount)
+{
+	if (vertexCount > m_vertCap)
 	{
-		float* vertex = vertices + n * 3;
-		addVertex(vertex[0], vertex[1], vertex[2], vcap);
+		float* nv = new float[vertexCount*3];
+		if (m_vertCount)
+			memcpy(nv, m_verts, m_vertCount*3*sizeof(float));
+		delete [] m_verts;
+		m_verts = nv;
+		m_vertCap = vertexCount;
+	}
+	if (triangleCount > m_triCap)
+	{
+		int* nv = new int[triangleCount*3];
+		if (m_triCount)
+			memcpy(nv, m_tris, m_triCount*3*sizeof(int));
+		delete [] m_tris;
+		m_tris = nv;
+		m_triCap = triangleCount;
 	}
+}
+
+void rcMeshLoaderObj::reserveIds(int idCount)
+{
+	if (idCount > m_idCap)
+	{
+		int* nv = new int[idCount];
+		if (m_idCount)
+			memcpy(nv, m_idSlots, m_idCount*sizeof(int));
+		delete [] m_idSlots;
+		m_idSlots = nv;
+		m_idCap = idCount;
+	}
+}
 
+bool rcMeshLoaderObj::append(const float* vertices, int vertexCount, const int* indices, int indexCount)
+{
+	const int firstVertex = m_vertCount;
 	int triangleCount = indexCount / 3;
 
+	// Grow by at least half to keep repeated appends cheap.
+	if (m_vertCount + vertexCount > m_vertCap)
+		reserve(m_vertCount + vertexCount + (m_vertCount ? m_vertCount/2 : 0), 0);
+	if (m_triCount + triangleCount > m_triCap)
+		reserve(0, m_triCount + triangleCount + (m_triCount ? m_triCount/2 : 0));
+	if (m_idCount + triangleCount > m_idCap)
+		reserveIds(m_idCount + triangleCount + (m_idCount ? m_idCount/2 : 0));
+
+	for(int n = 0; n < triangleCount; n++)
+		m_idSlots[m_idCount++] = m_triCount + n;
+
+	for(int n = 0; n < vertexCount; n++)
+	{
+		const float* vertex = vertices + n * 3;
+		addVertex(vertex[0], vertex[1], vertex[2], m_vertCap);
+	}
+
 	for(int n = 0; n < triangleCount; n++)
 	{
-		int* index = indices + n * 3;
-		addTriangle(index[0], index[1], index[2], tcap);
+		const int* index = indices + n * 3;
+		addTriangle(firstVertex + index[0], firstVertex + index[1], firstVertex + index[2], m_triCap);
+	}
+
+	return true;
+}
+
+void rcMeshLoaderObj::removeTriangle(int id)
+{
+	if (getTriSlot(id) < 0)
+		return;
+	m_idSlots[id] = -1;
+	m_removedCount++;
+}
+
+bool rcMeshLoaderObj::compact()
+{
+	if (!m_removedCount)
+		return true;
+
+	int* vertMap = new int[m_vertCount];
+	if (!vertMap)
+		return false;
+	memset(vertMap, 0xff, m_vertCount*sizeof(int));
+	int vertCount = 0;
+	for (int id = 0; id < m_idCount; ++id)
+	{
+		const int slot = m_idSlots[id];
+		if (slot < 0)
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			int& v = vertMap[m_tris[slot*3+k]];
+			if (v < 0)
+				v = vertCount++;
+		}
 	}
 
+	const int triCount = m_triCount - m_removedCount;
+	float* verts = new float[vertCount*3];
+	int* tris = new int[triCount*3];
+	if (!verts || !tris)
+	{
+		delete [] verts;
+		delete [] tris;
+		delete [] vertMap;
+		return false;
+	}
+
+	for (int i = 0; i < m_vertCount; ++i)
+	{
+		if (vertMap[i] >= 0)
+			memcpy(&verts[vertMap[i]*3], &m_verts[i*3], 3*sizeof(float));
+	}
+
+	// Slots are assigned in id order, the triangles which are left keep it.
+	int newSlot = 0;
+	for (int id = 0; id < m_idCount; ++id)
+	{
+		const int slot = m_idSlots[id];
+		if (slot < 0)
+			continue;
+		for (int k = 0; k < 3; ++k)
+			tris[newSlot*3+k] = vertMap[m_tris[slot*3+k]];
+		m_idSlots[id] = newSlot++;
+	}
+
+	delete [] vertMap;
+	delete [] m_verts;
+	delete [] m_tris;
+	m_verts = verts;
+	m_tris = tris;
+	m_vertCount = vertCount;
+	m_vertCap = vertCount;
+	m_triCount = triCount;
+	m_triCap = triCount;
+	m_removedCount = 0;
+
 	return true;
 }
@@ -26,19 +26,35 @@ public:
 	~rcMeshLoaderObj();
 	
 	bool load(float* vertices, int vertexCount, int* indices, int indexCount);
+	/// Appends vertices and triangles, indices are relative to the appended vertices.
+	/// The triangles get the ids following getTriIdCount().
+	bool append(const float* vertices, int vertexCount, const int* indices, int indexCount);
+	/// Marks the triangle as removed. Its vertices and indices are kept until compact() is called.
+	void removeTriangle(int id);
+	/// Drops removed triangles and the vertices used only by them. Triangle ids stay valid,
+	/// the triangles which are left move to lower slots of getTris() in the same order.
+	bool compact();
 	//bool load(const char* fileName);
 
 	inline const float* getVerts() const { return m_verts; }
 	//inline const float* getNormals() const { return m_normals; }
+	/// Triangles by slot. Slots are the ids until triangles are removed and the mesh is compacted.
 	inline const int* getTris() const { return m_tris; }
 	inline int getVertCount() const { return m_vertCount; }
 	inline int getTriCount() const { return m_triCount; }
+	/// Triangle ids handed out so far, including the removed ones.
+	inline int getTriIdCount() const { return m_idCount; }
+	/// Returns the slot of the triangle id in getTris(), -1 for removed triangles.
+	inline int getTriSlot(int id) const { return id >= 0 && id < m_idCount ? m_idSlots[id] : -1; }
+	inline int getRemovedTriCount() const { return m_removedCount; }
 	//inline const char* getFileName() const { return m_filename; }
 
 private:
 	
 	void addVertex(float x, float y, float z, int& cap);
 	void addTriangle(int a, int b, int c, int& cap);
+	void reserve(int vertexCount, int triangleCount);
+	void reserveIds(int idCount);
 	
 	//char m_filename[260];
 	
@@ -47,6 +63,12 @@ private:
 	//float* m_normals;
 	int m_vertCount;
 	int m_triCount;
+	int m_vertCap;
+	int m_triCap;
+	int* m_idSlots;
+	int m_idCount;
+	int m_idCap;
+	int m_removedCount;
 };
 
 #endif // MESHLOADER_OBJ
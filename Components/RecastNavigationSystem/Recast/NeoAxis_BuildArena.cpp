@@ -0,0 +1,273 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+#include "NeoAxis_BuildArena.h"
+#include "RecastAlloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <pthread.h>
+#endif
+
+// Every allocation of rcAlloc starts with a header, which tells rcFree where the memory is from.
+static const int HEADER_SIZE = 16;
+static const int ALIGNMENT = 16;
+static const int MIN_BLOCK_SIZE = 256*1024;
+
+static const int TAG_HEAP = 0x50414548;
+static const int TAG_ARENA = 0x4e455241;
+static const int TAG_RELEASED = 0x454c4552;
+
+struct NeoAxis_BuildArena::Header
+{
+	// Previous allocation of the arena.
+	Header* prev;
+	int block;
+	int tag;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Arena of the scope of the calling thread.
+#ifdef _WIN32
+
+static DWORD s_currentArena = TLS_OUT_OF_INDEXES;
+
+static bool createCurrentArena()
+{
+	s_currentArena = TlsAlloc();
+	return s_currentArena != TLS_OUT_OF_INDEXES;
+}
+
+static inline NeoAxis_BuildArena* getCurrentArena()
+{
+	return (NeoAxis_BuildArena*)TlsGetValue(s_currentArena);
+}
+
+static inline void setCurrentArena(NeoAxis_BuildArena* arena)
+{
+	TlsSetValue(s_currentArena, arena);
+}
+
+#else
+
+static pthread_key_t s_currentArena;
+
+static bool createCurrentArena()
+{
+	return pthread_key_create(&s_currentArena, NULL) == 0;
+}
+
+static inline NeoAxis_BuildArena* getCurrentArena()
+{
+	return (NeoAxis_BuildArena*)pthread_getspecific(s_currentArena);
+}
+
+static inline void setCurrentArena(NeoAxis_BuildArena* arena)
+{
+	pthread_setspecific(s_currentArena, arena);
+}
+
+#endif
+
+static bool s_currentArenaCreated = false;
+
+static void* allocHook(int size, rcAllocHint /*hint*/)
+{
+	NeoAxis_BuildArena* arena = s_currentArenaCreated ? getCurrentArena() : 0;
+	if (arena)
+		return arena->allocate(size);
+
+	char* data = (char*)malloc(HEADER_SIZE + size);
+	if (!data)
+		return 0;
+	((NeoAxis_BuildArena::Header*)data)->tag = TAG_HEAP;
+	return data + HEADER_SIZE;
+}
+
+static void freeHook(void* ptr)
+{
+	char* data = (char*)ptr - HEADER_SIZE;
+	if (((NeoAxis_BuildArena::Header*)data)->tag == TAG_HEAP)
+	{
+		free(data);
+		return;
+	}
+
+	// Arena memory released outside of a scope is reused after the reset.
+	NeoAxis_BuildArena* arena = s_currentArenaCreated ? getCurrentArena() : 0;
+	if (arena)
+		arena->release(ptr);
+}
+
+// The hooks are installed when the library is loaded, before anything is allocated with rcAlloc.
+static struct BuildArenaHooks
+{
+	BuildArenaHooks()
+	{
+		s_currentArenaCreated = createCurrentArena();
+		rcAllocSetCustom(allocHook, freeHook);
+	}
+} s_hooks;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+NeoAxis_BuildArena::NeoAxis_BuildArena() :
+	m_blocks(0),
+	m_blockCount(0),
+	m_blockCapacity(0),
+	m_block(0),
+	m_blockStart(0),
+	m_used(0),
+	m_peakUsage(0),
+	m_top(0)
+{
+}
+
+NeoAxis_BuildArena::~NeoAxis_BuildArena()
+{
+	freeBlocks();
+}
+
+void NeoAxis_BuildArena::freeBlocks()
+{
+	for (int i = 0; i < m_blockCount; ++i)
+		free(m_blocks[i].data);
+	free(m_blocks);
+	m_blocks = 0;
+	m_blockCount = 0;
+	m_blockCapacity = 0;
+}
+
+int NeoAxis_BuildArena::getCapacity() const
+{
+	int capacity = 0;
+	for (int i = 0; i < m_blockCount; ++i)
+		capacity += m_blocks[i].size;
+	return capacity;
+}
+
+bool NeoAxis_BuildArena::owns(const void* ptr) const
+{
+	for (int i = 0; i < m_blockCount; ++i)
+	{
+		if ((const char*)ptr >= m_blocks[i].data && (const char*)ptr < m_blocks[i].data + m_blocks[i].size)
+			return true;
+	}
+	return false;
+}
+
+void* NeoAxis_BuildArena::allocate(int size)
+{
+	if (size < 0)
+		return 0;
+	const int total = HEADER_SIZE + ((size + ALIGNMENT-1) & ~(ALIGNMENT-1));
+
+	// The blocks after the current one are empty.
+	while (m_block < m_blockCount && m_used + total > m_blocks[m_block].size)
+	{
+		m_blockStart += m_blocks[m_block].size;
+		m_block++;
+		m_used = 0;
+	}
+
+	if (m_block == m_blockCount)
+	{
+		if (m_blockCount == m_blockCapacity)
+		{
+			const int capacity = m_blockCapacity ? m_blockCapacity*2 : 4;
+			Block* blocks = (Block*)realloc(m_blocks, capacity*sizeof(Block));
+			if (!blocks)
+				return 0;
+			m_blocks = blocks;
+			m_blockCapacity = capacity;
+		}
+
+		// Grow geometrically, a large tile needs only a few blocks.
+		int blockSize = m_blockStart > MIN_BLOCK_SIZE ? m_blockStart : MIN_BLOCK_SIZE;
+		if (blockSize < total)
+			blockSize = total;
+		Block& block = m_blocks[m_blockCount];
+		block.data = (char*)malloc(blockSize);
+		if (!block.data)
+			return 0;
+		block.size = blockSize;
+		m_blockCount++;
+	}
+
+	Header* header = (Header*)(m_blocks[m_block].data + m_used);
+	header->prev = m_top;
+	header->block = m_block;
+	header->tag = TAG_ARENA;
+	m_top = header;
+	m_used += total;
+
+	if (m_peakUsage < m_blockStart + m_used)
+		m_peakUsage = m_blockStart + m_used;
+
+	return (char*)header + HEADER_SIZE;
+}
+
+void NeoAxis_BuildArena::release(void* ptr)
+{
+	if (!owns(ptr))
+		return;
+
+	Header* header = (Header*)((char*)ptr - HEADER_SIZE);
+	header->tag = TAG_RELEASED;
+
+	// Rewind over the released allocations at the top, like a stack.
+	while (m_top && m_top->tag == TAG_RELEASED)
+	{
+		Header* top = m_top;
+		if (top->block != m_block)
+		{
+			m_block = top->block;
+			m_blockStart = 0;
+			for (int i = 0; i < m_block; ++i)
+				m_blockStart += m_blocks[i].size;
+		}
+		m_used = (int)((char*)top - m_blocks[m_block].data);
+		m_top = top->prev;
+	}
+}
+
+void NeoAxis_BuildArena::reset()
+{
+	// Merge the blocks, the next tile likely needs as much memory.
+	if (m_blockCount > 1)
+	{
+		const int capacity = getCapacity();
+		freeBlocks();
+		m_blocks = (Block*)malloc(4*sizeof(Block));
+		if (m_blocks)
+		{
+			m_blockCapacity = 4;
+			m_blocks[0].data = (char*)malloc(capacity);
+			m_blocks[0].size = capacity;
+			if (m_blocks[0].data)
+				m_blockCount = 1;
+		}
+	}
+
+	m_block = 0;
+	m_blockStart = 0;
+	m_used = 0;
+	m_top = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+NeoAxis_BuildArena::Scope::Scope(NeoAxis_BuildArena* arena)
+{
+	m_previous = s_currentArenaCreated ? getCurrentArena() : 0;
+	if (s_currentArenaCreated)
+		setCurrentArena(arena);
+}
+
+NeoAxis_BuildArena::Scope::~Scope()
+{
+	if (s_currentArenaCreated)
+		setCurrentArena(m_previous);
+}
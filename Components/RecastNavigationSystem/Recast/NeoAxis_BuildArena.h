@@ -0,0 +1,62 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+
+#ifndef NEOAXIS_BUILDARENA_H
+#define NEOAXIS_BUILDARENA_H
+
+/// Bump allocator for the Recast allocations of a tile build. Every thread that builds tiles needs its own.
+/// Memory freed in reverse order of allocation is reused at once, the rest when the arena is reset
+/// before the next tile. The blocks are kept, so after the first tiles a build does not allocate at all.
+class NeoAxis_BuildArena
+{
+public:
+	NeoAxis_BuildArena();
+	~NeoAxis_BuildArena();
+
+	void* allocate(int size);
+	void release(void* ptr);
+	/// Releases all allocations, nothing allocated from the arena may be used afterwards.
+	void reset();
+
+	/// Size of the blocks of the arena.
+	int getCapacity() const;
+	/// Most memory used since the arena was created.
+	int getPeakUsage() const { return m_peakUsage; }
+
+	/// Precedes every allocation of rcAlloc.
+	struct Header;
+
+	/// rcAlloc allocates from the arena on the calling thread while the scope exists. Allocations
+	/// outside of a scope go to the heap.
+	class Scope
+	{
+	public:
+		Scope(NeoAxis_BuildArena* arena);
+		~Scope();
+	private:
+		NeoAxis_BuildArena* m_previous;
+	};
+
+private:
+	struct Block
+	{
+		char* data;
+		int size;
+	};
+
+	bool owns(const void* ptr) const;
+	void freeBlocks();
+
+	Block* m_blocks;
+	int m_blockCount;
+	int m_blockCapacity;
+	int m_block;
+	int m_blockStart;
+	int m_used;
+	int m_peakUsage;
+	Header* m_top;
+
+	NeoAxis_BuildArena(const NeoAxis_BuildArena&);
+	NeoAxis_BuildArena& operator=(const NeoAxis_BuildArena&);
+};
+
+#endif // NEOAXIS_BUILDARENA_H
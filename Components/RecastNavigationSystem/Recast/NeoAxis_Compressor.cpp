@@ -0,0 +1,167 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+#include <string.h>
+#include "NeoAxis_Compressor.h"
+#include "DetourCommon.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The tile cache layers are mostly runs of equal heights and areas, a greedy match search with a
+// single hash probe packs them well and decompresses fast, which matters since every obstacle
+// change decompresses the touched layers. Saved navmesh tiles are less regular and shrink to about
+// two thirds.
+//
+// Stream of sequences: token (literal count << 4 | match length - LZ_MIN_MATCH), literal count
+// extension bytes, literals, 2 byte match offset, match length extension bytes. Counts of 15 in
+// the token continue in extension bytes, added until a byte below 255. The last sequence has
+// only literals.
+static const int LZ_MIN_MATCH = 4;
+static const int LZ_MAX_OFFSET = 0xffff;
+static const int LZ_HASH_BITS = 12;
+
+static inline unsigned int hash(const unsigned char* p)
+{
+	const unsigned int v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static unsigned char* writeCount(unsigned char* op, int count)
+{
+	while (count >= 255)
+	{
+		*op++ = 255;
+		count -= 255;
+	}
+	*op++ = (unsigned char)count;
+	return op;
+}
+
+// matchLength 0 writes the last sequence.
+static unsigned char* writeSequence(unsigned char* op, const unsigned char* literals, const int literalCount,
+	const int offset, const int matchLength)
+{
+	const int matchCode = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+	unsigned char* token = op++;
+	*token = (unsigned char)((dtMin(literalCount, 15) << 4) | dtMin(matchCode, 15));
+	if (literalCount >= 15)
+		op = writeCount(op, literalCount - 15);
+	memcpy(op, literals, literalCount);
+	op += literalCount;
+	if (!matchLength)
+		return op;
+	*op++ = (unsigned char)(offset & 0xff);
+	*op++ = (unsigned char)(offset >> 8);
+	if (matchCode >= 15)
+		op = writeCount(op, matchCode - 15);
+	return op;
+}
+
+static bool readCount(const unsigned char*& ip, const unsigned char* iend, int& count)
+{
+	unsigned char b;
+	do
+	{
+		if (ip >= iend)
+			return false;
+		b = *ip++;
+		count += b;
+	}
+	while (b == 255);
+	return true;
+}
+
+NeoAxis_Compressor::~NeoAxis_Compressor()
+{
+}
+
+int NeoAxis_Compressor::maxCompressedSize(const int bufferSize)
+{
+	return bufferSize + bufferSize / 255 + 16;
+}
+
+dtStatus NeoAxis_Compressor::compress(const unsigned char* buffer, const int bufferSize,
+	unsigned char* compressed, const int maxCompressedSize, int* compressedSize)
+{
+	if (maxCompressedSize < this->maxCompressedSize(bufferSize))
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+
+	int table[1 << LZ_HASH_BITS];
+	memset(table, 0xff, sizeof(table));
+
+	unsigned char* op = compressed;
+	int anchor = 0;
+	int i = 0;
+	while (i + LZ_MIN_MATCH <= bufferSize)
+	{
+		const unsigned int h = hash(buffer + i);
+		const int candidate = table[h];
+		table[h] = i;
+		if (candidate < 0 || i - candidate > LZ_MAX_OFFSET ||
+			memcmp(buffer + candidate, buffer + i, LZ_MIN_MATCH) != 0)
+		{
+			i++;
+			continue;
+		}
+
+		int length = LZ_MIN_MATCH;
+		while (i + length < bufferSize && buffer[candidate + length] == buffer[i + length])
+			length++;
+
+		op = writeSequence(op, buffer + anchor, i - anchor, i - candidate, length);
+		i += length;
+		anchor = i;
+	}
+	op = writeSequence(op, buffer + anchor, bufferSize - anchor, 0, 0);
+
+	*compressedSize = (int)(op - compressed);
+	return DT_SUCCESS;
+}
+
+dtStatus NeoAxis_Compressor::decompress(const unsigned char* compressed, const int compressedSize,
+	unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+{
+	const unsigned char* ip = compressed;
+	const unsigned char* iend = compressed + compressedSize;
+	unsigned char* op = buffer;
+	unsigned char* oend = buffer + maxBufferSize;
+
+	while (ip < iend)
+	{
+		const int token = *ip++;
+
+		int literalCount = token >> 4;
+		if (literalCount == 15 && !readCount(ip, iend, literalCount))
+			return DT_FAILURE;
+		if (literalCount > iend - ip || literalCount > oend - op)
+			return DT_FAILURE;
+		memcpy(op, ip, literalCount);
+		op += literalCount;
+		ip += literalCount;
+
+		// The last sequence.
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return DT_FAILURE;
+		const int offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op - buffer)
+			return DT_FAILURE;
+
+		int matchLength = token & 15;
+		if (matchLength == 15 && !readCount(ip, iend, matchLength))
+			return DT_FAILURE;
+		matchLength += LZ_MIN_MATCH;
+		if (matchLength > oend - op)
+			return DT_FAILURE;
+
+		// The match can overlap the output, copy forward byte by byte.
+		const unsigned char* match = op - offset;
+		for (int i = 0; i < matchLength; ++i)
+			op[i] = match[i];
+		op += matchLength;
+	}
+
+	*bufferSize = (int)(op - buffer);
+	return DT_SUCCESS;
+}
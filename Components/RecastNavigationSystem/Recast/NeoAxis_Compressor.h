@@ -0,0 +1,21 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+
+#ifndef NEOAXIS_COMPRESSOR_H
+#define NEOAXIS_COMPRESSOR_H
+
+#include "DetourTileCacheBuilder.h"
+
+/// LZ77 compressor of the tile cache layers and the saved navmesh tiles. Has no state, one instance
+/// can be used by several threads at once.
+struct NeoAxis_Compressor : public dtTileCacheCompressor
+{
+	virtual ~NeoAxis_Compressor();
+
+	virtual int maxCompressedSize(const int bufferSize);
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+		unsigned char* compressed, const int maxCompressedSize, int* compressedSize);
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+		unsigned char* buffer, const int maxBufferSize, int* bufferSize);
+};
+
+#endif // NEOAXIS_COMPRESSOR_H
@@ -0,0 +1,92 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+#include "NeoAxis_MappedFile.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+NeoAxis_MappedFile::NeoAxis_MappedFile() :
+	m_data(0),
+	m_size(0)
+{
+}
+
+NeoAxis_MappedFile::~NeoAxis_MappedFile()
+{
+	close();
+}
+
+bool NeoAxis_MappedFile::open(const char* fileName)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || (ULONGLONG)fileSize.QuadPart > (size_t)-1)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// The view keeps the mapping alive, the handles are not needed after mapping.
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+	void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!view)
+		return false;
+
+	m_data = (unsigned char*)view;
+	m_size = (size_t)fileSize.QuadPart;
+#else
+	int file = ::open(fileName, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size <= 0)
+	{
+		::close(file);
+		return false;
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	void* view = mmap(0, (size_t)fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (view == MAP_FAILED)
+		return false;
+
+	m_data = (unsigned char*)view;
+	m_size = (size_t)fileStat.st_size;
+#endif
+
+	return true;
+}
+
+void NeoAxis_MappedFile::close()
+{
+	if (!m_data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+#else
+	munmap(m_data, m_size);
+#endif
+	m_data = 0;
+	m_size = 0;
+}
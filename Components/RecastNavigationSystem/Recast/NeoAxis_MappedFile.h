@@ -0,0 +1,27 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+
+#ifndef NEOAXIS_MAPPEDFILE_H
+#define NEOAXIS_MAPPEDFILE_H
+
+#include <stddef.h>
+
+/// Read-only file mapped into memory copy-on-write. The data can be modified in place, the changed
+/// pages become private to the process and the file itself is never written.
+class NeoAxis_MappedFile
+{
+public:
+	NeoAxis_MappedFile();
+	~NeoAxis_MappedFile();
+
+	bool open(const char* fileName);
+	void close();
+
+	unsigned char* getData() const { return m_data; }
+	size_t getSize() const { return m_size; }
+
+private:
+	unsigned char* m_data;
+	size_t m_size;
+};
+
+#endif // NEOAXIS_MAPPEDFILE_H
@@ -0,0 +1,251 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+#include <string.h>
+#include "NeoAxis_PathCache.h"
+
+NeoAxis_PathCache::NeoAxis_PathCache() :
+	m_entries(0),
+	m_maxEntries(0),
+	m_entryCount(0),
+	m_buckets(0),
+	m_bucketMask(0),
+	m_first(-1),
+	m_last(-1),
+	m_free(-1),
+	m_navMesh(0),
+	m_changeCount(0),
+	m_hitCount(0),
+	m_missCount(0),
+	m_invalidatedCount(0)
+{
+}
+
+NeoAxis_PathCache::~NeoAxis_PathCache()
+{
+	init(0);
+}
+
+void NeoAxis_PathCache::init(const int maxEntries)
+{
+	for (int i = 0; i < m_maxEntries; ++i)
+		delete [] m_entries[i].path;
+	delete [] m_entries;
+	delete [] m_buckets;
+	m_entries = 0;
+	m_buckets = 0;
+	m_maxEntries = 0;
+	m_bucketMask = 0;
+
+	if (maxEntries > 0)
+	{
+		m_maxEntries = maxEntries;
+		m_entries = new Entry[maxEntries];
+		memset(m_entries, 0, sizeof(Entry)*maxEntries);
+
+		int bucketCount = 1;
+		while (bucketCount < maxEntries*2)
+			bucketCount <<= 1;
+		m_buckets = new int[bucketCount];
+		m_bucketMask = bucketCount-1;
+	}
+	clear();
+}
+
+void NeoAxis_PathCache::clear()
+{
+	m_entryCount = 0;
+	m_first = -1;
+	m_last = -1;
+	m_navMesh = 0;
+	if (!m_maxEntries)
+	{
+		m_free = -1;
+		return;
+	}
+
+	// The path buffers are kept for the next corridors.
+	for (int i = 0; i < m_maxEntries; ++i)
+	{
+		m_entries[i].pathCount = 0;
+		m_entries[i].next = i+1 < m_maxEntries ? i+1 : -1;
+	}
+	m_free = 0;
+	memset(m_buckets, 0xff, sizeof(int)*(m_bucketMask+1));
+}
+
+unsigned int NeoAxis_PathCache::hashFilter(const dtQueryFilter* filter)
+{
+	// FNV-1a over the area costs and the flags.
+	const unsigned char* data = (const unsigned char*)filter;
+	unsigned int hash = 2166136261u;
+	for (int i = 0; i < (int)sizeof(dtQueryFilter); ++i)
+		hash = (hash ^ data[i]) * 16777619u;
+	return hash;
+}
+
+unsigned int NeoAxis_PathCache::getBucket(dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash) const
+{
+	unsigned int hash = (unsigned int)startRef * 73856093u;
+	hash ^= (unsigned int)endRef * 19349663u;
+	hash ^= filterHash * 83492791u;
+	return hash & (unsigned int)m_bucketMask;
+}
+
+int NeoAxis_PathCache::findEntry(dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash) const
+{
+	for (int i = m_buckets[getBucket(startRef, endRef, filterHash)]; i != -1; i = m_entries[i].bucketNext)
+	{
+		const Entry& entry = m_entries[i];
+		if (entry.startRef == startRef && entry.endRef == endRef && entry.filterHash == filterHash)
+			return i;
+	}
+	return -1;
+}
+
+void NeoAxis_PathCache::unlink(const int index)
+{
+	Entry& entry = m_entries[index];
+	if (entry.prev != -1)
+		m_entries[entry.prev].next = entry.next;
+	else
+		m_first = entry.next;
+	if (entry.next != -1)
+		m_entries[entry.next].prev = entry.prev;
+	else
+		m_last = entry.prev;
+}
+
+void NeoAxis_PathCache::pushFront(const int index)
+{
+	Entry& entry = m_entries[index];
+	entry.prev = -1;
+	entry.next = m_first;
+	if (m_first != -1)
+		m_entries[m_first].prev = index;
+	m_first = index;
+	if (m_last == -1)
+		m_last = index;
+}
+
+void NeoAxis_PathCache::remove(const int index)
+{
+	Entry& entry = m_entries[index];
+	unlink(index);
+
+	int* link = &m_buckets[getBucket(entry.startRef, entry.endRef, entry.filterHash)];
+	while (*link != index)
+		link = &m_entries[*link].bucketNext;
+	*link = entry.bucketNext;
+
+	entry.pathCount = 0;
+	entry.next = m_free;
+	m_free = index;
+	m_entryCount--;
+}
+
+void NeoAxis_PathCache::validate(const dtNavMesh* navMesh)
+{
+	if (m_navMesh != navMesh)
+	{
+		clear();
+		m_navMesh = navMesh;
+		m_changeCount = navMesh->getChangeCount();
+		return;
+	}
+	if (m_changeCount == navMesh->getChangeCount())
+		return;
+	m_changeCount = navMesh->getChangeCount();
+
+	// A rebuilt or removed tile changes the salt of the references to its polygons.
+	for (int i = m_first; i != -1; )
+	{
+		const Entry& entry = m_entries[i];
+		const int next = entry.next;
+		for (int j = 0; j < entry.pathCount; ++j)
+		{
+			if (!navMesh->isValidPolyRef(entry.path[j]))
+			{
+				remove(i);
+				m_invalidatedCount++;
+				break;
+			}
+		}
+		i = next;
+	}
+}
+
+bool NeoAxis_PathCache::find(const dtNavMesh* navMesh, dtPolyRef startRef, dtPolyRef endRef,
+	unsigned int filterHash, dtPolyRef* path, int* pathCount, const int maxPath)
+{
+	*pathCount = 0;
+	if (!m_maxEntries)
+		return false;
+	validate(navMesh);
+
+	const int index = findEntry(startRef, endRef, filterHash);
+	if (index == -1 || m_entries[index].pathCount > maxPath)
+	{
+		m_missCount++;
+		return false;
+	}
+
+	const Entry& entry = m_entries[index];
+	memcpy(path, entry.path, sizeof(dtPolyRef)*entry.pathCount);
+	*pathCount = entry.pathCount;
+	unlink(index);
+	pushFront(index);
+	m_hitCount++;
+	return true;
+}
+
+void NeoAxis_PathCache::add(dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash, const dtPolyRef* path,
+	const int pathCount)
+{
+	if (!m_maxEntries || !m_navMesh || pathCount <= 0)
+		return;
+
+	int index = findEntry(startRef, endRef, filterHash);
+	if (index != -1)
+		unlink(index);
+	else
+	{
+		if (m_free == -1)
+			remove(m_last);
+		index = m_free;
+		m_free = m_entries[index].next;
+		m_entryCount++;
+
+		Entry& entry = m_entries[index];
+		entry.startRef = startRef;
+		entry.endRef = endRef;
+		entry.filterHash = filterHash;
+		const unsigned int bucket = getBucket(startRef, endRef, filterHash);
+		entry.bucketNext = m_buckets[bucket];
+		m_buckets[bucket] = index;
+	}
+
+	Entry& entry = m_entries[index];
+	if (entry.pathCapacity < pathCount)
+	{
+		delete [] entry.path;
+		entry.path = new dtPolyRef[pathCount];
+		entry.pathCapacity = pathCount;
+	}
+	memcpy(entry.path, path, sizeof(dtPolyRef)*pathCount);
+	entry.pathCount = pathCount;
+	pushFront(index);
+}
+
+void NeoAxis_PathCache::getStatistics(int* hitCount, int* missCount, int* invalidatedCount, int* entryCount) const
+{
+	*hitCount = m_hitCount;
+	*missCount = m_missCount;
+	*invalidatedCount = m_invalidatedCount;
+	*entryCount = m_entryCount;
+}
+
+void NeoAxis_PathCache::resetStatistics()
+{
+	m_hitCount = 0;
+	m_missCount = 0;
+	m_invalidatedCount = 0;
+}
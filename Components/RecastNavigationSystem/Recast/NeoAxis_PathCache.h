@@ -0,0 +1,80 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+
+#ifndef NEOAXIS_PATHCACHE_H
+#define NEOAXIS_PATHCACHE_H
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+/// Least recently used polygon corridors found by path queries, keyed by the start and the end polygon and
+/// the hash of the query filter. A corridor is dropped when a tile it goes through is rebuilt or removed,
+/// the corridors are checked when dtNavMesh::getChangeCount changes.
+class NeoAxis_PathCache
+{
+public:
+	NeoAxis_PathCache();
+	~NeoAxis_PathCache();
+
+	/// Removes all corridors and sets the number of them to keep, 0 disables the cache.
+	void init(const int maxEntries);
+	/// Removes all corridors, needed when the navmesh is replaced by another one with the same tiles.
+	void clear();
+	bool isEnabled() const { return m_maxEntries > 0; }
+
+	/// Copies the corridor from startRef to endRef to path. Returns false if there is none or it is longer
+	/// than maxPath.
+	bool find(const dtNavMesh* navMesh, dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash,
+		dtPolyRef* path, int* pathCount, const int maxPath);
+	/// Adds the corridor of a complete path, the least recently used one is dropped if the cache is full.
+	void add(dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash, const dtPolyRef* path,
+		const int pathCount);
+
+	static unsigned int hashFilter(const dtQueryFilter* filter);
+
+	void getStatistics(int* hitCount, int* missCount, int* invalidatedCount, int* entryCount) const;
+	void resetStatistics();
+
+private:
+	struct Entry
+	{
+		dtPolyRef startRef;
+		dtPolyRef endRef;
+		unsigned int filterHash;
+		dtPolyRef* path;
+		int pathCount;
+		int pathCapacity;
+		/// Neighbours in the usage list, the next of a free entry is the next free one.
+		int prev;
+		int next;
+		int bucketNext;
+	};
+
+	void validate(const dtNavMesh* navMesh);
+	int findEntry(dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash) const;
+	unsigned int getBucket(dtPolyRef startRef, dtPolyRef endRef, unsigned int filterHash) const;
+	void unlink(const int index);
+	void pushFront(const int index);
+	void remove(const int index);
+
+	Entry* m_entries;
+	int m_maxEntries;
+	int m_entryCount;
+	int* m_buckets;
+	int m_bucketMask;
+	// Most and least recently used entry.
+	int m_first;
+	int m_last;
+	int m_free;
+
+	const dtNavMesh* m_navMesh;
+	unsigned int m_changeCount;
+
+	int m_hitCount;
+	int m_missCount;
+	int m_invalidatedCount;
+
+	NeoAxis_PathCache(const NeoAxis_PathCache&);
+	NeoAxis_PathCache& operator=(const NeoAxis_PathCache&);
+};
+
+#endif // NEOAXIS_PATHCACHE_H
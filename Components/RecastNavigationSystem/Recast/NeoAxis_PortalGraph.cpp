@@ -0,0 +1,862 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NeoAxis_PortalGraph.h"
+#include "DetourCommon.h"
+
+static const unsigned char EXT_LINK_SIDE_NONE = 0xff;
+// Polygons of the corridor searched for loops when a segment is added.
+static const int MAX_LOOP_SEARCH = 256;
+// The costs between the portals go through the middle of the polygons and are well above the straight
+// distance, an admissible heuristic makes the search visit most portals. The path is refined anyway.
+static const float HEURISTIC_SCALE = 2.0f;
+// Every n-th portal of the abstract path is a waypoint of the refined path.
+static const int WAYPOINT_STEP = 2;
+// Portals of the neighbour tile a portal is linked to, more are ignored.
+static const int MAX_PORTAL_CROSSINGS = 8;
+
+struct NeoAxis_PortalGraph::Portal
+{
+	/// Polygon in the middle of the portal, the refined path goes through it.
+	dtPolyRef poly;
+	float pos[3];
+	int neighbourTile;
+	/// Border polygons of the portal in members of the tile graph, indices in the tile.
+	int firstMember;
+	int memberCount;
+	/// Portals of the neighbour tile linked to the members, valid while the neighbour tile graph is not
+	/// built again.
+	int crossings[MAX_PORTAL_CROSSINGS];
+	int crossingCount;
+	int crossingsBuilt;
+};
+
+struct NeoAxis_PortalGraph::TileGraph
+{
+	/// Tile and neighbour tiles the portals were computed from.
+	dtTileRef ref;
+	unsigned int neighbourKey;
+	unsigned int validated;
+	int built;
+
+	Portal* portals;
+	int portalCount;
+	int* members;
+	/// Costs between the portals inside the tile, portalCount*portalCount, FLT_MAX if not connected.
+	float* costs;
+
+	// Search state of the portals, valid if visited is the current search. openIndex is the position in
+	// the open list, -1 if not in it and -2 if closed.
+	float* cost;
+	int* parentTile;
+	int* parentPortal;
+	unsigned int* visited;
+	int* openIndex;
+
+	void release()
+	{
+		delete [] portals;
+		delete [] members;
+		delete [] costs;
+		delete [] cost;
+		delete [] parentTile;
+		delete [] parentPortal;
+		delete [] visited;
+		delete [] openIndex;
+		portals = 0;
+		members = 0;
+		costs = 0;
+		cost = 0;
+		parentTile = 0;
+		parentPortal = 0;
+		visited = 0;
+		openIndex = 0;
+		portalCount = 0;
+	}
+};
+
+struct BorderEntry
+{
+	int poly;
+	int neighbourTile;
+};
+
+static int compareBorderEntries(const void* a, const void* b)
+{
+	const BorderEntry* ea = (const BorderEntry*)a;
+	const BorderEntry* eb = (const BorderEntry*)b;
+	if (ea->neighbourTile != eb->neighbourTile)
+		return ea->neighbourTile < eb->neighbourTile ? -1 : 1;
+	if (ea->poly != eb->poly)
+		return ea->poly < eb->poly ? -1 : 1;
+	return 0;
+}
+
+// Same as dtQueryFilter::passFilter, which is not visible outside of DetourNavMeshQuery.cpp.
+static bool passFilter(const dtQueryFilter& filter, const dtPoly* poly)
+{
+	return (poly->flags & filter.getIncludeFlags()) != 0 && (poly->flags & filter.getExcludeFlags()) == 0;
+}
+
+static int findSet(int* sets, int i)
+{
+	while (sets[i] != i)
+	{
+		sets[i] = sets[sets[i]];
+		i = sets[i];
+	}
+	return i;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+NeoAxis_PortalGraph::NeoAxis_PortalGraph() :
+	m_navMesh(0),
+	m_tiles(0),
+	m_tileCount(0),
+	m_changeCount(0),
+	m_validation(0),
+	m_search(0),
+	m_centers(0),
+	m_costs(0),
+	m_heap(0),
+	m_heapIndex(0),
+	m_sets(0),
+	m_polyCapacity(0),
+	m_segment(0),
+	m_segmentCapacity(0),
+	m_open(0),
+	m_openSize(0),
+	m_openCapacity(0)
+{
+}
+
+NeoAxis_PortalGraph::~NeoAxis_PortalGraph()
+{
+	clear();
+	delete [] m_centers;
+	delete [] m_costs;
+	delete [] m_heap;
+	delete [] m_heapIndex;
+	delete [] m_sets;
+	delete [] m_segment;
+	delete [] m_open;
+}
+
+void NeoAxis_PortalGraph::clear()
+{
+	for (int i = 0; i < m_tileCount; ++i)
+		m_tiles[i].release();
+	delete [] m_tiles;
+	m_tiles = 0;
+	m_tileCount = 0;
+	m_navMesh = 0;
+}
+
+void NeoAxis_PortalGraph::init(const dtNavMesh* navMesh, const dtQueryFilter* filter)
+{
+	// The costs between the portals depend on the filter.
+	bool reset = false;
+	if (m_navMesh != navMesh || m_tileCount != navMesh->getMaxTiles() ||
+		memcmp(&m_filter, filter, sizeof(dtQueryFilter)) != 0)
+	{
+		clear();
+		m_navMesh = navMesh;
+		m_filter = *filter;
+		m_tileCount = navMesh->getMaxTiles();
+		m_tiles = new TileGraph[m_tileCount];
+		memset(m_tiles, 0, sizeof(TileGraph)*m_tileCount);
+		reset = true;
+	}
+
+	// The tiles are checked again only after tiles were added or removed.
+	if (reset || m_changeCount != navMesh->getChangeCount())
+	{
+		m_changeCount = navMesh->getChangeCount();
+		m_validation++;
+		if (m_validation == 0)
+		{
+			for (int i = 0; i < m_tileCount; ++i)
+				m_tiles[i].validated = 0;
+			m_validation = 1;
+		}
+	}
+
+	m_search++;
+	if (m_search == 0)
+	{
+		for (int i = 0; i < m_tileCount; ++i)
+		{
+			TileGraph& graph = m_tiles[i];
+			if (graph.portalCount)
+				memset(graph.visited, 0, sizeof(unsigned int)*graph.portalCount);
+		}
+		m_search = 1;
+	}
+}
+
+void NeoAxis_PortalGraph::reservePolys(const int polyCount)
+{
+	if (polyCount <= m_polyCapacity)
+		return;
+	delete [] m_centers;
+	delete [] m_costs;
+	delete [] m_heap;
+	delete [] m_heapIndex;
+	delete [] m_sets;
+	m_polyCapacity = polyCount;
+	m_centers = new float[polyCount*3];
+	m_costs = new float[polyCount];
+	m_heap = new int[polyCount];
+	m_heapIndex = new int[polyCount];
+	m_sets = new int[polyCount];
+}
+
+unsigned int NeoAxis_PortalGraph::getNeighbourKey(const dtMeshTile* tile)
+{
+	static const int MAX_LAYERS = 32;
+	const dtMeshTile* neighbours[MAX_LAYERS];
+
+	unsigned int key = 0;
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			if (!dx && !dy)
+				continue;
+			const int n = m_navMesh->getTilesAt(tile->header->x + dx, tile->header->y + dy, neighbours, MAX_LAYERS);
+			for (int i = 0; i < n; ++i)
+				key = key*31 + (unsigned int)m_navMesh->getTileRef(neighbours[i]);
+			key = key*31 + 1;
+		}
+	}
+	return key;
+}
+
+NeoAxis_PortalGraph::TileGraph* NeoAxis_PortalGraph::getTileGraph(const int tileIndex)
+{
+	TileGraph& graph = m_tiles[tileIndex];
+	if (graph.validated == m_validation)
+		return &graph;
+	graph.validated = m_validation;
+
+	const dtMeshTile* tile = m_navMesh->getTile(tileIndex);
+	if (!tile->header)
+	{
+		graph.release();
+		graph.ref = 0;
+		return &graph;
+	}
+
+	// The links of the border polygons change with the neighbour tiles.
+	const dtTileRef ref = m_navMesh->getTileRef(tile);
+	const unsigned int neighbourKey = getNeighbourKey(tile);
+	if (graph.ref != ref || graph.neighbourKey != neighbourKey)
+	{
+		buildTileGraph(graph, tile, tileIndex);
+		graph.ref = ref;
+		graph.neighbourKey = neighbourKey;
+	}
+	return &graph;
+}
+
+// Costs from startPoly to every polygon of the tile, over the centers of the polygons.
+void NeoAxis_PortalGraph::calcTileCosts(const dtMeshTile* tile, const int tileIndex, const int startPoly,
+	const float* startPos)
+{
+	const int polyCount = tile->header->polyCount;
+
+	for (int i = 0; i < polyCount; ++i)
+	{
+		m_costs[i] = FLT_MAX;
+		m_heapIndex[i] = -1;
+	}
+
+	int heapSize = 0;
+	m_costs[startPoly] = 0;
+	m_heap[heapSize] = startPoly;
+	m_heapIndex[startPoly] = heapSize++;
+
+	while (heapSize)
+	{
+		// Pop the cheapest polygon.
+		const int current = m_heap[0];
+		m_heapIndex[current] = -2;
+		heapSize--;
+		if (heapSize)
+		{
+			const int last = m_heap[heapSize];
+			int i = 0;
+			for (;;)
+			{
+				int child = i*2+1;
+				if (child >= heapSize)
+					break;
+				if (child+1 < heapSize && m_costs[m_heap[child+1]] < m_costs[m_heap[child]])
+					child++;
+				if (m_costs[m_heap[child]] >= m_costs[last])
+					break;
+				m_heap[i] = m_heap[child];
+				m_heapIndex[m_heap[i]] = i;
+				i = child;
+			}
+			m_heap[i] = last;
+			m_heapIndex[last] = i;
+		}
+
+		const float* pos = current == startPoly ? startPos : &m_centers[current*3];
+		const dtPoly* poly = &tile->polys[current];
+		for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+		{
+			const dtLink& link = tile->links[k];
+			if (link.side != EXT_LINK_SIDE_NONE || m_navMesh->decodePolyIdTile(link.ref) != (unsigned int)tileIndex)
+				continue;
+			const int neighbour = (int)m_navMesh->decodePolyIdPoly(link.ref);
+			if (m_heapIndex[neighbour] == -2)
+				continue;
+			const dtPoly* neighbourPoly = &tile->polys[neighbour];
+			if (!passFilter(m_filter, neighbourPoly))
+				continue;
+
+			const float cost = m_costs[current] +
+				dtVdist(pos, &m_centers[neighbour*3]) * m_filter.getAreaCost(neighbourPoly->getArea());
+			if (cost >= m_costs[neighbour])
+				continue;
+			m_costs[neighbour] = cost;
+
+			// Push or move up.
+			int i = m_heapIndex[neighbour];
+			if (i < 0)
+				i = heapSize++;
+			while (i > 0)
+			{
+				const int parent = (i-1)/2;
+				if (m_costs[m_heap[parent]] <= cost)
+					break;
+				m_heap[i] = m_heap[parent];
+				m_heapIndex[m_heap[i]] = i;
+				i = parent;
+			}
+			m_heap[i] = neighbour;
+			m_heapIndex[neighbour] = i;
+		}
+	}
+}
+
+void NeoAxis_PortalGraph::buildTileGraph(TileGraph& graph, const dtMeshTile* tile, const int tileIndex)
+{
+	graph.release();
+	graph.built++;
+
+	const int polyCount = tile->header->polyCount;
+	const dtPolyRef base = m_navMesh->getPolyRefBase(tile);
+	reservePolys(polyCount);
+
+	for (int i = 0; i < polyCount; ++i)
+	{
+		const dtPoly* poly = &tile->polys[i];
+		float* center = &m_centers[i*3];
+		dtVset(center, 0, 0, 0);
+		for (int j = 0; j < (int)poly->vertCount; ++j)
+			dtVadd(center, center, &tile->verts[poly->verts[j]*3]);
+		dtVscale(center, center, 1.0f / (float)dtMax((int)poly->vertCount, 1));
+	}
+
+	// Border polygons and the tiles they lead to.
+	int entryCount = 0;
+	for (int i = 0; i < polyCount; ++i)
+	{
+		for (unsigned int k = tile->polys[i].firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+		{
+			if (tile->links[k].side != EXT_LINK_SIDE_NONE)
+				entryCount++;
+		}
+	}
+	if (!entryCount)
+		return;
+
+	BorderEntry* entries = new BorderEntry[entryCount];
+	entryCount = 0;
+	for (int i = 0; i < polyCount; ++i)
+	{
+		const dtPoly* poly = &tile->polys[i];
+		if (!passFilter(m_filter, poly))
+			continue;
+		for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+		{
+			const dtLink& link = tile->links[k];
+			if (link.side == EXT_LINK_SIDE_NONE)
+				continue;
+			entries[entryCount].poly = i;
+			entries[entryCount].neighbourTile = (int)m_navMesh->decodePolyIdTile(link.ref);
+			entryCount++;
+		}
+	}
+	qsort(entries, entryCount, sizeof(BorderEntry), compareBorderEntries);
+	int uniqueCount = 0;
+	for (int i = 0; i < entryCount; ++i)
+	{
+		if (uniqueCount && compareBorderEntries(&entries[uniqueCount-1], &entries[i]) == 0)
+			continue;
+		entries[uniqueCount++] = entries[i];
+	}
+	entryCount = uniqueCount;
+
+	// The border polygons which lead to the same tile and are connected to each other form a portal.
+	int* entryPortals = new int[entryCount];
+	graph.portals = new Portal[entryCount];
+	graph.portalCount = 0;
+	for (int i = 0; i < polyCount; ++i)
+		m_heapIndex[i] = -1;
+
+	for (int groupStart = 0; groupStart < entryCount; )
+	{
+		int groupEnd = groupStart;
+		while (groupEnd < entryCount && entries[groupEnd].neighbourTile == entries[groupStart].neighbourTile)
+			groupEnd++;
+
+		for (int i = groupStart; i < groupEnd; ++i)
+		{
+			m_sets[entries[i].poly] = entries[i].poly;
+			m_heapIndex[entries[i].poly] = groupStart;
+			m_heap[entries[i].poly] = -1;
+		}
+		for (int i = groupStart; i < groupEnd; ++i)
+		{
+			const int p = entries[i].poly;
+			for (unsigned int k = tile->polys[p].firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				const dtLink& link = tile->links[k];
+				if (link.side != EXT_LINK_SIDE_NONE || m_navMesh->decodePolyIdTile(link.ref) != (unsigned int)tileIndex)
+					continue;
+				const int q = (int)m_navMesh->decodePolyIdPoly(link.ref);
+				if (m_heapIndex[q] != groupStart)
+					continue;
+				const int rp = findSet(m_sets, p);
+				const int rq = findSet(m_sets, q);
+				if (rp != rq)
+					m_sets[rq] = rp;
+			}
+		}
+		for (int i = groupStart; i < groupEnd; ++i)
+		{
+			const int root = findSet(m_sets, entries[i].poly);
+			if (m_heap[root] < 0)
+			{
+				Portal& portal = graph.portals[graph.portalCount];
+				portal.neighbourTile = entries[i].neighbourTile;
+				portal.memberCount = 0;
+				portal.crossingCount = 0;
+				portal.crossingsBuilt = -1;
+				m_heap[root] = graph.portalCount++;
+			}
+			entryPortals[i] = m_heap[root];
+			graph.portals[entryPortals[i]].memberCount++;
+		}
+
+		// The polygons are marked by their group, the next group does not need a reset.
+		groupStart = groupEnd;
+	}
+
+	// Members of the portals, the entries of a portal are in the same order as in the group.
+	graph.members = new int[entryCount];
+	int memberCount = 0;
+	for (int i = 0; i < graph.portalCount; ++i)
+	{
+		graph.portals[i].firstMember = memberCount;
+		memberCount += graph.portals[i].memberCount;
+		graph.portals[i].memberCount = 0;
+	}
+	for (int i = 0; i < entryCount; ++i)
+	{
+		Portal& portal = graph.portals[entryPortals[i]];
+		graph.members[portal.firstMember + portal.memberCount++] = entries[i].poly;
+	}
+	delete [] entryPortals;
+	delete [] entries;
+
+	// The polygon closest to the middle of the members represents the portal.
+	for (int i = 0; i < graph.portalCount; ++i)
+	{
+		Portal& portal = graph.portals[i];
+		float middle[3] = { 0, 0, 0 };
+		for (int j = 0; j < portal.memberCount; ++j)
+			dtVadd(middle, middle, &m_centers[graph.members[portal.firstMember + j]*3]);
+		dtVscale(middle, middle, 1.0f / (float)portal.memberCount);
+
+		int best = graph.members[portal.firstMember];
+		float bestDist = FLT_MAX;
+		for (int j = 0; j < portal.memberCount; ++j)
+		{
+			const int p = graph.members[portal.firstMember + j];
+			const float d = dtVdistSqr(middle, &m_centers[p*3]);
+			if (d < bestDist)
+			{
+				best = p;
+				bestDist = d;
+			}
+		}
+		portal.poly = base | (dtPolyRef)best;
+		dtVcopy(portal.pos, &m_centers[best*3]);
+	}
+
+	// Costs between the portals inside the tile.
+	const int n = graph.portalCount;
+	graph.costs = new float[n*n];
+	for (int i = 0; i < n; ++i)
+	{
+		const int start = (int)m_navMesh->decodePolyIdPoly(graph.portals[i].poly);
+		calcTileCosts(tile, tileIndex, start, graph.portals[i].pos);
+		for (int j = 0; j < n; ++j)
+			graph.costs[i*n+j] = m_costs[m_navMesh->decodePolyIdPoly(graph.portals[j].poly)];
+	}
+
+	graph.cost = new float[n];
+	graph.parentTile = new int[n];
+	graph.parentPortal = new int[n];
+	graph.visited = new unsigned int[n];
+	graph.openIndex = new int[n];
+	memset(graph.visited, 0, sizeof(unsigned int)*n);
+}
+
+// Finds the portals of the neighbour tile which lead back to the members of the portal.
+void NeoAxis_PortalGraph::findCrossings(const TileGraph& graph, Portal& portal, const int tileIndex,
+	const TileGraph& neighbourGraph)
+{
+	portal.crossingCount = 0;
+	portal.crossingsBuilt = neighbourGraph.built;
+
+	const dtMeshTile* tile = m_navMesh->getTile(tileIndex);
+	for (int m = 0; m < portal.memberCount; ++m)
+	{
+		const dtPoly* member = &tile->polys[graph.members[portal.firstMember + m]];
+		for (unsigned int k = member->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+		{
+			const dtLink& link = tile->links[k];
+			if (link.side == EXT_LINK_SIDE_NONE || (int)m_navMesh->decodePolyIdTile(link.ref) != portal.neighbourTile)
+				continue;
+			const int target = (int)m_navMesh->decodePolyIdPoly(link.ref);
+			for (int i = 0; i < neighbourGraph.portalCount; ++i)
+			{
+				const Portal& neighbour = neighbourGraph.portals[i];
+				if (neighbour.neighbourTile != tileIndex)
+					continue;
+				bool contains = false;
+				for (int j = 0; j < neighbour.memberCount && !contains; ++j)
+					contains = neighbourGraph.members[neighbour.firstMember + j] == target;
+				if (!contains)
+					continue;
+
+				bool added = false;
+				for (int j = 0; j < portal.crossingCount && !added; ++j)
+					added = portal.crossings[j] == i;
+				if (!added && portal.crossingCount < MAX_PORTAL_CROSSINGS)
+					portal.crossings[portal.crossingCount++] = i;
+			}
+		}
+	}
+}
+
+int NeoAxis_PortalGraph::update(const dtNavMesh* navMesh, const dtQueryFilter* filter)
+{
+	init(navMesh, filter);
+
+	int builtCount = 0;
+	for (int i = 0; i < m_tileCount; ++i)
+	{
+		const int built = m_tiles[i].built;
+		getTileGraph(i);
+		if (m_tiles[i].built != built)
+			builtCount++;
+	}
+	return builtCount;
+}
+
+void NeoAxis_PortalGraph::getStatistics(int* tileCount, int* portalCount)
+{
+	*tileCount = 0;
+	*portalCount = 0;
+	for (int i = 0; i < m_tileCount; ++i)
+	{
+		if (!m_tiles[i].ref)
+			continue;
+		(*tileCount)++;
+		*portalCount += m_tiles[i].portalCount;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Adds the portal to the open list or moves it up if it is already there.
+void NeoAxis_PortalGraph::pushOpen(const float total, const int tile, const int portal)
+{
+	int* openIndex = m_tiles[tile].openIndex;
+	int i = openIndex[portal];
+	if (i < 0)
+	{
+		if (m_openSize == m_openCapacity)
+		{
+			const int capacity = m_openCapacity ? m_openCapacity*2 : 256;
+			OpenNode* open = new OpenNode[capacity];
+			if (m_openSize)
+				memcpy(open, m_open, sizeof(OpenNode)*m_openSize);
+			delete [] m_open;
+			m_open = open;
+			m_openCapacity = capacity;
+		}
+		i = m_openSize++;
+	}
+
+	while (i > 0)
+	{
+		const int parent = (i-1)/2;
+		if (m_open[parent].total <= total)
+			break;
+		m_open[i] = m_open[parent];
+		m_tiles[m_open[i].tile].openIndex[m_open[i].portal] = i;
+		i = parent;
+	}
+	m_open[i].total = total;
+	m_open[i].tile = tile;
+	m_open[i].portal = portal;
+	openIndex[portal] = i;
+}
+
+// Removes the cheapest portal from the open list and closes it.
+NeoAxis_PortalGraph::OpenNode NeoAxis_PortalGraph::popOpen()
+{
+	const OpenNode result = m_open[0];
+	m_tiles[result.tile].openIndex[result.portal] = -2;
+	m_openSize--;
+	if (m_openSize)
+	{
+		const OpenNode last = m_open[m_openSize];
+		int i = 0;
+		for (;;)
+		{
+			int child = i*2+1;
+			if (child >= m_openSize)
+				break;
+			if (child+1 < m_openSize && m_open[child+1].total < m_open[child].total)
+				child++;
+			if (m_open[child].total >= last.total)
+				break;
+			m_open[i] = m_open[child];
+			m_tiles[m_open[i].tile].openIndex[m_open[i].portal] = i;
+			i = child;
+		}
+		m_open[i] = last;
+		m_tiles[last.tile].openIndex[last.portal] = i;
+	}
+	return result;
+}
+
+void NeoAxis_PortalGraph::openPortal(TileGraph& graph, const int tile, const int portal, const float cost,
+	const int parentTile, const int parentPortal, const float* endPos)
+{
+	if (graph.visited[portal] != m_search)
+	{
+		graph.visited[portal] = m_search;
+		graph.openIndex[portal] = -1;
+	}
+	else if (graph.openIndex[portal] == -2 || cost >= graph.cost[portal])
+		return;
+
+	graph.cost[portal] = cost;
+	graph.parentTile[portal] = parentTile;
+	graph.parentPortal[portal] = parentPortal;
+	pushOpen(cost + HEURISTIC_SCALE*dtVdist(graph.portals[portal].pos, endPos), tile, portal);
+}
+
+// Adds the segment to the corridor. The segment starts at the last polygon of the corridor, a polygon
+// which is already in the corridor cuts the loop out. Returns the new size, -1 if maxPath was reached.
+int NeoAxis_PortalGraph::appendToCorridor(dtPolyRef* path, int count, const dtPolyRef* segment,
+	const int segmentCount, const int maxPath)
+{
+	for (int i = 0; i < segmentCount; ++i)
+	{
+		const dtPolyRef ref = segment[i];
+		int found = -1;
+		for (int j = count-1; j >= 0 && j >= count-MAX_LOOP_SEARCH; --j)
+		{
+			if (path[j] == ref)
+			{
+				found = j;
+				break;
+			}
+		}
+		if (found >= 0)
+		{
+			count = found+1;
+			continue;
+		}
+		if (count >= maxPath)
+			return -1;
+		path[count++] = ref;
+	}
+	return count;
+}
+
+dtStatus NeoAxis_PortalGraph::findPath(dtNavMeshQuery* navQuery, dtPolyRef startRef, dtPolyRef endRef,
+	const float* startPos, const float* endPos, const dtQueryFilter* filter,
+	dtPolyRef* path, int* pathCount, const int maxPath)
+{
+	*pathCount = 0;
+
+	const dtNavMesh* navMesh = navQuery->getAttachedNavMesh();
+	if (!navMesh || !navMesh->isValidPolyRef(startRef) || !navMesh->isValidPolyRef(endRef) || maxPath <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	init(navMesh, filter);
+
+	// Paths to the same or a neighbour tile are short enough for the flat search.
+	const int startTile = (int)navMesh->decodePolyIdTile(startRef);
+	const int endTile = (int)navMesh->decodePolyIdTile(endRef);
+	const dtMeshTile* tile = navMesh->getTile(startTile);
+	const dtMeshTile* otherTile = navMesh->getTile(endTile);
+	if (dtAbs(tile->header->x - otherTile->header->x) <= 1 && dtAbs(tile->header->y - otherTile->header->y) <= 1)
+		return navQuery->findPath(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
+
+	TileGraph* startGraph = getTileGraph(startTile);
+	TileGraph* endGraph = getTileGraph(endTile);
+	if (!startGraph->portalCount || !endGraph->portalCount)
+		return navQuery->findPath(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
+
+	// Costs from the end polygon to the portals of its tile.
+	const dtPoly* poly = 0;
+	navMesh->getTileAndPolyByRefUnsafe(endRef, &tile, &poly);
+	calcTileCosts(tile, endTile, (int)navMesh->decodePolyIdPoly(endRef), endPos);
+	float* goalCosts = new float[endGraph->portalCount];
+	for (int i = 0; i < endGraph->portalCount; ++i)
+		goalCosts[i] = m_costs[navMesh->decodePolyIdPoly(endGraph->portals[i].poly)];
+
+	// The search starts at the portals of the start tile.
+	navMesh->getTileAndPolyByRefUnsafe(startRef, &tile, &poly);
+	calcTileCosts(tile, startTile, (int)navMesh->decodePolyIdPoly(startRef), startPos);
+	m_openSize = 0;
+	for (int i = 0; i < startGraph->portalCount; ++i)
+	{
+		const float cost = m_costs[navMesh->decodePolyIdPoly(startGraph->portals[i].poly)];
+		if (cost != FLT_MAX)
+			openPortal(*startGraph, startTile, i, cost, -1, -1, endPos);
+	}
+
+	float goalCost = FLT_MAX;
+	int goalPortal = -1;
+
+	while (m_openSize)
+	{
+		const OpenNode node = popOpen();
+		if (node.total >= goalCost)
+			break;
+
+		TileGraph& graph = m_tiles[node.tile];
+		const float cost = graph.cost[node.portal];
+
+		if (node.tile == endTile && goalCosts[node.portal] != FLT_MAX && cost + goalCosts[node.portal] < goalCost)
+		{
+			goalCost = cost + goalCosts[node.portal];
+			goalPortal = node.portal;
+		}
+
+		// Portals of the same tile.
+		const int n = graph.portalCount;
+		for (int i = 0; i < n; ++i)
+		{
+			const float edgeCost = graph.costs[node.portal*n + i];
+			if (i != node.portal && edgeCost != FLT_MAX)
+				openPortal(graph, node.tile, i, cost + edgeCost, node.tile, node.portal, endPos);
+		}
+
+		// Portals of the neighbour tile the border polygons are linked to.
+		Portal& portal = graph.portals[node.portal];
+		TileGraph* neighbourGraph = getTileGraph(portal.neighbourTile);
+		if (portal.crossingsBuilt != neighbourGraph->built)
+			findCrossings(graph, portal, node.tile, *neighbourGraph);
+		for (int c = 0; c < portal.crossingCount; ++c)
+		{
+			const int i = portal.crossings[c];
+			const float newCost = cost + dtVdist(portal.pos, neighbourGraph->portals[i].pos);
+			openPortal(*neighbourGraph, portal.neighbourTile, i, newCost, node.tile, node.portal, endPos);
+		}
+	}
+	delete [] goalCosts;
+
+	if (goalPortal < 0)
+		return navQuery->findPath(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
+
+	// The refined path goes through the portals where it enters a tile.
+	int waypointCount = 0;
+	for (int t = endTile, p = goalPortal; t >= 0; )
+	{
+		const int parentTile = m_tiles[t].parentTile[p];
+		if (parentTile != t)
+			waypointCount++;
+		p = m_tiles[t].parentPortal[p];
+		t = parentTile;
+	}
+	const Portal** waypoints = new const Portal*[waypointCount];
+	int waypoint = waypointCount;
+	for (int t = endTile, p = goalPortal; t >= 0; )
+	{
+		const int parentTile = m_tiles[t].parentTile[p];
+		if (parentTile != t)
+			waypoints[--waypoint] = &m_tiles[t].portals[p];
+		p = m_tiles[t].parentPortal[p];
+		t = parentTile;
+	}
+
+	if (m_segmentCapacity < maxPath)
+	{
+		delete [] m_segment;
+		m_segment = new dtPolyRef[maxPath];
+		m_segmentCapacity = maxPath;
+	}
+
+	dtStatus status = DT_SUCCESS;
+	int count = 0;
+	dtPolyRef fromRef = startRef;
+	const float* fromPos = startPos;
+	for (int i = WAYPOINT_STEP-1; i < waypointCount+WAYPOINT_STEP; i += WAYPOINT_STEP)
+	{
+		if (i > waypointCount)
+			i = waypointCount;
+		const dtPolyRef toRef = i < waypointCount ? waypoints[i]->poly : endRef;
+		const float* toPos = i < waypointCount ? waypoints[i]->pos : endPos;
+		if (toRef == fromRef)
+			continue;
+
+		int segmentCount = 0;
+		const dtStatus segmentStatus = navQuery->findPath(fromRef, toRef, fromPos, toPos, filter,
+			m_segment, &segmentCount, maxPath);
+		if (dtStatusFailed(segmentStatus) || !segmentCount)
+		{
+			status |= DT_PARTIAL_RESULT;
+			break;
+		}
+
+		const int newCount = appendToCorridor(path, count, m_segment, segmentCount, maxPath);
+		if (newCount < 0)
+		{
+			count = maxPath;
+			status |= DT_BUFFER_TOO_SMALL | DT_PARTIAL_RESULT;
+			break;
+		}
+		count = newCount;
+
+		if (m_segment[segmentCount-1] != toRef)
+		{
+			status |= DT_PARTIAL_RESULT;
+			break;
+		}
+		fromRef = toRef;
+		fromPos = toPos;
+	}
+	delete [] waypoints;
+
+	*pathCount = count;
+	if (!count)
+		return DT_FAILURE;
+	return status;
+}
@@ -0,0 +1,93 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+
+#ifndef NEOAXIS_PORTALGRAPH_H
+#define NEOAXIS_PORTALGRAPH_H
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+/// Abstract graph of the navmesh for long paths (hierarchical A*). The border polygons of a tile which
+/// lead to the same neighbour tile form a portal, the portals of a tile are connected by the costs of
+/// the paths between them inside the tile. A long path is planned over the portals first and then
+/// refined with dtNavMeshQuery::findPath from portal to portal, so every search stays within a tile
+/// or two.
+/// The portals of a tile are computed when a search reaches the tile. A tile whose navmesh tile or
+/// neighbour tiles were rebuilt or removed since then is computed again, the tiles are checked only
+/// when dtNavMesh::getChangeCount changes.
+class NeoAxis_PortalGraph
+{
+public:
+	NeoAxis_PortalGraph();
+	~NeoAxis_PortalGraph();
+
+	/// Removes all portals, needed when the navmesh is replaced by another one with the same tiles.
+	void clear();
+
+	/// Computes the portals of every tile which changed since the last update, returns the number of them.
+	int update(const dtNavMesh* navMesh, const dtQueryFilter* filter);
+
+	/// Finds the polygon corridor from startRef to endRef like dtNavMeshQuery::findPath. Paths within a
+	/// tile are found by navQuery directly. The corridor is not the shortest one, it goes through the
+	/// middle of the portals.
+	dtStatus findPath(dtNavMeshQuery* navQuery, dtPolyRef startRef, dtPolyRef endRef,
+		const float* startPos, const float* endPos, const dtQueryFilter* filter,
+		dtPolyRef* path, int* pathCount, const int maxPath);
+
+	void getStatistics(int* tileCount, int* portalCount);
+
+private:
+	struct Portal;
+	struct TileGraph;
+
+	void init(const dtNavMesh* navMesh, const dtQueryFilter* filter);
+	TileGraph* getTileGraph(const int tileIndex);
+	unsigned int getNeighbourKey(const dtMeshTile* tile);
+	void buildTileGraph(TileGraph& graph, const dtMeshTile* tile, const int tileIndex);
+	void findCrossings(const TileGraph& graph, Portal& portal, const int tileIndex, const TileGraph& neighbourGraph);
+	void calcTileCosts(const dtMeshTile* tile, const int tileIndex, const int startPoly, const float* startPos);
+	void reservePolys(const int polyCount);
+	int appendToCorridor(dtPolyRef* path, int count, const dtPolyRef* segment, const int segmentCount,
+		const int maxPath);
+
+	const dtNavMesh* m_navMesh;
+	dtQueryFilter m_filter;
+
+	TileGraph* m_tiles;
+	int m_tileCount;
+
+	// Tiles are validated once per change of the navmesh tiles.
+	unsigned int m_changeCount;
+	unsigned int m_validation;
+	// Stamp of the current search, the search state of the portals is reset by it.
+	unsigned int m_search;
+
+	// Buffers of a tile, sized for the largest one.
+	float* m_centers;
+	float* m_costs;
+	int* m_heap;
+	int* m_heapIndex;
+	int* m_sets;
+	int m_polyCapacity;
+
+	dtPolyRef* m_segment;
+	int m_segmentCapacity;
+
+	struct OpenNode
+	{
+		float total;
+		int tile;
+		int portal;
+	};
+	OpenNode* m_open;
+	int m_openSize;
+	int m_openCapacity;
+	void pushOpen(const float total, const int tile, const int portal);
+	OpenNode popOpen();
+	void openPortal(TileGraph& graph, const int tile, const int portal, const float cost, const int parentTile,
+		const int parentPortal, const float* endPos);
+
+	NeoAxis_PortalGraph(const NeoAxis_PortalGraph&);
+	NeoAxis_PortalGraph& operator=(const NeoAxis_PortalGraph&);
+};
+
+#endif // NEOAXIS_PORTALGRAPH_H
@@ -0,0 +1,244 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+#include "NeoAxis_ThreadPool.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Auto-reset event.
+class Signal
+{
+#ifdef _WIN32
+	HANDLE m_event;
+#else
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_cond;
+	bool m_state;
+#endif
+
+public:
+
+	Signal()
+	{
+#ifdef _WIN32
+		m_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+		pthread_mutex_init(&m_mutex, NULL);
+		pthread_cond_init(&m_cond, NULL);
+		m_state = false;
+#endif
+	}
+
+	~Signal()
+	{
+#ifdef _WIN32
+		CloseHandle(m_event);
+#else
+		pthread_cond_destroy(&m_cond);
+		pthread_mutex_destroy(&m_mutex);
+#endif
+	}
+
+	void set()
+	{
+#ifdef _WIN32
+		SetEvent(m_event);
+#else
+		pthread_mutex_lock(&m_mutex);
+		m_state = true;
+		pthread_cond_signal(&m_cond);
+		pthread_mutex_unlock(&m_mutex);
+#endif
+	}
+
+	void wait()
+	{
+#ifdef _WIN32
+		WaitForSingleObject(m_event, INFINITE);
+#else
+		pthread_mutex_lock(&m_mutex);
+		while (!m_state)
+			pthread_cond_wait(&m_cond, &m_mutex);
+		m_state = false;
+		pthread_mutex_unlock(&m_mutex);
+#endif
+	}
+};
+
+static inline long atomicIncrement(volatile long* value)
+{
+#ifdef _WIN32
+	return InterlockedIncrement(value);
+#else
+	return __sync_add_and_fetch(value, 1);
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct NeoAxis_ThreadPool::Worker
+{
+	NeoAxis_ThreadPool* pool;
+	int index;
+	Signal start;
+	Signal done;
+#ifdef _WIN32
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
+};
+
+NeoAxis_ThreadPool::NeoAxis_ThreadPool() :
+	m_workers(0),
+	m_threadCount(1),
+	m_quit(false),
+	m_function(0),
+	m_userData(0),
+	m_taskCount(0),
+	m_nextTask(0)
+{
+}
+
+NeoAxis_ThreadPool::~NeoAxis_ThreadPool()
+{
+	shutdown();
+}
+
+int NeoAxis_ThreadPool::getProcessorCount()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#endif
+}
+
+bool NeoAxis_ThreadPool::init(int threadCount)
+{
+	shutdown();
+
+	if (threadCount <= 0)
+		threadCount = getProcessorCount();
+
+	m_quit = false;
+	m_threadCount = 1;
+	if (threadCount == 1)
+		return true;
+
+	// Worker 0 is the calling thread and has no entry here.
+	m_workers = new Worker[threadCount];
+	for (int i = 1; i < threadCount; ++i)
+	{
+		Worker& worker = m_workers[i];
+		worker.pool = this;
+		worker.index = i;
+#ifdef _WIN32
+		worker.thread = CreateThread(NULL, 0, threadProc, &worker, 0, NULL);
+		if (!worker.thread)
+			break;
+#else
+		if (pthread_create(&worker.thread, NULL, threadProc, &worker) != 0)
+			break;
+#endif
+		m_threadCount++;
+	}
+
+	return m_threadCount == threadCount;
+}
+
+void NeoAxis_ThreadPool::shutdown()
+{
+	if (!m_workers)
+		return;
+
+	m_quit = true;
+	for (int i = 1; i < m_threadCount; ++i)
+		m_workers[i].start.set();
+
+	for (int i = 1; i < m_threadCount; ++i)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(m_workers[i].thread, INFINITE);
+		CloseHandle(m_workers[i].thread);
+#else
+		pthread_join(m_workers[i].thread, NULL);
+#endif
+	}
+
+	delete [] m_workers;
+	m_workers = 0;
+	m_threadCount = 1;
+}
+
+void NeoAxis_ThreadPool::run(TaskFunction function, void* userData, int taskCount)
+{
+	if (taskCount <= 0)
+		return;
+
+	m_function = function;
+	m_userData = userData;
+	m_taskCount = taskCount;
+	m_nextTask = 0;
+
+	// No point waking more workers than there are tasks.
+	const int activeThreads = taskCount < m_threadCount ? taskCount : m_threadCount;
+
+	for (int i = 1; i < activeThreads; ++i)
+		m_workers[i].start.set();
+
+	doTasks(0);
+
+	for (int i = 1; i < activeThreads; ++i)
+		m_workers[i].done.wait();
+
+	m_function = 0;
+	m_userData = 0;
+}
+
+void NeoAxis_ThreadPool::doTasks(int workerIndex)
+{
+	while (true)
+	{
+		const int taskIndex = (int)atomicIncrement(&m_nextTask) - 1;
+		if (taskIndex >= m_taskCount)
+			break;
+		m_function(m_userData, taskIndex, workerIndex);
+	}
+}
+
+void NeoAxis_ThreadPool::workerMain(Worker* worker)
+{
+	NeoAxis_ThreadPool* pool = worker->pool;
+	while (true)
+	{
+		worker->start.wait();
+		if (pool->m_quit)
+			break;
+		pool->doTasks(worker->index);
+		worker->done.set();
+	}
+}
+
+#ifdef _WIN32
+unsigned long __stdcall NeoAxis_ThreadPool::threadProc(void* param)
+{
+	workerMain((Worker*)param);
+	return 0;
+}
+#else
+void* NeoAxis_ThreadPool::threadProc(void* param)
+{
+	workerMain((Worker*)param);
+	return 0;
+}
+#endif
@@ -0,0 +1,51 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+
+#ifndef NEOAXIS_THREADPOOL_H
+#define NEOAXIS_THREADPOOL_H
+
+/// Fixed-size worker pool for running independent jobs (tile builds, queries) in parallel.
+/// The calling thread takes part in every run as worker 0, so a pool initialized
+/// with one thread simply runs all tasks inline.
+class NeoAxis_ThreadPool
+{
+public:
+	/// Called once per task. workerIndex is in [0, getThreadCount()).
+	typedef void (*TaskFunction)(void* userData, int taskIndex, int workerIndex);
+
+	NeoAxis_ThreadPool();
+	~NeoAxis_ThreadPool();
+
+	/// Starts threadCount-1 background threads. threadCount <= 0 means one per processor.
+	bool init(int threadCount);
+	void shutdown();
+
+	int getThreadCount() const { return m_threadCount; }
+
+	/// Runs function for every task index in [0, taskCount) and returns when all of them are done.
+	/// Not reentrant: do not call run() from inside a task.
+	void run(TaskFunction function, void* userData, int taskCount);
+
+	static int getProcessorCount();
+
+private:
+	struct Worker;
+
+	void doTasks(int workerIndex);
+	static void workerMain(Worker* worker);
+#ifdef _WIN32
+	static unsigned long __stdcall threadProc(void* param);
+#else
+	static void* threadProc(void* param);
+#endif
+
+	Worker* m_workers;
+	int m_threadCount;
+	bool m_quit;
+
+	TaskFunction m_function;
+	void* m_userData;
+	int m_taskCount;
+	volatile long m_nextTask;
+};
+
+#endif // NEOAXIS_THREADPOOL_H
@@ -0,0 +1,514 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+// based on the original Sample_TempObstacles.cpp by Mikko Mononen
+
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include "NeoAxis_TileCache.h"
+#include "NeoAxis_TileMesh.h"
+#include "NeoAxis_ThreadPool.h"
+#include "NeoAxis_Compressor.h"
+#include "NeoAxis_BuildArena.h"
+#include "InputGeom.h"
+#include "Recast.h"
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourTileCacheBuilder.h"
+
+// Navmesh tiles expected at one tile position, used to size the navmesh.
+static const int EXPECTED_LAYERS_PER_TILE = 4;
+static const int MAX_LAYERS = 32;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Temporary memory of the navmesh tile builds. Allocations which do not fit in the buffer go to
+// the heap and the buffer is grown to the needed size at the next reset.
+struct TileCacheAllocator : public dtTileCacheAlloc
+{
+	unsigned char* buffer;
+	int capacity;
+	int top;
+	int overflow;
+
+	TileCacheAllocator(const int cap) : buffer(0), capacity(0), top(0), overflow(0)
+	{
+		resize(cap);
+	}
+
+	virtual ~TileCacheAllocator()
+	{
+		dtFree(buffer);
+	}
+
+	void resize(const int cap)
+	{
+		dtFree(buffer);
+		buffer = (unsigned char*)dtAlloc(cap, DT_ALLOC_PERM);
+		capacity = buffer ? cap : 0;
+	}
+
+	virtual void reset()
+	{
+		if (overflow)
+			resize(top + overflow);
+		top = 0;
+		overflow = 0;
+	}
+
+	virtual void* alloc(const int size)
+	{
+		// Keep the allocations aligned, the layers contain ints and shorts.
+		const int alignedSize = (size + 7) & ~7;
+		if (top + alignedSize <= capacity)
+		{
+			unsigned char* mem = &buffer[top];
+			top += alignedSize;
+			return mem;
+		}
+		overflow += alignedSize;
+		return dtAlloc(size, DT_ALLOC_TEMP);
+	}
+
+	virtual void free(void* ptr)
+	{
+		// Memory of the buffer is released all at once by reset().
+		if (ptr && ((unsigned char*)ptr < buffer || (unsigned char*)ptr >= buffer + capacity))
+			dtFree(ptr);
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Compressed layers of one tile.
+struct TileCacheLayers
+{
+	unsigned char* data[MAX_LAYERS];
+	int dataSizes[MAX_LAYERS];
+	int count;
+};
+
+struct ParallelLayerBuild
+{
+	NeoAxis_TileCache* tileCache;
+	int minX;
+	int minY;
+	int tilesWidth;
+	TileBuildScratch* scratches;
+	TileCacheLayers* tileLayers;
+};
+
+NeoAxis_TileCache::NeoAxis_TileCache(NeoAxis_TileMesh* tileMesh) :
+	m_tileMesh(tileMesh),
+	m_tileCache(0),
+	m_talloc(0),
+	m_tcomp(0)
+{
+}
+
+NeoAxis_TileCache::~NeoAxis_TileCache()
+{
+	cleanup();
+}
+
+void NeoAxis_TileCache::cleanup()
+{
+	dtFreeTileCache(m_tileCache);
+	m_tileCache = 0;
+	delete m_talloc;
+	m_talloc = 0;
+	delete m_tcomp;
+	m_tcomp = 0;
+}
+
+bool NeoAxis_TileCache::init(int maxObstacles)
+{
+	cleanup();
+
+	BuildContext* ctx = m_tileMesh->m_ctx;
+
+	rcConfig cfg;
+	m_tileMesh->initTileConfig(cfg, m_tileMesh->m_bmin, m_tileMesh->m_bmax);
+	if (cfg.width > 255 || cfg.height > 255)
+	{
+		ctx->log(RC_LOG_ERROR, "Tile cache: Tile size with the border is %d, the maximum is 255. Please decrease TileSize property.", cfg.width);
+		return false;
+	}
+
+	m_talloc = new TileCacheAllocator(32000);
+	m_tcomp = new NeoAxis_Compressor();
+
+	int tw = 0, th = 0;
+	m_tileMesh->getTileGridSize(tw, th);
+
+	dtTileCacheParams params;
+	memset(&params, 0, sizeof(params));
+	rcVcopy(params.orig, m_tileMesh->m_bmin);
+	params.cs = m_tileMesh->m_cellSize;
+	params.ch = m_tileMesh->m_cellHeight;
+	params.width = (int)m_tileMesh->m_tileSize;
+	params.height = (int)m_tileMesh->m_tileSize;
+	params.walkableHeight = m_tileMesh->m_agentHeight;
+	params.walkableRadius = m_tileMesh->m_agentRadius;
+	params.walkableClimb = m_tileMesh->m_agentMaxClimb;
+	params.maxSimplificationError = m_tileMesh->m_edgeMaxError;
+	params.maxTiles = tw*th*EXPECTED_LAYERS_PER_TILE;
+	params.maxObstacles = maxObstacles;
+
+	m_tileCache = dtAllocTileCache();
+	if (!m_tileCache)
+	{
+		ctx->log(RC_LOG_ERROR, "Tile cache: Could not allocate tile cache.");
+		return false;
+	}
+	dtStatus status = m_tileCache->init(&params, m_talloc, m_tcomp);
+	if (dtStatusFailed(status))
+	{
+		ctx->log(RC_LOG_ERROR, "Tile cache: Could not init tile cache.");
+		return false;
+	}
+
+	// Every layer of a tile is a separate navmesh tile.
+	m_tileMesh->calculateSize(EXPECTED_LAYERS_PER_TILE);
+	return m_tileMesh->init();
+}
+
+void NeoAxis_TileCache::buildAllTiles(NeoAxis_ThreadPool* threadPool)
+{
+	if (!m_tileCache) return;
+	if (!m_tileMesh->m_geom) return;
+	if (!m_tileMesh->m_navMesh) return;
+
+	int tw = 0, th = 0;
+	m_tileMesh->getTileGridSize(tw, th);
+	buildTiles(threadPool, 0, 0, tw-1, th-1);
+}
+
+// Same tile selection as NeoAxis_TileMesh::rebuildTilesInBounds(), the layers of these tiles are
+// rasterized again and the obstacles are applied to the new layers.
+void NeoAxis_TileCache::rebuildTilesInBounds(const float* bmin, const float* bmax, NeoAxis_ThreadPool* threadPool)
+{
+	if (!m_tileCache) return;
+	if (!m_tileMesh->m_geom) return;
+	if (!m_tileMesh->m_navMesh) return;
+	if (bmin[0] > bmax[0] || bmin[2] > bmax[2])
+		return;
+
+	int tw = 0, th = 0;
+	m_tileMesh->getTileGridSize(tw, th);
+	const float tcs = m_tileMesh->m_tileSize*m_tileMesh->m_cellSize;
+	const int borderSize = (int)ceilf(m_tileMesh->m_agentRadius / m_tileMesh->m_cellSize) + 3;
+	const float border = borderSize*m_tileMesh->m_cellSize;
+	const float* origin = m_tileMesh->m_bmin;
+
+	const int minX = rcMax((int)floorf((bmin[0] - border - origin[0]) / tcs), 0);
+	const int minY = rcMax((int)floorf((bmin[2] - border - origin[2]) / tcs), 0);
+	const int maxX = rcMin((int)floorf((bmax[0] + border - origin[0]) / tcs), tw-1);
+	const int maxY = rcMin((int)floorf((bmax[2] + border - origin[2]) / tcs), th-1);
+
+	buildTiles(threadPool, minX, minY, maxX, maxY);
+}
+
+void NeoAxis_TileCache::buildTileLayersTask(void* userData, int taskIndex, int workerIndex)
+{
+	ParallelLayerBuild* build = (ParallelLayerBuild*)userData;
+
+	const int x = build->minX + taskIndex % build->tilesWidth;
+	const int y = build->minY + taskIndex / build->tilesWidth;
+	build->tileCache->buildTileLayers(x, y, build->scratches[workerIndex], build->tileLayers[taskIndex]);
+}
+
+// Rasterizes the layers of the tiles on all threads of the pool, then replaces the layers in the
+// cache and rebuilds the navmesh tiles from them in tile order.
+void NeoAxis_TileCache::buildTiles(NeoAxis_ThreadPool* threadPool, const int minX, const int minY,
+	const int maxX, const int maxY)
+{
+	const int tilesWidth = maxX - minX + 1;
+	const int tilesHeight = maxY - minY + 1;
+	if (tilesWidth <= 0 || tilesHeight <= 0)
+		return;
+	const int tileCount = tilesWidth * tilesHeight;
+
+	const int threadCount = threadPool->getThreadCount();
+
+	BuildContext* contexts = new BuildContext[threadCount];
+	TileCacheLayers* tileLayers = new TileCacheLayers[tileCount];
+
+	ParallelLayerBuild build;
+	build.tileCache = this;
+	build.minX = minX;
+	build.minY = minY;
+	build.tilesWidth = tilesWidth;
+	build.scratches = new TileBuildScratch[threadCount];
+	build.tileLayers = tileLayers;
+	for (int i = 0; i < threadCount; ++i)
+		build.scratches[i].ctx = &contexts[i];
+
+	threadPool->run(buildTileLayersTask, &build, tileCount);
+
+	delete [] build.scratches;
+	delete [] contexts;
+
+	dtNavMesh* navMesh = m_tileMesh->m_navMesh;
+
+	for (int i = 0; i < tileCount; ++i)
+	{
+		const int x = minX + i % tilesWidth;
+		const int y = minY + i / tilesWidth;
+		TileCacheLayers& layers = tileLayers[i];
+
+		dtCompressedTileRef oldLayers[MAX_LAYERS];
+		const int oldLayerCount = m_tileCache->getTilesAt(x, y, oldLayers, MAX_LAYERS);
+		for (int j = 0; j < oldLayerCount; ++j)
+			m_tileCache->removeTile(oldLayers[j], 0, 0);
+
+		for (int j = 0; j < layers.count; ++j)
+		{
+			dtStatus status = m_tileCache->addTile(layers.data[j], layers.dataSizes[j], DT_COMPRESSEDTILE_FREE_DATA, 0);
+			if (dtStatusFailed(status))
+			{
+				dtFree(layers.data[j]);
+				if ((status & DT_OUT_OF_MEMORY) != 0)
+					m_tileMesh->m_ctx->log(RC_LOG_ERROR, "Tile cache: Max tiles reached (%d,%d).", x, y);
+			}
+		}
+	}
+
+	delete [] tileLayers;
+
+	// The obstacles refer to the removed layers.
+	const float tcs = m_tileMesh->m_tileSize*m_tileMesh->m_cellSize;
+	float bmin[3], bmax[3];
+	bmin[0] = m_tileMesh->m_bmin[0] + minX*tcs;
+	bmin[1] = -FLT_MAX;
+	bmin[2] = m_tileMesh->m_bmin[2] + minY*tcs;
+	bmax[0] = m_tileMesh->m_bmin[0] + (maxX+1)*tcs;
+	bmax[1] = FLT_MAX;
+	bmax[2] = m_tileMesh->m_bmin[2] + (maxY+1)*tcs;
+	m_tileCache->updateObstacleTiles(bmin, bmax);
+
+	for (int i = 0; i < tileCount; ++i)
+	{
+		const int x = minX + i % tilesWidth;
+		const int y = minY + i / tilesWidth;
+
+		// Layers can disappear with the geometry.
+		const dtMeshTile* navTiles[MAX_LAYERS];
+		const int navTileCount = navMesh->getTilesAt(x, y, navTiles, MAX_LAYERS);
+		for (int j = 0; j < navTileCount; ++j)
+			navMesh->removeTile(navMesh->getTileRef(navTiles[j]), 0, 0);
+
+		dtStatus status = m_tileCache->buildNavMeshTilesAt(x, y, navMesh);
+		if (dtStatusFailed(status) && (status & DT_OUT_OF_MEMORY) != 0)
+		{
+			//SodanKerjuu: stop calculating!!!
+			m_tileMesh->m_ctx->log(RC_LOG_ERROR, "Max tiles reached! Please increase TileSize, CellSize properties.");
+			return;
+		}
+	}
+}
+
+int NeoAxis_TileCache::buildTileLayers(const int tx, const int ty, TileBuildScratch& scratch, TileCacheLayers& layers)
+{
+	layers.count = 0;
+
+	InputGeom* geom = m_tileMesh->m_geom;
+	if (!geom || !geom->getMesh() || !geom->getChunkyMesh())
+	{
+		scratch.ctx->log(RC_LOG_ERROR, "buildTileLayers: Input mesh is not specified.");
+		return 0;
+	}
+
+	scratch.cleanup();
+	scratch.arena.reset();
+	NeoAxis_BuildArena::Scope arenaScope(&scratch.arena);
+
+	const float* verts = geom->getMesh()->getVerts();
+	const int nverts = geom->getMesh()->getVertCount();
+	const rcChunkyTriMesh* chunkyMesh = geom->getChunkyMesh();
+
+	const float tcs = m_tileMesh->m_tileSize*m_tileMesh->m_cellSize;
+	float tileBmin[3], tileBmax[3];
+	tileBmin[0] = m_tileMesh->m_bmin[0] + tx*tcs;
+	tileBmin[1] = m_tileMesh->m_bmin[1];
+	tileBmin[2] = m_tileMesh->m_bmin[2] + ty*tcs;
+	tileBmax[0] = m_tileMesh->m_bmin[0] + (tx+1)*tcs;
+	tileBmax[1] = m_tileMesh->m_bmax[1];
+	tileBmax[2] = m_tileMesh->m_bmin[2] + (ty+1)*tcs;
+
+	rcConfig& cfg = scratch.cfg;
+	m_tileMesh->initTileConfig(cfg, tileBmin, tileBmax);
+
+	// Allocate voxel heightfield where we rasterize our input data to.
+	scratch.solid = rcAllocHeightfield();
+	if (!scratch.solid)
+	{
+		scratch.ctx->log(RC_LOG_ERROR, "buildTileLayers: Out of memory 'solid'.");
+		return 0;
+	}
+	if (!rcCreateHeightfield(scratch.ctx, *scratch.solid, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs, cfg.ch))
+	{
+		scratch.ctx->log(RC_LOG_ERROR, "buildTileLayers: Could not create solid heightfield.");
+		return 0;
+	}
+
+	scratch.triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
+
+	float tbmin[2], tbmax[2];
+	tbmin[0] = cfg.bmin[0];
+	tbmin[1] = cfg.bmin[2];
+	tbmax[0] = cfg.bmax[0];
+	tbmax[1] = cfg.bmax[2];
+	const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, scratch.chunkIds);
+	if (!ncid)
+		return 0;
+	const int* cid = scratch.chunkIds.ids;
+
+	for (int i = 0; i < ncid; ++i)
+	{
+		const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
+		const int* tris = &chunkyMesh->tris[node.i*3];
+		const int ntris = node.n;
+
+		memset(scratch.triareas, 0, ntris*sizeof(unsigned char));
+		rcMarkWalkableTriangles(scratch.ctx, cfg.walkableSlopeAngle, verts, nverts, tris, ntris, scratch.triareas);
+
+		rcRasterizeTriangles(scratch.ctx, verts, nverts, tris, scratch.triareas, ntris, *scratch.solid, cfg.walkableClimb);
+	}
+
+	// Once all geometry is rasterized, we do initial pass of filtering to
+	// remove unwanted overhangs caused by the conservative rasterization
+	// as well as filter spans where the character cannot possibly stand.
+	rcFilterLowHangingWalkableObstacles(scratch.ctx, cfg.walkableClimb, *scratch.solid);
+	rcFilterLedgeSpans(scratch.ctx, cfg.walkableHeight, cfg.walkableClimb, *scratch.solid);
+	rcFilterWalkableLowHeightSpans(scratch.ctx, cfg.walkableHeight, *scratch.solid);
+
+	scratch.chf = rcAllocCompactHeightfield();
+	if (!scratch.chf)
+	{
+		scratch.ctx->log(RC_LOG_ERROR, "buildTileLayers: Out of memory 'chf'.");
+		return 0;
+	}
+	if (!rcBuildCompactHeightfield(scratch.ctx, cfg.walkableHeight, cfg.walkableClimb, *scratch.solid, *scratch.chf))
+	{
+		scratch.ctx->log(RC_LOG_ERROR, "buildTileLayers: Could not build compact data.");
+		return 0;
+	}
+
+	// Erode the walkable area by agent radius.
+	if (!rcErodeWalkableArea(scratch.ctx, cfg.walkableRadius, *scratch.chf))
+	{
+		scratch.ctx->log(RC_LOG_ERROR, "buildTileLayers: Could not erode.");
+		return 0;
+	}
+
+	// (Optional) Mark areas.
+	const ConvexVolume* vols = geom->getConvexVolumes();
+	for (int i  = 0; i < geom->getConvexVolumeCount(); ++i)
+		rcMarkConvexPolyArea(scratch.ctx, vols[i].verts, vols[i].nverts, vols[i].hmin, vols[i].hmax, (unsigned char)vols[i].area, *scratch.chf);
+
+	scratch.lset = rcAllocHeightfieldLayerSet();
+	if (!scratch.lset)
+	{
+		scratch.ctx->log(RC_LOG_ERROR, "buildTileLayers: Out of memory 'lset'.");
+		return 0;
+	}
+	if (!rcBuildHeightfieldLayers(scratch.ctx, *scratch.chf, cfg.borderSize, cfg.walkableHeight, *scratch.lset))
+	{
+		scratch.ctx->log(RC_LOG_ERROR, "buildTileLayers: Could not build heighfield layers.");
+		return 0;
+	}
+
+	for (int i = 0; i < rcMin(scratch.lset->nlayers, MAX_LAYERS); ++i)
+	{
+		const rcHeightfieldLayer* layer = &scratch.lset->layers[i];
+
+		// Store header
+		dtTileCacheLayerHeader header;
+		header.magic = DT_TILECACHE_MAGIC;
+		header.version = DT_TILECACHE_VERSION;
+
+		// Tile layer location in the navmesh.
+		header.tx = tx;
+		header.ty = ty;
+		header.tlayer = i;
+		dtVcopy(header.bmin, layer->bmin);
+		dtVcopy(header.bmax, layer->bmax);
+
+		// Tile info.
+		header.width = (unsigned char)layer->width;
+		header.height = (unsigned char)layer->height;
+		header.minx = (unsigned char)layer->minx;
+		header.maxx = (unsigned char)layer->maxx;
+		header.miny = (unsigned char)layer->miny;
+		header.maxy = (unsigned char)layer->maxy;
+		header.hmin = (unsigned short)layer->hmin;
+		header.hmax = (unsigned short)layer->hmax;
+
+		dtStatus status = dtBuildTileCacheLayer(m_tcomp, &header, layer->heights, layer->areas, layer->cons,
+			&layers.data[layers.count], &layers.dataSizes[layers.count]);
+		if (dtStatusFailed(status))
+		{
+			scratch.ctx->log(RC_LOG_ERROR, "buildTileLayers: Could not build tile cache layer.");
+			break;
+		}
+		layers.count++;
+	}
+
+	// Intermediate results are large, do not keep them until the next tile of the thread.
+	scratch.cleanup();
+
+	return layers.count;
+}
+
+dtStatus NeoAxis_TileCache::addCylinderObstacle(const float* pos, const float radius, const float height,
+	dtObstacleRef* result)
+{
+	if (!m_tileCache)
+		return DT_FAILURE;
+	return m_tileCache->addObstacle(pos, radius, height, result);
+}
+
+dtStatus NeoAxis_TileCache::addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result)
+{
+	if (!m_tileCache)
+		return DT_FAILURE;
+	return m_tileCache->addBoxObstacle(bmin, bmax, result);
+}
+
+dtStatus NeoAxis_TileCache::removeObstacle(dtObstacleRef ref)
+{
+	if (!m_tileCache)
+		return DT_FAILURE;
+	return m_tileCache->removeObstacle(ref);
+}
+
+dtStatus NeoAxis_TileCache::update(const float dt, bool* upToDate)
+{
+	if (!m_tileCache || !m_tileMesh->m_navMesh)
+	{
+		if (upToDate)
+			*upToDate = true;
+		return DT_FAILURE;
+	}
+	return m_tileCache->update(dt, m_tileMesh->m_navMesh, upToDate);
+}
+
+void NeoAxis_TileCache::getStatistics(int* layerCount, int* compressedSize, int* rawSize)
+{
+	*layerCount = 0;
+	*compressedSize = 0;
+	*rawSize = 0;
+	if (!m_tileCache)
+		return;
+
+	const int headerSize = dtAlign4(sizeof(dtTileCacheLayerHeader));
+	for (int i = 0; i < m_tileCache->getTileCount(); ++i)
+	{
+		const dtCompressedTile* tile = m_tileCache->getTile(i);
+		if (!tile->header)
+			continue;
+		(*layerCount)++;
+		*compressedSize += tile->dataSize;
+		*rawSize += headerSize + tile->header->width * tile->header->height * 4;
+	}
+}
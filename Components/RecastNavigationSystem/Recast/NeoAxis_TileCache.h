@@ -0,0 +1,51 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+
+#ifndef NEOAXIS_TILECACHE_H
+#define NEOAXIS_TILECACHE_H
+
+#include "DetourTileCache.h"
+
+class NeoAxis_TileMesh;
+class NeoAxis_ThreadPool;
+struct TileBuildScratch;
+struct TileCacheLayers;
+
+/// Navmesh built from the walkable layers of the tiles, which are kept compressed in memory.
+/// Adding or removing a temporary obstacle only rebuilds the navmesh tiles it touches from these
+/// layers instead of rasterizing the input triangles again.
+/// Uses the settings, the input geometry and the navmesh of the tile mesh.
+class NeoAxis_TileCache
+{
+public:
+	NeoAxis_TileCache(NeoAxis_TileMesh* tileMesh);
+	~NeoAxis_TileCache();
+
+	/// Creates the tile cache and replaces the navmesh of the tile mesh with one sized for the tile layers.
+	bool init(int maxObstacles);
+	void cleanup();
+
+	void buildAllTiles(NeoAxis_ThreadPool* threadPool);
+	void rebuildTilesInBounds(const float* bmin, const float* bmax, NeoAxis_ThreadPool* threadPool);
+
+	dtStatus addCylinderObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result);
+	dtStatus addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result);
+	dtStatus removeObstacle(dtObstacleRef ref);
+
+	/// Applies the added and removed obstacles. Rebuilds one navmesh tile per call, upToDate tells
+	/// whether all changes are in the navmesh.
+	dtStatus update(const float dt, bool* upToDate);
+
+	void getStatistics(int* layerCount, int* compressedSize, int* rawSize);
+
+private:
+	void buildTiles(NeoAxis_ThreadPool* threadPool, const int minX, const int minY, const int maxX, const int maxY);
+	int buildTileLayers(const int tx, const int ty, TileBuildScratch& scratch, TileCacheLayers& layers);
+	static void buildTileLayersTask(void* userData, int taskIndex, int workerIndex);
+
+	NeoAxis_TileMesh* m_tileMesh;
+	dtTileCache* m_tileCache;
+	struct TileCacheAllocator* m_talloc;
+	struct NeoAxis_Compressor* m_tcomp;
+};
+
+#endif // NEOAXIS_TILECACHE_H
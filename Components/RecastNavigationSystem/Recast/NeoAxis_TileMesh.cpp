@@ -28,7 +28,11 @@
 #include "RecastDump.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshBuilder.h"
+#include "DetourCommon.h"
 #include "DetourDebugDraw.h"
+#include "NeoAxis_ThreadPool.h"
+#include "NeoAxis_MappedFile.h"
+#include "NeoAxis_Compressor.h"
 
 #ifdef WIN32
 #	define snprintf _snprintf
@@ -59,24 +63,59 @@ inline unsigned int ilog2(unsigned int v)
 	return r;
 }
 
+TileBuildScratch::TileBuildScratch() :
+	ctx(0),
+	triareas(0),
+	solid(0),
+	chf(0),
+	cset(0),
+	pmesh(0),
+	dmesh(0),
+	lset(0)
+{
+	memset(&cfg, 0, sizeof(cfg));
+	memset(&stats, 0, sizeof(stats));
+}
+
+TileBuildScratch::~TileBuildScratch()
+{
+	cleanup();
+}
+
+void TileBuildScratch::cleanup()
+{
+	delete [] triareas;
+	triareas = 0;
+	rcFreeHeightField(solid);
+	solid = 0;
+	rcFreeCompactHeightfield(chf);
+	chf = 0;
+	rcFreeContourSet(cset);
+	cset = 0;
+	rcFreePolyMesh(pmesh);
+	pmesh = 0;
+	rcFreePolyMeshDetail(dmesh);
+	dmesh = 0;
+	rcFreeHeightfieldLayerSet(lset);
+	lset = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 NeoAxis_TileMesh::NeoAxis_TileMesh() :
 	m_geom(0),
 	m_navMesh(0),
 	m_navQuery(0),
 	m_ctx(0),
 	m_keepInterResults(false),
-	m_triareas(0),
-	m_solid(0),
-	m_chf(0),
-	m_cset(0),
-	m_pmesh(0),
-	m_dmesh(0),
 	m_maxTiles(0),
 	m_maxPolysPerTile(0),
-	m_tileSize(32),
-	m_tileBuildTime(0),
-	m_tileMemUsage(0),
-	m_tileTriCount(0)
+	m_tileStats(0),
+	m_tileStatsWidth(0),
+	m_tileStatsHeight(0),
+	m_mappedFile(0),
+	m_navMeshGeneration(0),
+	m_tileSize(32)
 {
 	resetCommonSettings();
 	memset(m_tileBmin, 0, sizeof(m_tileBmin));
@@ -87,25 +126,24 @@ NeoAxis_TileMesh::NeoAxis_TileMesh() :
 NeoAxis_TileMesh::~NeoAxis_TileMesh()
 {
 	cleanup();
-	dtFreeNavMesh(m_navMesh);
+	freeNavMesh();
 	dtFreeNavMeshQuery(m_navQuery);
+	delete [] m_tileStats;
+}
+
+void NeoAxis_TileMesh::freeNavMesh()
+{
+	dtFreeNavMesh(m_navMesh);
 	m_navMesh = 0;
+	m_navMeshGeneration++;
+	// Tiles loaded from the mapped file point into it.
+	delete m_mappedFile;
+	m_mappedFile = 0;
 }
 
 void NeoAxis_TileMesh::cleanup()
 {
-	delete [] m_triareas;
-	m_triareas = 0;
-	rcFreeHeightField(m_solid);
-	m_solid = 0;
-	rcFreeCompactHeightfield(m_chf);
-	m_chf = 0;
-	rcFreeContourSet(m_cset);
-	m_cset = 0;
-	rcFreePolyMesh(m_pmesh);
-	m_pmesh = 0;
-	rcFreePolyMeshDetail(m_dmesh);
-	m_dmesh = 0;
+	m_scratch.cleanup();
 }
 
 void NeoAxis_TileMesh::resetCommonSettings()
@@ -127,8 +165,13 @@ void NeoAxis_TileMesh::resetCommonSettings()
 }
 
 static const int NAVMESHSET_MAGIC = 'M'<<24 | 'S'<<16 | 'E'<<8 | 'T'; //'MSET';
-static const int NAVMESHSET_VERSION = 1;
+static const int NAVMESHSET_VERSION = 3;
+static const int NAVMESHSET_TILE_ALIGN = 16;
 
+// Version 1 stores every tile as NavMeshTileHeader followed by the tile data.
+// Version 2 stores a tile index after the set header, followed by the tile data at aligned offsets, so the
+// tiles of a mapped file can be added to the navmesh in place.
+// Version 3 adds the stored size to the tile index, tiles stored smaller than their data size are compressed.
 struct NavMeshSetHeader
 {
 	int magic;
@@ -143,6 +186,103 @@ struct NavMeshTileHeader
 	int dataSize;
 };
 
+struct NavMeshTileIndex2
+{
+	dtTileRef tileRef;
+	int dataSize;
+	unsigned int dataOffset;
+};
+
+struct NavMeshTileIndex
+{
+	dtTileRef tileRef;
+	int dataSize;
+	unsigned int dataOffset;
+	int storedSize;
+};
+
+// Reads the set header and the location of every tile of a saved navmesh. tiles must be freed with delete[].
+static bool readNavMeshSet(const unsigned char* data, size_t dataSize, NavMeshSetHeader& header, 
+	NavMeshTileIndex*& tiles, int& tileCount)
+{
+	tiles = 0;
+	tileCount = 0;
+
+	if (dataSize < sizeof(NavMeshSetHeader))
+		return false;
+	memcpy(&header, data, sizeof(NavMeshSetHeader));
+	if (header.magic != NAVMESHSET_MAGIC)
+		return false;
+	if (header.version < 1 || header.version > NAVMESHSET_VERSION)
+		return false;
+	if (header.numTiles < 0)
+		return false;
+
+	tiles = new NavMeshTileIndex[header.numTiles ? header.numTiles : 1];
+
+	if (header.version == 1)
+	{
+		size_t position = sizeof(NavMeshSetHeader);
+		for (int i = 0; i < header.numTiles; ++i)
+		{
+			NavMeshTileHeader tileHeader;
+			if (position + sizeof(tileHeader) > dataSize)
+				break;
+			memcpy(&tileHeader, data + position, sizeof(tileHeader));
+			position += sizeof(tileHeader);
+
+			if (!tileHeader.tileRef || tileHeader.dataSize < (int)sizeof(dtMeshHeader) || 
+				(size_t)tileHeader.dataSize > dataSize - position)
+				break;
+
+			NavMeshTileIndex& tile = tiles[tileCount++];
+			tile.tileRef = tileHeader.tileRef;
+			tile.dataSize = tileHeader.dataSize;
+			tile.dataOffset = (unsigned int)position;
+			tile.storedSize = tileHeader.dataSize;
+			position += tileHeader.dataSize;
+		}
+		return true;
+	}
+
+	const size_t entrySize = header.version == 2 ? sizeof(NavMeshTileIndex2) : sizeof(NavMeshTileIndex);
+	if (header.numTiles * entrySize > dataSize - sizeof(NavMeshSetHeader))
+	{
+		delete[] tiles;
+		tiles = 0;
+		return false;
+	}
+
+	for (int i = 0; i < header.numTiles; ++i)
+	{
+		const unsigned char* entry = data + sizeof(NavMeshSetHeader) + i * entrySize;
+		NavMeshTileIndex& tile = tiles[i];
+		if (header.version == 2)
+		{
+			NavMeshTileIndex2 tile2;
+			memcpy(&tile2, entry, sizeof(tile2));
+			tile.tileRef = tile2.tileRef;
+			tile.dataSize = tile2.dataSize;
+			tile.dataOffset = tile2.dataOffset;
+			tile.storedSize = tile2.dataSize;
+		}
+		else
+			memcpy(&tile, entry, sizeof(tile));
+
+		if (!tile.tileRef || tile.dataSize < (int)sizeof(dtMeshHeader) || tile.storedSize <= 0 || 
+			tile.storedSize > tile.dataSize || tile.dataOffset > dataSize || 
+			(size_t)tile.storedSize > dataSize - tile.dataOffset)
+		{
+			delete[] tiles;
+			tiles = 0;
+			return false;
+		}
+	}
+	tileCount = header.numTiles;
+
+	return true;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class ReadBuffer
@@ -207,61 +347,207 @@ public:
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool NeoAxis_TileMesh::loadNavMesh(void* data, int dataSize)
+// Checks that the sections described by the tile header fit in the tile data, Detour does not check it.
+static bool checkTileData(const unsigned char* data, const int dataSize)
 {
-	ReadBuffer buffer(data, dataSize);
-
-	// Read header.
-	NavMeshSetHeader header;
-	if(!buffer.Read(&header, sizeof(NavMeshSetHeader)))
-		return false;
-	if (header.magic != NAVMESHSET_MAGIC)
+	const dtMeshHeader* header = (const dtMeshHeader*)data;
+	if (header->magic != DT_NAVMESH_MAGIC || header->version != DT_NAVMESH_VERSION)
 		return false;
-	if (header.version != NAVMESHSET_VERSION)
+
+	const int counts[] = { header->vertCount, header->polyCount, header->maxLinkCount, header->detailMeshCount,
+		header->detailVertCount, header->detailTriCount, header->bvNodeCount, header->offMeshConCount };
+	const int itemSizes[] = { (int)sizeof(float)*3, (int)sizeof(dtPoly), (int)sizeof(dtLink), 
+		(int)sizeof(dtPolyDetail), (int)sizeof(float)*3, 4, (int)sizeof(dtBVNode), (int)sizeof(dtOffMeshConnection) };
+
+	if (header->maxLinkCount <= 0)
 		return false;
+	int size = dtAlign4(sizeof(dtMeshHeader));
+	for (int i = 0; i < 8; ++i)
+	{
+		if (counts[i] < 0 || counts[i] > (dataSize - size) / itemSizes[i])
+			return false;
+		size += dtAlign4(counts[i] * itemSizes[i]);
+	}
+	return size <= dataSize;
+}
+
+struct LoadTilesData
+{
+	unsigned char* data;
+	const NavMeshTileIndex* tiles;
+	bool inPlace;
+	NeoAxis_Compressor* compressor;
+	// Result, points into data for the tiles used in place.
+	unsigned char** tileData;
+};
+
+static void loadTileTask(void* userData, int taskIndex, int /*workerIndex*/)
+{
+	LoadTilesData* load = (LoadTilesData*)userData;
+	const NavMeshTileIndex& tile = load->tiles[taskIndex];
+	unsigned char* stored = load->data + tile.dataOffset;
+	load->tileData[taskIndex] = 0;
+
+	// Tiles need 4 byte alignment to be used in place.
+	if (load->inPlace && tile.storedSize == tile.dataSize && !(tile.dataOffset & 3))
+	{
+		load->tileData[taskIndex] = stored;
+		return;
+	}
+
+	unsigned char* tileData = (unsigned char*)dtAlloc(tile.dataSize, DT_ALLOC_PERM);
+	if (!tileData)
+		return;
+
+	if (tile.storedSize == tile.dataSize)
+		memcpy(tileData, stored, tile.dataSize);
+	else
+	{
+		int size = 0;
+		if (dtStatusFailed(load->compressor->decompress(stored, tile.storedSize, tileData, tile.dataSize, &size)) ||
+			size != tile.dataSize)
+		{
+			dtFree(tileData);
+			return;
+		}
+	}
+	load->tileData[taskIndex] = tileData;
+}
+
+// Creates the navmesh of saved data. The tiles are copied or decompressed on the threads of threadPool
+// (0 to use the calling thread), with inPlace the uncompressed tiles point into data instead.
+static dtNavMesh* createNavMesh(unsigned char* data, size_t dataSize, bool inPlace, NeoAxis_ThreadPool* threadPool)
+{
+	NavMeshSetHeader header;
+	NavMeshTileIndex* tiles;
+	int tileCount;
+	if (!readNavMeshSet(data, dataSize, header, tiles, tileCount))
+		return 0;
 	
 	dtNavMesh* mesh = dtAllocNavMesh();
+	if (!mesh || dtStatusFailed(mesh->init(&header.params)))
+	{
+		dtFreeNavMesh(mesh);
+		delete[] tiles;
+		return 0;
+	}
+
+	NeoAxis_Compressor compressor;
+	LoadTilesData load;
+	load.data = data;
+	load.tiles = tiles;
+	load.inPlace = inPlace;
+	load.compressor = &compressor;
+	load.tileData = new unsigned char*[tileCount ? tileCount : 1];
+	if (threadPool)
+		threadPool->run(loadTileTask, &load, tileCount);
+	else
+	{
+		for (int i = 0; i < tileCount; ++i)
+			loadTileTask(&load, i, 0);
+	}
+
+	// Adding is serial, in the saved order.
+	for (int i = 0; i < tileCount; ++i)
+	{
+		unsigned char* tileData = load.tileData[i];
+		if (!tileData)
+			continue;
+		const int flags = tileData == data + tiles[i].dataOffset ? 0 : DT_TILE_FREE_DATA;
+		if ((!checkTileData(tileData, tiles[i].dataSize) || 
+			dtStatusFailed(mesh->addTile(tileData, tiles[i].dataSize, flags, tiles[i].tileRef, 0))) && flags)
+		{
+			dtFree(tileData);
+		}
+	}
+
+	delete[] load.tileData;
+	delete[] tiles;
+	return mesh;
+}
+
+bool NeoAxis_TileMesh::loadNavMesh(void* data, int dataSize, NeoAxis_ThreadPool* threadPool)
+{
+	dtNavMesh* mesh = createNavMesh((unsigned char*)data, dataSize, false, threadPool);
 	if (!mesh)
 		return false;
 
-	dtStatus status = mesh->init(&header.params);
-	if (dtStatusFailed(status))
-		return false;
-		
-	// Read tiles.
-	for (int i = 0; i < header.numTiles; ++i)
-	{
-		NavMeshTileHeader tileHeader;
-		buffer.Read(&tileHeader, sizeof(tileHeader));
+	freeNavMesh();
+	m_navMesh = mesh;
 
-		if (!tileHeader.tileRef || !tileHeader.dataSize)
-			break;
+	return true;
+}
 
-		unsigned char* data = (unsigned char*)dtAlloc(tileHeader.dataSize, DT_ALLOC_PERM);
-		if (!data)
-			break;
-		memset(data, 0, tileHeader.dataSize);
-		buffer.Read(data, tileHeader.dataSize);
-		
-		mesh->addTile(data, tileHeader.dataSize, DT_TILE_FREE_DATA, tileHeader.tileRef, 0);
+bool NeoAxis_TileMesh::loadNavMeshMapped(const char* fileName, NeoAxis_ThreadPool* threadPool)
+{
+	NeoAxis_MappedFile* file = new NeoAxis_MappedFile();
+	if (!file->open(fileName))
+	{
+		m_ctx->log(RC_LOG_ERROR, "loadNavMeshMapped: Could not map '%s'.", fileName);
+		delete file;
+		return false;
 	}
-	
+
+	// Detour writes the links into the tile data, only these pages of the tiles get copied.
+	dtNavMesh* mesh = createNavMesh(file->getData(), file->getSize(), true, threadPool);
+	if (!mesh)
+	{
+		m_ctx->log(RC_LOG_ERROR, "loadNavMeshMapped: Could not load navmesh from '%s'.", fileName);
+		delete file;
+		return false;
+	}
+
+	freeNavMesh();
 	m_navMesh = mesh;
+	m_mappedFile = file;
 
 	return true;
 }
 
-void NeoAxis_TileMesh::saveNavMesh(const dtNavMesh* mesh, void** outData, int* outDataSize)
+struct SaveTilesData
 {
-	*outData = NULL;
-	*outDataSize = 0;
+	const dtMeshTile** tiles;
+	NeoAxis_Compressor* compressor;
+	// Result, 0 for the tiles stored uncompressed.
+	unsigned char** compressed;
+	int* compressedSizes;
+	// Compression buffer of every worker.
+	unsigned char** workerBuffers;
+	int workerBufferSize;
+};
 
-	if (!mesh)
+static void compressTileTask(void* userData, int taskIndex, int workerIndex)
+{
+	SaveTilesData* save = (SaveTilesData*)userData;
+	const dtMeshTile* tile = save->tiles[taskIndex];
+	save->compressed[taskIndex] = 0;
+
+	unsigned char*& buffer = save->workerBuffers[workerIndex];
+	if (!buffer)
+		buffer = (unsigned char*)dtAlloc(save->workerBufferSize, DT_ALLOC_TEMP);
+	if (!buffer)
+		return;
+
+	int size = 0;
+	if (dtStatusFailed(save->compressor->compress(tile->data, tile->dataSize, buffer, save->workerBufferSize, &size)))
+		return;
+	if (size >= tile->dataSize)
 		return;
 
-	WriteBuffer buffer(16384);
+	unsigned char* compressed = (unsigned char*)dtAlloc(size, DT_ALLOC_TEMP);
+	if (!compressed)
+		return;
+	memcpy(compressed, buffer, size);
+	save->compressed[taskIndex] = compressed;
+	save->compressedSizes[taskIndex] = size;
+}
+
+bool NeoAxis_TileMesh::saveNavMesh(const dtNavMesh* mesh, WriteFunction write, void* userData, bool compress,
+	NeoAxis_ThreadPool* threadPool)
+{
+	if (!mesh)
+		return false;
 
-	// Store header.
 	NavMeshSetHeader header;
 	header.magic = NAVMESHSET_MAGIC;
 	header.version = NAVMESHSET_VERSION;
@@ -274,21 +560,124 @@ void NeoAxis_TileMesh::saveNavMesh(const dtNavMesh* mesh, void** outData, int* o
 		header.numTiles++;
 	}
 	memcpy(&header.params, mesh->getParams(), sizeof(dtNavMeshParams));
-	buffer.Write(&header, sizeof(NavMeshSetHeader));
+
+	const int tileCount = header.numTiles;
+	const dtMeshTile** tiles = new const dtMeshTile*[tileCount ? tileCount : 1];
+	int maxDataSize = 0;
+	for (int i = 0, n = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize)
+			continue;
+		tiles[n++] = tile;
+		maxDataSize = rcMax(maxDataSize, tile->dataSize);
+	}
+
+	// The tile index holds the stored sizes, so the tiles are compressed before anything is written.
+	NeoAxis_Compressor compressor;
+	SaveTilesData save;
+	save.tiles = tiles;
+	save.compressor = &compressor;
+	save.compressed = new unsigned char*[tileCount ? tileCount : 1];
+	save.compressedSizes = new int[tileCount ? tileCount : 1];
+	const int workerCount = threadPool ? threadPool->getThreadCount() : 1;
+	save.workerBuffers = new unsigned char*[workerCount];
+	save.workerBufferSize = compressor.maxCompressedSize(maxDataSize);
+	memset(save.compressed, 0, (tileCount ? tileCount : 1) * sizeof(unsigned char*));
+	memset(save.workerBuffers, 0, workerCount * sizeof(unsigned char*));
+	if (compress)
+	{
+		if (threadPool)
+			threadPool->run(compressTileTask, &save, tileCount);
+		else
+		{
+			for (int i = 0; i < tileCount; ++i)
+				compressTileTask(&save, i, 0);
+		}
+	}
+	for (int i = 0; i < workerCount; ++i)
+		dtFree(save.workerBuffers[i]);
+	delete[] save.workerBuffers;
+
+	// Lay out the tiles.
+	NavMeshTileIndex* index = new NavMeshTileIndex[tileCount ? tileCount : 1];
+	size_t position = sizeof(NavMeshSetHeader) + tileCount * sizeof(NavMeshTileIndex);
+	bool result = true;
+	for (int i = 0; i < tileCount; ++i)
+	{
+		NavMeshTileIndex& tileIndex = index[i];
+		tileIndex.tileRef = mesh->getTileRef(tiles[i]);
+		tileIndex.dataSize = tiles[i]->dataSize;
+		tileIndex.storedSize = save.compressed[i] ? save.compressedSizes[i] : tiles[i]->dataSize;
+
+		// Offsets are 32 bit.
+		if (position > (size_t)(0xffffffffu - NAVMESHSET_TILE_ALIGN - tileIndex.storedSize))
+		{
+			result = false;
+			break;
+		}
+		position = (position + NAVMESHSET_TILE_ALIGN - 1) & ~(size_t)(NAVMESHSET_TILE_ALIGN - 1);
+		tileIndex.dataOffset = (unsigned int)position;
+		position += tileIndex.storedSize;
+	}
+
+	if (result)
+		result = write(userData, &header, sizeof(NavMeshSetHeader));
+	if (result && tileCount)
+		result = write(userData, index, tileCount * sizeof(NavMeshTileIndex));
 
 	// Store tiles.
+	static const unsigned char padding[NAVMESHSET_TILE_ALIGN] = {0};
+	position = sizeof(NavMeshSetHeader) + tileCount * sizeof(NavMeshTileIndex);
+	for (int i = 0; i < tileCount && result; ++i)
+	{
+		const int paddingSize = (int)(index[i].dataOffset - position);
+		if (paddingSize)
+			result = write(userData, padding, paddingSize);
+		if (result)
+			result = write(userData, save.compressed[i] ? save.compressed[i] : tiles[i]->data, index[i].storedSize);
+		position = index[i].dataOffset + index[i].storedSize;
+	}
+
+	for (int i = 0; i < tileCount; ++i)
+		dtFree(save.compressed[i]);
+	delete[] save.compressed;
+	delete[] save.compressedSizes;
+	delete[] index;
+	delete[] tiles;
+
+	return result;
+}
+
+static bool writeToBuffer(void* userData, const void* data, int size)
+{
+	((WriteBuffer*)userData)->Write((void*)data, size);
+	return true;
+}
+
+void NeoAxis_TileMesh::saveNavMesh(const dtNavMesh* mesh, void** outData, int* outDataSize)
+{
+	*outData = NULL;
+	*outDataSize = 0;
+
+	if (!mesh)
+		return;
+
+	// Reserve the whole size, the buffer is never grown.
+	int capacity = sizeof(NavMeshSetHeader);
 	for (int i = 0; i < mesh->getMaxTiles(); ++i)
 	{
 		const dtMeshTile* tile = mesh->getTile(i);
 		if (!tile || !tile->header || !tile->dataSize)
 			continue;
+		capacity += sizeof(NavMeshTileIndex) + NAVMESHSET_TILE_ALIGN + tile->dataSize;
+	}
 
-		NavMeshTileHeader tileHeader;
-		tileHeader.tileRef = mesh->getTileRef(tile);
-		tileHeader.dataSize = tile->dataSize;
-		buffer.Write(&tileHeader, sizeof(tileHeader));
-
-		buffer.Write(tile->data, tile->dataSize);
+	WriteBuffer buffer(capacity);
+	if (!saveNavMesh(mesh, writeToBuffer, &buffer, false, 0))
+	{
+		free(buffer.buffer);
+		return;
 	}
 
 	*outData = buffer.buffer;
@@ -325,7 +714,8 @@ void NeoAxis_TileMesh::fixMinMaxCorners()
 	rcVcopy(m_bmax, truMax);
 }
 
-void NeoAxis_TileMesh::calculateSize()
+//layersPerTile is the expected number of navmesh tiles at a tile position, more than one for the tile cache.
+void NeoAxis_TileMesh::calculateSize(int layersPerTile)
 {
 	//!!!!!!when we set tileSize = 4, we can got "max tiles reached" error.
 
@@ -337,7 +727,7 @@ void NeoAxis_TileMesh::calculateSize()
 
 	// Max tiles and max polys affect how the tile IDs are caculated.
 	// There are 22 bits available for identifying a tile and a polygon.
-	int tileBits = rcMin((int)ilog2(nextPow2(tw*th)), 14);
+	int tileBits = rcMin((int)ilog2(nextPow2(tw*th*layersPerTile)), 14);
 	if (tileBits > 14) tileBits = 14;
 	int polyBits = 22 - tileBits;
 	m_maxTiles = 1 << tileBits;
@@ -357,7 +747,7 @@ void NeoAxis_TileMesh::getMaximums(int* maxTiles, int* maxPolysPerTile)
 
 bool NeoAxis_TileMesh::init()
 {
-	dtFreeNavMesh(m_navMesh);
+	freeNavMesh();
 	
 	m_navMesh = dtAllocNavMesh();
 	if (!m_navMesh)
@@ -411,18 +801,10 @@ void NeoAxis_TileMesh::buildTile(const float* pos)
 	m_ctx->resetLog();
 	
 	int dataSize = 0;
-	unsigned char* data = buildTileMesh(tx, ty, m_tileBmin, m_tileBmax, dataSize);
-	
+	unsigned char* data = buildTileMesh(tx, ty, m_tileBmin, m_tileBmax, dataSize, m_scratch);
+	addTileStats(m_scratch.stats);
 	if (data)
-	{
-		// Remove any previous data (navmesh owns and deletes the data).
-		m_navMesh->removeTile(m_navMesh->getTileRefAt(tx,ty,0),0,0);
-		
-		// Let the navmesh own the data.
-		dtStatus status = m_navMesh->addTile(data,dataSize,DT_TILE_FREE_DATA,0,0);
-		if (dtStatusFailed(status))
-			dtFree(data);
-	}
+		addTileData(tx, ty, data, dataSize);
 	
 	m_ctx->dumpLog("Build Tile (%d,%d):", tx,ty);
 }
@@ -446,16 +828,37 @@ void NeoAxis_TileMesh::removeTile(const float* pos)
 	m_navMesh->removeTile(m_navMesh->getTileRefAt(tx,ty,0),0,0);
 }
 
+void NeoAxis_TileMesh::getTileGridSize(int& tw, int& th)
+{
+	int gw = 0, gh = 0;
+	rcCalcGridSize(m_bmin, m_bmax, m_cellSize, &gw, &gh);
+	const int ts = (int)m_tileSize;
+	tw = (gw + ts-1) / ts;
+	th = (gh + ts-1) / ts;
+}
+
+bool NeoAxis_TileMesh::addTileData(const int tx, const int ty, unsigned char* data, const int dataSize)
+{
+	// Remove any previous data (navmesh owns and deletes the data).
+	m_navMesh->removeTile(m_navMesh->getTileRefAt(tx,ty,0),0,0);
+	// Let the navmesh own the data.
+	dtStatus status = m_navMesh->addTile(data,dataSize,DT_TILE_FREE_DATA,0,0);
+	if (dtStatusFailed(status))
+	{
+		dtFree(data);
+		if ((status & DT_OUT_OF_MEMORY) != 0)
+			return false;
+	}
+	return true;
+}
+
 void NeoAxis_TileMesh::buildAllTiles()
 {
 	if (!m_geom) return;
 	if (!m_navMesh) return;
 
-	int gw = 0, gh = 0;
-	rcCalcGridSize(m_bmin, m_bmax, m_cellSize, &gw, &gh);
-	const int ts = (int)m_tileSize;
-	const int tw = (gw + ts-1) / ts;
-	const int th = (gh + ts-1) / ts;
+	int tw = 0, th = 0;
+	getTileGridSize(tw, th);
 	const float tcs = m_tileSize*m_cellSize;
 
 	// Start the build process.
@@ -474,25 +877,14 @@ void NeoAxis_TileMesh::buildAllTiles()
 			m_tileBmax[2] = m_bmin[2] + (y+1)*tcs;
 			
 			int dataSize = 0;
-			unsigned char* data = buildTileMesh(x, y, m_tileBmin, m_tileBmax, dataSize);
-			if (data)
+			unsigned char* data = buildTileMesh(x, y, m_tileBmin, m_tileBmax, dataSize, m_scratch);
+			addTileStats(m_scratch.stats);
+			if (data && !addTileData(x, y, data, dataSize))
 			{
-				// Remove any previous data (navmesh owns and deletes the data).
-				m_navMesh->removeTile(m_navMesh->getTileRefAt(x,y,0),0,0);
-				// Let the navmesh own the data.
-				dtStatus status = m_navMesh->addTile(data,dataSize,DT_TILE_FREE_DATA,0,0);
-				if (dtStatusFailed(status))
-				{
-					dtFree(data);
-
-					//!!!!
-					//SodanKerjuu: stop calculating!!!
-					if ((status & DT_OUT_OF_MEMORY) != 0)
-					{
-						m_ctx->log(RC_LOG_ERROR, "Max tiles reached! Please increase TileSize, CellSize properties.");
-						return;
-					}
-				}
+				//!!!!
+				//SodanKerjuu: stop calculating!!!
+				m_ctx->log(RC_LOG_ERROR, "Max tiles reached! Please increase TileSize, CellSize properties.");
+				return;
 			}
 		}
 	}
@@ -504,298 +896,675 @@ void NeoAxis_TileMesh::buildAllTiles()
 	
 }
 
+struct ParallelTileBuild
+{
+	NeoAxis_TileMesh* tileMesh;
+	int minX;
+	int minY;
+	int tilesWidth;
+	BuildContext* contexts;
+	TileBuildScratch* scratches;
+	unsigned char** tileData;
+	int* tileDataSizes;
+	TileBuildStats* tileStats;
+};
+
+void NeoAxis_TileMesh::buildTileTask(void* userData, int taskIndex, int workerIndex)
+{
+	ParallelTileBuild* build = (ParallelTileBuild*)userData;
+	NeoAxis_TileMesh* tileMesh = build->tileMesh;
+
+	const int x = build->minX + taskIndex % build->tilesWidth;
+	const int y = build->minY + taskIndex / build->tilesWidth;
+	const float tcs = tileMesh->m_tileSize*tileMesh->m_cellSize;
+
+	float tileBmin[3], tileBmax[3];
+	tileBmin[0] = tileMesh->m_bmin[0] + x*tcs;
+	tileBmin[1] = tileMesh->m_bmin[1];
+	tileBmin[2] = tileMesh->m_bmin[2] + y*tcs;
+
+	tileBmax[0] = tileMesh->m_bmin[0] + (x+1)*tcs;
+	tileBmax[1] = tileMesh->m_bmax[1];
+	tileBmax[2] = tileMesh->m_bmin[2] + (y+1)*tcs;
+
+	int dataSize = 0;
+	build->tileData[taskIndex] = tileMesh->buildTileMesh(x, y, tileBmin, tileBmax, dataSize, 
+		build->scratches[workerIndex]);
+	build->tileDataSizes[taskIndex] = dataSize;
+	build->tileStats[taskIndex] = build->scratches[workerIndex].stats;
+}
+
+// Builds tiles on all threads of the pool. Only the Recast/Detour build runs concurrently, the tiles
+// are added to the navmesh afterwards in the same order as buildAllTiles() does, so tile refs and
+// the saved navmesh are identical to the serial build.
+void NeoAxis_TileMesh::buildAllTilesParallel(NeoAxis_ThreadPool* threadPool)
+{
+	if (!m_geom) return;
+	if (!m_navMesh) return;
+
+	int tw = 0, th = 0;
+	getTileGridSize(tw, th);
+	buildTilesParallel(threadPool, 0, 0, tw-1, th-1, false);
+}
+
+void NeoAxis_TileMesh::buildTilesParallel(NeoAxis_ThreadPool* threadPool, const int minX, const int minY, 
+	const int maxX, const int maxY, const bool removeEmptyTiles)
+{
+	const int tilesWidth = maxX - minX + 1;
+	const int tilesHeight = maxY - minY + 1;
+	if (tilesWidth <= 0 || tilesHeight <= 0)
+		return;
+	const int tileCount = tilesWidth * tilesHeight;
+
+	const int threadCount = threadPool->getThreadCount();
+
+	ParallelTileBuild build;
+	build.tileMesh = this;
+	build.minX = minX;
+	build.minY = minY;
+	build.tilesWidth = tilesWidth;
+	build.contexts = new BuildContext[threadCount];
+	build.scratches = new TileBuildScratch[threadCount];
+	build.tileData = new unsigned char*[tileCount];
+	build.tileDataSizes = new int[tileCount];
+	build.tileStats = new TileBuildStats[tileCount];
+	for (int i = 0; i < threadCount; ++i)
+		build.scratches[i].ctx = &build.contexts[i];
+
+	threadPool->run(buildTileTask, &build, tileCount);
+
+	// Scratch is not needed anymore, free it before the navmesh starts growing.
+	delete [] build.scratches;
+	delete [] build.contexts;
+
+	for (int i = 0; i < tileCount; ++i)
+		addTileStats(build.tileStats[i]);
+	delete [] build.tileStats;
+
+	bool maxTilesReached = false;
+	for (int i = 0; i < tileCount; ++i)
+	{
+		const int x = minX + i % tilesWidth;
+		const int y = minY + i / tilesWidth;
+		unsigned char* data = build.tileData[i];
+		if (!data)
+		{
+			// The geometry of the tile is gone.
+			if (removeEmptyTiles)
+				m_navMesh->removeTile(m_navMesh->getTileRefAt(x,y,0),0,0);
+			continue;
+		}
+		if (maxTilesReached)
+		{
+			dtFree(data);
+			continue;
+		}
+		if (!addTileData(x, y, data, build.tileDataSizes[i]))
+		{
+			//SodanKerjuu: stop calculating!!!
+			m_ctx->log(RC_LOG_ERROR, "Max tiles reached! Please increase TileSize, CellSize properties.");
+			maxTilesReached = true;
+		}
+	}
+
+	delete [] build.tileData;
+	delete [] build.tileDataSizes;
+}
+
+// Rebuilds the tiles which can be affected by geometry changes inside the bounds, tiles near the
+// bounds are included since the geometry within the border size of a tile is rasterized with it.
+void NeoAxis_TileMesh::rebuildTilesInBounds(const float* bmin, const float* bmax, NeoAxis_ThreadPool* threadPool)
+{
+	if (!m_geom) return;
+	if (!m_navMesh) return;
+	if (bmin[0] > bmax[0] || bmin[2] > bmax[2])
+		return;
+
+	int tw = 0, th = 0;
+	getTileGridSize(tw, th);
+	const float tcs = m_tileSize*m_cellSize;
+	const int borderSize = (int)ceilf(m_agentRadius / m_cellSize) + 3;
+	const float border = borderSize*m_cellSize;
+
+	const int minX = rcMax((int)floorf((bmin[0] - border - m_bmin[0]) / tcs), 0);
+	const int minY = rcMax((int)floorf((bmin[2] - border - m_bmin[2]) / tcs), 0);
+	const int maxX = rcMin((int)floorf((bmax[0] + border - m_bmin[0]) / tcs), tw-1);
+	const int maxY = rcMin((int)floorf((bmax[2] + border - m_bmin[2]) / tcs), th-1);
+
+	buildTilesParallel(threadPool, minX, minY, maxX, maxY, true);
+}
+
 void NeoAxis_TileMesh::removeAllTiles()
 {
-	int gw = 0, gh = 0;
-	rcCalcGridSize(m_bmin, m_bmax, m_cellSize, &gw, &gh);
-	const int ts = (int)m_tileSize;
-	const int tw = (gw + ts-1) / ts;
-	const int th = (gh + ts-1) / ts;
+	int tw = 0, th = 0;
+	getTileGridSize(tw, th);
 	
 	for (int y = 0; y < th; ++y)
 		for (int x = 0; x < tw; ++x)
 			m_navMesh->removeTile(m_navMesh->getTileRefAt(x,y,0),0,0);
 }
 
+void NeoAxis_TileMesh::addTileStats(const TileBuildStats& stats)
+{
+	// Tiles without input geometry are skipped by the build.
+	if (!stats.triangleCount)
+		return;
+
+	int tw = 0, th = 0;
+	getTileGridSize(tw, th);
+	if (stats.x < 0 || stats.y < 0 || stats.x >= tw || stats.y >= th)
+		return;
+
+	// The tile grid changes with the bounds, the old statistics do not belong to it.
+	if (!m_tileStats || tw != m_tileStatsWidth || th != m_tileStatsHeight)
+	{
+		delete [] m_tileStats;
+		m_tileStats = new TileBuildStats[tw*th];
+		m_tileStatsWidth = tw;
+		m_tileStatsHeight = th;
+		resetBuildStats();
+	}
+
+	m_tileStats[stats.y*m_tileStatsWidth + stats.x] = stats;
+}
+
+void NeoAxis_TileMesh::resetBuildStats()
+{
+	const int count = m_tileStatsWidth*m_tileStatsHeight;
+	for (int i = 0; i < count; ++i)
+	{
+		memset(&m_tileStats[i], 0, sizeof(TileBuildStats));
+		m_tileStats[i].buildTime = -1;
+	}
+}
+
+int NeoAxis_TileMesh::getBuildStats(float* totalBuildTime, float* stageTimes, int* triangleCount, int* dataSize, 
+	TileBuildStats* slowestTiles, int maxSlowestTiles, int* slowestTileCount)
+{
+	*totalBuildTime = 0;
+	for (int i = 0; i < RC_MAX_TIMERS; ++i)
+		stageTimes[i] = 0;
+	*triangleCount = 0;
+	*dataSize = 0;
+	*slowestTileCount = 0;
+
+	int tileCount = 0;
+	const int count = m_tileStatsWidth*m_tileStatsHeight;
+	for (int i = 0; i < count; ++i)
+	{
+		const TileBuildStats& stats = m_tileStats[i];
+		if (stats.buildTime < 0)
+			continue;
+
+		tileCount++;
+		*totalBuildTime += stats.buildTime;
+		for (int j = 0; j < RC_MAX_TIMERS; ++j)
+			stageTimes[j] += stats.stageTimes[j];
+		*triangleCount += stats.triangleCount;
+		*dataSize += stats.dataSize;
+
+		// Insert into the slowest tiles, which are sorted by decreasing build time. Equal times keep 
+		// the tile order, so the result does not depend on the build threads.
+		int n = *slowestTileCount;
+		if (n == maxSlowestTiles && (!n || slowestTiles[n-1].buildTime >= stats.buildTime))
+			continue;
+		if (n < maxSlowestTiles)
+			n++;
+		int j = n-1;
+		for (; j > 0 && slowestTiles[j-1].buildTime < stats.buildTime; --j)
+			slowestTiles[j] = slowestTiles[j-1];
+		slowestTiles[j] = stats;
+		*slowestTileCount = n;
+	}
+
+	return tileCount;
+}
+
+static bool heightfieldsEqual(const rcHeightfield& a, const rcHeightfield& b)
+{
+	if (a.width != b.width || a.height != b.height)
+		return false;
+	for (int i = 0; i < a.width*a.height; ++i)
+	{
+		const rcSpan* sa = a.spans[i];
+		const rcSpan* sb = b.spans[i];
+		for (; sa && sb; sa = sa->next, sb = sb->next)
+		{
+			if (sa->smin != sb->smin || sa->smax != sb->smax || sa->area != sb->area)
+				return false;
+		}
+		if (sa || sb)
+			return false;
+	}
+	return true;
+}
+
+bool NeoAxis_TileMesh::benchmarkRasterization(int iterations, float* scalarTime, float* simdTime, bool* identical)
+{
+	*scalarTime = 0;
+	*simdTime = 0;
+	*identical = true;
+	if (!m_geom || !m_geom->getMesh() || !m_geom->getChunkyMesh())
+		return false;
+
+	const bool simdEnabled = rcGetSimdRasterization();
+	const bool simdAvailable = rcSetSimdRasterization(true);
+
+	const float* verts = m_geom->getMesh()->getVerts();
+	const int nverts = m_geom->getMesh()->getVertCount();
+	const rcChunkyTriMesh* chunkyMesh = m_geom->getChunkyMesh();
+
+	int tw = 0, th = 0;
+	getTileGridSize(tw, th);
+	const float tcs = m_tileSize*m_cellSize;
+
+	// The rasterization timer of each context only gets the time of its path.
+	BuildContext contexts[2];
+	rcHeightfield* solids[2] = { 0, 0 };
+	unsigned char* triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
+	rcChunkIdList chunkIds;
+
+	for (int y = 0; y < th; ++y)
+	{
+		for (int x = 0; x < tw; ++x)
+		{
+			float bmin[3], bmax[3];
+			bmin[0] = m_bmin[0] + x*tcs;
+			bmin[1] = m_bmin[1];
+			bmin[2] = m_bmin[2] + y*tcs;
+			bmax[0] = m_bmin[0] + (x+1)*tcs;
+			bmax[1] = m_bmax[1];
+			bmax[2] = m_bmin[2] + (y+1)*tcs;
+
+			rcConfig cfg;
+			initTileConfig(cfg, bmin, bmax);
+
+			float tbmin[2], tbmax[2];
+			tbmin[0] = cfg.bmin[0];
+			tbmin[1] = cfg.bmin[2];
+			tbmax[0] = cfg.bmax[0];
+			tbmax[1] = cfg.bmax[2];
+			const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, chunkIds);
+			if (!ncid)
+				continue;
+			const int* cid = chunkIds.ids;
+
+			for (int path = 0; path < 2; ++path)
+			{
+				rcSetSimdRasterization(path == 1);
+				for (int iteration = 0; iteration < iterations; ++iteration)
+				{
+					rcFreeHeightField(solids[path]);
+					solids[path] = rcAllocHeightfield();
+					if (!solids[path] || !rcCreateHeightfield(&contexts[path], *solids[path], cfg.width, cfg.height, 
+						cfg.bmin, cfg.bmax, cfg.cs, cfg.ch))
+					{
+						rcFreeHeightField(solids[0]);
+						rcFreeHeightField(solids[1]);
+						delete [] triareas;
+						rcSetSimdRasterization(simdEnabled);
+						return false;
+					}
+
+					for (int i = 0; i < ncid; ++i)
+					{
+						const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
+						const int* tris = &chunkyMesh->tris[node.i*3];
+						const int ntris = node.n;
+
+						memset(triareas, 0, ntris*sizeof(unsigned char));
+						rcMarkWalkableTriangles(&contexts[path], cfg.walkableSlopeAngle, verts, nverts, tris, ntris, 
+							triareas);
+						rcRasterizeTriangles(&contexts[path], verts, nverts, tris, triareas, ntris, *solids[path], 
+							cfg.walkableClimb);
+					}
+				}
+			}
+
+			if (!heightfieldsEqual(*solids[0], *solids[1]))
+				*identical = false;
+		}
+	}
+
+	rcFreeHeightField(solids[0]);
+	rcFreeHeightField(solids[1]);
+	delete [] triareas;
+	rcSetSimdRasterization(simdEnabled);
+
+	*scalarTime = rcMax(contexts[0].getAccumulatedTime(RC_TIMER_RASTERIZE_TRIANGLES), 0)/1000.0f;
+	*simdTime = rcMax(contexts[1].getAccumulatedTime(RC_TIMER_RASTERIZE_TRIANGLES), 0)/1000.0f;
+	return simdAvailable;
+}
+
+// Build configuration of the tile with the given bounds, the bounds are expanded by the border size.
+void NeoAxis_TileMesh::initTileConfig(rcConfig& cfg, const float* bmin, const float* bmax)
+{
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.cs = m_cellSize;
+	cfg.ch = m_cellHeight;
+	cfg.walkableSlopeAngle = m_agentMaxSlope;
+	cfg.walkableHeight = (int)ceilf(m_agentHeight / cfg.ch);
+	cfg.walkableClimb = (int)floorf(m_agentMaxClimb / cfg.ch);
+	cfg.walkableRadius = (int)ceilf(m_agentRadius / cfg.cs);
+	cfg.maxEdgeLen = (int)(m_edgeMaxLen / m_cellSize);
+	cfg.maxSimplificationError = m_edgeMaxError;
+	cfg.minRegionArea = (int)rcSqr(m_regionMinSize);		// Note: area = size*size
+	cfg.mergeRegionArea = (int)rcSqr(m_regionMergeSize);	// Note: area = size*size
+	cfg.maxVertsPerPoly = (int)m_vertsPerPoly;
+	cfg.tileSize = (int)m_tileSize;
+	cfg.borderSize = cfg.walkableRadius + 3; // Reserve enough padding.
+	cfg.width = cfg.tileSize + cfg.borderSize*2;
+	cfg.height = cfg.tileSize + cfg.borderSize*2;
+	cfg.detailSampleDist = m_detailSampleDist < 0.9f ? 0 : m_cellSize * m_detailSampleDist;
+	cfg.detailSampleMaxError = m_cellHeight * m_detailSampleMaxError;
+	
+	rcVcopy(cfg.bmin, bmin);
+	rcVcopy(cfg.bmax, bmax);
+	cfg.bmin[0] -= cfg.borderSize*cfg.cs;
+	cfg.bmin[2] -= cfg.borderSize*cfg.cs;
+	cfg.bmax[0] += cfg.borderSize*cfg.cs;
+	cfg.bmax[2] += cfg.borderSize*cfg.cs;
+}
+
 unsigned char* NeoAxis_TileMesh::buildTileMesh(const int tx, const int ty, const float* bmin, 
-	const float* bmax, int& dataSize)
+	const float* bmax, int& dataSize, TileBuildScratch& scratch)
+{
+	memset(&scratch.stats, 0, sizeof(scratch.stats));
+	scratch.stats.x = tx;
+	scratch.stats.y = ty;
+
+	// Intermediate results of the previous tile live in the arena.
+	scratch.cleanup();
+	scratch.arena.reset();
+	
+	// Reset build times gathering.
+	scratch.ctx->resetTimers();
+	
+	// Start the build process.
+	scratch.ctx->startTimer(RC_TIMER_TOTAL);
+
+	dataSize = 0;
+	unsigned char* data;
+	{
+		NeoAxis_BuildArena::Scope arenaScope(&scratch.arena);
+		data = buildTileMeshData(tx, ty, bmin, bmax, dataSize, scratch);
+	}
+
+	scratch.ctx->stopTimer(RC_TIMER_TOTAL);
+
+	scratch.stats.dataSize = dataSize;
+	for (int i = 0; i < RC_MAX_TIMERS; ++i)
+	{
+		// Stages which did not run are -1.
+		const int time = scratch.ctx->getAccumulatedTime((rcTimerLabel)i);
+		scratch.stats.stageTimes[i] = time > 0 ? time/1000.0f : 0.0f;
+	}
+	scratch.stats.buildTime = scratch.stats.stageTimes[RC_TIMER_TOTAL];
+
+	return data;
+}
+
+// Size of the spans and the span pools of the heightfield.
+static int getHeightfieldMemory(const rcHeightfield& hf)
+{
+	int size = hf.width*hf.height*sizeof(rcSpan*);
+	for (const rcSpanPool* pool = hf.pools; pool; pool = pool->next)
+		size += sizeof(rcSpanPool);
+	return size;
+}
+
+static int getCompactHeightfieldMemory(const rcCompactHeightfield& chf)
+{
+	return chf.width*chf.height*sizeof(rcCompactCell) + chf.spanCount*(sizeof(rcCompactSpan) + 
+		sizeof(unsigned short) + sizeof(unsigned char));
+}
+
+unsigned char* NeoAxis_TileMesh::buildTileMeshData(const int tx, const int ty, const float* bmin, 
+	const float* bmax, int& dataSize, TileBuildScratch& scratch)
 {
 	if (!m_geom || !m_geom->getMesh() || !m_geom->getChunkyMesh())
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Input mesh is not specified.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Input mesh is not specified.");
 		return 0;
 	}
 	
-	m_tileMemUsage = 0;
-	m_tileBuildTime = 0;
-	
-	cleanup();
+	scratch.cleanup();
 	
 	const float* verts = m_geom->getMesh()->getVerts();
 	const int nverts = m_geom->getMesh()->getVertCount();
 	const int ntris = m_geom->getMesh()->getTriCount();
 	const rcChunkyTriMesh* chunkyMesh = m_geom->getChunkyMesh();
 	
-	// Init build configuration from GUI
-	memset(&m_cfg, 0, sizeof(m_cfg));
-	m_cfg.cs = m_cellSize;
-	m_cfg.ch = m_cellHeight;
-	m_cfg.walkableSlopeAngle = m_agentMaxSlope;
-	m_cfg.walkableHeight = (int)ceilf(m_agentHeight / m_cfg.ch);
-	m_cfg.walkableClimb = (int)floorf(m_agentMaxClimb / m_cfg.ch);
-	m_cfg.walkableRadius = (int)ceilf(m_agentRadius / m_cfg.cs);
-	m_cfg.maxEdgeLen = (int)(m_edgeMaxLen / m_cellSize);
-	m_cfg.maxSimplificationError = m_edgeMaxError;
-	m_cfg.minRegionArea = (int)rcSqr(m_regionMinSize);		// Note: area = size*size
-	m_cfg.mergeRegionArea = (int)rcSqr(m_regionMergeSize);	// Note: area = size*size
-	m_cfg.maxVertsPerPoly = (int)m_vertsPerPoly;
-	m_cfg.tileSize = (int)m_tileSize;
-	m_cfg.borderSize = m_cfg.walkableRadius + 3; // Reserve enough padding.
-	m_cfg.width = m_cfg.tileSize + m_cfg.borderSize*2;
-	m_cfg.height = m_cfg.tileSize + m_cfg.borderSize*2;
-	m_cfg.detailSampleDist = m_detailSampleDist < 0.9f ? 0 : m_cellSize * m_detailSampleDist;
-	m_cfg.detailSampleMaxError = m_cellHeight * m_detailSampleMaxError;
-	
-	rcVcopy(m_cfg.bmin, bmin);
-	rcVcopy(m_cfg.bmax, bmax);
-	m_cfg.bmin[0] -= m_cfg.borderSize*m_cfg.cs;
-	m_cfg.bmin[2] -= m_cfg.borderSize*m_cfg.cs;
-	m_cfg.bmax[0] += m_cfg.borderSize*m_cfg.cs;
-	m_cfg.bmax[2] += m_cfg.borderSize*m_cfg.cs;
-	
-	// Reset build times gathering.
-	//m_ctx->resetTimers();
-	
-	// Start the build process.
-	//m_ctx->startTimer(RC_TIMER_TOTAL);
+	initTileConfig(scratch.cfg, bmin, bmax);
 	
-	m_ctx->log(RC_LOG_PROGRESS, "Building navigation:");
-	m_ctx->log(RC_LOG_PROGRESS, " - %d x %d cells", m_cfg.width, m_cfg.height);
-	m_ctx->log(RC_LOG_PROGRESS, " - %.1fK verts, %.1fK tris", nverts/1000.0f, ntris/1000.0f);
+	scratch.ctx->log(RC_LOG_PROGRESS, "Building navigation:");
+	scratch.ctx->log(RC_LOG_PROGRESS, " - %d x %d cells", scratch.cfg.width, scratch.cfg.height);
+	scratch.ctx->log(RC_LOG_PROGRESS, " - %.1fK verts, %.1fK tris", nverts/1000.0f, ntris/1000.0f);
 	
 	// Allocate voxel heightfield where we rasterize our input data to.
-	m_solid = rcAllocHeightfield();
-	if (!m_solid)
+	scratch.solid = rcAllocHeightfield();
+	if (!scratch.solid)
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'solid'.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'solid'.");
 		return 0;
 	}
-	if (!rcCreateHeightfield(m_ctx, *m_solid, m_cfg.width, m_cfg.height, m_cfg.bmin, m_cfg.bmax, m_cfg.cs, m_cfg.ch))
+	if (!rcCreateHeightfield(scratch.ctx, *scratch.solid, scratch.cfg.width, scratch.cfg.height, scratch.cfg.bmin, scratch.cfg.bmax, scratch.cfg.cs, scratch.cfg.ch))
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not create solid heightfield.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Could not create solid heightfield.");
 		return 0;
 	}
 	
 	// Allocate array that can hold triangle flags.
 	// If you have multiple meshes you need to process, allocate
 	// and array which can hold the max number of triangles you need to process.
-	m_triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
-	if (!m_triareas)
+	scratch.triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
+	if (!scratch.triareas)
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", chunkyMesh->maxTrisPerChunk);
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'triareas' (%d).", chunkyMesh->maxTrisPerChunk);
 		return 0;
 	}
 	
 	float tbmin[2], tbmax[2];
-	tbmin[0] = m_cfg.bmin[0];
-	tbmin[1] = m_cfg.bmin[2];
-	tbmax[0] = m_cfg.bmax[0];
-	tbmax[1] = m_cfg.bmax[2];
-	int cid[512];// TODO: Make grow when returning too many items.
-
-	const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
+	tbmin[0] = scratch.cfg.bmin[0];
+	tbmin[1] = scratch.cfg.bmin[2];
+	tbmax[0] = scratch.cfg.bmax[0];
+	tbmax[1] = scratch.cfg.bmax[2];
+	const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, scratch.chunkIds);
 	if (!ncid)
 		return 0;
+	const int* cid = scratch.chunkIds.ids;
 
-	m_tileTriCount = 0;
-	
 	for (int i = 0; i < ncid; ++i)
 	{
 		const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
 		const int* tris = &chunkyMesh->tris[node.i*3];
 		const int ntris = node.n;
 		
-		m_tileTriCount += ntris;
+		scratch.stats.triangleCount += ntris;
 		
-		memset(m_triareas, 0, ntris*sizeof(unsigned char));
-		rcMarkWalkableTriangles(m_ctx, m_cfg.walkableSlopeAngle, verts, nverts, tris, ntris, m_triareas);
+		memset(scratch.triareas, 0, ntris*sizeof(unsigned char));
+		rcMarkWalkableTriangles(scratch.ctx, scratch.cfg.walkableSlopeAngle, verts, nverts, tris, ntris, scratch.triareas);
 		
-		rcRasterizeTriangles(m_ctx, verts, nverts, tris, m_triareas, ntris, *m_solid, m_cfg.walkableClimb);
+		rcRasterizeTriangles(scratch.ctx, verts, nverts, tris, scratch.triareas, ntris, *scratch.solid, scratch.cfg.walkableClimb);
 	}
 	
+	scratch.stats.heightfieldMemory = getHeightfieldMemory(*scratch.solid);
+	
 	if (!m_keepInterResults)
 	{
-		delete [] m_triareas;
-		m_triareas = 0;
+		delete [] scratch.triareas;
+		scratch.triareas = 0;
 	}
 	
 	// Once all geometry is rasterized, we do initial pass of filtering to
 	// remove unwanted overhangs caused by the conservative rasterization
 	// as well as filter spans where the character cannot possibly stand.
-	rcFilterLowHangingWalkableObstacles(m_ctx, m_cfg.walkableClimb, *m_solid);
-	rcFilterLedgeSpans(m_ctx, m_cfg.walkableHeight, m_cfg.walkableClimb, *m_solid);
-	rcFilterWalkableLowHeightSpans(m_ctx, m_cfg.walkableHeight, *m_solid);
+	rcFilterLowHangingWalkableObstacles(scratch.ctx, scratch.cfg.walkableClimb, *scratch.solid);
+	rcFilterLedgeSpans(scratch.ctx, scratch.cfg.walkableHeight, scratch.cfg.walkableClimb, *scratch.solid);
+	rcFilterWalkableLowHeightSpans(scratch.ctx, scratch.cfg.walkableHeight, *scratch.solid);
 	
 	// Compact the heightfield so that it is faster to handle from now on.
 	// This will result more cache coherent data as well as the neighbours
 	// between walkable cells will be calculated.
-	m_chf = rcAllocCompactHeightfield();
-	if (!m_chf)
+	scratch.chf = rcAllocCompactHeightfield();
+	if (!scratch.chf)
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'chf'.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'chf'.");
 		return 0;
 	}
-	if (!rcBuildCompactHeightfield(m_ctx, m_cfg.walkableHeight, m_cfg.walkableClimb, *m_solid, *m_chf))
+	if (!rcBuildCompactHeightfield(scratch.ctx, scratch.cfg.walkableHeight, scratch.cfg.walkableClimb, *scratch.solid, *scratch.chf))
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build compact data.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build compact data.");
 		return 0;
 	}
+	scratch.stats.heightfieldMemory += getCompactHeightfieldMemory(*scratch.chf);
 	
 	if (!m_keepInterResults)
 	{
-		rcFreeHeightField(m_solid);
-		m_solid = 0;
+		rcFreeHeightField(scratch.solid);
+		scratch.solid = 0;
 	}
 
 	// Erode the walkable area by agent radius.
-	if (!rcErodeWalkableArea(m_ctx, m_cfg.walkableRadius, *m_chf))
+	if (!rcErodeWalkableArea(scratch.ctx, scratch.cfg.walkableRadius, *scratch.chf))
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not erode.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Could not erode.");
 		return 0;
 	}
 
 	// (Optional) Mark areas.
 	const ConvexVolume* vols = m_geom->getConvexVolumes();
 	for (int i  = 0; i < m_geom->getConvexVolumeCount(); ++i)
-		rcMarkConvexPolyArea(m_ctx, vols[i].verts, vols[i].nverts, vols[i].hmin, vols[i].hmax, (unsigned char)vols[i].area, *m_chf);
+		rcMarkConvexPolyArea(scratch.ctx, vols[i].verts, vols[i].nverts, vols[i].hmin, vols[i].hmax, (unsigned char)vols[i].area, *scratch.chf);
 	
 	if (m_monotonePartitioning)
 	{
 		// Partition the walkable surface into simple regions without holes.
-		if (!rcBuildRegionsMonotone(m_ctx, *m_chf, m_cfg.borderSize, m_cfg.minRegionArea, m_cfg.mergeRegionArea))
+		if (!rcBuildRegionsMonotone(scratch.ctx, *scratch.chf, scratch.cfg.borderSize, scratch.cfg.minRegionArea, scratch.cfg.mergeRegionArea))
 		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build regions.");
+			scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build regions.");
 			return 0;
 		}
 	}
 	else
 	{
 		// Prepare for region partitioning, by calculating distance field along the walkable surface.
-		if (!rcBuildDistanceField(m_ctx, *m_chf))
+		if (!rcBuildDistanceField(scratch.ctx, *scratch.chf))
 		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build distance field.");
+			scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build distance field.");
 			return 0;
 		}
 		
 		// Partition the walkable surface into simple regions without holes.
-		if (!rcBuildRegions(m_ctx, *m_chf, m_cfg.borderSize, m_cfg.minRegionArea, m_cfg.mergeRegionArea))
+		if (!rcBuildRegions(scratch.ctx, *scratch.chf, scratch.cfg.borderSize, scratch.cfg.minRegionArea, scratch.cfg.mergeRegionArea))
 		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build regions.");
+			scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build regions.");
 			return 0;
 		}
 	}
  	
 	// Create contours.
-	m_cset = rcAllocContourSet();
-	if (!m_cset)
+	scratch.cset = rcAllocContourSet();
+	if (!scratch.cset)
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'cset'.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'cset'.");
 		return 0;
 	}
-	if (!rcBuildContours(m_ctx, *m_chf, m_cfg.maxSimplificationError, m_cfg.maxEdgeLen, *m_cset))
+	if (!rcBuildContours(scratch.ctx, *scratch.chf, scratch.cfg.maxSimplificationError, scratch.cfg.maxEdgeLen, *scratch.cset))
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not create contours.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Could not create contours.");
 		return 0;
 	}
 	
-	if (m_cset->nconts == 0)
+	if (scratch.cset->nconts == 0)
 	{
 		return 0;
 	}
 	
 	// Build polygon navmesh from the contours.
-	m_pmesh = rcAllocPolyMesh();
-	if (!m_pmesh)
+	scratch.pmesh = rcAllocPolyMesh();
+	if (!scratch.pmesh)
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'pmesh'.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'pmesh'.");
 		return 0;
 	}
-	if (!rcBuildPolyMesh(m_ctx, *m_cset, m_cfg.maxVertsPerPoly, *m_pmesh))
+	if (!rcBuildPolyMesh(scratch.ctx, *scratch.cset, scratch.cfg.maxVertsPerPoly, *scratch.pmesh))
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not triangulate contours.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Could not triangulate contours.");
 		return 0;
 	}
+	scratch.stats.polygonCount = scratch.pmesh->npolys;
 	
 	// Build detail mesh.
-	m_dmesh = rcAllocPolyMeshDetail();
-	if (!m_dmesh)
+	scratch.dmesh = rcAllocPolyMeshDetail();
+	if (!scratch.dmesh)
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'dmesh'.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'dmesh'.");
 		return 0;
 	}
 	
-	if (!rcBuildPolyMeshDetail(m_ctx, *m_pmesh, *m_chf,
-							   m_cfg.detailSampleDist, m_cfg.detailSampleMaxError,
-							   *m_dmesh))
+	if (!rcBuildPolyMeshDetail(scratch.ctx, *scratch.pmesh, *scratch.chf,
+							   scratch.cfg.detailSampleDist, scratch.cfg.detailSampleMaxError,
+							   *scratch.dmesh))
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could build polymesh detail.");
+		scratch.ctx->log(RC_LOG_ERROR, "buildNavigation: Could build polymesh detail.");
 		return 0;
 	}
 	
 	if (!m_keepInterResults)
 	{
-		rcFreeCompactHeightfield(m_chf);
-		m_chf = 0;
-		rcFreeContourSet(m_cset);
-		m_cset = 0;
+		rcFreeCompactHeightfield(scratch.chf);
+		scratch.chf = 0;
+		rcFreeContourSet(scratch.cset);
+		scratch.cset = 0;
 	}
 	
 	unsigned char* navData = 0;
 	int navDataSize = 0;
-	if (m_cfg.maxVertsPerPoly <= DT_VERTS_PER_POLYGON)
+	if (scratch.cfg.maxVertsPerPoly <= DT_VERTS_PER_POLYGON)
 	{
-		if (m_pmesh->nverts >= 0xffff)
+		if (scratch.pmesh->nverts >= 0xffff)
 		{
 			// The vertex indices are ushorts, and cannot point to more than 0xffff vertices.
-			m_ctx->log(RC_LOG_ERROR, "Too many vertices per tile %d (max: %d).", m_pmesh->nverts, 0xffff);
+			scratch.ctx->log(RC_LOG_ERROR, "Too many vertices per tile %d (max: %d).", scratch.pmesh->nverts, 0xffff);
 			return false;
 		}
 		
 		// Update poly flags from areas.
-		for (int i = 0; i < m_pmesh->npolys; ++i)
+		for (int i = 0; i < scratch.pmesh->npolys; ++i)
 		{
-			if (m_pmesh->areas[i] == RC_WALKABLE_AREA)
-				m_pmesh->areas[i] = POLYAREA_GROUND;
+			if (scratch.pmesh->areas[i] == RC_WALKABLE_AREA)
+				scratch.pmesh->areas[i] = POLYAREA_GROUND;
 			
-			if (m_pmesh->areas[i] == POLYAREA_GROUND ||
-				m_pmesh->areas[i] == POLYAREA_ROAD)
+			if (scratch.pmesh->areas[i] == POLYAREA_GROUND ||
+				scratch.pmesh->areas[i] == POLYAREA_ROAD)
 			{
-				m_pmesh->flags[i] = POLYFLAGS_WALK;
+				scratch.pmesh->flags[i] = POLYFLAGS_WALK;
 			}
-			else if (m_pmesh->areas[i] == POLYAREA_WATER)
+			else if (scratch.pmesh->areas[i] == POLYAREA_WATER)
 			{
-				m_pmesh->flags[i] = POLYFLAGS_SWIM;
+				scratch.pmesh->flags[i] = POLYFLAGS_SWIM;
 			}
-			else if (m_pmesh->areas[i] == POLYAREA_DOOR)
+			else if (scratch.pmesh->areas[i] == POLYAREA_DOOR)
 			{
-				m_pmesh->flags[i] = POLYFLAGS_WALK | POLYFLAGS_DOOR;
+				scratch.pmesh->flags[i] = POLYFLAGS_WALK | POLYFLAGS_DOOR;
 			}
 		}
 		
 		dtNavMeshCreateParams params;
 		memset(&params, 0, sizeof(params));
-		params.verts = m_pmesh->verts;
-		params.vertCount = m_pmesh->nverts;
-		params.polys = m_pmesh->polys;
-		params.polyAreas = m_pmesh->areas;
-		params.polyFlags = m_pmesh->flags;
-		params.polyCount = m_pmesh->npolys;
-		params.nvp = m_pmesh->nvp;
-		params.detailMeshes = m_dmesh->meshes;
-		params.detailVerts = m_dmesh->verts;
-		params.detailVertsCount = m_dmesh->nverts;
-		params.detailTris = m_dmesh->tris;
-		params.detailTriCount = m_dmesh->ntris;
+		params.verts = scratch.pmesh->verts;
+		params.vertCount = scratch.pmesh->nverts;
+		params.polys = scratch.pmesh->polys;
+		params.polyAreas = scratch.pmesh->areas;
+		params.polyFlags = scratch.pmesh->flags;
+		params.polyCount = scratch.pmesh->npolys;
+		params.nvp = scratch.pmesh->nvp;
+		params.detailMeshes = scratch.dmesh->meshes;
+		params.detailVerts = scratch.dmesh->verts;
+		params.detailVertsCount = scratch.dmesh->nverts;
+		params.detailTris = scratch.dmesh->tris;
+		params.detailTriCount = scratch.dmesh->ntris;
 		params.offMeshConVerts = m_geom->getOffMeshConnectionVerts();
 		params.offMeshConRad = m_geom->getOffMeshConnectionRads();
 		params.offMeshConDir = m_geom->getOffMeshConnectionDirs();
@@ -809,27 +1578,20 @@ unsigned char* NeoAxis_TileMesh::buildTileMesh(const int tx, const int ty, const
 		params.tileX = tx;
 		params.tileY = ty;
 		params.tileLayer = 0;
-		rcVcopy(params.bmin, m_pmesh->bmin);
-		rcVcopy(params.bmax, m_pmesh->bmax);
-		params.cs = m_cfg.cs;
-		params.ch = m_cfg.ch;
+		rcVcopy(params.bmin, scratch.pmesh->bmin);
+		rcVcopy(params.bmax, scratch.pmesh->bmax);
+		params.cs = scratch.cfg.cs;
+		params.ch = scratch.cfg.ch;
 		params.buildBvTree = true;
 		
 		if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
 		{
-			m_ctx->log(RC_LOG_ERROR, "Could not build Detour navmesh.");
+			scratch.ctx->log(RC_LOG_ERROR, "Could not build Detour navmesh.");
 			return 0;
 		}		
 	}
-	m_tileMemUsage = navDataSize/1024.0f;
-	
-	//m_ctx->stopTimer(RC_TIMER_TOTAL);
-	
-	// Show performance stats.
-	//duLogBuildTimes(*m_ctx, m_ctx->getAccumulatedTime(RC_TIMER_TOTAL));
-	m_ctx->log(RC_LOG_PROGRESS, ">> Polymesh: %d vertices  %d polygons", m_pmesh->nverts, m_pmesh->npolys);
 	
-	//m_tileBuildTime = m_ctx->getAccumulatedTime(RC_TIMER_TOTAL)/1000.0f;
+	scratch.ctx->log(RC_LOG_PROGRESS, ">> Polymesh: %d vertices  %d polygons", scratch.pmesh->nverts, scratch.pmesh->npolys);
 
 	dataSize = navDataSize;
 	return navData;
@@ -9,6 +9,52 @@
 #include "DetourNavMesh.h"
 #include "Recast.h"
 #include "ChunkyTriMesh.h"
+#include "NeoAxis_BuildArena.h"
+
+class NeoAxis_ThreadPool;
+
+/// Statistics of the last build of a tile. Times are in milliseconds, sizes in bytes.
+struct TileBuildStats
+{
+	int x;
+	int y;
+	float buildTime;
+	/// Input triangles rasterized into the tile.
+	int triangleCount;
+	int polygonCount;
+	/// Size of the navmesh tile data.
+	int dataSize;
+	/// Memory of the solid and the compact heightfield, the largest intermediate results.
+	int heightfieldMemory;
+	/// Accumulated time of every rcTimerLabel stage.
+	float stageTimes[RC_MAX_TIMERS];
+};
+
+/// Intermediate results of a single tile build. Every thread that builds tiles needs its own.
+struct TileBuildScratch
+{
+	rcContext* ctx;
+
+	unsigned char* triareas;
+	/// Chunks of the input mesh overlapping the tile, kept between the tiles.
+	rcChunkIdList chunkIds;
+	rcHeightfield* solid;
+	rcCompactHeightfield* chf;
+	rcContourSet* cset;
+	rcPolyMesh* pmesh;
+	rcPolyMeshDetail* dmesh;
+	rcHeightfieldLayerSet* lset;
+	rcConfig cfg;
+
+	/// Serves the Recast allocations of the build, it is reset at the start of every tile.
+	NeoAxis_BuildArena arena;
+
+	TileBuildStats stats;
+
+	TileBuildScratch();
+	~TileBuildScratch();
+	void cleanup();
+};
 
 class NeoAxis_TileMesh
 {
@@ -16,50 +62,89 @@ protected:
 	bool m_keepInterResults;
 	bool m_buildAll;
 
-	unsigned char* m_triareas;
-	rcHeightfield* m_solid;
-	rcCompactHeightfield* m_chf;
-	rcContourSet* m_cset;
-	rcPolyMesh* m_pmesh;
-	rcPolyMeshDetail* m_dmesh;
-	rcConfig m_cfg;	
+	TileBuildScratch m_scratch;
 	
 	int m_maxTiles;
 	int m_maxPolysPerTile;
 	
 	float m_tileBmin[3];
 	float m_tileBmax[3];
-	float m_tileBuildTime;
-	float m_tileMemUsage;//in floats in MB?!
-	int m_tileTriCount;
 
-	unsigned char* buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize);
+	/// Builds the tile and fills the statistics of the scratch.
+	unsigned char* buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize,
+		TileBuildScratch& scratch);
+	unsigned char* buildTileMeshData(const int tx, const int ty, const float* bmin, const float* bmax, 
+		int& dataSize, TileBuildScratch& scratch);
+	bool addTileData(const int tx, const int ty, unsigned char* data, const int dataSize);
+
+	static void buildTileTask(void* userData, int taskIndex, int workerIndex);
+
+	/// Statistics of every built tile position, indexed by y*tilesWidth+x. buildTime is negative 
+	/// for tiles not built since the last reset.
+	TileBuildStats* m_tileStats;
+	int m_tileStatsWidth;
+	int m_tileStatsHeight;
+	void addTileStats(const TileBuildStats& stats);
+
+	class NeoAxis_MappedFile* m_mappedFile;
+	unsigned int m_navMeshGeneration;
+	void freeNavMesh();
 	
 public:
 	NeoAxis_TileMesh();
 	virtual ~NeoAxis_TileMesh();
 
-	bool loadNavMesh(void* data, int dataSize);
+	/// Receives the saved navmesh piece by piece. Returning false stops the save.
+	typedef bool (*WriteFunction)(void* userData, const void* data, int size);
+
+	/// Compressed tiles are decompressed on the threads of threadPool, 0 uses the calling thread.
+	bool loadNavMesh(void* data, int dataSize, NeoAxis_ThreadPool* threadPool = 0);
+	/// Loads a navmesh saved by saveNavMesh without copying it: the file is mapped and the uncompressed 
+	/// tiles are used in place. The mapping is released with the navmesh.
+	bool loadNavMeshMapped(const char* fileName, NeoAxis_ThreadPool* threadPool = 0);
 	void saveNavMesh(const dtNavMesh* mesh, void** outData, int* outDataSize);
+	/// Writes the navmesh to write instead of a buffer. With compress every tile which gets smaller is 
+	/// stored compressed, the tiles are compressed on the threads of threadPool.
+	bool saveNavMesh(const dtNavMesh* mesh, WriteFunction write, void* userData, bool compress, 
+		NeoAxis_ThreadPool* threadPool);
 
 	float m_tileSize;
 
 	float m_bmin[3];
 	float m_bmax[3];
 
-	void calculateSize();
+	void calculateSize(int layersPerTile = 1);
 	void fixMinMaxCorners();
 	virtual bool init();
 	
 	void getTilePos(const float* pos, int& tx, int& ty);
+	void getTileGridSize(int& tw, int& th);
+	void initTileConfig(rcConfig& cfg, const float* bmin, const float* bmax);
 
 	void getMaximums(int* maxTiles, int* maxPolysPerTile);
+	/// Changes every time the navmesh is freed, a new navmesh can be allocated at the address of the old one.
+	unsigned int getNavMeshGeneration() const { return m_navMeshGeneration; }
 
 	void buildTile(const float* pos);
 	void removeTile(const float* pos);
 	void buildAllTiles();
+	void buildAllTilesParallel(NeoAxis_ThreadPool* threadPool);
+	void buildTilesParallel(NeoAxis_ThreadPool* threadPool, const int minX, const int minY, 
+		const int maxX, const int maxY, const bool removeEmptyTiles);
+	void rebuildTilesInBounds(const float* bmin, const float* bmax, NeoAxis_ThreadPool* threadPool);
 	void removeAllTiles();
 
+	/// Returns the number of tiles built since the last reset and the summed statistics of them.
+	/// slowestTiles receives up to maxSlowestTiles tiles with the longest build time, slowest first.
+	int getBuildStats(float* totalBuildTime, float* stageTimes, int* triangleCount, int* dataSize, 
+		TileBuildStats* slowestTiles, int maxSlowestTiles, int* slowestTileCount);
+	void resetBuildStats();
+
+	/// Rasterizes the input geometry of every tile iterations times with the scalar and with the SSE path 
+	/// of rcRasterizeTriangles. Times are in milliseconds, identical tells whether the heightfields of 
+	/// both paths are the same in every tile. Returns false if the SSE path is not compiled in.
+	bool benchmarkRasterization(int iterations, float* scalarTime, float* simdTime, bool* identical);
+
 	void cleanup();
 
 	//------------------
@@ -105,7 +190,7 @@ public:
 	float m_detailSampleMaxError;
 
 	BuildContext* m_ctx;
-	void setContext(BuildContext* ctx) { m_ctx = ctx; }
+	void setContext(BuildContext* ctx) { m_ctx = ctx; m_scratch.ctx = ctx; }
 
 	virtual class InputGeom* getInputGeom() { return m_geom; }
 	virtual class dtNavMesh* getNavMesh() { return m_navMesh; }
@@ -2,9 +2,14 @@
 #include "precompiled.h"
 #include "RecastWrapper.h"
 #include "NeoAxis_TileMesh.h"
+#include "NeoAxis_ThreadPool.h"
+#include "NeoAxis_TileCache.h"
+#include "NeoAxis_PortalGraph.h"
+#include "NeoAxis_PathCache.h"
 #include "InputGeom.h"
 #include "DetourDebugDraw.h"
 #include "DetourCommon.h"
+#include "DetourCrowd.h"
 
 #ifdef __APPLE_CC__
 	#import <Carbon/Carbon.h>
@@ -37,6 +42,82 @@ struct Vec3
 	float x, y, z;
 };
 
+enum RecastRaycastStatus
+{
+	//no navmesh polygon at the start of the ray
+	RAYCAST_FAILED,
+	RAYCAST_CLEAR,
+	RAYCAST_HIT,
+};
+
+struct RecastRaycastResult
+{
+	//hit position, the end of the ray without a hit
+	Vec3 position;
+	Vec3 normal;
+	//fraction of the ray before the hit, 1 without a hit
+	float fraction;
+	//RecastRaycastStatus
+	int status;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Navmesh query with the buffers used by FindPath. Every thread that runs path queries needs its own.
+class PathQueryContext
+{
+public:
+
+	dtNavMeshQuery* navQuery;
+	bool ownsNavQuery;
+
+	int polyListSize;
+	dtPolyRef* polyList;
+	int smoothListSize;
+	float* smoothList;
+
+	int steerSize;
+	float* steerPath;
+	unsigned char* steerPathFlags;
+	dtPolyRef* steerPathPolys;
+
+	//batch results
+	std::vector<Vec3> points;
+	std::vector<dtPolyRef> polygons;
+
+	//
+
+	PathQueryContext();
+	~PathQueryContext();
+	bool InitNavQuery(const dtNavMesh* navMesh, int maxNodes, bool openAddressing);
+	void FreeBuffers();
+
+	dtPolyRef* GetPolyList(int size);
+	float* GetSmoothList(int size);
+	void ReserveSteerPath(int size);
+	int StringPullPolyList(const Vec3& start, const Vec3& end, dtPolyRef endRef, int polyCount, 
+		int maxStraightPath);
+	void Raycast(const dtQueryFilter& filter, const Vec3& start, const Vec3& end, const Vec3& polygonPickExtents, 
+		RecastRaycastResult* result);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Area costs and polygon flags of the path and raycast queries, created by Recast_CreateQueryFilter. A NULL 
+//filter of a query means the default one of the world: all areas cost 1 and all flags are included.
+struct RecastQueryFilter
+{
+	dtQueryFilter filter;
+	//hash for the path cache, updated when the filter is changed
+	unsigned int hash;
+
+	//
+
+	RecastQueryFilter();
+	void SetTerrainAreaCosts();
+	void Changed();
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class RecastWorld
@@ -44,18 +125,28 @@ class RecastWorld
 public:
 
 	NeoAxis_TileMesh* tileMesh;
+	NeoAxis_TileCache* tileCache;
 	InputGeom* inputGeometry;
 	BuildContext ctx;
+	NeoAxis_ThreadPool threadPool;
+
+	int navQueryMaxNodes;
+	bool navQueryOpenAddressing;
+	PathQueryContext mainQuery;
 
-	int findPathPolyListSize;
-	dtPolyRef* findPathPolyList;
-	int findPathSmoothListSize;
-	float* findPathSmoothList;
+	//per thread queries for batches
+	PathQueryContext* workerQueries;
+	int workerQueryCount;
+	//navmesh generation of the worker queries
+	uint workerQueriesNavMeshGeneration;
 
-	int findPathSteerSize;
-	float* findPathSteerPath;
-	unsigned char* findPathSteerPathFlags;
-	dtPolyRef* findPathSteerPathPolys;
+	//portals of the tiles for the hierarchical queries, created by the first of them
+	NeoAxis_PortalGraph* portalGraph;
+
+	//corridors of the main query, disabled until Recast_SetPathCacheSize
+	NeoAxis_PathCache pathCache;
+
+	RecastQueryFilter defaultFilter;
 
 	//
 
@@ -67,16 +158,213 @@ public:
 		int vertsPerPoly, float detailSampleDistance, float detailMaxSampleError, 
 		float agentHeight, float agentRadius, float agentMaxClimb, float agentMaxSlope);
 	void Destroy();
-	bool NavQueryInit(int maxNodes);
+	bool NavQueryInit(int maxNodes, bool openAddressing);
+	void InitThreadPool(int threadCount);
+	NeoAxis_ThreadPool* GetThreadPool(int threadCount);
+	bool BuildTileCache(int maxObstacles, int threadCount);
+	void DestroyTileCache();
+	bool LoadNavMesh(void* data, int dataSize, const char* mappedFileName, int threadCount);
 	bool GetNavigationMesh(float** vertices, int* vertexCount);
-
-	bool getSteerTarget(dtNavMeshQuery* navQuery, const float* startPos, const float* endPos,
+	bool GetNavigationMeshIndexed(int tileMinX, int tileMinY, int tileMaxX, int tileMaxY, Vec3** outVertices, 
+		int* outVertexCount, int** outIndices, int* outIndexCount, struct RecastDebugPolygon** outPolygons, 
+		int* outPolygonCount);
+
+	const RecastQueryFilter& GetFilter(const RecastQueryFilter* filter) const;
+	bool FindPolygonPath( PathQueryContext& query, const RecastQueryFilter& filter, const Vec3& start, 
+		const Vec3& end, const Vec3& polygonPickExtents, int maxPolygonPath, dtPolyRef* outStartRef, 
+		dtPolyRef* outEndRef, int* outPolyCount, bool hierarchical = false );
+	bool getSteerTarget(PathQueryContext& query, const float* startPos, const float* endPos,
 		const float minTargetDist, const dtPolyRef* path, const int pathSize,
 		float* steerPos, unsigned char& steerPosFlag, dtPolyRef& steerPosRef, int maxSteerPoints);
+	bool FindSmoothPath( PathQueryContext& query, const RecastQueryFilter& filter, const Vec3& start, 
+		const Vec3& end, float stepSize, const Vec3& polygonPickExtents, int maxPolygonPath, int maxSmoothPath, 
+		int maxSteerPoints, int* outPointCount );
 	bool FindPath( const Vec3& start, const Vec3& end, float stepSize, const Vec3& polygonPickExtents, 
-		int maxPolygonPath, int maxSmoothPath, int maxSteerPoints, Vec3** outPath, int* outPathCount );
+		int maxPolygonPath, int maxSmoothPath, int maxSteerPoints, const RecastQueryFilter* filter, 
+		Vec3** outPath, int* outPathCount );
+	bool FindStraightPath( const Vec3& start, const Vec3& end, const Vec3& polygonPickExtents, 
+		int maxPolygonPath, int maxStraightPath, const RecastQueryFilter* filter, Vec3** outPath, 
+		unsigned char** outFlags, dtPolyRef** outPolygons, int* outPathCount, bool hierarchical = false );
+	bool Raycast( const Vec3& start, const Vec3& end, const Vec3& polygonPickExtents, 
+		const RecastQueryFilter* filter, bool* outHit, float* outHitFraction, Vec3* outHitPosition, 
+		Vec3* outHitNormal );
+	bool UpdatePortalGraph(const RecastQueryFilter* filter, int* outUpdatedTileCount, int* outTileCount, 
+		int* outPortalCount);
+
+	bool InitWorkerQueries();
+	void DestroyWorkerQueries();
+	bool FindPathsBatch( int queryCount, const Vec3* starts, const Vec3* ends, float stepSize, 
+		const Vec3& polygonPickExtents, int maxPolygonPath, int maxSmoothPath, int maxSteerPoints, 
+		const RecastQueryFilter* filter, int threadCount, Vec3** outPoints, int* outPointCount, 
+		int* outPathOffsets, int* outPathCounts );
+	bool RunQueryBatch( int queryCount, int threadCount, NeoAxis_ThreadPool::TaskFunction function, 
+		struct NavQueryBatchData& data );
+	bool RaycastBatch( int queryCount, const Vec3* starts, const Vec3* ends, const Vec3& polygonPickExtents, 
+		const RecastQueryFilter* filter, int threadCount, RecastRaycastResult* outResults );
+	bool FindNearestPointBatch( int queryCount, const Vec3* positions, const Vec3& polygonPickExtents, 
+		const RecastQueryFilter* filter, int threadCount, Vec3* outPoints, dtPolyRef* outPolygons );
+	bool FindDistanceToWallBatch( int queryCount, const Vec3* positions, const float* maxRadii, 
+		const Vec3& polygonPickExtents, const RecastQueryFilter* filter, int threadCount, float* outDistances, 
+		Vec3* outHitPositions, Vec3* outHitNormals );
+	bool FindPolygonsAroundCircleBatch( int queryCount, const Vec3* centers, const float* radii, 
+		const Vec3& polygonPickExtents, int maxPolygons, const RecastQueryFilter* filter, int threadCount, 
+		dtPolyRef** outPolygons, int* outPolygonCount, int* outOffsets, int* outCounts );
+
+	void SetGeometry(float* vertices, int vertexCount, int* indices, int indexCount, int trianglesPerChunk, 
+		int threadCount);
+	bool UpdateGeometry(float* vertices, int vertexCount, int* indices, int indexCount, int* removeRanges, 
+		int removeRangeCount, const Vec3& changedBoundsMin, const Vec3& changedBoundsMax, 
+		int* outFirstAddedTriangle);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//polygon of GetNavigationMeshIndexed, its triangles are triangleCount triangles from firstTriangle
+struct RecastDebugPolygon
+{
+	dtPolyRef reference;
+	int firstTriangle;
+	int triangleCount;
+	unsigned short flags;
+	unsigned char area;
+	unsigned char padding;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//TileBuildStats without the stage times
+struct RecastTileBuildStats
+{
+	int x;
+	int y;
+	float buildTime;
+	int triangleCount;
+	int polygonCount;
+	int dataSize;
+	int heightfieldMemory;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct RecastCrowdAgent
+{
+	Vec3 position;
+	Vec3 velocity;
+};
+
+//Agent slot of RecastCrowd. The index of the slot is the agent index the caller gets, it stays the same 
+//when the agents are moved to a new dtCrowd.
+struct RecastCrowdSlot
+{
+	//index in the dtCrowd, -1 for a free slot
+	int crowdAgent;
+	bool hasTarget;
+	Vec3 target;
+	Vec3 targetPickExtents;
+};
+
+//Agents moved over the navmesh of the world by DetourCrowd.
+class RecastCrowd
+{
+public:
+
+	RecastWorld* world;
+	dtCrowd* crowd;
+	//the crowd keeps polygon references of this navmesh, the paths of the agents were checked at this 
+	//change count of it
+	const dtNavMesh* navMesh;
+	uint navMeshGeneration;
+	uint navMeshChangeCount;
+	int maxAgents;
+	float maxAgentRadius;
+
+	std::vector<RecastCrowdSlot> slots;
+	//result of Update, one item per agent slot
+	std::vector<RecastCrowdAgent> states;
+
+	//
+
+	RecastCrowd();
+	~RecastCrowd();
+	bool Initialize(RecastWorld* world, int maxAgents, float maxAgentRadius);
+	bool HasInvalidPolygons();
+	bool UpdateNavMesh();
+	int AddAgent(const Vec3& position, const dtCrowdAgentParams& params);
+	void RemoveAgent(int agent);
+	bool SetTarget(int agent, const Vec3& target, const Vec3& polygonPickExtents);
+	int SetTargets(int count, const int* agents, const Vec3* targets, const Vec3& polygonPickExtents);
+	bool Update(float delta, RecastCrowdAgent** outStates, int* outAgentCount);
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum RecastPathRequestStatus
+{
+	PATHREQUEST_INVALID,
+	PATHREQUEST_PENDING,
+	PATHREQUEST_SUCCEEDED,
+	PATHREQUEST_FAILED,
+};
 
-	void SetGeometry(float* vertices, int vertexCount, int* indices, int indexCount, int trianglesPerChunk);
+struct RecastPathRequest
+{
+	//0 for a free slot
+	uint handle;
+	RecastPathRequestStatus status;
+	bool searching;
+
+	Vec3 start;
+	Vec3 end;
+	Vec3 polygonPickExtents;
+	int maxPolygonPath;
+	int maxStraightPath;
+	//the sliced search keeps a pointer to the filter
+	dtQueryFilter filter;
+	dtPolyRef startRef;
+	dtPolyRef endRef;
+
+	//straight path, set when the request is completed
+	Vec3* path;
+	int pathCount;
+	bool partial;
+};
+
+//Path requests which are searched over several updates with the sliced search of dtNavMeshQuery, so 
+//many requests in the same frame do not stall it. Requests are searched one after another in the order 
+//they were made.
+class RecastPathQueue
+{
+public:
+
+	RecastWorld* world;
+	PathQueryContext query;
+	//the query was initialized for this navmesh
+	const dtNavMesh* navMesh;
+	uint navMeshGeneration;
+	int maxNodes;
+
+	std::vector<RecastPathRequest> requests;
+	//handles of the pending requests, a ring buffer
+	std::vector<uint> pending;
+	int pendingFirst;
+	int pendingCount;
+	uint nextSerial;
+
+	//
+
+	RecastPathQueue();
+	~RecastPathQueue();
+	bool Initialize(RecastWorld* world, int maxRequests, int maxNodes);
+	RecastPathRequest* GetRequest(uint handle);
+	uint Request(const Vec3& start, const Vec3& end, const Vec3& polygonPickExtents, int maxPolygonPath, 
+		int maxStraightPath, const RecastQueryFilter& filter);
+	int Update(int maxIterations, int maxMicroseconds);
+	RecastPathRequestStatus GetStatus(uint handle);
+	bool GetResult(uint handle, Vec3** outPath, int* outPathCount, bool* outPartial);
+	void Release(uint handle);
+
+	bool StartSearch(RecastPathRequest& request);
+	void CompleteSearch(RecastPathRequest& request, bool succeeded);
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -104,15 +392,155 @@ EXPORT RecastWorld* Recast_Initialize( const Vec3& bmin, const Vec3& bmax,
 	return world;
 }
 
-EXPORT bool Recast_NavQueryInit(RecastWorld* world, int maxNodes)
+//openAddressing selects the node pool with open addressing and the indexed 4-ary open list, which are faster
+//for short paths. The found paths can differ from the default pool only between paths of equal cost.
+EXPORT bool Recast_NavQueryInit(RecastWorld* world, int maxNodes, bool openAddressing)
 {
-	return world->NavQueryInit(maxNodes);
+	return world->NavQueryInit(maxNodes, openAddressing);
 }
 
 EXPORT void Recast_BuildAllTiles(RecastWorld* world)
 {
 	if (world->tileMesh)
+	{
+		world->DestroyTileCache();
 		world->tileMesh->buildAllTiles();
+	}
+}
+
+EXPORT void Recast_BuildAllTilesParallel(RecastWorld* world, int threadCount)
+{
+	if (world->tileMesh)
+	{
+		world->DestroyTileCache();
+		world->InitThreadPool(threadCount);
+		world->tileMesh->buildAllTilesParallel(&world->threadPool);
+	}
+}
+
+//Builds all tiles through a tile cache instead of Recast_BuildAllTiles. The cache keeps the walkable layers
+//of the tiles compressed, temporary obstacles are applied by rebuilding only the touched tiles from them.
+//Replaces the navmesh, the nav query is initialized again if Recast_NavQueryInit was called before.
+EXPORT bool Recast_BuildTileCache(RecastWorld* world, int maxObstacles, int threadCount)
+{
+	return world->BuildTileCache(maxObstacles, threadCount);
+}
+
+//The obstacles are applied by Recast_UpdateTileCache, the returned handle is valid right away.
+EXPORT bool Recast_AddCylinderObstacle(RecastWorld* world, const Vec3& position, float radius, float height, 
+	uint* outObstacle)
+{
+	*outObstacle = 0;
+	if(!world->tileCache)
+		return false;
+	return dtStatusSucceed(world->tileCache->addCylinderObstacle((float*)&position, radius, height, outObstacle));
+}
+
+EXPORT bool Recast_AddBoxObstacle(RecastWorld* world, const Vec3& boundsMin, const Vec3& boundsMax, 
+	uint* outObstacle)
+{
+	*outObstacle = 0;
+	if(!world->tileCache)
+		return false;
+	return dtStatusSucceed(world->tileCache->addBoxObstacle((float*)&boundsMin, (float*)&boundsMax, outObstacle));
+}
+
+EXPORT bool Recast_RemoveObstacle(RecastWorld* world, uint obstacle)
+{
+	if(!world->tileCache)
+		return false;
+	return dtStatusSucceed(world->tileCache->removeObstacle(obstacle));
+}
+
+//Call every frame. Applies the obstacle changes and rebuilds one of the touched tiles per call, upToDate 
+//is false while tiles are left to rebuild.
+EXPORT bool Recast_UpdateTileCache(RecastWorld* world, float delta, bool* upToDate)
+{
+	*upToDate = true;
+	if(!world->tileCache)
+		return false;
+	return dtStatusSucceed(world->tileCache->update(delta, upToDate));
+}
+
+EXPORT void Recast_GetTileCacheStatistics(RecastWorld* world, int* layerCount, int* compressedSize, int* rawSize)
+{
+	*layerCount = 0;
+	*compressedSize = 0;
+	*rawSize = 0;
+	if(world->tileCache)
+		world->tileCache->getStatistics(layerCount, compressedSize, rawSize);
+}
+
+//Statistics of the tiles built since the last reset, times in milliseconds. stageTimes receives 
+//RC_MAX_TIMERS values indexed by rcTimerLabel, summed over all tiles. Returns the tile count.
+EXPORT int Recast_GetBuildStatistics(RecastWorld* world, float* totalBuildTime, float* stageTimes, 
+	int* triangleCount, int* dataSize, RecastTileBuildStats* slowestTiles, int maxSlowestTiles, 
+	int* slowestTileCount)
+{
+	*totalBuildTime = 0;
+	memset(stageTimes, 0, RC_MAX_TIMERS * sizeof(float));
+	*triangleCount = 0;
+	*dataSize = 0;
+	*slowestTileCount = 0;
+	if(!world->tileMesh)
+		return 0;
+
+	std::vector<TileBuildStats> tiles(maxSlowestTiles > 0 ? maxSlowestTiles : 1);
+	int tileCount = world->tileMesh->getBuildStats(totalBuildTime, stageTimes, triangleCount, dataSize, 
+		&tiles[0], maxSlowestTiles > 0 ? maxSlowestTiles : 0, slowestTileCount);
+
+	for(int n = 0; n < *slowestTileCount; n++)
+	{
+		const TileBuildStats& stats = tiles[n];
+		RecastTileBuildStats& item = slowestTiles[n];
+		item.x = stats.x;
+		item.y = stats.y;
+		item.buildTime = stats.buildTime;
+		item.triangleCount = stats.triangleCount;
+		item.polygonCount = stats.polygonCount;
+		item.dataSize = stats.dataSize;
+		item.heightfieldMemory = stats.heightfieldMemory;
+	}
+
+	return tileCount;
+}
+
+EXPORT void Recast_ResetBuildStatistics(RecastWorld* world)
+{
+	if(world->tileMesh)
+		world->tileMesh->resetBuildStats();
+}
+
+//Rasterizes the input geometry of every tile with both paths of rcRasterizeTriangles and returns their 
+//times in milliseconds. identical tells whether the heightfields of both paths are the same.
+EXPORT bool Recast_BenchmarkRasterization(RecastWorld* world, int iterations, float* scalarTime, float* simdTime, 
+	bool* identical)
+{
+	*scalarTime = 0;
+	*simdTime = 0;
+	*identical = false;
+	if(!world->tileMesh)
+		return false;
+	return world->tileMesh->benchmarkRasterization(iterations, scalarTime, simdTime, identical);
+}
+
+//Selects the SSE path of the navmesh rasterization, returns whether it is used.
+EXPORT bool Recast_SetSimdRasterization(bool enabled)
+{
+	return rcSetSimdRasterization(enabled);
+}
+
+//The distance field and the regions of the tiles built by Recast_BuildTile and Recast_BuildAllTiles are computed
+//on threadCount threads, for large tiles. The regions are the same as of one thread. threadCount == 1 turns it off.
+EXPORT void Recast_SetParallelRegionBuild(RecastWorld* world, int threadCount)
+{
+	if(threadCount == 1)
+	{
+		world->ctx.setThreadPool(NULL);
+		return;
+	}
+	world->InitThreadPool(threadCount);
+	world->ctx.setThreadPool(&world->threadPool);
 }
 
 EXPORT void Recast_DestroyAllTiles(RecastWorld* world)
@@ -132,12 +560,180 @@ EXPORT bool Recast_GetNavigationMesh(RecastWorld* world, float** vertices, int*
 	return world->GetNavigationMesh(vertices, vertexCount);
 }
 
+//Navmesh triangles with shared vertices. Only the tiles from tileMin to tileMax (inclusive) are returned, 
+//tileMaxX < tileMinX means all tiles. outPolygons is optional, pass NULL to skip it. All returned arrays 
+//must be freed with Recast_FreeMemory.
+EXPORT bool Recast_GetNavigationMeshIndexed(RecastWorld* world, int tileMinX, int tileMinY, int tileMaxX, 
+	int tileMaxY, Vec3** outVertices, int* outVertexCount, int** outIndices, int* outIndexCount, 
+	RecastDebugPolygon** outPolygons, int* outPolygonCount)
+{
+	return world->GetNavigationMeshIndexed(tileMinX, tileMinY, tileMaxX, tileMaxY, outVertices, outVertexCount, 
+		outIndices, outIndexCount, outPolygons, outPolygonCount);
+}
+
+//filter is optional, NULL means the default filter.
 EXPORT bool Recast_FindPath( RecastWorld* world, const Vec3& start, const Vec3& end, float stepSize, 
 	const Vec3& polygonPickExtents, int maxPolygonPath, int maxSmoothPath, int maxSteerPoints, 
-	Vec3** outPath, int* outPathCount )
+	RecastQueryFilter* filter, Vec3** outPath, int* outPathCount )
 {
 	return world->FindPath(start, end, stepSize, polygonPickExtents, maxPolygonPath, maxSmoothPath, 
-		maxSteerPoints, outPath, outPathCount );
+		maxSteerPoints, filter, outPath, outPathCount );
+}
+
+//Returns only the corners of the string-pulled path instead of the points of the smoothed walk of 
+//Recast_FindPath. outFlags (DT_STRAIGHTPATH_*) and outPolygons are optional, pass NULL to skip them.
+//All returned arrays must be freed with Recast_FreeMemory.
+EXPORT bool Recast_FindStraightPath( RecastWorld* world, const Vec3& start, const Vec3& end, 
+	const Vec3& polygonPickExtents, int maxPolygonPath, int maxStraightPath, RecastQueryFilter* filter, 
+	Vec3** outPath, unsigned char** outFlags, uint** outPolygons, int* outPathCount )
+{
+	return world->FindStraightPath(start, end, polygonPickExtents, maxPolygonPath, maxStraightPath, filter, 
+		outPath, outFlags, (dtPolyRef**)outPolygons, outPathCount);
+}
+
+//Same as Recast_FindStraightPath, but long paths are planned over the portals between the tiles first 
+//and then refined tile by tile. Much faster for paths over many tiles, the path can be a bit longer.
+//The portals are computed for one filter, a query with another filter computes them again.
+EXPORT bool Recast_FindStraightPathHierarchical( RecastWorld* world, const Vec3& start, const Vec3& end, 
+	const Vec3& polygonPickExtents, int maxPolygonPath, int maxStraightPath, RecastQueryFilter* filter, 
+	Vec3** outPath, unsigned char** outFlags, uint** outPolygons, int* outPathCount )
+{
+	return world->FindStraightPath(start, end, polygonPickExtents, maxPolygonPath, maxStraightPath, filter, 
+		outPath, outFlags, (dtPolyRef**)outPolygons, outPathCount, true);
+}
+
+//Casts a ray along the navmesh surface from start to end. outHit tells whether a wall or a polygon 
+//excluded by the filter was hit, outHitFraction is the fraction of the ray before the hit (1 without a 
+//hit). Returns false if there is no navmesh polygon at start.
+EXPORT bool Recast_Raycast( RecastWorld* world, const Vec3& start, const Vec3& end, 
+	const Vec3& polygonPickExtents, RecastQueryFilter* filter, bool* outHit, float* outHitFraction, 
+	Vec3* outHitPosition, Vec3* outHitNormal )
+{
+	return world->Raycast(start, end, polygonPickExtents, filter, outHit, outHitFraction, outHitPosition, 
+		outHitNormal);
+}
+
+//Keeps the polygon corridors of up to maxEntries start and end polygon pairs of Recast_FindPath and 
+//Recast_FindStraightPath, 0 disables the cache. Corridors going through a rebuilt or removed tile are 
+//dropped. Batches do not use the cache.
+EXPORT void Recast_SetPathCacheSize( RecastWorld* world, int maxEntries )
+{
+	world->pathCache.init(maxEntries);
+}
+
+EXPORT void Recast_GetPathCacheStatistics( RecastWorld* world, int* hitCount, int* missCount, 
+	int* invalidatedCount, int* entryCount )
+{
+	world->pathCache.getStatistics(hitCount, missCount, invalidatedCount, entryCount);
+}
+
+EXPORT void Recast_ResetPathCacheStatistics( RecastWorld* world )
+{
+	world->pathCache.resetStatistics();
+}
+
+//Tiles rebuilt or removed are updated by the hierarchical queries when they need them, this updates 
+//all of them at once, e.g. after a build.
+EXPORT bool Recast_UpdatePortalGraph( RecastWorld* world, RecastQueryFilter* filter, int* outUpdatedTileCount, 
+	int* outTileCount, int* outPortalCount )
+{
+	return world->UpdatePortalGraph(filter, outUpdatedTileCount, outTileCount, outPortalCount);
+}
+
+//Finds paths for all start/end pairs at once, spreading them over threadCount threads (<= 0 means one 
+//per processor). All paths are returned in outPoints, path n starts at outPathOffsets[n] and has 
+//outPathCounts[n] points, 0 if it was not found. outPoints must be freed with Recast_FreeMemory.
+EXPORT bool Recast_FindPathsBatch( RecastWorld* world, int queryCount, const Vec3* starts, const Vec3* ends, 
+	float stepSize, const Vec3& polygonPickExtents, int maxPolygonPath, int maxSmoothPath, int maxSteerPoints, 
+	RecastQueryFilter* filter, int threadCount, Vec3** outPoints, int* outPointCount, int* outPathOffsets, 
+	int* outPathCounts )
+{
+	return world->FindPathsBatch(queryCount, starts, ends, stepSize, polygonPickExtents, maxPolygonPath, 
+		maxSmoothPath, maxSteerPoints, filter, threadCount, outPoints, outPointCount, outPathOffsets, 
+		outPathCounts);
+}
+
+//Casts the rays from starts to ends on threadCount threads (<= 0 means one per processor). outResults has 
+//queryCount items.
+EXPORT bool Recast_RaycastBatch( RecastWorld* world, int queryCount, const Vec3* starts, const Vec3* ends, 
+	const Vec3& polygonPickExtents, RecastQueryFilter* filter, int threadCount, RecastRaycastResult* outResults )
+{
+	return world->RaycastBatch(queryCount, starts, ends, polygonPickExtents, filter, threadCount, outResults);
+}
+
+//Finds the nearest point on the navmesh to every position within polygonPickExtents. outPolygons is 
+//optional, a polygon is 0 and the point is the position if there is no navmesh near it.
+EXPORT bool Recast_FindNearestPointBatch( RecastWorld* world, int queryCount, const Vec3* positions, 
+	const Vec3& polygonPickExtents, RecastQueryFilter* filter, int threadCount, Vec3* outPoints, 
+	uint* outPolygons )
+{
+	return world->FindNearestPointBatch(queryCount, positions, polygonPickExtents, filter, threadCount, 
+		outPoints, (dtPolyRef*)outPolygons);
+}
+
+//Finds the distance from every position to the nearest wall within its maxRadius, the distance is maxRadius 
+//if there is no wall that near (the hit normal is zero then) and -1 if there is no navmesh at the position. 
+//outHitPositions and outHitNormals are optional.
+EXPORT bool Recast_FindDistanceToWallBatch( RecastWorld* world, int queryCount, const Vec3* positions, 
+	const float* maxRadii, const Vec3& polygonPickExtents, RecastQueryFilter* filter, int threadCount, 
+	float* outDistances, Vec3* outHitPositions, Vec3* outHitNormals )
+{
+	return world->FindDistanceToWallBatch(queryCount, positions, maxRadii, polygonPickExtents, filter, 
+		threadCount, outDistances, outHitPositions, outHitNormals);
+}
+
+//Finds up to maxPolygons polygons connected to the polygon of every center which touch the circle of its 
+//radius. The polygons of query n start at outOffsets[n] of outPolygons and there are outCounts[n] of them. 
+//outPolygons must be freed with Recast_FreeMemory.
+EXPORT bool Recast_FindPolygonsAroundCircleBatch( RecastWorld* world, int queryCount, const Vec3* centers, 
+	const float* radii, const Vec3& polygonPickExtents, int maxPolygons, RecastQueryFilter* filter, 
+	int threadCount, uint** outPolygons, int* outPolygonCount, int* outOffsets, int* outCounts )
+{
+	return world->FindPolygonsAroundCircleBatch(queryCount, centers, radii, polygonPickExtents, maxPolygons, 
+		filter, threadCount, (dtPolyRef**)outPolygons, outPolygonCount, outOffsets, outCounts);
+}
+
+//Creates a filter for the path and raycast queries. It starts as the default filter: all areas 
+//(NeoAxis_TileMesh::POLYAREA_*) cost 1 and all polygon flags (POLYFLAGS_*) are included.
+EXPORT RecastQueryFilter* Recast_CreateQueryFilter()
+{
+	return new RecastQueryFilter();
+}
+
+EXPORT void Recast_DestroyQueryFilter(RecastQueryFilter* filter)
+{
+	delete filter;
+}
+
+//Polygons pass the filter if they have any of the include flags and none of the exclude flags.
+EXPORT void Recast_SetQueryFilterFlags(RecastQueryFilter* filter, int includeFlags, int excludeFlags)
+{
+	filter->filter.setIncludeFlags((unsigned short)includeFlags);
+	filter->filter.setExcludeFlags((unsigned short)excludeFlags);
+	filter->Changed();
+}
+
+//The cost of moving through a polygon is its distance multiplied by the cost of its area.
+EXPORT void Recast_SetQueryFilterAreaCost(RecastQueryFilter* filter, int area, float cost)
+{
+	if(area < 0 || area >= DT_MAX_AREAS)
+		return;
+	filter->filter.setAreaCost(area, cost);
+	filter->Changed();
+}
+
+//Sets the costs of the areas from 0 to costCount - 1 at once.
+EXPORT void Recast_SetQueryFilterAreaCosts(RecastQueryFilter* filter, const float* costs, int costCount)
+{
+	for(int n = 0; n < costCount && n < DT_MAX_AREAS; n++)
+		filter->filter.setAreaCost(n, costs[n]);
+	filter->Changed();
+}
+
+//Sets the preset costs of the terrain areas: rough ground, swamp and water are avoided, roads are preferred.
+EXPORT void Recast_SetQueryFilterTerrainAreaCosts(RecastQueryFilter* filter)
+{
+	filter->SetTerrainAreaCosts();
 }
 
 EXPORT void Recast_FreeMemory(void* pointer)
@@ -153,10 +749,22 @@ EXPORT void Recast_GetSizes(RecastWorld* world, int* maxTiles, int* maxPolysPerT
 
 EXPORT bool Recast_LoadNavMesh(RecastWorld* world, void* data, int dataSize)
 {
-	if(world->tileMesh && world->tileMesh->m_navMesh)
-		return world->tileMesh->loadNavMesh(data, dataSize);
-	else
-		return false;
+	return world->LoadNavMesh(data, dataSize, NULL, 1);
+}
+
+//Same as Recast_LoadNavMesh, compressed tiles are decompressed on threadCount threads (<= 0 means one per 
+//processor).
+EXPORT bool Recast_LoadNavMeshParallel(RecastWorld* world, void* data, int dataSize, int threadCount)
+{
+	return world->LoadNavMesh(data, dataSize, NULL, threadCount);
+}
+
+//Loads a file written with the data of Recast_SaveNavMesh or Recast_SaveNavMeshStream without copying it. 
+//The file is mapped into memory and the uncompressed tiles are used where they are, it must not be changed 
+//while the navmesh is loaded. Compressed tiles are decompressed on threadCount threads.
+EXPORT bool Recast_LoadNavMeshMapped(RecastWorld* world, const char* fileName, int threadCount)
+{
+	return world->LoadNavMesh(NULL, 0, fileName, threadCount);
 }
 
 EXPORT void Recast_SaveNavMesh(RecastWorld* world, void** data, int* dataSize)
@@ -168,6 +776,18 @@ EXPORT void Recast_SaveNavMesh(RecastWorld* world, void** data, int* dataSize)
 	return;
 }
 
+//Saves the navmesh by passing it to write in pieces, without building the whole data in memory. With 
+//compress the tiles are compressed on threadCount threads first, which takes memory for the compressed 
+//tiles. Returns false if write returned false.
+EXPORT bool Recast_SaveNavMeshStream(RecastWorld* world, NeoAxis_TileMesh::WriteFunction write, void* userData, 
+	bool compress, int threadCount)
+{
+	if(!world->tileMesh || !world->tileMesh->m_navMesh)
+		return false;
+	return world->tileMesh->saveNavMesh(world->tileMesh->m_navMesh, write, userData, compress, 
+		world->GetThreadPool(threadCount));
+}
+
 EXPORT void Recast_BuildTile(RecastWorld* world, const Vec3& position)
 {
 	if(world->tileMesh)
@@ -180,97 +800,553 @@ EXPORT void Recast_RemoveTile(RecastWorld* world, const Vec3& position)
 		world->tileMesh->removeTile((float*)&position);
 }
 
+//The chunky mesh tree of a large geometry is built on threadCount threads, the tree is the same as of one 
+//thread.
 EXPORT void Recast_SetGeometry(RecastWorld* world, float* vertices, int vertexCount, int* indices, 
-	int indexCount, int trianglesPerChunk)
+	int indexCount, int trianglesPerChunk, int threadCount)
 {
-	world->SetGeometry(vertices, vertexCount, indices, indexCount, trianglesPerChunk);
+	world->SetGeometry(vertices, vertexCount, indices, indexCount, trianglesPerChunk, threadCount);
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-RecastWorld::RecastWorld()
+//Applies a geometry change without reloading the whole mesh and rebuilds only the affected tiles.
+//Triangles are identified by their index in Recast_SetGeometry, added triangles get the following 
+//indices (the first one is returned in outFirstAddedTriangle). removeRanges contains removeRangeCount
+//pairs of (first triangle, triangle count). Tiles intersecting changedBoundsMin/Max are rebuilt in 
+//addition to the tiles of the added and removed triangles, pass min > max on any axis to not use it.
+EXPORT bool Recast_UpdateGeometry(RecastWorld* world, float* vertices, int vertexCount, int* indices, 
+	int indexCount, int* removeRanges, int removeRangeCount, const Vec3& changedBoundsMin, 
+	const Vec3& changedBoundsMax, int* outFirstAddedTriangle)
 {
-	tileMesh = NULL;
-	inputGeometry = NULL;
-	findPathPolyListSize = 0;
-	findPathPolyList = NULL;
-	findPathSmoothListSize = 0;
-	findPathSmoothList = NULL;
-
-	findPathSteerSize = 0;
-	findPathSteerPath = NULL;
-	findPathSteerPathFlags = NULL;
-	findPathSteerPathPolys = NULL;
+	return world->UpdateGeometry(vertices, vertexCount, indices, indexCount, removeRanges, removeRangeCount, 
+		changedBoundsMin, changedBoundsMax, outFirstAddedTriangle);
 }
 
-bool RecastWorld::Initialize( Vec3 bmin, Vec3 bmax,
-	float tileSize, float cellSize, float cellHeight,
-	int minRegionSize, int mergeRegionSize, bool monotonePartitioning,
-	float maxEdgeLength, float maxEdgeError, 
-	int vertsPerPoly, float detailSampleDistance, float detailMaxSampleError, 
-	float agentHeight, float agentRadius, float agentMaxClimb, float agentMaxSlope)
+//Creates a crowd on the current navmesh. The crowd must be destroyed before the world. When the navmesh is 
+//replaced by Recast_BuildTileCache or Recast_LoadNavMesh, or tiles under the agents are rebuilt, the next call 
+//of the crowd moves the agents to the new polygons at their positions, keeping their indices and targets. 
+//Agents without a polygon near them are removed.
+EXPORT RecastCrowd* Recast_CreateCrowd(RecastWorld* world, int maxAgents, float maxAgentRadius)
 {
-	tileMesh = new NeoAxis_TileMesh();
-
-	rcVcopy(tileMesh->m_bmin, (float*)&bmin);
-	rcVcopy(tileMesh->m_bmax, (float*)&bmax);
-
-	//SodanKerjuu: get true minmax corners of the given bounding box (user can give false orientation)
-	tileMesh->fixMinMaxCorners();
+	RecastCrowd* crowd = new RecastCrowd();
+	if(!crowd->Initialize(world, maxAgents, maxAgentRadius))
+	{
+		delete crowd;
+		return NULL;
+	}
+	return crowd;
+}
 
-	tileMesh->m_tileSize = tileSize;
-	tileMesh->m_cellSize = cellSize;
-	tileMesh->m_cellHeight = cellHeight;
+EXPORT void Recast_DestroyCrowd(RecastCrowd* crowd)
+{
+	delete crowd;
+}
 
-	tileMesh->m_regionMinSize = (float)minRegionSize;
-	tileMesh->m_regionMergeSize = (float)mergeRegionSize;
-	tileMesh->m_monotonePartitioning = monotonePartitioning;
-	
-	tileMesh->m_edgeMaxLen = maxEdgeLength;
-	tileMesh->m_edgeMaxError = maxEdgeError;
-	
-	tileMesh->m_vertsPerPoly = (float)vertsPerPoly;
-	tileMesh->m_detailSampleDist = detailSampleDistance;
-	tileMesh->m_detailSampleMaxError = detailMaxSampleError;
+//Returns the index of the agent, -1 if there are no free slots or no navmesh polygon near the position.
+//updateFlags is a combination of UpdateFlags of DetourCrowd.h. obstacleAvoidanceType must be less than 
+//DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS, -1 is returned otherwise.
+EXPORT int Recast_CrowdAddAgent(RecastCrowd* crowd, const Vec3& position, float radius, float height, 
+	float maxAcceleration, float maxSpeed, float collisionQueryRange, float pathOptimizationRange, 
+	float separationWeight, int updateFlags, int obstacleAvoidanceType)
+{
+	if(obstacleAvoidanceType < 0 || obstacleAvoidanceType >= DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS)
+		return -1;
+
+	dtCrowdAgentParams params;
+	memset(&params, 0, sizeof(params));
+	params.radius = radius;
+	params.height = height;
+	params.maxAcceleration = maxAcceleration;
+	params.maxSpeed = maxSpeed;
+	params.collisionQueryRange = collisionQueryRange;
+	params.pathOptimizationRange = pathOptimizationRange;
+	params.separationWeight = separationWeight;
+	params.updateFlags = (unsigned char)updateFlags;
+	params.obstacleAvoidanceType = (unsigned char)obstacleAvoidanceType;
+	return crowd->AddAgent(position, params);
+}
 
-	tileMesh->m_agentHeight = agentHeight;
-	tileMesh->m_agentRadius = agentRadius;
-	tileMesh->m_agentMaxClimb = agentMaxClimb;
-	tileMesh->m_agentMaxSlope = agentMaxSlope;
+EXPORT void Recast_CrowdRemoveAgent(RecastCrowd* crowd, int agent)
+{
+	crowd->RemoveAgent(agent);
+}
 
-	tileMesh->setContext(&ctx);
+//Sets the move targets of count agents at once. Returns how many targets were set, targets without a 
+//navmesh polygon within polygonPickExtents are skipped.
+EXPORT int Recast_CrowdSetTargets(RecastCrowd* crowd, int count, const int* agents, const Vec3* targets, 
+	const Vec3& polygonPickExtents)
+{
+	return crowd->SetTargets(count, agents, targets, polygonPickExtents);
+}
 
-	//tile and polygon maximums
-	tileMesh->calculateSize();
-	
-	return tileMesh->init();
+//Steps the crowd and returns the position and velocity of all agent slots in one array, indexed by the
+//agent index. Free slots are zero. The array is owned by the crowd and valid until the next update.
+//Returns false if the world has no navmesh.
+EXPORT bool Recast_CrowdUpdate(RecastCrowd* crowd, float delta, RecastCrowdAgent** outStates, 
+	int* outAgentCount)
+{
+	return crowd->Update(delta, outStates, outAgentCount);
 }
 
-bool RecastWorld::NavQueryInit(int maxNodes)
+//Creates a queue for path requests which are searched over several Recast_PathQueueUpdate calls. maxNodes 
+//is the node limit of the search, like in Recast_NavQueryInit. The queue must be destroyed before the world.
+EXPORT RecastPathQueue* Recast_CreatePathQueue(RecastWorld* world, int maxRequests, int maxNodes)
 {
-	dtStatus status = tileMesh->m_navQuery->init(tileMesh->m_navMesh, maxNodes, true);
-	if (dtStatusFailed(status))
+	RecastPathQueue* queue = new RecastPathQueue();
+	if(!queue->Initialize(world, maxRequests, maxNodes))
 	{
-		tileMesh->m_ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Could not init Detour navmesh query");
-		return false;
+		delete queue;
+		return NULL;
+	}
+	return queue;
+}
+
+EXPORT void Recast_DestroyPathQueue(RecastPathQueue* queue)
+{
+	delete queue;
+}
+
+//Returns the handle of the request, 0 if the queue is full. The filter is copied to the request, NULL means 
+//the default filter.
+EXPORT uint Recast_PathQueueRequest(RecastPathQueue* queue, const Vec3& start, const Vec3& end, 
+	const Vec3& polygonPickExtents, int maxPolygonPath, int maxStraightPath, RecastQueryFilter* filter)
+{
+	return queue->Request(start, end, polygonPickExtents, maxPolygonPath, maxStraightPath, 
+		queue->world->GetFilter(filter));
+}
+
+//Searches the pending requests until maxIterations search iterations are done or maxMicroseconds passed, 
+//<= 0 means no limit. Returns the number of requests completed by the update.
+EXPORT int Recast_PathQueueUpdate(RecastPathQueue* queue, int maxIterations, int maxMicroseconds)
+{
+	return queue->Update(maxIterations, maxMicroseconds);
+}
+
+//Returns a RecastPathRequestStatus.
+EXPORT int Recast_PathQueueGetStatus(RecastPathQueue* queue, uint handle)
+{
+	return queue->GetStatus(handle);
+}
+
+//Returns the straight path of a succeeded request and releases the request. outPath must be freed with 
+//Recast_FreeMemory. outPartial tells whether the path ends at the closest reachable point.
+EXPORT bool Recast_PathQueueGetResult(RecastPathQueue* queue, uint handle, Vec3** outPath, int* outPathCount, 
+	bool* outPartial)
+{
+	return queue->GetResult(handle, outPath, outPathCount, outPartial);
+}
+
+//Cancels a pending request or frees a completed one.
+EXPORT void Recast_PathQueueRelease(RecastPathQueue* queue, uint handle)
+{
+	queue->Release(handle);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PathQueryContext::PathQueryContext()
+{
+	navQuery = NULL;
+	ownsNavQuery = false;
+
+	polyListSize = 0;
+	polyList = NULL;
+	smoothListSize = 0;
+	smoothList = NULL;
+
+	steerSize = 0;
+	steerPath = NULL;
+	steerPathFlags = NULL;
+	steerPathPolys = NULL;
+}
+
+PathQueryContext::~PathQueryContext()
+{
+	FreeBuffers();
+	if(ownsNavQuery)
+		dtFreeNavMeshQuery(navQuery);
+}
+
+bool PathQueryContext::InitNavQuery(const dtNavMesh* navMesh, int maxNodes, bool openAddressing)
+{
+	if(!navQuery)
+	{
+		navQuery = dtAllocNavMeshQuery();
+		ownsNavQuery = true;
+	}
+	return dtStatusSucceed(navQuery->init(navMesh, maxNodes, true, openAddressing));
+}
+
+void PathQueryContext::FreeBuffers()
+{
+	polyListSize = 0;
+	if(polyList)
+	{
+		delete[] polyList;
+		polyList = NULL;
+	}
+
+	smoothListSize = 0;
+	if(smoothList)
+	{
+		delete[] smoothList;
+		smoothList = NULL;
+	}
+
+	steerSize = 0;
+	if(steerPath)
+	{
+		delete[] steerPath;
+		delete[] steerPathFlags;
+		delete[] steerPathPolys;
+		steerPath = NULL;
+		steerPathFlags = NULL;
+		steerPathPolys = NULL;
+	}
+}
+
+//Casts a ray from start to end along the navmesh surface with dtNavMeshQuery::raycast.
+void PathQueryContext::Raycast(const dtQueryFilter& filter, const Vec3& start, const Vec3& end, 
+	const Vec3& polygonPickExtents, RecastRaycastResult* result)
+{
+	result->position = end;
+	memset(&result->normal, 0, sizeof(Vec3));
+	result->fraction = 1;
+	result->status = RAYCAST_FAILED;
+
+	dtPolyRef startRef = 0;
+	dtStatus status = navQuery->findNearestPoly((float*)&start, (float*)&polygonPickExtents, &filter, 
+		&startRef, 0);
+	if(!dtStatusSucceed(status) || !startRef)
+		return;
+
+	float t = 0;
+	status = navQuery->raycast(startRef, (float*)&start, (float*)&end, &filter, &t, (float*)&result->normal, 
+		NULL, NULL, 0);
+	if(!dtStatusSucceed(status))
+		return;
+
+	//t is FLT_MAX when the ray reaches the end
+	result->status = RAYCAST_CLEAR;
+	if(t <= 1)
+	{
+		result->status = RAYCAST_HIT;
+		result->fraction = t;
+		dtVlerp((float*)&result->position, (float*)&start, (float*)&end, t);
+	}
+}
+
+dtPolyRef* PathQueryContext::GetPolyList(int size)
+{
+	if(polyList == NULL || polyListSize < size)
+	{
+		if(polyList)
+			delete[] polyList;
+		polyListSize = size;
+		polyList = new dtPolyRef[polyListSize];
+	}
+	return polyList;
+}
+
+float* PathQueryContext::GetSmoothList(int size)
+{
+	if(smoothList == NULL || smoothListSize < size)
+	{
+		if(smoothList)
+			delete[] smoothList;
+		smoothListSize = size;
+		smoothList = new float[smoothListSize * 3];
+	}
+	return smoothList;
+}
+
+void PathQueryContext::ReserveSteerPath(int size)
+{
+	if(steerPath == NULL || steerSize < size)
+	{
+		if(steerPath)
+		{
+			delete[] steerPath;
+			delete[] steerPathFlags;
+			delete[] steerPathPolys;
+		}
+		steerSize = size;
+		steerPath = new float[size * 3];
+		steerPathFlags = new unsigned char[size];
+		steerPathPolys = new dtPolyRef[size];
+	}
+}
+
+//Finds the corners of the corridor in polyList, they are stored in the steer path buffers. Returns the 
+//number of corners.
+int PathQueryContext::StringPullPolyList(const Vec3& start, const Vec3& end, dtPolyRef endRef, int polyCount, 
+	int maxStraightPath)
+{
+	//in case of a partial path, end at the closest point of the last polygon
+	float endPos[3];
+	dtVcopy(endPos, (float*)&end);
+	if(polyList[polyCount - 1] != endRef)
+		navQuery->closestPointOnPoly(polyList[polyCount - 1], (float*)&end, endPos);
+
+	//same kind of data as the steer path, share the buffers
+	ReserveSteerPath(maxStraightPath);
+	int count = 0;
+	dtStatus status = navQuery->findStraightPath((float*)&start, endPos, polyList, polyCount, 
+		steerPath, steerPathFlags, steerPathPolys, &count, maxStraightPath);
+	if(!dtStatusSucceed(status))
+		return 0;
+	return count;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RecastWorld::RecastWorld()
+{
+	tileMesh = NULL;
+	tileCache = NULL;
+	inputGeometry = NULL;
+	navQueryMaxNodes = 0;
+	navQueryOpenAddressing = false;
+	workerQueries = NULL;
+	workerQueryCount = 0;
+	workerQueriesNavMeshGeneration = 0;
+	portalGraph = NULL;
+}
+
+bool RecastWorld::Initialize( Vec3 bmin, Vec3 bmax,
+	float tileSize, float cellSize, float cellHeight,
+	int minRegionSize, int mergeRegionSize, bool monotonePartitioning,
+	float maxEdgeLength, float maxEdgeError, 
+	int vertsPerPoly, float detailSampleDistance, float detailMaxSampleError, 
+	float agentHeight, float agentRadius, float agentMaxClimb, float agentMaxSlope)
+{
+	tileMesh = new NeoAxis_TileMesh();
+
+	rcVcopy(tileMesh->m_bmin, (float*)&bmin);
+	rcVcopy(tileMesh->m_bmax, (float*)&bmax);
+
+	//SodanKerjuu: get true minmax corners of the given bounding box (user can give false orientation)
+	tileMesh->fixMinMaxCorners();
+
+	tileMesh->m_tileSize = tileSize;
+	tileMesh->m_cellSize = cellSize;
+	tileMesh->m_cellHeight = cellHeight;
+
+	tileMesh->m_regionMinSize = (float)minRegionSize;
+	tileMesh->m_regionMergeSize = (float)mergeRegionSize;
+	tileMesh->m_monotonePartitioning = monotonePartitioning;
+	
+	tileMesh->m_edgeMaxLen = maxEdgeLength;
+	tileMesh->m_edgeMaxError = maxEdgeError;
+	
+	tileMesh->m_vertsPerPoly = (float)vertsPerPoly;
+	tileMesh->m_detailSampleDist = detailSampleDistance;
+	tileMesh->m_detailSampleMaxError = detailMaxSampleError;
+
+	tileMesh->m_agentHeight = agentHeight;
+	tileMesh->m_agentRadius = agentRadius;
+	tileMesh->m_agentMaxClimb = agentMaxClimb;
+	tileMesh->m_agentMaxSlope = agentMaxSlope;
+
+	tileMesh->setContext(&ctx);
+	mainQuery.navQuery = tileMesh->m_navQuery;
+
+	//tile and polygon maximums
+	tileMesh->calculateSize();
+	
+	return tileMesh->init();
+}
+
+bool RecastWorld::NavQueryInit(int maxNodes, bool openAddressing)
+{
+	dtStatus status = tileMesh->m_navQuery->init(tileMesh->m_navMesh, maxNodes, true, openAddressing);
+	if (dtStatusFailed(status))
+	{
+		tileMesh->m_ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Could not init Detour navmesh query");
+		return false;
+	}
+	navQueryMaxNodes = maxNodes;
+	navQueryOpenAddressing = openAddressing;
+	//worker queries will be reinitialized with the new settings by the next batch
+	DestroyWorkerQueries();
+	//a replaced navmesh can have the same tile references as the old one
+	if(portalGraph)
+		portalGraph->clear();
+	pathCache.clear();
+	return true;
+}
+
+bool RecastWorld::InitWorkerQueries()
+{
+	const int threadCount = threadPool.getThreadCount();
+	if(workerQueries && workerQueryCount == threadCount && 
+		workerQueriesNavMeshGeneration == tileMesh->getNavMeshGeneration())
+	{
+		return true;
+	}
+
+	DestroyWorkerQueries();
+
+	workerQueries = new PathQueryContext[threadCount];
+	workerQueryCount = threadCount;
+	workerQueriesNavMeshGeneration = tileMesh->getNavMeshGeneration();
+	for(int n = 0; n < threadCount; n++)
+	{
+		if(!workerQueries[n].InitNavQuery(tileMesh->m_navMesh, navQueryMaxNodes, navQueryOpenAddressing))
+		{
+			DestroyWorkerQueries();
+			return false;
+		}
+	}
+	return true;
+}
+
+void RecastWorld::DestroyWorkerQueries()
+{
+	if(workerQueries)
+	{
+		delete[] workerQueries;
+		workerQueries = NULL;
+	}
+	workerQueryCount = 0;
+	workerQueriesNavMeshGeneration = 0;
+}
+
+//threadCount <= 0 means one thread per processor
+void RecastWorld::InitThreadPool(int threadCount)
+{
+	if(threadCount <= 0)
+		threadCount = NeoAxis_ThreadPool::getProcessorCount();
+	if(threadPool.getThreadCount() != threadCount)
+		threadPool.init(threadCount);
+}
+
+//NULL for one thread, the work is done by the calling thread without changing the pool
+NeoAxis_ThreadPool* RecastWorld::GetThreadPool(int threadCount)
+{
+	if(threadCount == 1)
+		return NULL;
+	InitThreadPool(threadCount);
+	return &threadPool;
+}
+
+bool RecastWorld::BuildTileCache(int maxObstacles, int threadCount)
+{
+	if(!inputGeometry)
+		return false;
+
+	if(!tileCache)
+		tileCache = new NeoAxis_TileCache(tileMesh);
+	if(!tileCache->init(maxObstacles))
+	{
+		DestroyTileCache();
+		return false;
+	}
+
+	//the navmesh was replaced
+	if(navQueryMaxNodes && !NavQueryInit(navQueryMaxNodes, navQueryOpenAddressing))
+		return false;
+
+	InitThreadPool(threadCount);
+	tileCache->buildAllTiles(&threadPool);
+	return true;
+}
+
+void RecastWorld::DestroyTileCache()
+{
+	if(tileCache)
+	{
+		delete tileCache;
+		tileCache = NULL;
 	}
+}
+
+//mappedFileName is used instead of data when it is not NULL
+bool RecastWorld::LoadNavMesh(void* data, int dataSize, const char* mappedFileName, int threadCount)
+{
+	if(!tileMesh || !tileMesh->m_navMesh)
+		return false;
+
+	bool loaded;
+	if(mappedFileName)
+		loaded = tileMesh->loadNavMeshMapped(mappedFileName, GetThreadPool(threadCount));
+	else
+		loaded = tileMesh->loadNavMesh(data, dataSize, GetThreadPool(threadCount));
+	if(!loaded)
+		return false;
+
+	//the tile cache does not match the loaded navmesh
+	DestroyTileCache();
+
+	//the navmesh was replaced
+	if(navQueryMaxNodes && !NavQueryInit(navQueryMaxNodes, navQueryOpenAddressing))
+		return false;
 	return true;
 }
 
 void RecastWorld::SetGeometry(float* vertices, int vertexCount, int* indices, int indexCount, 
-	int trianglesPerChunk)
+	int trianglesPerChunk, int threadCount)
 {
 	//SodanKerjuu: need to delete previous or fills up memory really fast
 	delete inputGeometry;
 	tileMesh->cleanup();
 	
 	inputGeometry = new InputGeom();
-	if(!inputGeometry->loadMesh(&ctx, vertices, vertexCount, indices, indexCount, trianglesPerChunk))
+	//the pool of Recast_SetParallelRegionBuild is restored after
+	NeoAxis_ThreadPool* regionThreadPool = ctx.getThreadPool();
+	ctx.setThreadPool(GetThreadPool(threadCount));
+	bool loaded = inputGeometry->loadMesh(&ctx, vertices, vertexCount, indices, indexCount, trianglesPerChunk);
+	ctx.setThreadPool(regionThreadPool);
+	if(!loaded)
 		Fatal("Recast: !geom->loadMesh(&ctx, path)");
 
 	tileMesh->m_geom = inputGeometry;
 }
 
+bool RecastWorld::UpdateGeometry(float* vertices, int vertexCount, int* indices, int indexCount, 
+	int* removeRanges, int removeRangeCount, const Vec3& changedBoundsMin, const Vec3& changedBoundsMax, 
+	int* outFirstAddedTriangle)
+{
+	*outFirstAddedTriangle = -1;
+
+	if(!inputGeometry || !inputGeometry->getChunkyMesh())
+		return false;
+
+	//min > max on any axis means no extra bounds, the box starts empty and only takes the triangles
+	float bmin[3];
+	float bmax[3];
+	if(changedBoundsMin.x > changedBoundsMax.x || changedBoundsMin.y > changedBoundsMax.y || 
+		changedBoundsMin.z > changedBoundsMax.z)
+	{
+		dtVset(bmin, FLT_MAX, FLT_MAX, FLT_MAX);
+		dtVset(bmax, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+	}
+	else
+	{
+		rcVcopy(bmin, (float*)&changedBoundsMin);
+		rcVcopy(bmax, (float*)&changedBoundsMax);
+	}
+
+	if(removeRangeCount > 0)
+	{
+		if(!inputGeometry->removeTriangles(&ctx, removeRanges, removeRangeCount, bmin, bmax))
+			return false;
+	}
+
+	if(indexCount > 0)
+	{
+		*outFirstAddedTriangle = inputGeometry->addTriangles(&ctx, vertices, vertexCount, indices, indexCount, 
+			bmin, bmax);
+		if(*outFirstAddedTriangle < 0)
+			return false;
+	}
+
+	if(tileCache)
+		tileCache->rebuildTilesInBounds(bmin, bmax, &threadPool);
+	else
+		tileMesh->rebuildTilesInBounds(bmin, bmax, &threadPool);
+	return true;
+}
+
 class DebugDraw : public duDebugDraw
 {
 public:
@@ -378,35 +1454,165 @@ bool RecastWorld::GetNavigationMesh(float** outVertices, int* outVertexCount)
 	return false;
 }
 
-void RecastWorld::Destroy()
+bool RecastWorld::GetNavigationMeshIndexed(int tileMinX, int tileMinY, int tileMaxX, int tileMaxY, 
+	Vec3** outVertices, int* outVertexCount, int** outIndices, int* outIndexCount, 
+	RecastDebugPolygon** outPolygons, int* outPolygonCount)
 {
-	//!!!!!!leaks?
+	*outVertices = NULL;
+	*outVertexCount = 0;
+	*outIndices = NULL;
+	*outIndexCount = 0;
+	if(outPolygons)
+	{
+		*outPolygons = NULL;
+		*outPolygonCount = 0;
+	}
+
+	if(!tileMesh || !tileMesh->m_navMesh)
+		return false;
+	const dtNavMesh* navMesh = tileMesh->m_navMesh;
+	const bool allTiles = tileMaxX < tileMinX;
+
+	//the vertices of a tile are its polygon vertices followed by the detail vertices, only the used ones are 
+	//returned. first pass gets the upper bounds, so every array is allocated once.
+	int maxVertexCount = 0;
+	int triangleCount = 0;
+	int polygonCount = 0;
+	int maxTileVertexCount = 0;
+	for(int i = 0; i < navMesh->getMaxTiles(); i++)
+	{
+		const dtMeshTile* tile = navMesh->getTile(i);
+		if(!tile || !tile->header)
+			continue;
+		const dtMeshHeader* header = tile->header;
+		if(!allTiles && (header->x < tileMinX || header->x > tileMaxX || header->y < tileMinY || 
+			header->y > tileMaxY))
+			continue;
+
+		const int tileVertexCount = header->vertCount + header->detailVertCount;
+		maxVertexCount += tileVertexCount;
+		maxTileVertexCount = rcMax(maxTileVertexCount, tileVertexCount);
+		for(int n = 0; n < header->polyCount; n++)
+		{
+			if(tile->polys[n].getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+			triangleCount += tile->detailMeshes[n].triCount;
+			polygonCount++;
+		}
+	}
+
+	if(!triangleCount)
+		return false;
+
+	Vec3* vertices = (Vec3*)malloc(maxVertexCount * sizeof(Vec3));
+	int* indices = (int*)malloc(triangleCount * 3 * sizeof(int));
+	RecastDebugPolygon* polygons = outPolygons ? 
+		(RecastDebugPolygon*)malloc(polygonCount * sizeof(RecastDebugPolygon)) : NULL;
+	std::vector<int> remap(maxTileVertexCount);
 
-	findPathPolyListSize = 0;
-	if(findPathPolyList)
+	int vertexCount = 0;
+	int indexCount = 0;
+	int polygonIndex = 0;
+	for(int i = 0; i < navMesh->getMaxTiles(); i++)
 	{
-		delete[] findPathPolyList;
-		findPathPolyList = NULL;
+		const dtMeshTile* tile = navMesh->getTile(i);
+		if(!tile || !tile->header)
+			continue;
+		const dtMeshHeader* header = tile->header;
+		if(!allTiles && (header->x < tileMinX || header->x > tileMaxX || header->y < tileMinY || 
+			header->y > tileMaxY))
+			continue;
+
+		const dtPolyRef base = navMesh->getPolyRefBase(tile);
+		for(int n = 0; n < header->vertCount + header->detailVertCount; n++)
+			remap[n] = -1;
+
+		for(int n = 0; n < header->polyCount; n++)
+		{
+			const dtPoly* poly = &tile->polys[n];
+			if(poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+			const dtPolyDetail* detail = &tile->detailMeshes[n];
+
+			if(polygons)
+			{
+				RecastDebugPolygon& polygon = polygons[polygonIndex];
+				polygon.reference = base | (dtPolyRef)n;
+				polygon.firstTriangle = indexCount / 3;
+				polygon.triangleCount = detail->triCount;
+				polygon.flags = poly->flags;
+				polygon.area = poly->getArea();
+				polygon.padding = 0;
+			}
+			polygonIndex++;
+
+			for(int t = 0; t < detail->triCount; t++)
+			{
+				const unsigned char* triangle = &tile->detailTris[(detail->triBase + t) * 4];
+				for(int k = 0; k < 3; k++)
+				{
+					int tileVertex;
+					const float* position;
+					if(triangle[k] < poly->vertCount)
+					{
+						tileVertex = poly->verts[triangle[k]];
+						position = &tile->verts[tileVertex * 3];
+					}
+					else
+					{
+						const int detailVertex = detail->vertBase + triangle[k] - poly->vertCount;
+						tileVertex = header->vertCount + detailVertex;
+						position = &tile->detailVerts[detailVertex * 3];
+					}
+
+					if(remap[tileVertex] < 0)
+					{
+						remap[tileVertex] = vertexCount;
+						Vec3& vertex = vertices[vertexCount];
+						vertex.x = position[0];
+						vertex.y = position[1];
+						vertex.z = position[2];
+						vertexCount++;
+					}
+					indices[indexCount++] = remap[tileVertex];
+				}
+			}
+		}
 	}
 
-	findPathSmoothListSize = 0;
-	if(findPathSmoothList)
+	//off-mesh connection vertices are not used
+	if(vertexCount < maxVertexCount)
+		vertices = (Vec3*)realloc(vertices, vertexCount * sizeof(Vec3));
+
+	*outVertices = vertices;
+	*outVertexCount = vertexCount;
+	*outIndices = indices;
+	*outIndexCount = indexCount;
+	if(outPolygons)
 	{
-		delete[] findPathSmoothList;
-		findPathSmoothList = NULL;
+		*outPolygons = polygons;
+		*outPolygonCount = polygonCount;
 	}
+	return true;
+}
 
-	findPathSteerSize = 0;
-	if(findPathSteerPath)
+void RecastWorld::Destroy()
+{
+	//!!!!!!leaks?
+
+	mainQuery.FreeBuffers();
+	DestroyWorkerQueries();
+
+	if(portalGraph)
 	{
-		delete[] findPathSteerPath;
-		delete[] findPathSteerPathFlags;
-		delete[] findPathSteerPathPolys;
-		findPathSteerPath = NULL;
-		findPathSteerPathFlags = NULL;
-		findPathSteerPathPolys = NULL;
+		delete portalGraph;
+		portalGraph = NULL;
 	}
 
+	threadPool.shutdown();
+
+	DestroyTileCache();
+
 	if(tileMesh)
 	{
 		delete tileMesh;
@@ -473,36 +1679,24 @@ static int fixupCorridor(dtPolyRef* path, const int npath, const int maxPath,
 	return req+size;
 }
 
-bool RecastWorld::getSteerTarget(dtNavMeshQuery* navQuery, const float* startPos, const float* endPos,
+bool RecastWorld::getSteerTarget(PathQueryContext& query, const float* startPos, const float* endPos,
    const float minTargetDist, const dtPolyRef* path, const int pathSize,
    float* steerPos, unsigned char& steerPosFlag, dtPolyRef& steerPosRef, int maxSteerPoints)
    /*float* outPoints = 0, int* outPointCount = 0)*/
 {
 	// Find steer target.
 
-	if(findPathSteerPath == NULL || findPathSteerSize < maxSteerPoints)
-	{
-		if(findPathSteerPath)
-		{
-			delete[] findPathSteerPath;
-			delete[] findPathSteerPathFlags;
-			delete[] findPathSteerPathPolys;
-		}
-		findPathSteerSize = maxSteerPoints;
-		findPathSteerPath = new float[maxSteerPoints * 3];
-		findPathSteerPathFlags = new unsigned char[maxSteerPoints];
-		findPathSteerPathPolys = new dtPolyRef[maxSteerPoints];
-	}
-	float* steerPath = findPathSteerPath;
-	unsigned char* steerPathFlags = findPathSteerPathFlags;
-	dtPolyRef* steerPathPolys = findPathSteerPathPolys;
+	query.ReserveSteerPath(maxSteerPoints);
+	float* steerPath = query.steerPath;
+	unsigned char* steerPathFlags = query.steerPathFlags;
+	dtPolyRef* steerPathPolys = query.steerPathPolys;
 	//static const int MAX_STEER_POINTS = 3;
 	//float steerPath[MAX_STEER_POINTS*3];
 	//unsigned char steerPathFlags[MAX_STEER_POINTS];
 	//dtPolyRef steerPathPolys[MAX_STEER_POINTS];
 
 	int nsteerPath = 0;
-	navQuery->findStraightPath(startPos, endPos, path, pathSize,
+	query.navQuery->findStraightPath(startPos, endPos, path, pathSize,
 		steerPath, steerPathFlags, steerPathPolys, &nsteerPath, maxSteerPoints);
 	if (!nsteerPath)
 		return false;
@@ -537,80 +1731,146 @@ bool RecastWorld::getSteerTarget(dtNavMeshQuery* navQuery, const float* startPos
 	return true;
 }
 
-bool RecastWorld::FindPath( const Vec3& start, const Vec3& end, float stepSize, 
-	const Vec3& polygonPickExtents, int maxPolygonPath, int maxSmoothPath, int maxSteerPoints, 
-	Vec3** outPath, int* outPathCount )
+static void InitDefaultQueryFilter(dtQueryFilter& m_filter)
 {
-	*outPath = NULL;
-	*outPathCount = 0;
-
-	dtStatus status;
-
-	float m_polyPickExt[3];
-	m_polyPickExt[0] = polygonPickExtents.x;
-	m_polyPickExt[1] = polygonPickExtents.y;
-	m_polyPickExt[2] = polygonPickExtents.z;
-
-	dtQueryFilter m_filter;
 	m_filter.setIncludeFlags(NeoAxis_TileMesh::POLYFLAGS_ALL);
 	m_filter.setExcludeFlags(0);
 	
 	for(int n = 0;n < DT_MAX_AREAS; n++)
 		m_filter.setAreaCost(n, 1);
 	
-	//m_filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_GROUND, 1.0f);
-	//m_filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_ROUGH, 1.25f);
-	//m_filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_SWAMP, 2.0f);
-	//m_filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_WATER, 10.0f);
-	//m_filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_ROAD, 0.8f);
-	//m_filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_DOOR, 1.0f);
-	//m_filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_JUMP, 1.5f);
 	//m_filter.setIncludeFlags(m_filter.getIncludeFlags() ^ NeoAxis_TileMesh::POLYFLAGS_WALK);
+}
+
+RecastQueryFilter::RecastQueryFilter()
+{
+	InitDefaultQueryFilter(filter);
+	Changed();
+}
+
+void RecastQueryFilter::SetTerrainAreaCosts()
+{
+	filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_GROUND, 1.0f);
+	filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_ROUGH, 1.25f);
+	filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_SWAMP, 2.0f);
+	filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_WATER, 10.0f);
+	filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_ROAD, 0.8f);
+	filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_DOOR, 1.0f);
+	filter.setAreaCost(NeoAxis_TileMesh::POLYAREA_JUMP, 1.5f);
+	Changed();
+}
+
+//the hash is computed once here instead of by every query which uses the path cache
+void RecastQueryFilter::Changed()
+{
+	hash = NeoAxis_PathCache::hashFilter(&filter);
+}
+
+const RecastQueryFilter& RecastWorld::GetFilter(const RecastQueryFilter* filter) const
+{
+	return filter ? *filter : defaultFilter;
+}
+
+//Finds the polygon corridor from start to end. The corridor is stored in query.polyList.
+//hierarchical plans the path over the portal graph first, only for the main query. Corridors of the main 
+//query are taken from the path cache if it is enabled.
+bool RecastWorld::FindPolygonPath( PathQueryContext& query, const RecastQueryFilter& filter, const Vec3& start, 
+	const Vec3& end, const Vec3& polygonPickExtents, int maxPolygonPath, dtPolyRef* outStartRef, 
+	dtPolyRef* outEndRef, int* outPolyCount, bool hierarchical )
+{
+	*outPolyCount = 0;
+
+	const dtQueryFilter& m_filter = filter.filter;
+
+	dtNavMeshQuery* navQuery = query.navQuery;
+	dtStatus status;
+
+	float m_polyPickExt[3];
+	m_polyPickExt[0] = polygonPickExtents.x;
+	m_polyPickExt[1] = polygonPickExtents.y;
+	m_polyPickExt[2] = polygonPickExtents.z;
 
 	dtPolyRef m_startRef;
-	status = tileMesh->m_navQuery->findNearestPoly((float*)&start, m_polyPickExt, &m_filter, &m_startRef, 0);
+	status = navQuery->findNearestPoly((float*)&start, m_polyPickExt, &m_filter, &m_startRef, 0);
 	if(!dtStatusSucceed(status))
 		return false;
 
 	dtPolyRef m_endRef;
-	status = tileMesh->m_navQuery->findNearestPoly((float*)&end, m_polyPickExt, &m_filter, &m_endRef, 0);
+	status = navQuery->findNearestPoly((float*)&end, m_polyPickExt, &m_filter, &m_endRef, 0);
 	if(!dtStatusSucceed(status))
 		return false;
 
 	//static const int MAX_POLYS = 256 * 4;
-	//static const int MAX_SMOOTH = 2048 * 4;
 
-	if(findPathPolyList == NULL || findPathPolyListSize < maxPolygonPath)
-	{
-		if(findPathPolyList)
-			delete[] findPathPolyList;
-		findPathPolyListSize = maxPolygonPath;
-		findPathPolyList = new dtPolyRef[findPathPolyListSize];
-	}
-	dtPolyRef* m_polys = findPathPolyList;
+	dtPolyRef* m_polys = query.GetPolyList(maxPolygonPath);
 	//dtPolyRef m_polys[MAX_POLYS];
 	int m_npolys = 0;
 
-	status = tileMesh->m_navQuery->findPath(m_startRef, m_endRef, (float*)&start, (float*)&end, 
-		&m_filter, m_polys, &m_npolys, maxPolygonPath);
-	if(!dtStatusSucceed(status))
-		return false;
+	//the corridors of both modes differ
+	const bool useCache = &query == &mainQuery && pathCache.isEnabled();
+	unsigned int filterHash = 0;
+	if(useCache)
+		filterHash = filter.hash ^ (hierarchical ? 1 : 0);
+
+	if(!useCache || !pathCache.find(tileMesh->m_navMesh, m_startRef, m_endRef, filterHash, m_polys, &m_npolys, 
+		maxPolygonPath))
+	{
+		if(hierarchical)
+		{
+			if(!portalGraph)
+				portalGraph = new NeoAxis_PortalGraph();
+			status = portalGraph->findPath(navQuery, m_startRef, m_endRef, (float*)&start, (float*)&end, 
+				&m_filter, m_polys, &m_npolys, maxPolygonPath);
+		}
+		else
+		{
+			status = navQuery->findPath(m_startRef, m_endRef, (float*)&start, (float*)&end, 
+				&m_filter, m_polys, &m_npolys, maxPolygonPath);
+		}
+		if(!dtStatusSucceed(status))
+			return false;
+
+		//partial paths depend on the node limit and the buffer size
+		if(useCache && m_npolys != 0 && m_polys[m_npolys - 1] == m_endRef && !dtStatusDetail(status, DT_PARTIAL_RESULT))
+			pathCache.add(m_startRef, m_endRef, filterHash, m_polys, m_npolys);
+	}
 
 	if(m_npolys == 0)
 		return false;
 
-	float m_prevIterPos[3], m_iterPos[3], m_steerPos[3], m_targetPos[3];
-	tileMesh->m_navQuery->closestPointOnPolyBoundary(m_startRef, (float*)&start, m_iterPos);
-	tileMesh->m_navQuery->closestPointOnPolyBoundary(m_polys[m_npolys-1], (float*)&end, m_targetPos);
+	*outStartRef = m_startRef;
+	*outEndRef = m_endRef;
+	*outPolyCount = m_npolys;
+	return true;
+}
 
-	if(findPathSmoothList == NULL || findPathSmoothListSize < maxSmoothPath)
+bool RecastWorld::FindSmoothPath( PathQueryContext& query, const RecastQueryFilter& filter, const Vec3& start, 
+	const Vec3& end, float stepSize, const Vec3& polygonPickExtents, int maxPolygonPath, int maxSmoothPath, 
+	int maxSteerPoints, int* outPointCount )
+{
+	*outPointCount = 0;
+
+	dtNavMeshQuery* navQuery = query.navQuery;
+
+	const dtQueryFilter& m_filter = filter.filter;
+
+	dtPolyRef m_startRef;
+	dtPolyRef m_endRef;
+	int m_npolys = 0;
+	if(!FindPolygonPath(query, filter, start, end, polygonPickExtents, maxPolygonPath, &m_startRef, &m_endRef, 
+		&m_npolys))
 	{
-		if(findPathSmoothList)
-			delete[] findPathSmoothList;
-		findPathSmoothListSize = maxSmoothPath;
-		findPathSmoothList = new float[findPathSmoothListSize * 3];
+		return false;
 	}
-	float* m_smoothPath = findPathSmoothList;
+	dtPolyRef* m_polys = query.polyList;
+
+	//static const int MAX_SMOOTH = 2048 * 4;
+
+	float m_prevIterPos[3], m_iterPos[3], m_steerPos[3], m_targetPos[3];
+	navQuery->closestPointOnPolyBoundary(m_startRef, (float*)&start, m_iterPos);
+	navQuery->closestPointOnPolyBoundary(m_polys[m_npolys-1], (float*)&end, m_targetPos);
+
+	float* m_smoothPath = query.GetSmoothList(maxSmoothPath);
 	//float m_smoothPath[MAX_SMOOTH*3];
 	int m_nsmoothPath = 0;
 
@@ -642,7 +1902,7 @@ bool RecastWorld::FindPath( const Vec3& start, const Vec3& end, float stepSize,
 		//float m_steerPoints[MAX_STEER_POINTS*3];
 		//int m_steerPointCount;
 
-		if (!getSteerTarget(tileMesh->m_navQuery, m_iterPos, m_targetPos, SLOP,
+		if (!getSteerTarget(query, m_iterPos, m_targetPos, SLOP,
 			m_polys, m_npolys, steerPos, steerPosFlag, steerPosRef, maxSteerPoints)/*,
 			m_steerPoints, &m_steerPointCount)*/)
 		{
@@ -670,11 +1930,11 @@ bool RecastWorld::FindPath( const Vec3& start, const Vec3& end, float stepSize,
 		float result[3];
 		dtPolyRef visited[16];
 		int nvisited = 0;
-		tileMesh->m_navQuery->moveAlongSurface(m_polys[0], m_iterPos, moveTgt, &m_filter,
+		navQuery->moveAlongSurface(m_polys[0], m_iterPos, moveTgt, &m_filter,
 			result, visited, &nvisited, 16);
 		m_npolys = fixupCorridor(m_polys, m_npolys, maxPolygonPath, visited, nvisited);
 		float h = 0;
-		tileMesh->m_navQuery->getPolyHeight(m_polys[0], result, &h);
+		navQuery->getPolyHeight(m_polys[0], result, &h);
 		result[1] = h;
 		dtVcopy(m_iterPos, result);
 		
@@ -726,7 +1986,7 @@ bool RecastWorld::FindPath( const Vec3& start, const Vec3& end, float stepSize,
 				// Move position at the other side of the off-mesh link.
 				dtVcopy(m_iterPos, endPos);
 				float h;
-				tileMesh->m_navQuery->getPolyHeight(m_polys[0], m_iterPos, &h);
+				navQuery->getPolyHeight(m_polys[0], m_iterPos, &h);
 				m_iterPos[1] = h;
 			}
 		}
@@ -742,6 +2002,25 @@ bool RecastWorld::FindPath( const Vec3& start, const Vec3& end, float stepSize,
 
 	end:;
 
+	*outPointCount = m_nsmoothPath;
+	return true;
+}
+
+bool RecastWorld::FindPath( const Vec3& start, const Vec3& end, float stepSize, 
+	const Vec3& polygonPickExtents, int maxPolygonPath, int maxSmoothPath, int maxSteerPoints, 
+	const RecastQueryFilter* filter, Vec3** outPath, int* outPathCount )
+{
+	*outPath = NULL;
+	*outPathCount = 0;
+
+	int m_nsmoothPath = 0;
+	if(!FindSmoothPath(mainQuery, GetFilter(filter), start, end, stepSize, polygonPickExtents, maxPolygonPath, 
+		maxSmoothPath, maxSteerPoints, &m_nsmoothPath))
+	{
+		return false;
+	}
+	const float* m_smoothPath = mainQuery.smoothList;
+
 	Vec3* path = (Vec3*)malloc(m_nsmoothPath * sizeof(Vec3));
 	for(int n = 0;n < m_nsmoothPath;n++)
 	{
@@ -756,3 +2035,907 @@ bool RecastWorld::FindPath( const Vec3& start, const Vec3& end, float stepSize,
 	*outPathCount = m_nsmoothPath;
 	return true;
 }
+
+bool RecastWorld::FindStraightPath( const Vec3& start, const Vec3& end, const Vec3& polygonPickExtents, 
+	int maxPolygonPath, int maxStraightPath, const RecastQueryFilter* filter, Vec3** outPath, 
+	unsigned char** outFlags, dtPolyRef** outPolygons, int* outPathCount, bool hierarchical )
+{
+	*outPath = NULL;
+	if(outFlags)
+		*outFlags = NULL;
+	if(outPolygons)
+		*outPolygons = NULL;
+	*outPathCount = 0;
+
+	PathQueryContext& query = mainQuery;
+
+	dtPolyRef startRef;
+	dtPolyRef endRef;
+	int polyCount = 0;
+	if(!FindPolygonPath(query, GetFilter(filter), start, end, polygonPickExtents, maxPolygonPath, &startRef, 
+		&endRef, &polyCount, hierarchical))
+	{
+		return false;
+	}
+
+	int count = query.StringPullPolyList(start, end, endRef, polyCount, maxStraightPath);
+	if(count == 0)
+		return false;
+
+	Vec3* path = (Vec3*)malloc(count * sizeof(Vec3));
+	memcpy(path, query.steerPath, count * sizeof(Vec3));
+	*outPath = path;
+
+	if(outFlags)
+	{
+		*outFlags = (unsigned char*)malloc(count);
+		memcpy(*outFlags, query.steerPathFlags, count);
+	}
+	if(outPolygons)
+	{
+		*outPolygons = (dtPolyRef*)malloc(count * sizeof(dtPolyRef));
+		memcpy(*outPolygons, query.steerPathPolys, count * sizeof(dtPolyRef));
+	}
+
+	*outPathCount = count;
+	return true;
+}
+
+bool RecastWorld::Raycast( const Vec3& start, const Vec3& end, const Vec3& polygonPickExtents, 
+	const RecastQueryFilter* filter, bool* outHit, float* outHitFraction, Vec3* outHitPosition, 
+	Vec3* outHitNormal )
+{
+	RecastRaycastResult result;
+	if(mainQuery.navQuery)
+		mainQuery.Raycast(GetFilter(filter).filter, start, end, polygonPickExtents, &result);
+	else
+	{
+		memset(&result, 0, sizeof(RecastRaycastResult));
+		result.status = RAYCAST_FAILED;
+	}
+
+	*outHit = result.status == RAYCAST_HIT;
+	*outHitFraction = result.status == RAYCAST_HIT ? result.fraction : 1;
+	*outHitPosition = result.status == RAYCAST_HIT ? result.position : end;
+	*outHitNormal = result.normal;
+	return result.status != RAYCAST_FAILED;
+}
+
+//Computes the portals of the tiles changed since the last query, so the next hierarchical query does 
+//not have to. Statistics are optional.
+bool RecastWorld::UpdatePortalGraph(const RecastQueryFilter* filter, int* outUpdatedTileCount, 
+	int* outTileCount, int* outPortalCount)
+{
+	if(!tileMesh || !tileMesh->m_navMesh)
+		return false;
+	if(!portalGraph)
+		portalGraph = new NeoAxis_PortalGraph();
+
+	int updatedTileCount = portalGraph->update(tileMesh->m_navMesh, &GetFilter(filter).filter);
+
+	int tileCount, portalCount;
+	portalGraph->getStatistics(&tileCount, &portalCount);
+	if(outUpdatedTileCount)
+		*outUpdatedTileCount = updatedTileCount;
+	if(outTileCount)
+		*outTileCount = tileCount;
+	if(outPortalCount)
+		*outPortalCount = portalCount;
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct FindPathsBatchData
+{
+	RecastWorld* world;
+	const Vec3* starts;
+	const Vec3* ends;
+	float stepSize;
+	Vec3 polygonPickExtents;
+	int maxPolygonPath;
+	int maxSmoothPath;
+	int maxSteerPoints;
+	const RecastQueryFilter* filter;
+
+	//results of every query are kept in the points of the worker that did it
+	int* queryWorkers;
+	int* queryOffsets;
+	int* queryCounts;
+};
+
+static void FindPathsBatchTask(void* userData, int taskIndex, int workerIndex)
+{
+	FindPathsBatchData* data = (FindPathsBatchData*)userData;
+	PathQueryContext& query = data->world->workerQueries[workerIndex];
+
+	data->queryWorkers[taskIndex] = workerIndex;
+	data->queryOffsets[taskIndex] = (int)query.points.size();
+	data->queryCounts[taskIndex] = 0;
+
+	int pointCount = 0;
+	if(!data->world->FindSmoothPath(query, *data->filter, data->starts[taskIndex], data->ends[taskIndex], 
+		data->stepSize, data->polygonPickExtents, data->maxPolygonPath, data->maxSmoothPath, data->maxSteerPoints, 
+		&pointCount))
+	{
+		return;
+	}
+
+	const Vec3* smoothList = (const Vec3*)query.smoothList;
+	query.points.insert(query.points.end(), smoothList, smoothList + pointCount);
+	data->queryCounts[taskIndex] = pointCount;
+}
+
+bool RecastWorld::FindPathsBatch( int queryCount, const Vec3* starts, const Vec3* ends, float stepSize, 
+	const Vec3& polygonPickExtents, int maxPolygonPath, int maxSmoothPath, int maxSteerPoints, 
+	const RecastQueryFilter* filter, int threadCount, Vec3** outPoints, int* outPointCount, 
+	int* outPathOffsets, int* outPathCounts )
+{
+	*outPoints = NULL;
+	*outPointCount = 0;
+	for(int n = 0; n < queryCount; n++)
+	{
+		outPathOffsets[n] = 0;
+		outPathCounts[n] = 0;
+	}
+
+	if(queryCount <= 0 || !tileMesh->m_navMesh || navQueryMaxNodes == 0)
+		return false;
+
+	InitThreadPool(threadCount);
+	if(!InitWorkerQueries())
+		return false;
+
+	for(int n = 0; n < workerQueryCount; n++)
+		workerQueries[n].points.clear();
+
+	FindPathsBatchData data;
+	data.world = this;
+	data.starts = starts;
+	data.ends = ends;
+	data.stepSize = stepSize;
+	data.polygonPickExtents = polygonPickExtents;
+	data.maxPolygonPath = maxPolygonPath;
+	data.maxSmoothPath = maxSmoothPath;
+	data.maxSteerPoints = maxSteerPoints;
+	data.filter = &GetFilter(filter);
+	data.queryWorkers = new int[queryCount];
+	data.queryOffsets = new int[queryCount];
+	data.queryCounts = new int[queryCount];
+
+	threadPool.run(FindPathsBatchTask, &data, queryCount);
+
+	int totalCount = 0;
+	for(int n = 0; n < queryCount; n++)
+		totalCount += data.queryCounts[n];
+
+	Vec3* points = totalCount ? (Vec3*)malloc(totalCount * sizeof(Vec3)) : NULL;
+	int offset = 0;
+	for(int n = 0; n < queryCount; n++)
+	{
+		const int count = data.queryCounts[n];
+		if(count)
+		{
+			const std::vector<Vec3>& workerPoints = workerQueries[data.queryWorkers[n]].points;
+			memcpy(points + offset, &workerPoints[data.queryOffsets[n]], count * sizeof(Vec3));
+		}
+		outPathOffsets[n] = offset;
+		outPathCounts[n] = count;
+		offset += count;
+	}
+
+	delete[] data.queryWorkers;
+	delete[] data.queryOffsets;
+	delete[] data.queryCounts;
+
+	*outPoints = points;
+	*outPointCount = totalCount;
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//the queries of the batches are short, every task does this many of them
+static const int QUERY_BATCH_TASK_SIZE = 64;
+
+struct NavQueryBatchData
+{
+	RecastWorld* world;
+	const dtQueryFilter* filter;
+	int queryCount;
+	const Vec3* positions;
+	const Vec3* ends;
+	const float* radii;
+	Vec3 polygonPickExtents;
+	int maxPolygons;
+
+	RecastRaycastResult* raycastResults;
+	Vec3* points;
+	dtPolyRef* polygons;
+	float* distances;
+	Vec3* hitPositions;
+	Vec3* hitNormals;
+
+	//polygons of every circle query are kept in the polygons of the worker that did it
+	int* queryWorkers;
+	int* queryOffsets;
+	int* queryCounts;
+};
+
+static void RaycastBatchTask(void* userData, int taskIndex, int workerIndex)
+{
+	NavQueryBatchData* data = (NavQueryBatchData*)userData;
+	PathQueryContext& query = data->world->workerQueries[workerIndex];
+
+	const int end = dtMin((taskIndex + 1) * QUERY_BATCH_TASK_SIZE, data->queryCount);
+	for(int n = taskIndex * QUERY_BATCH_TASK_SIZE; n < end; n++)
+	{
+		query.Raycast(*data->filter, data->positions[n], data->ends[n], data->polygonPickExtents, 
+			&data->raycastResults[n]);
+	}
+}
+
+static void FindNearestPointBatchTask(void* userData, int taskIndex, int workerIndex)
+{
+	NavQueryBatchData* data = (NavQueryBatchData*)userData;
+	dtNavMeshQuery* navQuery = data->world->workerQueries[workerIndex].navQuery;
+
+	const int end = dtMin((taskIndex + 1) * QUERY_BATCH_TASK_SIZE, data->queryCount);
+	for(int n = taskIndex * QUERY_BATCH_TASK_SIZE; n < end; n++)
+	{
+		dtPolyRef ref = 0;
+		data->points[n] = data->positions[n];
+		navQuery->findNearestPoly((float*)&data->positions[n], (float*)&data->polygonPickExtents, data->filter, 
+			&ref, (float*)&data->points[n]);
+		if(data->polygons)
+			data->polygons[n] = ref;
+	}
+}
+
+static void FindDistanceToWallBatchTask(void* userData, int taskIndex, int workerIndex)
+{
+	NavQueryBatchData* data = (NavQueryBatchData*)userData;
+	dtNavMeshQuery* navQuery = data->world->workerQueries[workerIndex].navQuery;
+
+	const int end = dtMin((taskIndex + 1) * QUERY_BATCH_TASK_SIZE, data->queryCount);
+	for(int n = taskIndex * QUERY_BATCH_TASK_SIZE; n < end; n++)
+	{
+		float distance = -1;
+		Vec3 hitPosition = data->positions[n];
+		Vec3 hitNormal = { 0, 0, 0 };
+
+		dtPolyRef ref = 0;
+		navQuery->findNearestPoly((float*)&data->positions[n], (float*)&data->polygonPickExtents, data->filter, 
+			&ref, 0);
+		if(ref)
+		{
+			float hitDistance;
+			dtStatus status = navQuery->findDistanceToWall(ref, (float*)&data->positions[n], data->radii[n], 
+				data->filter, &hitDistance, (float*)&hitPosition, (float*)&hitNormal);
+			if(dtStatusSucceed(status))
+			{
+				distance = hitDistance;
+				//the normal of no hit is not defined
+				if(hitDistance >= data->radii[n])
+				{
+					hitPosition = data->positions[n];
+					memset(&hitNormal, 0, sizeof(Vec3));
+				}
+			}
+		}
+
+		data->distances[n] = distance;
+		if(data->hitPositions)
+			data->hitPositions[n] = hitPosition;
+		if(data->hitNormals)
+			data->hitNormals[n] = hitNormal;
+	}
+}
+
+static void FindPolygonsAroundCircleBatchTask(void* userData, int taskIndex, int workerIndex)
+{
+	NavQueryBatchData* data = (NavQueryBatchData*)userData;
+	PathQueryContext& query = data->world->workerQueries[workerIndex];
+	dtNavMeshQuery* navQuery = query.navQuery;
+	dtPolyRef* polys = query.GetPolyList(data->maxPolygons);
+
+	const int end = dtMin((taskIndex + 1) * QUERY_BATCH_TASK_SIZE, data->queryCount);
+	for(int n = taskIndex * QUERY_BATCH_TASK_SIZE; n < end; n++)
+	{
+		data->queryWorkers[n] = workerIndex;
+		data->queryOffsets[n] = (int)query.polygons.size();
+		data->queryCounts[n] = 0;
+
+		dtPolyRef ref = 0;
+		navQuery->findNearestPoly((float*)&data->positions[n], (float*)&data->polygonPickExtents, data->filter, 
+			&ref, 0);
+		if(!ref)
+			continue;
+
+		int count = 0;
+		navQuery->findPolysAroundCircle(ref, (float*)&data->positions[n], data->radii[n], data->filter, polys, 
+			NULL, NULL, &count, data->maxPolygons);
+		query.polygons.insert(query.polygons.end(), polys, polys + count);
+		data->queryCounts[n] = count;
+	}
+}
+
+//Runs the task function over the worker queries, each task does QUERY_BATCH_TASK_SIZE queries.
+bool RecastWorld::RunQueryBatch( int queryCount, int threadCount, NeoAxis_ThreadPool::TaskFunction function, 
+	NavQueryBatchData& data )
+{
+	if(queryCount <= 0 || !tileMesh->m_navMesh || navQueryMaxNodes == 0)
+		return false;
+
+	InitThreadPool(threadCount);
+	if(!InitWorkerQueries())
+		return false;
+
+	data.world = this;
+	data.queryCount = queryCount;
+	threadPool.run(function, &data, (queryCount + QUERY_BATCH_TASK_SIZE - 1) / QUERY_BATCH_TASK_SIZE);
+	return true;
+}
+
+bool RecastWorld::RaycastBatch( int queryCount, const Vec3* starts, const Vec3* ends, 
+	const Vec3& polygonPickExtents, const RecastQueryFilter* filter, int threadCount, 
+	RecastRaycastResult* outResults )
+{
+	NavQueryBatchData data;
+	memset(&data, 0, sizeof(NavQueryBatchData));
+	data.filter = &GetFilter(filter).filter;
+	data.positions = starts;
+	data.ends = ends;
+	data.polygonPickExtents = polygonPickExtents;
+	data.raycastResults = outResults;
+	return RunQueryBatch(queryCount, threadCount, RaycastBatchTask, data);
+}
+
+bool RecastWorld::FindNearestPointBatch( int queryCount, const Vec3* positions, const Vec3& polygonPickExtents, 
+	const RecastQueryFilter* filter, int threadCount, Vec3* outPoints, dtPolyRef* outPolygons )
+{
+	NavQueryBatchData data;
+	memset(&data, 0, sizeof(NavQueryBatchData));
+	data.filter = &GetFilter(filter).filter;
+	data.positions = positions;
+	data.polygonPickExtents = polygonPickExtents;
+	data.points = outPoints;
+	data.polygons = outPolygons;
+	return RunQueryBatch(queryCount, threadCount, FindNearestPointBatchTask, data);
+}
+
+bool RecastWorld::FindDistanceToWallBatch( int queryCount, const Vec3* positions, const float* maxRadii, 
+	const Vec3& polygonPickExtents, const RecastQueryFilter* filter, int threadCount, float* outDistances, 
+	Vec3* outHitPositions, Vec3* outHitNormals )
+{
+	NavQueryBatchData data;
+	memset(&data, 0, sizeof(NavQueryBatchData));
+	data.filter = &GetFilter(filter).filter;
+	data.positions = positions;
+	data.radii = maxRadii;
+	data.polygonPickExtents = polygonPickExtents;
+	data.distances = outDistances;
+	data.hitPositions = outHitPositions;
+	data.hitNormals = outHitNormals;
+	return RunQueryBatch(queryCount, threadCount, FindDistanceToWallBatchTask, data);
+}
+
+bool RecastWorld::FindPolygonsAroundCircleBatch( int queryCount, const Vec3* centers, const float* radii, 
+	const Vec3& polygonPickExtents, int maxPolygons, const RecastQueryFilter* filter, int threadCount, 
+	dtPolyRef** outPolygons, int* outPolygonCount, int* outOffsets, int* outCounts )
+{
+	*outPolygons = NULL;
+	*outPolygonCount = 0;
+	for(int n = 0; n < queryCount; n++)
+	{
+		outOffsets[n] = 0;
+		outCounts[n] = 0;
+	}
+	if(queryCount <= 0 || maxPolygons <= 0 || !tileMesh->m_navMesh || navQueryMaxNodes == 0)
+		return false;
+
+	for(int n = 0; n < workerQueryCount; n++)
+		workerQueries[n].polygons.clear();
+
+	NavQueryBatchData data;
+	memset(&data, 0, sizeof(NavQueryBatchData));
+	data.filter = &GetFilter(filter).filter;
+	data.positions = centers;
+	data.radii = radii;
+	data.polygonPickExtents = polygonPickExtents;
+	data.maxPolygons = maxPolygons;
+	data.queryWorkers = new int[queryCount];
+	data.queryOffsets = new int[queryCount];
+	data.queryCounts = new int[queryCount];
+
+	bool result = RunQueryBatch(queryCount, threadCount, FindPolygonsAroundCircleBatchTask, data);
+	if(result)
+	{
+		int totalCount = 0;
+		for(int n = 0; n < queryCount; n++)
+			totalCount += data.queryCounts[n];
+
+		dtPolyRef* polygons = totalCount ? (dtPolyRef*)malloc(totalCount * sizeof(dtPolyRef)) : NULL;
+		int offset = 0;
+		for(int n = 0; n < queryCount; n++)
+		{
+			const int count = data.queryCounts[n];
+			if(count)
+			{
+				const std::vector<dtPolyRef>& workerPolygons = workerQueries[data.queryWorkers[n]].polygons;
+				memcpy(polygons + offset, &workerPolygons[data.queryOffsets[n]], count * sizeof(dtPolyRef));
+			}
+			outOffsets[n] = offset;
+			outCounts[n] = count;
+			offset += count;
+		}
+
+		*outPolygons = polygons;
+		*outPolygonCount = totalCount;
+	}
+
+	delete[] data.queryWorkers;
+	delete[] data.queryOffsets;
+	delete[] data.queryCounts;
+	return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+RecastCrowd::RecastCrowd()
+{
+	world = NULL;
+	crowd = NULL;
+	navMesh = NULL;
+	navMeshGeneration = 0;
+	navMeshChangeCount = 0;
+	maxAgents = 0;
+	maxAgentRadius = 0;
+}
+
+RecastCrowd::~RecastCrowd()
+{
+	if(crowd)
+		delete crowd;
+}
+
+bool RecastCrowd::Initialize(RecastWorld* world, int maxAgents, float maxAgentRadius)
+{
+	this->world = world;
+	if(maxAgents <= 0 || !world->tileMesh || !world->tileMesh->m_navMesh)
+		return false;
+
+	navMesh = world->tileMesh->m_navMesh;
+	navMeshGeneration = world->tileMesh->getNavMeshGeneration();
+	navMeshChangeCount = navMesh->getChangeCount();
+	this->maxAgents = maxAgents;
+	this->maxAgentRadius = maxAgentRadius;
+	crowd = new dtCrowd();
+	if(!crowd->init(maxAgents, maxAgentRadius, world->tileMesh->m_navMesh))
+	{
+		world->tileMesh->m_ctx->log(RC_LOG_ERROR, "RecastCrowd: Could not init Detour crowd");
+		return false;
+	}
+
+	slots.resize(maxAgents);
+	for(int n = 0; n < maxAgents; n++)
+	{
+		slots[n].crowdAgent = -1;
+		slots[n].hasTarget = false;
+	}
+	states.resize(maxAgents);
+	memset(&states[0], 0, maxAgents * sizeof(RecastCrowdAgent));
+	return true;
+}
+
+//Checks the paths of the agents for polygons of tiles which were rebuilt or removed.
+bool RecastCrowd::HasInvalidPolygons()
+{
+	for(int n = 0; n < maxAgents; n++)
+	{
+		if(slots[n].crowdAgent == -1)
+			continue;
+		const dtPathCorridor& corridor = crowd->getAgent(slots[n].crowdAgent)->corridor;
+		const dtPolyRef* path = corridor.getPath();
+		for(int i = 0; i < corridor.getPathCount(); i++)
+		{
+			if(!navMesh->isValidPolyRef(path[i]))
+				return true;
+		}
+	}
+	return false;
+}
+
+//The polygon references of the crowd are not valid after the navmesh was replaced or the tiles under the 
+//agents were rebuilt, DetourCrowd does not check them. The agents are added to a new dtCrowd at their 
+//positions and get their targets again. The paths are checked only after tiles were added or removed.
+bool RecastCrowd::UpdateNavMesh()
+{
+	const uint generation = world->tileMesh->getNavMeshGeneration();
+	if(generation == navMeshGeneration)
+	{
+		if(!crowd)
+			return false;
+		if(navMesh->getChangeCount() == navMeshChangeCount)
+			return true;
+		navMeshChangeCount = navMesh->getChangeCount();
+		if(!HasInvalidPolygons())
+			return true;
+	}
+
+	dtCrowd* oldCrowd = crowd;
+	crowd = NULL;
+	navMesh = world->tileMesh->m_navMesh;
+	navMeshGeneration = generation;
+	navMeshChangeCount = navMesh ? navMesh->getChangeCount() : 0;
+	if(navMesh)
+	{
+		crowd = new dtCrowd();
+		if(!crowd->init(maxAgents, maxAgentRadius, world->tileMesh->m_navMesh))
+		{
+			world->tileMesh->m_ctx->log(RC_LOG_ERROR, "RecastCrowd: Could not init Detour crowd");
+			delete crowd;
+			crowd = NULL;
+		}
+	}
+
+	for(int n = 0; n < maxAgents; n++)
+	{
+		RecastCrowdSlot& slot = slots[n];
+		if(slot.crowdAgent == -1)
+			continue;
+
+		const dtCrowdAgent* oldAgent = oldCrowd->getAgent(slot.crowdAgent);
+		slot.crowdAgent = crowd ? crowd->addAgent(oldAgent->npos, &oldAgent->params) : -1;
+		if(slot.crowdAgent == -1)
+		{
+			slot.hasTarget = false;
+			memset(&states[n], 0, sizeof(RecastCrowdAgent));
+			continue;
+		}
+
+		if(slot.hasTarget && !SetTarget(n, slot.target, slot.targetPickExtents))
+			slot.hasTarget = false;
+	}
+
+	delete oldCrowd;
+	return crowd != NULL;
+}
+
+int RecastCrowd::AddAgent(const Vec3& position, const dtCrowdAgentParams& params)
+{
+	if(!UpdateNavMesh())
+		return -1;
+
+	int agent = 0;
+	while(agent < maxAgents && slots[agent].crowdAgent != -1)
+		agent++;
+	if(agent == maxAgents)
+		return -1;
+
+	RecastCrowdSlot& slot = slots[agent];
+	slot.crowdAgent = crowd->addAgent((const float*)&position, &params);
+	if(slot.crowdAgent == -1)
+		return -1;
+	slot.hasTarget = false;
+	return agent;
+}
+
+void RecastCrowd::RemoveAgent(int agent)
+{
+	if(agent < 0 || agent >= maxAgents || slots[agent].crowdAgent == -1)
+		return;
+
+	crowd->removeAgent(slots[agent].crowdAgent);
+	slots[agent].crowdAgent = -1;
+	slots[agent].hasTarget = false;
+	memset(&states[agent], 0, sizeof(RecastCrowdAgent));
+}
+
+bool RecastCrowd::SetTarget(int agent, const Vec3& target, const Vec3& polygonPickExtents)
+{
+	if(agent < 0 || agent >= maxAgents || slots[agent].crowdAgent == -1)
+		return false;
+
+	dtPolyRef ref = 0;
+	float nearest[3];
+	crowd->getNavMeshQuery()->findNearestPoly((const float*)&target, (const float*)&polygonPickExtents, 
+		crowd->getFilter(), &ref, nearest);
+	if(!ref)
+		return false;
+
+	RecastCrowdSlot& slot = slots[agent];
+	if(!crowd->requestMoveTarget(slot.crowdAgent, ref, nearest))
+		return false;
+	slot.hasTarget = true;
+	slot.target = target;
+	slot.targetPickExtents = polygonPickExtents;
+	return true;
+}
+
+int RecastCrowd::SetTargets(int count, const int* agents, const Vec3* targets, const Vec3& polygonPickExtents)
+{
+	if(!UpdateNavMesh())
+		return 0;
+
+	int setCount = 0;
+	for(int n = 0; n < count; n++)
+	{
+		if(SetTarget(agents[n], targets[n], polygonPickExtents))
+			setCount++;
+	}
+	return setCount;
+}
+
+bool RecastCrowd::Update(float delta, RecastCrowdAgent** outStates, int* outAgentCount)
+{
+	*outStates = NULL;
+	*outAgentCount = 0;
+
+	if(!UpdateNavMesh())
+		return false;
+
+	crowd->update(delta, NULL);
+
+	for(int n = 0; n < maxAgents; n++)
+	{
+		RecastCrowdAgent& state = states[n];
+		if(slots[n].crowdAgent != -1)
+		{
+			const dtCrowdAgent* agent = crowd->getAgent(slots[n].crowdAgent);
+			dtVcopy((float*)&state.position, agent->npos);
+			dtVcopy((float*)&state.velocity, agent->vel);
+		}
+		else
+			memset(&state, 0, sizeof(RecastCrowdAgent));
+	}
+
+	*outStates = &states[0];
+	*outAgentCount = maxAgents;
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//search iterations between the checks of the time budget
+static const int PATH_QUEUE_ITERATIONS_PER_TIME_CHECK = 32;
+
+RecastPathQueue::RecastPathQueue()
+{
+	world = NULL;
+	navMesh = NULL;
+	navMeshGeneration = 0;
+	maxNodes = 0;
+	pendingFirst = 0;
+	pendingCount = 0;
+	nextSerial = 1;
+}
+
+RecastPathQueue::~RecastPathQueue()
+{
+	for(size_t n = 0; n < requests.size(); n++)
+	{
+		if(requests[n].path)
+			free(requests[n].path);
+	}
+}
+
+bool RecastPathQueue::Initialize(RecastWorld* world, int maxRequests, int maxNodes)
+{
+	this->world = world;
+	this->maxNodes = maxNodes;
+	//the slot index is in the low 16 bits of the handle
+	if(maxRequests <= 0 || maxRequests > 0xffff || !world->tileMesh || !world->tileMesh->m_navMesh)
+		return false;
+
+	navMesh = world->tileMesh->m_navMesh;
+	navMeshGeneration = world->tileMesh->getNavMeshGeneration();
+	if(!query.InitNavQuery(navMesh, maxNodes, world->navQueryOpenAddressing))
+	{
+		world->tileMesh->m_ctx->log(RC_LOG_ERROR, "RecastPathQueue: Could not init Detour navmesh query");
+		return false;
+	}
+
+	requests.resize(maxRequests);
+	pending.resize(maxRequests);
+	return true;
+}
+
+RecastPathRequest* RecastPathQueue::GetRequest(uint handle)
+{
+	const int slot = (int)(handle & 0xffff) - 1;
+	if(slot < 0 || slot >= (int)requests.size() || requests[slot].handle != handle)
+		return NULL;
+	return &requests[slot];
+}
+
+uint RecastPathQueue::Request(const Vec3& start, const Vec3& end, const Vec3& polygonPickExtents, 
+	int maxPolygonPath, int maxStraightPath, const RecastQueryFilter& filter)
+{
+	if(maxPolygonPath <= 0 || maxStraightPath <= 0)
+		return 0;
+
+	int slot = -1;
+	for(int n = 0; n < (int)requests.size(); n++)
+	{
+		if(!requests[n].handle)
+		{
+			slot = n;
+			break;
+		}
+	}
+	if(slot == -1)
+		return 0;
+
+	RecastPathRequest& request = requests[slot];
+	request = RecastPathRequest();
+	request.handle = ((nextSerial++ & 0xffff) << 16) | (uint)(slot + 1);
+	request.status = PATHREQUEST_PENDING;
+	request.start = start;
+	request.end = end;
+	request.polygonPickExtents = polygonPickExtents;
+	request.maxPolygonPath = maxPolygonPath;
+	request.maxStraightPath = maxStraightPath;
+	request.filter = filter.filter;
+
+	pending[(pendingFirst + pendingCount) % pending.size()] = request.handle;
+	pendingCount++;
+	return request.handle;
+}
+
+bool RecastPathQueue::StartSearch(RecastPathRequest& request)
+{
+	dtNavMeshQuery* navQuery = query.navQuery;
+
+	navQuery->findNearestPoly((float*)&request.start, (float*)&request.polygonPickExtents, &request.filter, 
+		&request.startRef, 0);
+	navQuery->findNearestPoly((float*)&request.end, (float*)&request.polygonPickExtents, &request.filter, 
+		&request.endRef, 0);
+	if(!request.startRef || !request.endRef)
+		return false;
+
+	dtStatus status = navQuery->initSlicedFindPath(request.startRef, request.endRef, (float*)&request.start, 
+		(float*)&request.end, &request.filter);
+	if(dtStatusFailed(status))
+		return false;
+	request.searching = true;
+	return true;
+}
+
+void RecastPathQueue::CompleteSearch(RecastPathRequest& request, bool succeeded)
+{
+	request.searching = false;
+	request.status = PATHREQUEST_FAILED;
+	if(!succeeded)
+		return;
+
+	dtPolyRef* polys = query.GetPolyList(request.maxPolygonPath);
+	int polyCount = 0;
+	dtStatus status = query.navQuery->finalizeSlicedFindPath(polys, &polyCount, request.maxPolygonPath);
+	if(!dtStatusSucceed(status) || polyCount == 0)
+		return;
+
+	int count = query.StringPullPolyList(request.start, request.end, request.endRef, polyCount, 
+		request.maxStraightPath);
+	if(count == 0)
+		return;
+
+	request.path = (Vec3*)malloc(count * sizeof(Vec3));
+	memcpy(request.path, query.steerPath, count * sizeof(Vec3));
+	request.pathCount = count;
+	request.partial = polys[polyCount - 1] != request.endRef;
+	request.status = PATHREQUEST_SUCCEEDED;
+}
+
+int RecastPathQueue::Update(int maxIterations, int maxMicroseconds)
+{
+	//polygon references of a replaced navmesh are not valid, the searches start again. the new navmesh
+	//can be allocated at the address of the old one
+	if(!navMesh || navMeshGeneration != world->tileMesh->getNavMeshGeneration())
+	{
+		navMesh = world->tileMesh->m_navMesh;
+		navMeshGeneration = world->tileMesh->getNavMeshGeneration();
+		if(!navMesh || !query.InitNavQuery(navMesh, maxNodes, world->navQueryOpenAddressing))
+		{
+			navMesh = NULL;
+			return 0;
+		}
+		for(size_t n = 0; n < requests.size(); n++)
+			requests[n].searching = false;
+	}
+
+	const TimeVal startTime = getPerfTime();
+	int completedCount = 0;
+	int iterationCount = 0;
+
+	while(pendingCount)
+	{
+		//released requests are removed from the pending ones
+		RecastPathRequest* request = GetRequest(pending[pendingFirst]);
+		if(!request->searching && !StartSearch(*request))
+			CompleteSearch(*request, false);
+		else
+		{
+			int iterations = PATH_QUEUE_ITERATIONS_PER_TIME_CHECK;
+			if(maxIterations > 0)
+			{
+				if(iterationCount >= maxIterations)
+					break;
+				iterations = dtMin(iterations, maxIterations - iterationCount);
+			}
+
+			int doneIterations = 0;
+			dtStatus status = query.navQuery->updateSlicedFindPath(iterations, &doneIterations);
+			iterationCount += dtMax(doneIterations, 1);
+			if(dtStatusFailed(status))
+				CompleteSearch(*request, false);
+			else if(dtStatusSucceed(status))
+				CompleteSearch(*request, true);
+		}
+
+		if(request->status != PATHREQUEST_PENDING)
+		{
+			pendingFirst = (pendingFirst + 1) % (int)pending.size();
+			pendingCount--;
+			completedCount++;
+		}
+
+		if(maxMicroseconds > 0 && getPerfDeltaTimeUsec(startTime, getPerfTime()) >= maxMicroseconds)
+			break;
+	}
+
+	return completedCount;
+}
+
+RecastPathRequestStatus RecastPathQueue::GetStatus(uint handle)
+{
+	RecastPathRequest* request = GetRequest(handle);
+	if(!request)
+		return PATHREQUEST_INVALID;
+	return request->status;
+}
+
+bool RecastPathQueue::GetResult(uint handle, Vec3** outPath, int* outPathCount, bool* outPartial)
+{
+	*outPath = NULL;
+	*outPathCount = 0;
+	if(outPartial)
+		*outPartial = false;
+
+	RecastPathRequest* request = GetRequest(handle);
+	if(!request || request->status != PATHREQUEST_SUCCEEDED)
+		return false;
+
+	*outPath = request->path;
+	*outPathCount = request->pathCount;
+	if(outPartial)
+		*outPartial = request->partial;
+	request->path = NULL;
+	Release(handle);
+	return true;
+}
+
+void RecastPathQueue::Release(uint handle)
+{
+	RecastPathRequest* request = GetRequest(handle);
+	if(!request)
+		return;
+
+	//remove from the pending requests, the ones after it move up
+	if(request->status == PATHREQUEST_PENDING)
+	{
+		const int size = (int)pending.size();
+		int to = 0;
+		for(int n = 0; n < pendingCount; n++)
+		{
+			uint h = pending[(pendingFirst + n) % size];
+			if(h != handle)
+				pending[(pendingFirst + to++) % size] = h;
+		}
+		pendingCount = to;
+	}
+
+	if(request->path)
+		free(request->path);
+	*request = RecastPathRequest();
+}
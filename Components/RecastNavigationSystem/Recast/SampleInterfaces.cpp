@@ -7,6 +7,7 @@
 #include "Recast.h"
 #include "RecastDebugDraw.h"
 #include "DetourDebugDraw.h"
+#include "NeoAxis_ThreadPool.h"
 //#include "PerfTimer.h"
 //#include "SDL.h"
 //#include "SDL_opengl.h"
@@ -20,10 +21,50 @@
 	#import <Carbon/Carbon.h>
 #endif
 
+#ifndef WIN32
+#	include <sys/time.h>
+#endif
+
+// From PerfTimer.cpp of the Recast demo, which is not part of the library.
+#ifdef WIN32
+
+TimeVal getPerfTime()
+{
+	__int64 count;
+	QueryPerformanceCounter((LARGE_INTEGER*)&count);
+	return count;
+}
+
+int getPerfDeltaTimeUsec(const TimeVal start, const TimeVal end)
+{
+	static __int64 freq = 0;
+	if (freq == 0)
+		QueryPerformanceFrequency((LARGE_INTEGER*)&freq);
+	__int64 elapsed = end - start;
+	return (int)(elapsed*1000000 / freq);
+}
+
+#else
+
+TimeVal getPerfTime()
+{
+	timeval now;
+	gettimeofday(&now, 0);
+	return (TimeVal)now.tv_sec*1000000L + (TimeVal)now.tv_usec;
+}
+
+int getPerfDeltaTimeUsec(const TimeVal start, const TimeVal end)
+{
+	return (int)(end - start);
+}
+
+#endif
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-BuildContext::BuildContext()
+BuildContext::BuildContext() :
+	m_threadPool(0)
 	//m_messageCount(0),
 	//m_textPoolSize(0)
 {
@@ -94,31 +135,62 @@ void BuildContext::doLog(const rcLogCategory category, const char* msg, const in
 	//m_messages[m_messageCount++] = dst;
 }
 
-//void BuildContext::doResetTimers()
-//{
-	//for (int i = 0; i < RC_MAX_TIMERS; ++i)
-	//	m_accTime[i] = -1;
-//}
+void BuildContext::doResetTimers()
+{
+	for (int i = 0; i < RC_MAX_TIMERS; ++i)
+		m_accTime[i] = -1;
+}
 
-//void BuildContext::doStartTimer(const rcTimerLabel label)
-//{
-	//m_startTime[label] = getPerfTime();
-//}
+void BuildContext::doStartTimer(const rcTimerLabel label)
+{
+	m_startTime[label] = getPerfTime();
+}
 
-//void BuildContext::doStopTimer(const rcTimerLabel label)
-//{
-	//const TimeVal endTime = getPerfTime();
-	//const int deltaTime = (int)(endTime - m_startTime[label]);
-	//if (m_accTime[label] == -1)
-	//	m_accTime[label] = deltaTime;
-	//else
-	//	m_accTime[label] += deltaTime;
-//}
+void BuildContext::doStopTimer(const rcTimerLabel label)
+{
+	const TimeVal endTime = getPerfTime();
+	const int deltaTime = getPerfDeltaTimeUsec(m_startTime[label], endTime);
+	if (m_accTime[label] == -1)
+		m_accTime[label] = deltaTime;
+	else
+		m_accTime[label] += deltaTime;
+}
 
-//int BuildContext::doGetAccumulatedTime(const rcTimerLabel label) const
-//{
-//	return m_accTime[label];
-//}
+int BuildContext::doGetAccumulatedTime(const rcTimerLabel label) const
+{
+	return m_accTime[label];
+}
+
+int BuildContext::doGetParallelism() const
+{
+	return m_threadPool ? m_threadPool->getThreadCount() : 1;
+}
+
+struct ParallelTask
+{
+	rcParallelTaskFunc* task;
+	void* userData;
+};
+
+static void runParallelTask(void* userData, int taskIndex, int /*workerIndex*/)
+{
+	ParallelTask* parallelTask = (ParallelTask*)userData;
+	parallelTask->task(parallelTask->userData, taskIndex);
+}
+
+void BuildContext::doRunParallel(rcParallelTaskFunc* task, void* userData, const int taskCount)
+{
+	if (!m_threadPool)
+	{
+		rcContext::doRunParallel(task, userData, taskCount);
+		return;
+	}
+
+	ParallelTask parallelTask;
+	parallelTask.task = task;
+	parallelTask.userData = userData;
+	m_threadPool->run(runParallelTask, &parallelTask, taskCount);
+}
 
 void BuildContext::dumpLog(const char* format, ...)
 {
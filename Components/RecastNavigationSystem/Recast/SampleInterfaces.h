@@ -24,13 +24,21 @@
 #include "RecastDump.h"
 //#include "PerfTimer.h"
 
+class NeoAxis_ThreadPool;
+
+/// Performance counter value, see getPerfDeltaTimeUsec().
+typedef long long TimeVal;
+TimeVal getPerfTime();
+int getPerfDeltaTimeUsec(const TimeVal start, const TimeVal end);
+
 // These are example implementations of various interfaces used in Recast and Detour.
 
 /// Recast build context.
 class BuildContext : public rcContext
 {
-	//TimeVal m_startTime[RC_MAX_TIMERS];
-	//int m_accTime[RC_MAX_TIMERS];
+	TimeVal m_startTime[RC_MAX_TIMERS];
+	int m_accTime[RC_MAX_TIMERS];
+	NeoAxis_ThreadPool* m_threadPool;
 
 	//static const int MAX_MESSAGES = 1000;
 	//const char* m_messages[MAX_MESSAGES];
@@ -49,16 +57,23 @@ public:
 	//int getLogCount() const;
 	///// Returns log message text.
 	//const char* getLogText(const int i) const;
+
+	/// Threads for rcContext::runParallel, 0 runs the tasks on the calling thread. The pool must not
+	/// be running other tasks while the context is used.
+	void setThreadPool(NeoAxis_ThreadPool* threadPool) { m_threadPool = threadPool; }
+	NeoAxis_ThreadPool* getThreadPool() const { return m_threadPool; }
 	
 protected:	
 	/// Virtual functions for custom implementations.
 	///@{
 	virtual void doResetLog();
 	virtual void doLog(const rcLogCategory /*category*/, const char* /*msg*/, const int /*len*/);
-	//virtual void doResetTimers();
-	//virtual void doStartTimer(const rcTimerLabel /*label*/);
-	//virtual void doStopTimer(const rcTimerLabel /*label*/);
-	//virtual int doGetAccumulatedTime(const rcTimerLabel /*label*/) const;
+	virtual void doResetTimers();
+	virtual void doStartTimer(const rcTimerLabel /*label*/);
+	virtual void doStopTimer(const rcTimerLabel /*label*/);
+	virtual int doGetAccumulatedTime(const rcTimerLabel /*label*/) const;
+	virtual int doGetParallelism() const;
+	virtual void doRunParallel(rcParallelTaskFunc* task, void* userData, const int taskCount);
 	///@}
 };
 
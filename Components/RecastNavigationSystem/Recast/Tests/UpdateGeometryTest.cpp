@@ -0,0 +1,149 @@
+// Copyright (C) NeoAxis Group Ltd. This is part of NeoAxis 3D Engine SDK.
+
+// Test of Recast_UpdateGeometry. Adds a box far from the origin and counts the rebuilt tiles. The call
+// without extra bounds (min > max) must rebuild the same tiles as the call with the bounds of the box.
+// The program prints the results and returns 0 when all checks pass.
+//
+// Build it against the wrapper library, for example with g++:
+//   g++ -O2 -I../Library/Recast/Include UpdateGeometryTest.cpp -L<library path> -lRecast -lpthread
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include "Recast.h"
+
+struct Vec3
+{
+	float x, y, z;
+};
+
+struct RecastWorld;
+
+extern "C"
+{
+	RecastWorld* Recast_Initialize(const Vec3& bmin, const Vec3& bmax, float tileSize, float cellSize,
+		float cellHeight, int minRegionSize, int mergeRegionSize, bool monotonePartitioning, float maxEdgeLength,
+		float maxEdgeError, int vertsPerPoly, float detailSampleDistance, float detailMaxSampleError,
+		float agentHeight, float agentRadius, float agentMaxClimb, float agentMaxSlope);
+	void Recast_Destroy(RecastWorld* world);
+	void Recast_SetGeometry(RecastWorld* world, float* vertices, int vertexCount, int* indices, int indexCount,
+		int trianglesPerChunk, int threadCount);
+	void Recast_BuildAllTiles(RecastWorld* world);
+	bool Recast_UpdateGeometry(RecastWorld* world, float* vertices, int vertexCount, int* indices,
+		int indexCount, int* removeRanges, int removeRangeCount, const Vec3& changedBoundsMin,
+		const Vec3& changedBoundsMax, int* outFirstAddedTriangle);
+	int Recast_GetBuildStatistics(RecastWorld* world, float* totalBuildTime, float* stageTimes,
+		int* triangleCount, int* dataSize, void* slowestTiles, int maxSlowestTiles, int* slowestTileCount);
+	void Recast_ResetBuildStatistics(RecastWorld* world);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+const float worldSize = 150;
+
+static RecastWorld* createWorld()
+{
+	//flat terrain of worldSize x worldSize
+	const int quads = 100;
+	std::vector<float> vertices;
+	std::vector<int> indices;
+	for(int z = 0; z <= quads; z++)
+	{
+		for(int x = 0; x <= quads; x++)
+		{
+			vertices.push_back(x * worldSize / quads);
+			vertices.push_back(0);
+			vertices.push_back(z * worldSize / quads);
+		}
+	}
+	for(int z = 0; z < quads; z++)
+	{
+		for(int x = 0; x < quads; x++)
+		{
+			int a = z * (quads + 1) + x;
+			int b = a + 1;
+			int c = a + quads + 1;
+			int d = c + 1;
+			int quad[6] = { a, c, b, b, c, d };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	Vec3 bmin = { -1, -5, -1 };
+	Vec3 bmax = { worldSize + 1, 10, worldSize + 1 };
+	RecastWorld* world = Recast_Initialize(bmin, bmax, 32, .3f, .2f, 8, 20, false, 12, 1.3f, 6, 6, 1, 2, .6f,
+		.9f, 45);
+	Recast_SetGeometry(world, &vertices[0], (int)vertices.size() / 3, &indices[0], (int)indices.size(), 256, 1);
+	Recast_BuildAllTiles(world);
+	return world;
+}
+
+static void createBox(const Vec3& bmin, const Vec3& bmax, std::vector<float>& vertices, std::vector<int>& indices)
+{
+	for(int n = 0; n < 8; n++)
+	{
+		vertices.push_back(n & 1 ? bmax.x : bmin.x);
+		vertices.push_back(n & 4 ? bmax.y : bmin.y);
+		vertices.push_back(n & 2 ? bmax.z : bmin.z);
+	}
+	int faces[36] = { 0,2,1, 1,2,3, 4,5,6, 5,7,6, 0,1,4, 1,5,4, 2,6,3, 3,6,7, 0,4,2, 2,4,6, 1,3,5, 3,7,5 };
+	indices.insert(indices.end(), faces, faces + 36);
+}
+
+//returns the count of tiles rebuilt by adding the box
+static int addBox(const Vec3& changedBoundsMin, const Vec3& changedBoundsMax)
+{
+	RecastWorld* world = createWorld();
+
+	Vec3 boxMin = { 100, -2, 20 };
+	Vec3 boxMax = { 105, 3, 25 };
+	std::vector<float> vertices;
+	std::vector<int> indices;
+	createBox(boxMin, boxMax, vertices, indices);
+
+	Recast_ResetBuildStatistics(world);
+	int firstTriangle;
+	bool result = Recast_UpdateGeometry(world, &vertices[0], (int)vertices.size() / 3, &indices[0],
+		(int)indices.size(), NULL, 0, changedBoundsMin, changedBoundsMax, &firstTriangle);
+
+	float totalBuildTime;
+	float stageTimes[RC_MAX_TIMERS];
+	int triangleCount;
+	int dataSize;
+	int slowestTileCount;
+	int tileCount = Recast_GetBuildStatistics(world, &totalBuildTime, stageTimes, &triangleCount, &dataSize,
+		NULL, 0, &slowestTileCount);
+
+	Recast_Destroy(world);
+	return result ? tileCount : -1;
+}
+
+int main()
+{
+	int failed = 0;
+
+	Vec3 boxMin = { 100, -2, 20 };
+	Vec3 boxMax = { 105, 3, 25 };
+	int boxTiles = addBox(boxMin, boxMax);
+	printf("bounds of the box: %d tiles\n", boxTiles);
+	if(boxTiles <= 0)
+		failed++;
+
+	//min > max on all axes and on one axis only
+	Vec3 emptyMin = { 1, 1, 1 };
+	Vec3 emptyMax = { 0, 0, 0 };
+	int emptyTiles = addBox(emptyMin, emptyMax);
+	printf("no bounds: %d tiles\n", emptyTiles);
+	if(emptyTiles != boxTiles)
+		failed++;
+
+	Vec3 oneAxisMin = { 0, 1, 0 };
+	Vec3 oneAxisMax = { worldSize, 0, worldSize };
+	int oneAxisTiles = addBox(oneAxisMin, oneAxisMax);
+	printf("no bounds, min > max on one axis: %d tiles\n", oneAxisTiles);
+	if(oneAxisTiles != boxTiles)
+		failed++;
+
+	printf(failed ? "FAILED\n" : "PASSED\n");
+	return failed ? 1 : 0;
+}
@@ -25,6 +25,49 @@ namespace Engine
 
 	//////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+	[StructLayout( LayoutKind.Sequential )]
+	struct DebugPolygon
+	{
+		public uint reference;
+		public int firstTriangle;
+		public int triangleCount;
+		public ushort flags;
+		public byte area;
+		public byte padding;
+	}
+
+	[StructLayout( LayoutKind.Sequential )]
+	struct RaycastResult
+	{
+		public Vec3 position;
+		public Vec3 normal;
+		public float fraction;
+		//0 - no navmesh at the start, 1 - reached the end, 2 - hit
+		public int status;
+	}
+
+	[StructLayout( LayoutKind.Sequential )]
+	struct TileBuildStatistics
+	{
+		public int x;
+		public int y;
+		public float buildTime;
+		public int triangleCount;
+		public int polygonCount;
+		public int dataSize;
+		public int heightfieldMemory;
+	}
+
+	//item of Wrapper.CrowdUpdate, RecastCrowdAgent of the wrapper
+	[StructLayout( LayoutKind.Sequential )]
+	struct CrowdAgentState
+	{
+		public Vec3 position;
+		public Vec3 velocity;
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 	struct Wrapper
 	{
 		public const string library = "Recast";
@@ -41,7 +84,8 @@ namespace Engine
 
 		[DllImport( Wrapper.library, EntryPoint = "Recast_NavQueryInit", CallingConvention = Wrapper.convention )]
 		[return: MarshalAs( UnmanagedType.U1 )]
-		public unsafe static extern bool NavQueryInit( IntPtr world, int maxNodes );
+		public unsafe static extern bool NavQueryInit( IntPtr world, int maxNodes,
+			[MarshalAs( UnmanagedType.U1 )] bool openAddressing );
 
 		[DllImport( Wrapper.library, EntryPoint = "Recast_GetSizes", CallingConvention = Wrapper.convention )]
 		public unsafe static extern void GetSizes( IntPtr world, out int maxTiles, out int maxPolysPerTile );
@@ -49,12 +93,69 @@ namespace Engine
 		[DllImport( Wrapper.library, EntryPoint = "Recast_BuildAllTiles", CallingConvention = Wrapper.convention )]
 		public unsafe static extern void BuildAllTiles( IntPtr world );
 
+		[DllImport( Wrapper.library, EntryPoint = "Recast_BuildAllTilesParallel", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void BuildAllTilesParallel( IntPtr world, int threadCount );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_BuildTileCache", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool BuildTileCache( IntPtr world, int maxObstacles, int threadCount );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_AddCylinderObstacle", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool AddCylinderObstacle( IntPtr world, ref Vec3 position, float radius, float height,
+			out uint outObstacle );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_AddBoxObstacle", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool AddBoxObstacle( IntPtr world, ref Vec3 boundsMin, ref Vec3 boundsMax,
+			out uint outObstacle );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_RemoveObstacle", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool RemoveObstacle( IntPtr world, uint obstacle );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_UpdateTileCache", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool UpdateTileCache( IntPtr world, float delta,
+			[MarshalAs( UnmanagedType.U1 )] out bool upToDate );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_GetTileCacheStatistics", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void GetTileCacheStatistics( IntPtr world, out int layerCount, out int compressedSize,
+			out int rawSize );
+
+		//stageTimes must hold 28 values (RC_MAX_TIMERS), times are in milliseconds
+		[DllImport( Wrapper.library, EntryPoint = "Recast_GetBuildStatistics", CallingConvention = Wrapper.convention )]
+		public unsafe static extern int GetBuildStatistics( IntPtr world, out float totalBuildTime, float* stageTimes,
+			out int triangleCount, out int dataSize, TileBuildStatistics* slowestTiles, int maxSlowestTiles,
+			out int slowestTileCount );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_ResetBuildStatistics", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void ResetBuildStatistics( IntPtr world );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_BenchmarkRasterization", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool BenchmarkRasterization( IntPtr world, int iterations, out float scalarTime,
+			out float simdTime, [MarshalAs( UnmanagedType.U1 )] out bool identical );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_SetSimdRasterization", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool SetSimdRasterization( [MarshalAs( UnmanagedType.U1 )] bool enabled );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_SetParallelRegionBuild", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void SetParallelRegionBuild( IntPtr world, int threadCount );
+
 		[DllImport( Wrapper.library, EntryPoint = "Recast_DestroyAllTiles", CallingConvention = Wrapper.convention )]
 		public unsafe static extern void DestroyAllTiles( IntPtr world );
 
 		[DllImport( Wrapper.library, EntryPoint = "Recast_SetGeometry", CallingConvention = Wrapper.convention )]
 		public unsafe static extern void SetGeometry( IntPtr world, IntPtr vertices, int vertexCount,
-			IntPtr indices, int indexCount, int trianglesPerChunk );
+			IntPtr indices, int indexCount, int trianglesPerChunk, int threadCount );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_UpdateGeometry", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool UpdateGeometry( IntPtr world, IntPtr vertices, int vertexCount,
+			IntPtr indices, int indexCount, IntPtr removeRanges, int removeRangeCount, ref Vec3 changedBoundsMin,
+			ref Vec3 changedBoundsMax, out int outFirstAddedTriangle );
 
 		[DllImport( Wrapper.library, EntryPoint = "Recast_Destroy", CallingConvention = Wrapper.convention )]
 		public unsafe static extern void Destroy( IntPtr world );
@@ -64,11 +165,102 @@ namespace Engine
 		public unsafe static extern bool GetNavigationMesh( IntPtr world, out Vec3* vertices,
 			out int vertexCount );
 
+		//pass tileMaxX < tileMinX for all tiles. outPolygons is optional
+		[DllImport( Wrapper.library, EntryPoint = "Recast_GetNavigationMeshIndexed", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool GetNavigationMeshIndexed( IntPtr world, int tileMinX, int tileMinY,
+			int tileMaxX, int tileMaxY, out Vec3* outVertices, out int outVertexCount, out int* outIndices,
+			out int outIndexCount, DebugPolygon** outPolygons, int* outPolygonCount );
+
 		[DllImport( Wrapper.library, EntryPoint = "Recast_FindPath", CallingConvention = Wrapper.convention )]
 		[return: MarshalAs( UnmanagedType.U1 )]
 		public unsafe static extern bool FindPath( IntPtr world, ref Vec3 start, ref Vec3 end, float stepSize,
 			ref Vec3 polygonPickExtents, int maxPolygonPath, int maxSmoothPath, int maxSteerPoints,
-			out Vec3* outPath, out int outPathCount );
+			IntPtr filter, out Vec3* outPath, out int outPathCount );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_FindStraightPath", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool FindStraightPath( IntPtr world, ref Vec3 start, ref Vec3 end,
+			ref Vec3 polygonPickExtents, int maxPolygonPath, int maxStraightPath, IntPtr filter, out Vec3* outPath,
+			byte** outFlags, uint** outPolygons, out int outPathCount );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_FindStraightPathHierarchical", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool FindStraightPathHierarchical( IntPtr world, ref Vec3 start, ref Vec3 end,
+			ref Vec3 polygonPickExtents, int maxPolygonPath, int maxStraightPath, IntPtr filter, out Vec3* outPath,
+			byte** outFlags, uint** outPolygons, out int outPathCount );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_Raycast", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool Raycast( IntPtr world, ref Vec3 start, ref Vec3 end, ref Vec3 polygonPickExtents,
+			IntPtr filter, [MarshalAs( UnmanagedType.U1 )] out bool outHit, out float outHitFraction,
+			out Vec3 outHitPosition, out Vec3 outHitNormal );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_UpdatePortalGraph", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool UpdatePortalGraph( IntPtr world, IntPtr filter, out int outUpdatedTileCount,
+			out int outTileCount, out int outPortalCount );
+
+		//maxEntries 0 disables the cache
+		[DllImport( Wrapper.library, EntryPoint = "Recast_SetPathCacheSize", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void SetPathCacheSize( IntPtr world, int maxEntries );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_GetPathCacheStatistics", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void GetPathCacheStatistics( IntPtr world, out int outHitCount, out int outMissCount,
+			out int outInvalidatedCount, out int outEntryCount );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_ResetPathCacheStatistics", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void ResetPathCacheStatistics( IntPtr world );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_FindPathsBatch", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool FindPathsBatch( IntPtr world, int queryCount, Vec3* starts, Vec3* ends,
+			float stepSize, ref Vec3 polygonPickExtents, int maxPolygonPath, int maxSmoothPath, int maxSteerPoints,
+			IntPtr filter, int threadCount, out Vec3* outPoints, out int outPointCount, int* outPathOffsets,
+			int* outPathCounts );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_RaycastBatch", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool RaycastBatch( IntPtr world, int queryCount, Vec3* starts, Vec3* ends,
+			ref Vec3 polygonPickExtents, IntPtr filter, int threadCount, RaycastResult* outResults );
+
+		//outPolygons can be null
+		[DllImport( Wrapper.library, EntryPoint = "Recast_FindNearestPointBatch", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool FindNearestPointBatch( IntPtr world, int queryCount, Vec3* positions,
+			ref Vec3 polygonPickExtents, IntPtr filter, int threadCount, Vec3* outPoints, uint* outPolygons );
+
+		//outHitPositions and outHitNormals can be null
+		[DllImport( Wrapper.library, EntryPoint = "Recast_FindDistanceToWallBatch", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool FindDistanceToWallBatch( IntPtr world, int queryCount, Vec3* positions,
+			float* maxRadii, ref Vec3 polygonPickExtents, IntPtr filter, int threadCount, float* outDistances,
+			Vec3* outHitPositions, Vec3* outHitNormals );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_FindPolygonsAroundCircleBatch", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool FindPolygonsAroundCircleBatch( IntPtr world, int queryCount, Vec3* centers,
+			float* radii, ref Vec3 polygonPickExtents, int maxPolygons, IntPtr filter, int threadCount,
+			out uint* outPolygons, out int outPolygonCount, int* outOffsets, int* outCounts );
+
+		//filters of the queries, IntPtr.Zero means the default filter
+		[DllImport( Wrapper.library, EntryPoint = "Recast_CreateQueryFilter", CallingConvention = Wrapper.convention )]
+		public unsafe static extern IntPtr CreateQueryFilter();
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_DestroyQueryFilter", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void DestroyQueryFilter( IntPtr filter );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_SetQueryFilterFlags", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void SetQueryFilterFlags( IntPtr filter, int includeFlags, int excludeFlags );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_SetQueryFilterAreaCost", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void SetQueryFilterAreaCost( IntPtr filter, int area, float cost );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_SetQueryFilterAreaCosts", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void SetQueryFilterAreaCosts( IntPtr filter, float* costs, int costCount );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_SetQueryFilterTerrainAreaCosts", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void SetQueryFilterTerrainAreaCosts( IntPtr filter );
 
 		[DllImport( Wrapper.library, EntryPoint = "Recast_FreeMemory", CallingConvention = Wrapper.convention )]
 		public unsafe static extern void FreeMemory( IntPtr pointer );
@@ -77,14 +269,92 @@ namespace Engine
 		[return: MarshalAs( UnmanagedType.U1 )]
 		public unsafe static extern bool LoadNavMesh( IntPtr world, IntPtr data, int dataSize );
 
+		[DllImport( Wrapper.library, EntryPoint = "Recast_LoadNavMeshMapped", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool LoadNavMeshMapped( IntPtr world, string fileName, int threadCount );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_LoadNavMeshParallel", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool LoadNavMeshParallel( IntPtr world, IntPtr data, int dataSize, int threadCount );
+
 		[DllImport( Wrapper.library, EntryPoint = "Recast_SaveNavMesh", CallingConvention = Wrapper.convention )]
 		public unsafe static extern void SaveNavMesh( IntPtr world, out IntPtr data, out int dataSize );
 
+		[UnmanagedFunctionPointer( Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public delegate bool WriteNavMeshDelegate( IntPtr userData, IntPtr data, int size );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_SaveNavMeshStream", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool SaveNavMeshStream( IntPtr world, WriteNavMeshDelegate write, IntPtr userData,
+			[MarshalAs( UnmanagedType.U1 )] bool compress, int threadCount );
+
 		[DllImport( Wrapper.library, EntryPoint = "Recast_BuildTile", CallingConvention = Wrapper.convention )]
 		public unsafe static extern void BuildTile( IntPtr world, ref Vec3 position );
 
 		[DllImport( Wrapper.library, EntryPoint = "Recast_RemoveTile", CallingConvention = Wrapper.convention )]
 		public unsafe static extern void RemoveTile( IntPtr world, ref Vec3 position );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_CreateCrowd", CallingConvention = Wrapper.convention )]
+		public unsafe static extern IntPtr CreateCrowd( IntPtr world, int maxAgents, float maxAgentRadius );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_DestroyCrowd", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void DestroyCrowd( IntPtr crowd );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_CrowdAddAgent", CallingConvention = Wrapper.convention )]
+		public unsafe static extern int CrowdAddAgent( IntPtr crowd, ref Vec3 position, float radius, float height,
+			float maxAcceleration, float maxSpeed, float collisionQueryRange, float pathOptimizationRange,
+			float separationWeight, int updateFlags, int obstacleAvoidanceType );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_CrowdRemoveAgent", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void CrowdRemoveAgent( IntPtr crowd, int agent );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_CrowdSetTargets", CallingConvention = Wrapper.convention )]
+		public unsafe static extern int CrowdSetTargets( IntPtr crowd, int count, int* agents, Vec3* targets,
+			ref Vec3 polygonPickExtents );
+
+		//outStates contains position and velocity of every agent slot, the pointer is owned by the crowd.
+		//after the navmesh or the tiles under the agents are rebuilt the agents are moved to them with the same indices,
+		//the slots of agents which are not placed on the new navmesh become empty. false without navmesh.
+		[DllImport( Wrapper.library, EntryPoint = "Recast_CrowdUpdate", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool CrowdUpdate( IntPtr crowd, float delta, out CrowdAgentState* outStates,
+			out int outAgentCount );
+
+		public enum PathRequestStatus
+		{
+			Invalid,
+			Pending,
+			Succeeded,
+			Failed,
+		}
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_CreatePathQueue", CallingConvention = Wrapper.convention )]
+		public unsafe static extern IntPtr CreatePathQueue( IntPtr world, int maxRequests, int maxNodes );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_DestroyPathQueue", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void DestroyPathQueue( IntPtr queue );
+
+		//returns 0 if the queue is full
+		[DllImport( Wrapper.library, EntryPoint = "Recast_PathQueueRequest", CallingConvention = Wrapper.convention )]
+		public unsafe static extern uint PathQueueRequest( IntPtr queue, ref Vec3 start, ref Vec3 end,
+			ref Vec3 polygonPickExtents, int maxPolygonPath, int maxStraightPath, IntPtr filter );
+
+		//maxIterations and maxMicroseconds <= 0 mean no limit, returns the number of completed requests
+		[DllImport( Wrapper.library, EntryPoint = "Recast_PathQueueUpdate", CallingConvention = Wrapper.convention )]
+		public unsafe static extern int PathQueueUpdate( IntPtr queue, int maxIterations, int maxMicroseconds );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_PathQueueGetStatus", CallingConvention = Wrapper.convention )]
+		public unsafe static extern PathRequestStatus PathQueueGetStatus( IntPtr queue, uint handle );
+
+		//releases the request, outPath must be freed with FreeMemory
+		[DllImport( Wrapper.library, EntryPoint = "Recast_PathQueueGetResult", CallingConvention = Wrapper.convention )]
+		[return: MarshalAs( UnmanagedType.U1 )]
+		public unsafe static extern bool PathQueueGetResult( IntPtr queue, uint handle, out Vec3* outPath,
+			out int outPathCount, [MarshalAs( UnmanagedType.U1 )] out bool outPartial );
+
+		[DllImport( Wrapper.library, EntryPoint = "Recast_PathQueueRelease", CallingConvention = Wrapper.convention )]
+		public unsafe static extern void PathQueueRelease( IntPtr queue, uint handle );
 	}
 
 	//////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -159,6 +429,12 @@ namespace Engine
 		[FieldSerialize( "pathfindingMaxNodes" )]
 		int pathfindingMaxNodes = 8192;
 
+		[FieldSerialize( "pathfindingFastNodePool" )]
+		bool pathfindingFastNodePool;
+
+		[FieldSerialize( "pathfindingCacheSize" )]
+		int pathfindingCacheSize;
+
 		[FieldSerialize( "dataDirectory" )]
 		string dataDirectory = "RecastNavigationSystem";
 
@@ -552,7 +828,39 @@ namespace Engine
 				pathfindingMaxNodes = value;
 
 				if( recastWorld != IntPtr.Zero )
-					Wrapper.NavQueryInit( recastWorld, pathfindingMaxNodes );
+					Wrapper.NavQueryInit( recastWorld, pathfindingMaxNodes, pathfindingFastNodePool );
+			}
+		}
+
+		[Category( "Pathfinding" )]
+		[DefaultValue( false )]
+		[LocalizedDescription( "Use the open addressing node pool and the 4-ary open list, which are faster for short paths.", "RecastNavigationSystem" )]
+		public bool PathfindingFastNodePool
+		{
+			get { return pathfindingFastNodePool; }
+			set
+			{
+				pathfindingFastNodePool = value;
+
+				if( recastWorld != IntPtr.Zero )
+					Wrapper.NavQueryInit( recastWorld, pathfindingMaxNodes, pathfindingFastNodePool );
+			}
+		}
+
+		[Category( "Pathfinding" )]
+		[DefaultValue( 0 )]
+		[LocalizedDescription( "Number of recently found polygon corridors to reuse for the same start and end polygons. 0 disables the cache.", "RecastNavigationSystem" )]
+		public int PathfindingCacheSize
+		{
+			get { return pathfindingCacheSize; }
+			set
+			{
+				if( value < 0 )
+					value = 0;
+				pathfindingCacheSize = value;
+
+				if( recastWorld != IntPtr.Zero )
+					Wrapper.SetPathCacheSize( recastWorld, pathfindingCacheSize );
 			}
 		}
 
@@ -593,7 +901,7 @@ namespace Engine
 					{
 						if( Wrapper.LoadNavMesh( recastWorld, (IntPtr)pData, data.Length ) )
 						{
-							Wrapper.NavQueryInit( recastWorld, pathfindingMaxNodes );
+							Wrapper.NavQueryInit( recastWorld, pathfindingMaxNodes, pathfindingFastNodePool );
 						}
 					}
 				}
@@ -731,7 +1039,8 @@ namespace Engine
 
 				if( recastWorld != IntPtr.Zero )
 				{
-					Wrapper.NavQueryInit( recastWorld, pathfindingMaxNodes );
+					Wrapper.NavQueryInit( recastWorld, pathfindingMaxNodes, pathfindingFastNodePool );
+					Wrapper.SetPathCacheSize( recastWorld, pathfindingCacheSize );
 				}
 
 				//if( recastWorld != IntPtr.Zero )
@@ -815,7 +1124,7 @@ namespace Engine
 						fixed( int* pIndices = indices )
 						{
 							Wrapper.SetGeometry( recastWorld, (IntPtr)pVertices, vertexCount, (IntPtr)pIndices,
-								indexCount, trianglesPerChunk );
+								indexCount, trianglesPerChunk, 0 );
 
 							Wrapper.BuildAllTiles( recastWorld );
 						}
@@ -1173,7 +1482,7 @@ namespace Engine
 				Vec3* pathPointer;
 				int pathCount;
 				bool result = Wrapper.FindPath( recastWorld, ref recastStart, ref recastEnd, stepSize,
-					ref recastPolygonPickExtents, maxPolygonPath, maxSmoothPath, maxSteerPoints,
+					ref recastPolygonPickExtents, maxPolygonPath, maxSmoothPath, maxSteerPoints, IntPtr.Zero,
 					out pathPointer, out pathCount );
 
 				if( result )
@@ -1370,12 +1679,11 @@ namespace Engine
 
 			if( debugNavigationMeshVertices == null )
 			{
-				if( !GetDebugNavigationMeshGeometry( out debugNavigationMeshVertices ) )
+				if( !GetDebugNavigationMeshGeometry( out debugNavigationMeshVertices,
+					out debugNavigationMeshIndices ) )
+				{
 					return;
-
-				debugNavigationMeshIndices = new int[ debugNavigationMeshVertices.Length ];
-				for( int n = 0; n < debugNavigationMeshIndices.Length; n++ )
-					debugNavigationMeshIndices[ n ] = n;
+				}
 			}
 
 			//Render NavMesh
@@ -1517,6 +1825,40 @@ namespace Engine
 			return true;
 		}
 
+		public bool GetDebugNavigationMeshGeometry( out Vec3[] vertices, out int[] indices )
+		{
+			vertices = null;
+			indices = null;
+
+			if( recastWorld == IntPtr.Zero )
+				return false;
+
+			unsafe
+			{
+				Vec3* nativeVertices;
+				int vertexCount;
+				int* nativeIndices;
+				int indexCount;
+				if( !Wrapper.GetNavigationMeshIndexed( recastWorld, 0, 0, -1, -1, out nativeVertices,
+					out vertexCount, out nativeIndices, out indexCount, null, null ) )
+				{
+					return false;
+				}
+
+				vertices = new Vec3[ vertexCount ];
+				for( int n = 0; n < vertices.Length; n++ )
+					vertices[ n ] = ToEngineVec3( nativeVertices[ n ] );
+
+				indices = new int[ indexCount ];
+				Marshal.Copy( (IntPtr)nativeIndices, indices, 0, indexCount );
+
+				Wrapper.FreeMemory( (IntPtr)nativeVertices );
+				Wrapper.FreeMemory( (IntPtr)nativeIndices );
+			}
+
+			return true;
+		}
+
 		public void AddGeometry( Entity entity )
 		{
 			if( geometries.Contains( entity ) )